@@ -0,0 +1,59 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#include <animEngine.h>
+#include <poseEngine.h>
+
+int
+main (int argc, char *argv[])
+{
+	EtChannel *channelList;
+	EtPose *pose;
+	EtInt	numCurves;
+
+	/* make sure we have been given the names of the files */
+	if (argc < 3) {
+		fprintf (stderr, "##### Usage: %s .anim file .pose file\n", argv[0]);
+		exit (-1);
+	}
+
+	/* read in the list of channels */
+	channelList = engineAnimReadCurves (argv[1], &numCurves);
+	if (channelList == kEngineNULL) {
+		fprintf (stderr, "##### Unable to parse %s\n", argv[1]);
+		exit (-1);
+	}
+
+	/* compile them, and save the pose */
+	pose = enginePoseCreate (channelList);
+	engineAnimFreeChannelList (channelList);
+	if (pose == kEngineNULL) {
+		fprintf (stderr, "##### Unable to compile %s\n", argv[1]);
+		exit (-1);
+	}
+	if (!enginePoseSave (pose, argv[2])) {
+		fprintf (stderr, "##### Unable to write %s\n", argv[2]);
+		enginePoseFree (pose);
+		exit (-1);
+	}
+	printf ("%s: %d channels\n", argv[2], enginePoseNumChannels (pose));
+	enginePoseFree (pose);
+
+	/* make sure the pose can be loaded again */
+	pose = enginePoseLoad (argv[2]);
+	if (pose == kEngineNULL) {
+		fprintf (stderr, "##### Unable to load %s\n", argv[2]);
+		exit (-1);
+	}
+	enginePoseFree (pose);
+
+	return (0);
+}
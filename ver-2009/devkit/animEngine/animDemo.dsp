@@ -98,6 +98,10 @@ SOURCE=.\fileEngine.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\poseEngine.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\utilEngine.c
 # End Source File
 # End Group
@@ -118,6 +122,10 @@ SOURCE=.\fileEngine.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\poseEngine.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\utilEngine.h
 # End Source File
 # End Group
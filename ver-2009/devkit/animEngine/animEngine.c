@@ -605,7 +605,7 @@ engineAnimReadCurves (EtFileName fileName, EtInt *numCurves)
 	buffer = engineFileReadWord (animFile);
 	while ((buffer != NULL) && !engineUtilStringsMatch (buffer, (EtByte *)"animVersion")) {
 		/* Eat the rest of the line */
-		while (engineFileReadByte (animFile, buffer) && (buffer[0] >= ' ')) {}
+		engineFileSkipLine (animFile);
 		buffer = engineFileReadWord (animFile);
 	}
 	if (buffer == NULL) {
@@ -625,7 +625,7 @@ engineAnimReadCurves (EtFileName fileName, EtInt *numCurves)
 	/* timeUnit */
 	while ((buffer != NULL) && !engineUtilStringsMatch (buffer, (EtByte *)"timeUnit")) {
 		/* Eat the rest of the line */
-		while (engineFileReadByte (animFile, buffer) && (buffer[0] >= ' ')) {}
+		engineFileSkipLine (animFile);
 		buffer = engineFileReadWord (animFile);
 	}
 	if (buffer == NULL) {
@@ -656,7 +656,7 @@ engineAnimReadCurves (EtFileName fileName, EtInt *numCurves)
 	buffer = (continueReading ? engineFileReadWord (animFile) : NULL);
 	while ((buffer != NULL) && !engineUtilStringsMatch (buffer, (EtByte *)"angularUnit")) {
 		/* Eat the rest of the line */
-		while (engineFileReadByte (animFile, buffer) && (buffer[0] >= ' ')) {}
+		engineFileSkipLine (animFile);
 		buffer = engineFileReadWord (animFile);
 	}
 	if (buffer == NULL) {
@@ -702,7 +702,7 @@ engineAnimReadCurves (EtFileName fileName, EtInt *numCurves)
 					}
 				}
 				/* Eat the rest of the line */
-				while (engineFileReadByte (animFile, buffer) && (buffer[0] >= ' ')) {}
+				engineFileSkipLine (animFile);
 			}
 		}
 		/* animData */
@@ -753,7 +753,7 @@ engineAnimReadCurves (EtFileName fileName, EtInt *numCurves)
 						}
 						else if (buffer[0] != '{') {
 							readKey = (EtReadKey *)engineUtilAllocate (sizeof (EtReadKey));
-							readKey->time = (EtTime)atof ((const char *)buffer) / frameRate;
+							readKey->time = (EtTime)engineFileParseFloat (buffer) / frameRate;
 							readKey->value = (EtValue)engineFileReadFloat (animFile) * unitConversion;
 							readKey->inTangentType = wordAsTangentType (engineFileReadWord (animFile));
 							readKey->outTangentType = wordAsTangentType (engineFileReadWord (animFile));
@@ -789,7 +789,7 @@ engineAnimReadCurves (EtFileName fileName, EtInt *numCurves)
 				}
 				else {
 					/* Eat the rest of the line */
-					while (engineFileReadByte (animFile, buffer) && (buffer[0] >= ' ')) {}
+					engineFileSkipLine (animFile);
 				}
 			}
 			if (numKeys != 0) {
@@ -825,7 +825,7 @@ engineAnimReadCurves (EtFileName fileName, EtInt *numCurves)
 		}
 		else if (continueReading) {
 			/* Eat the rest of the line */
-			while (engineFileReadByte (animFile, buffer) && (buffer[0] >= ' ')) {}
+			engineFileSkipLine (animFile);
 		}
 	}
 
@@ -1833,3 +1833,104 @@ engineAnimEvaluate (EtCurve *animCurve, EtTime time)
 	}
 	return (value);
 }
+
+/*
+//	Function Name:
+//		engineAnimSegment
+//
+//	Description:
+//		A function to compute the polynomials of one segment of an
+//	animation curve, so the segment can be evaluated without the curve's
+//	evaluate cache (see poseEngine.c)
+//
+//  Input Arguments:
+//		EtCurve *animCurve			The animation curve
+//		EtInt index					The key that starts the segment
+//										(0 to numKeys - 2)
+//		EtSegment *segment			Where to return the segment
+//
+//  Return Value:
+//		EtBoolean result
+//			kEngineTRUE				the segment was computed
+//			kEngineFALSE			index is not the start of a segment
+//
+//	Note:
+//		For a weighted segment the value at time is y(t), where t solves
+//	x(t) = (time - key time) / (next key time - key time).  Otherwise
+//	t = time - key time.  Step segments have a constant y.  The curve's
+//	evaluate cache is not changed.
+*/
+EtBoolean
+engineAnimSegment (EtCurve *animCurve, EtInt index, EtSegment *segment)
+{
+	EtCurve scratch;
+	EtKey *key;
+	EtKey *nextKey;
+	EtValue x[4];
+	EtValue y[4];
+	EtInt i;
+
+	/* make sure we have a segment to compute */
+	if ((animCurve == kEngineNULL) || (segment == kEngineNULL)) {
+		return (kEngineFALSE);
+	}
+	if ((index < 0) || (index >= animCurve->numKeys - 1)) {
+		return (kEngineFALSE);
+	}
+	key = &(animCurve->keyList[index]);
+	nextKey = &(animCurve->keyList[index + 1]);
+
+	/* by default the segment is constant */
+	segment->isWeighted = kEngineFALSE;
+	for (i = 0; i < 4; i++) {
+		segment->x[i] = 0.0;
+		segment->y[i] = 0.0;
+	}
+	segment->x[1] = 1.0;
+
+	/* step tangents hold one of the key values */
+	if ((key->outTanX == 0.0) && (key->outTanY == 0.0)) {
+		segment->y[0] = key->value;
+		return (kEngineTRUE);
+	}
+	if ((key->outTanX == kEngineFloatMax) && (key->outTanY == kEngineFloatMax)) {
+		segment->y[0] = nextKey->value;
+		return (kEngineTRUE);
+	}
+	if (nextKey->time == key->time) {
+		segment->y[0] = key->value;
+		return (kEngineTRUE);
+	}
+
+	/* the same control points engineAnimEvaluate uses */
+	x[0] = key->time;
+	y[0] = key->value;
+	x[1] = x[0] + (key->outTanX * kOneThird);
+	y[1] = y[0] + (key->outTanY * kOneThird);
+	x[3] = nextKey->time;
+	y[3] = nextKey->value;
+	x[2] = x[3] - (nextKey->inTanX * kOneThird);
+	y[2] = y[3] - (nextKey->inTanY * kOneThird);
+
+	/* build the segment on a copy, so the evaluate cache is untouched */
+	scratch = *animCurve;
+	if (animCurve->isWeighted) {
+		engineBezierCreate (&scratch, x, y);
+		segment->isWeighted = kEngineTRUE;
+		if (!scratch.isLinear) {
+			for (i = 0; i < 4; i++) {
+				segment->x[i] = scratch.fCoeff[i];
+			}
+		}
+		for (i = 0; i < 4; i++) {
+			segment->y[i] = scratch.fPolyY[i];
+		}
+	}
+	else {
+		engineHermiteCreate (&scratch, x, y);
+		for (i = 0; i < 4; i++) {
+			segment->y[i] = scratch.fCoeff[3 - i];
+		}
+	}
+	return (kEngineTRUE);
+}
@@ -17,5 +17,6 @@
 EtChannel *engineAnimReadCurves (EtFileName fileName, EtInt *numCurves);
 EtVoid engineAnimFreeChannelList (EtChannel *channelList);
 EtValue engineAnimEvaluate (EtCurve *animCurve, EtTime time);
+EtBoolean engineAnimSegment (EtCurve *animCurve, EtInt index, EtSegment *segment);
 
 #endif
@@ -17,16 +17,33 @@
 #include <fcntl.h>
 #ifdef WIN32
 #	include <io.h>
+#	include <windows.h>
 #pragma warning (disable : 4244)
 #else
 #	include <unistd.h>
+#	include <sys/types.h>
+#	include <sys/stat.h>
+#	include <sys/mman.h>
+#	include <pthread.h>
+#	define kFileCanMap	/* large files are memory mapped				*/
+#endif
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#	include <xmmintrin.h>
+#	define kEngineHasSSE	/* evaluate poses four channels at a time	*/
+#endif
+#ifndef O_BINARY
+#	define O_BINARY 0
 #endif
 #include <string.h>
 #include <math.h>
+#include <float.h>
+#include <limits.h>
 #include <values.h>
 
 /* Constants ============================================================== */
 #define kFileMaxWordSize 256	/* maximum size of a word					*/
+#define kFileMaxOpen 32			/* maximum number of files open at once		*/
+#define kFileMapThreshold 65536	/* smaller files are read, not mapped		*/
 
 /* Common types =========================================================== */
 typedef int EtInt;			/* natural int representation					*/
@@ -94,6 +111,16 @@ struct EtCurve {
 };
 typedef struct EtCurve EtCurve;
 
+/* one segment of an animation curve, as polynomials in a parameter t	*/
+struct EtSegment {
+	EtBoolean	isWeighted;	/* whether t must be solved for (bezier) or	*/
+							/* is simply the time since the segment start */
+	EtValue		x[4];		/* normalised time as a polynomial in t		*/
+							/* (weighted segments only)					*/
+	EtValue		y[4];		/* value as a polynomial in t				*/
+};
+typedef struct EtSegment EtSegment;
+
 struct EtChannel {
 	EtByte *			channel;	/* the name of the channel				*/
 	EtCurve *			curve;		/* the animation curve					*/
@@ -101,4 +128,85 @@ struct EtChannel {
 };
 typedef struct EtChannel EtChannel;
 
+/* Pose Engine ============================================================ */
+struct EtPoseSegment {
+	EtValue		range;		/* time to normalised time divisor (1 if	*/
+							/* the segment is not weighted)				*/
+	EtValue		maxT;		/* upper bound of t (1 if weighted)			*/
+	EtValue		x[4];		/* see EtSegment							*/
+	EtValue		y[4];		/* see EtSegment							*/
+};
+typedef struct EtPoseSegment EtPoseSegment;
+
+/*
+// A pose's read-only data is a single image, which enginePoseSave writes
+// out as is and enginePoseLoad maps back in.  Sections are found through
+// byte offsets from the start of the image, so it can live anywhere.
+*/
+#define kPoseMagic "EPOS"	/* first four bytes of a pose image			*/
+#define kPoseVersion 1		/* layout version of a pose image			*/
+#define kPoseByteOrder 0x01020304	/* to detect images from other hosts */
+
+struct EtPoseHeader {
+	EtByte		magic[4];	/* kPoseMagic								*/
+	EtInt		version;	/* kPoseVersion								*/
+	EtInt		byteOrder;	/* kPoseByteOrder, as written by the host	*/
+	EtInt		imageSize;	/* size of the whole image, in bytes		*/
+	EtInt		numChannels;	/* the number of channels in the pose		*/
+	EtInt		numKeys;	/* the number of keys in all the channels	*/
+	EtInt		namesSize;	/* size of the channel name strings			*/
+
+	/* offsets of the sections, see EtPose */
+	EtInt		firstKey;
+	EtInt		keyCount;
+	EtInt		isStatic;
+	EtInt		preInfinity;
+	EtInt		postInfinity;
+	EtInt		preSlope;
+	EtInt		postSlope;
+	EtInt		nameOffset;
+	EtInt		keyTime;
+	EtInt		keyValue;
+	EtInt		segments;
+	EtInt		names;
+};
+typedef struct EtPoseHeader EtPoseHeader;
+
+struct EtPose {
+	EtInt		numChannels;	/* the number of channels in the pose		*/
+	EtInt		numKeys;		/* the number of keys in all the channels	*/
+
+	/* the image, either allocated or loaded from a file */
+	EtByte *	image;
+	EtInt		imageSize;	/* size of the image, in bytes				*/
+	EtBoolean	imageIsFile;	/* whether the image came from engineFileMap */
+	EtBoolean	imageIsMapped;	/* (see engineFileMap)					*/
+
+	/* per channel */
+	EtInt *		firstKey;	/* index of the channel's first key			*/
+	EtInt *		keyCount;	/* number of keys in the channel			*/
+	EtBoolean *	isStatic;	/* whether the channel has a single value	*/
+	EtInt *		preInfinity;	/* how to evaluate pre-infinity			*/
+	EtInt *		postInfinity;	/* how to evaluate post-infinity		*/
+	EtValue *	preSlope;	/* slope of a linear pre-infinity			*/
+	EtValue *	postSlope;	/* slope of a linear post-infinity			*/
+	EtInt *		nameOffset;	/* offset of the channel's name in names	*/
+
+	/* per key, for the segment that starts at the key */
+	EtTime *	keyTime;	/* key time (in seconds)					*/
+	EtValue *	keyValue;	/* key value								*/
+	EtPoseSegment * segments;	/* the segment polynomials				*/
+
+	EtByte *	names;		/* channel names, each 0x00 terminated		*/
+
+	/* per channel evaluation state (a single allocation)				*/
+	EtByte *	lanes;
+	EtInt *		lastSegment;	/* last segment evaluated				*/
+	EtValue *	laneParam;	/* the normalised or local time				*/
+	EtValue *	laneMaxT;	/* upper bound of t (1 for weighted)		*/
+	EtValue *	laneX[4];	/* x polynomial of the segment				*/
+	EtValue *	laneY[4];	/* y polynomial of the segment				*/
+};
+typedef struct EtPose EtPose;
+
 #endif
@@ -11,6 +11,320 @@
 
 #include <fileEngine.h>
 
+/*
+//	The whole file is held in memory while it is open: small files are
+//	read with a single read() and larger ones are memory mapped where the
+//	platform allows it (see kFileCanMap and kFileMapThreshold in engine.h).
+//	The word, integer and float readers then scan that buffer directly
+//	instead of making a system call for every character.
+//
+//	An EtFileHandle is an index into a small table of open buffers.  Each
+//	buffer has its own word buffer, so reading from one file does not
+//	overwrite a word returned for another.
+*/
+struct EtFileBuffer {
+	EtBoolean	inUse;		/* whether or not this entry is open			*/
+	EtBoolean	isMapped;	/* whether data is mapped or allocated			*/
+	EtByte *	data;		/* the contents of the file						*/
+	size_t		size;		/* the number of bytes in data					*/
+	size_t		pos;		/* the offset of the next byte to read			*/
+	EtByte		word[kFileMaxWordSize];	/* the last word read				*/
+};
+typedef struct EtFileBuffer EtFileBuffer;
+
+static EtFileBuffer fileBuffers[kFileMaxOpen];
+
+/* exactly representable powers of ten, for engineFileParseFloat */
+static const double powersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define kFileMaxPowerOfTen 22
+
+/* more significant digits than this cannot change a float */
+#define kFileMaxDigits 17
+
+/*
+//	Function Name:
+//		fileBufferFromHandle
+//
+//	Description:
+//		A static helper function to look up the buffer of an open file
+//
+//  Input Arguments:
+//		EtFileHandle fileHandle		The handle to an open file
+//
+//  Return Value:
+//		EtFileBuffer *				The buffer of the file
+//			kEngineNULL				the handle is not open
+*/
+static EtFileBuffer *
+fileBufferFromHandle (EtFileHandle fileHandle)
+{
+	if ((fileHandle < 0) || (fileHandle >= kFileMaxOpen)) {
+		return (kEngineNULL);
+	}
+	if (!fileBuffers[fileHandle].inUse) {
+		return (kEngineNULL);
+	}
+	return (&fileBuffers[fileHandle]);
+}
+
+/*
+//	Function Name:
+//		fileBufferNextToken
+//
+//	Description:
+//		A static helper function to skip to the first character of the
+//	next word in a file buffer
+//
+//  Input Arguments:
+//		EtFileBuffer *file			The buffer of an open file
+//
+//  Return Value:
+//		EtBoolean status
+//			kEngineTRUE				a word follows
+//			kEngineFALSE			we are at the end of the file
+*/
+static EtBoolean
+fileBufferNextToken (EtFileBuffer *file)
+{
+	while ((file->pos < file->size) && (file->data[file->pos] <= ' ')) {
+		file->pos++;
+	}
+	return (file->pos < file->size);
+}
+
+/*
+//	Function Name:
+//		fileBufferEndToken
+//
+//	Description:
+//		A static helper function to skip the rest of the current word, and
+//	the character that ends it
+//
+//  Input Arguments:
+//		EtFileBuffer *file			The buffer of an open file
+//
+//  Return Value:
+//		None
+*/
+static EtVoid
+fileBufferEndToken (EtFileBuffer *file)
+{
+	while ((file->pos < file->size) && (file->data[file->pos] > ' ')) {
+		file->pos++;
+	}
+	if (file->pos < file->size) {
+		file->pos++;
+	}
+}
+
+/*
+//	Function Name:
+//		parseFloat
+//
+//	Description:
+//		A static helper function to convert the start of a string to a
+//	floating point number.  Unlike atof the result does not depend on the
+//	current locale, and the number is converted in a single pass.
+//
+//  Input Arguments:
+//		const EtByte *c				The first character of the number
+//		const EtByte *end			One past the last character to look at
+//
+//  Return Value:
+//		double						The number, or 0.0 if there is none
+*/
+static double
+parseFloat (const EtByte *c, const EtByte *end)
+{
+	double mantissa = 0.0;
+	EtInt exponent = 0;
+	EtInt digits = 0;
+	EtInt power;
+	EtInt powerSign;
+	EtBoolean negative = kEngineFALSE;
+	const EtByte *e;
+
+	if ((c < end) && ((*c == '-') || (*c == '+'))) {
+		negative = (*c == '-');
+		c++;
+	}
+
+	/* integer part */
+	for (; (c < end) && (*c >= '0') && (*c <= '9'); c++) {
+		if (digits < kFileMaxDigits) {
+			mantissa = mantissa * 10.0 + (*c - '0');
+			if (mantissa != 0.0) digits++;
+		}
+		else {
+			exponent++;
+		}
+	}
+
+	/* fraction */
+	if ((c < end) && (*c == '.')) {
+		for (c++; (c < end) && (*c >= '0') && (*c <= '9'); c++) {
+			if (digits < kFileMaxDigits) {
+				mantissa = mantissa * 10.0 + (*c - '0');
+				exponent--;
+				if (mantissa != 0.0) digits++;
+			}
+		}
+	}
+
+	/* exponent, only if it has at least one digit */
+	if ((c < end) && ((*c == 'e') || (*c == 'E'))) {
+		e = c + 1;
+		powerSign = 1;
+		if ((e < end) && ((*e == '-') || (*e == '+'))) {
+			powerSign = (*e == '-') ? -1 : 1;
+			e++;
+		}
+		if ((e < end) && (*e >= '0') && (*e <= '9')) {
+			for (power = 0; (e < end) && (*e >= '0') && (*e <= '9'); e++) {
+				if (power < 10000) power = power * 10 + (*e - '0');
+			}
+			exponent += powerSign * power;
+		}
+	}
+
+	/* scale by exact powers of ten */
+	if (mantissa != 0.0) {
+		while (exponent > kFileMaxPowerOfTen) {
+			mantissa *= powersOfTen[kFileMaxPowerOfTen];
+			exponent -= kFileMaxPowerOfTen;
+		}
+		while (exponent < -kFileMaxPowerOfTen) {
+			mantissa /= powersOfTen[kFileMaxPowerOfTen];
+			exponent += kFileMaxPowerOfTen;
+		}
+		if (exponent > 0) {
+			mantissa *= powersOfTen[exponent];
+		}
+		else if (exponent < 0) {
+			mantissa /= powersOfTen[-exponent];
+		}
+	}
+	return (negative ? -mantissa : mantissa);
+}
+
+/*
+//	Function Name:
+//		fileLoad
+//
+//	Description:
+//		A static helper function to bring the whole of a file into memory
+//
+//  Input Arguments:
+//		EtFileName fileName			The name of the file to load
+//		EtBoolean sequential		Whether the file will be read from start
+//										to end (a hint for mapped files)
+//		EtByte **data				Where to return the contents
+//		size_t *size				Where to return the size of the contents
+//		EtBoolean *isMapped			Where to return whether data is mapped
+//
+//  Return Value:
+//		EtBoolean status
+//			kEngineTRUE				the file was loaded (data is kEngineNULL
+//										if the file is empty)
+//			kEngineFALSE			the file could not be loaded
+*/
+static EtBoolean
+fileLoad (EtFileName fileName, EtBoolean sequential, EtByte **data, size_t *size, EtBoolean *isMapped)
+{
+	int fd;
+	long length;
+	long bytesRead;
+	int result;
+
+	*data = kEngineNULL;
+	*size = 0;
+	*isMapped = kEngineFALSE;
+
+	/* open the file */
+	fd = open (fileName, O_RDONLY | O_BINARY);
+	if (fd < 0) {
+		return (kEngineFALSE);
+	}
+	length = lseek (fd, 0, SEEK_END);
+	if ((length < 0) || (lseek (fd, 0, SEEK_SET) != 0)) {
+		close (fd);
+		return (kEngineFALSE);
+	}
+
+#ifdef kFileCanMap
+	/* map large files, so only the pages we use are read */
+	if (length >= kFileMapThreshold) {
+		void *view = mmap (kEngineNULL, (size_t)length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+			if (sequential) {
+				madvise (view, (size_t)length, MADV_SEQUENTIAL);
+			}
+#endif
+			*data = (EtByte *)view;
+			*isMapped = kEngineTRUE;
+		}
+	}
+#endif
+
+	/* otherwise read the whole file at once */
+	if ((*data == kEngineNULL) && (length > 0)) {
+		*data = (EtByte *)malloc ((size_t)length);
+		if (*data == kEngineNULL) {
+			close (fd);
+			return (kEngineFALSE);
+		}
+		for (bytesRead = 0; bytesRead < length; bytesRead += result) {
+			result = read (fd, (char *)*data + bytesRead, (unsigned int)(length - bytesRead));
+			if (result <= 0) {
+				free (*data);
+				*data = kEngineNULL;
+				close (fd);
+				return (kEngineFALSE);
+			}
+		}
+	}
+
+	/* the contents no longer need the file descriptor */
+	close (fd);
+	*size = (size_t)length;
+	return (kEngineTRUE);
+}
+
+/*
+//	Function Name:
+//		fileUnload
+//
+//	Description:
+//		A static helper function to release the contents of a file
+//	loaded by fileLoad
+//
+//  Input Arguments:
+//		EtByte *data				The contents
+//		size_t size					The size of the contents
+//		EtBoolean isMapped			Whether data is mapped
+//
+//  Return Value:
+//		None
+*/
+static EtVoid
+fileUnload (EtByte *data, size_t size, EtBoolean isMapped)
+{
+	if (data == kEngineNULL) {
+		return;
+	}
+#ifdef kFileCanMap
+	if (isMapped) {
+		munmap ((void *)data, size);
+		return;
+	}
+#endif
+	free (data);
+}
+
 /*
 //	Function Name:
 //		engineFileOpen
@@ -29,16 +343,30 @@
 EtFileHandle
 engineFileOpen (EtFileName fileName)
 {
-	int fd;
+	EtFileHandle fileHandle;
+	EtFileBuffer *file;
 
 	/* make sure we have a valid file name */
 	if (fileName == kEngineNULL) {
 		return (kFileBadParam);
 	}
 
-	/* open the file */
-	fd = open (fileName, O_RDWR);
-	return (fd);
+	/* find a free buffer */
+	for (fileHandle = 0; fileHandle < kFileMaxOpen; fileHandle++) {
+		if (!fileBuffers[fileHandle].inUse) break;
+	}
+	if (fileHandle == kFileMaxOpen) {
+		return (kFileNotOpened);
+	}
+	file = &fileBuffers[fileHandle];
+
+	/* load the file */
+	if (!fileLoad (fileName, kEngineTRUE, &file->data, &file->size, &file->isMapped)) {
+		return (kFileNotOpened);
+	}
+	file->pos = 0;
+	file->inUse = kEngineTRUE;
+	return (fileHandle);
 }
 
 /*
@@ -57,12 +385,84 @@ engineFileOpen (EtFileName fileName)
 EtVoid
 engineFileClose (EtFileHandle fileHandle)
 {
+	EtFileBuffer *file = fileBufferFromHandle (fileHandle);
+
 	/* make sure we have a valid file handle */
-	if (fileHandle < 0) {
+	if (file == kEngineNULL) {
 		return;
 	}
 
-	close (fileHandle);
+	fileUnload (file->data, file->size, file->isMapped);
+	file->data = kEngineNULL;
+	file->size = 0;
+	file->pos = 0;
+	file->isMapped = kEngineFALSE;
+	file->inUse = kEngineFALSE;
+}
+
+/*
+//	Function Name:
+//		engineFileMap
+//
+//	Description:
+//		A helper function to bring the whole of a file into memory, for
+//	binary files which are used in place rather than parsed.  Unlike
+//	engineFileOpen this does not use up a file handle.
+//
+//  Input Arguments:
+//		EtFileName fileName			The name of the file to map
+//		EtInt *size					Where to return the size of the file
+//		EtBoolean *isMapped			Where to return whether the file is
+//										mapped (for engineFileUnmap)
+//
+//  Return Value:
+//		EtByte *					The contents of the file (read only)
+//			kEngineNULL				the file could not be loaded, or is empty
+*/
+EtByte *
+engineFileMap (EtFileName fileName, EtInt *size, EtBoolean *isMapped)
+{
+	EtByte *data;
+	size_t length;
+	EtBoolean mapped;
+
+	/* make sure we have valid parameters */
+	if ((fileName == kEngineNULL) || (size == kEngineNULL) || (isMapped == kEngineNULL)) {
+		return (kEngineNULL);
+	}
+
+	if (!fileLoad (fileName, kEngineFALSE, &data, &length, &mapped)) {
+		return (kEngineNULL);
+	}
+	if (length > (size_t)INT_MAX) {
+		fileUnload (data, length, mapped);
+		return (kEngineNULL);
+	}
+	*size = (EtInt)length;
+	*isMapped = mapped;
+	return (data);
+}
+
+/*
+//	Function Name:
+//		engineFileUnmap
+//
+//	Description:
+//		A helper function to release a file brought into memory by
+//	engineFileMap
+//
+//  Input Arguments:
+//		EtByte *data				The contents of the file
+//		EtInt size					The size returned by engineFileMap
+//		EtBoolean isMapped			The isMapped returned by engineFileMap
+//
+//  Return Value:
+//		None
+*/
+EtVoid
+engineFileUnmap (EtByte *data, EtInt size, EtBoolean isMapped)
+{
+	fileUnload (data, (size_t)size, isMapped);
 }
 
 /*
@@ -85,13 +485,19 @@ engineFileClose (EtFileHandle fileHandle)
 EtBoolean
 engineFileReadByte (EtFileHandle fileHandle, EtByte *byte)
 {
+	EtFileBuffer *file = fileBufferFromHandle (fileHandle);
+
 	/* make sure we have a valid file handle */
-	if ((fileHandle < 0) || (byte == kEngineNULL)) {
+	if ((file == kEngineNULL) || (byte == kEngineNULL)) {
 		return (kEngineFALSE);
 	}
 
-	/* read a single byte from the file */
-	return (read (fileHandle, (char *)byte, 1) == 1);
+	/* read a single byte from the buffer */
+	if (file->pos >= file->size) {
+		return (kEngineFALSE);
+	}
+	*byte = file->data[file->pos++];
+	return (kEngineTRUE);
 }
 
 /*
@@ -111,39 +517,38 @@ engineFileReadByte (EtFileHandle fileHandle, EtByte *byte)
 //										we are at the end of the file)
 //
 //	Note:
-//		engineFileReadWord uses a static buffer to hold the word just
-//	read.  Subsequent calls to engineFileReadWord will over write this
-//	buffer
+//		engineFileReadWord uses a buffer belonging to the file handle to
+//	hold the word just read.  Subsequent calls to engineFileReadWord for
+//	the same file will over write this buffer.  Words longer than
+//	kFileMaxWordSize - 1 characters are truncated.
 */
 EtByte *
 engineFileReadWord (EtFileHandle fileHandle)
 {
-	static EtByte string[kFileMaxWordSize];
-	EtByte *c = string;
-	EtBoolean continueReading;
+	EtFileBuffer *file = fileBufferFromHandle (fileHandle);
+	size_t start;
+	size_t length;
 
 	/* make sure we have a valid file handle */
-	if (fileHandle < 0) {
+	if (file == kEngineNULL) {
 		return (kEngineNULL);
 	}
 
 	/* look for the first character of the word */
-	continueReading = engineFileReadByte (fileHandle, c);
-	while (continueReading && (*c <= ' ')) {
-		continueReading = engineFileReadByte (fileHandle, c);
-	}
-	if (!continueReading) return (kEngineNULL);
+	if (!fileBufferNextToken (file)) return (kEngineNULL);
 
 	/* look for the last character of the word */
-	c++;
-	while (engineFileReadByte (fileHandle, c) && (*c > ' ')) {
-		c++;
-	}
+	start = file->pos;
+	fileBufferEndToken (file);
+	length = file->pos - start;
+	if ((length > 0) && (file->data[file->pos - 1] <= ' ')) length--;
+	if (length > kFileMaxWordSize - 1) length = kFileMaxWordSize - 1;
+	memcpy (file->word, file->data + start, length);
 
 	/* strip off any trailing ';' */
-	if ((c > string) && (*(c - 1) == ';')) c--;
-	*c = 0x00;
-	return (string);
+	if ((length > 0) && (file->word[length - 1] == ';')) length--;
+	file->word[length] = 0x00;
+	return (file->word);
 }
 
 /*
@@ -166,8 +571,28 @@ engineFileReadWord (EtFileHandle fileHandle)
 EtInt
 engineFileReadInt (EtFileHandle fileHandle)
 {
-	EtByte *word = engineFileReadWord (fileHandle);
-	return (word == kEngineNULL ? 0 : atoi ((const char *)word));
+	EtFileBuffer *file = fileBufferFromHandle (fileHandle);
+	const EtByte *c;
+	const EtByte *end;
+	EtInt value = 0;
+	EtBoolean negative = kEngineFALSE;
+
+	if ((file == kEngineNULL) || !fileBufferNextToken (file)) {
+		return (0);
+	}
+
+	/* convert the word in place */
+	c = file->data + file->pos;
+	end = file->data + file->size;
+	if ((*c == '-') || (*c == '+')) {
+		negative = (*c == '-');
+		c++;
+	}
+	for (; (c < end) && (*c >= '0') && (*c <= '9'); c++) {
+		value = value * 10 + (*c - '0');
+	}
+	fileBufferEndToken (file);
+	return (negative ? -value : value);
 }
 
 /*
@@ -190,6 +615,66 @@ engineFileReadInt (EtFileHandle fileHandle)
 EtFloat
 engineFileReadFloat (EtFileHandle fileHandle)
 {
-	EtByte *word = engineFileReadWord (fileHandle);
-	return (word == kEngineNULL ? 0.0 : atof ((const char *)word));
+	EtFileBuffer *file = fileBufferFromHandle (fileHandle);
+	double value;
+
+	if ((file == kEngineNULL) || !fileBufferNextToken (file)) {
+		return (0.0);
+	}
+
+	/* convert the word in place */
+	value = parseFloat (file->data + file->pos, file->data + file->size);
+	fileBufferEndToken (file);
+	return ((EtFloat)value);
+}
+
+/*
+//	Function Name:
+//		engineFileSkipLine
+//
+//	Description:
+//		A helper function to skip the rest of the current line of a file.
+//	Reading stops after the first control character (such as end of line
+//	or tab), the same as reading bytes until one is below ' '.
+//
+//  Input Arguments:
+//		EtFileHandle fileHandle		The handle to an open file
+//
+//  Return Value:
+//		None
+*/
+EtVoid
+engineFileSkipLine (EtFileHandle fileHandle)
+{
+	EtFileBuffer *file = fileBufferFromHandle (fileHandle);
+
+	if (file == kEngineNULL) {
+		return;
+	}
+	while ((file->pos < file->size) && (file->data[file->pos++] >= ' ')) {}
+}
+
+/*
+//	Function Name:
+//		engineFileParseFloat
+//
+//	Description:
+//		A helper function to convert a word (such as one returned by
+//	engineFileReadWord) to a floating point number, independent of the
+//	current locale
+//
+//  Input Arguments:
+//		const EtByte *word			The word to convert
+//
+//  Return Value:
+//		EtFloat						The floating point number, or 0.0 if the
+//										word does not start with a number
+*/
+EtFloat
+engineFileParseFloat (const EtByte *word)
+{
+	if (word == kEngineNULL) {
+		return (0.0);
+	}
+	return ((EtFloat)parseFloat (word, word + strlen ((const char *)word)));
 }
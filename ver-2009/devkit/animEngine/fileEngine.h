@@ -20,5 +20,9 @@ EtBoolean engineFileReadByte (EtFileHandle fileHandle, EtByte *byte);
 EtByte *engineFileReadWord (EtFileHandle fileHandle);
 EtInt engineFileReadInt (EtFileHandle fileHandle);
 EtFloat engineFileReadFloat (EtFileHandle fileHandle);
+EtVoid engineFileSkipLine (EtFileHandle fileHandle);
+EtFloat engineFileParseFloat (const EtByte *word);
+EtByte *engineFileMap (EtFileName fileName, EtInt *size, EtBoolean *isMapped);
+EtVoid engineFileUnmap (EtByte *data, EtInt size, EtBoolean isMapped);
 
 #endif
@@ -0,0 +1,1111 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#include <poseEngine.h>
+#include <animEngine.h>
+#include <utilEngine.h>
+#include <fileEngine.h>
+
+/*
+//	A pose is every channel of a channel list compiled into flat arrays,
+//	so a whole rig can be evaluated at one time with a single call:
+//
+//		pose = enginePoseCreate (channelList);
+//		values = (EtValue *)engineUtilAllocate (
+//			enginePoseNumChannels (pose) * sizeof (EtValue));
+//		enginePoseEvaluate (pose, time, values);
+//
+//	values[i] is the value of the i'th curve in the channel list.
+//
+//	The polynomials of every segment are computed once, when the pose is
+//	created, and stored as structures of arrays.  Evaluating a pose is then
+//	two passes over the channels:
+//
+//		1.	find each channel's segment (and handle the infinities) and
+//			copy its polynomials into the evaluation lanes.
+//		2.	solve for the bezier parameter and evaluate the value
+//			polynomial, four channels at a time where SSE is available.
+//
+//	The second pass does not branch on the type of the curve: hermite and
+//	step segments have an x polynomial of x(t) = t, which the solver
+//	returns without iterating.
+//
+//	Evaluating different ranges of channels of one pose concurrently is
+//	safe, so enginePoseEvaluateRange can be called from an application's
+//	own worker threads.  enginePoseEvaluateThreaded does that split with
+//	threads of its own.
+*/
+
+/* the bezier parameter is solved to this tolerance of the normalised time */
+#define kPoseTolerance (4.0f * FLT_EPSILON)
+
+/* give up on the solve after this many iterations (enough to bisect [0, 1]) */
+#define kPoseMaxIterations 24
+
+/* do not start threads for fewer channels than this per thread */
+#define kPoseMinThreadChannels 4096
+
+/* number of channels evaluated together */
+#define kPoseLaneWidth 4
+
+/*
+//	Function Name:
+//		setConstantLane
+//
+//	Description:
+//		A static helper function to make a channel's lane evaluate to a
+//	constant value
+//
+//  Input Arguments:
+//		EtPose *pose				The pose
+//		EtInt c						The channel
+//		EtValue value				The value
+//
+//  Return Value:
+//		None
+*/
+static EtVoid
+setConstantLane (EtPose *pose, EtInt c, EtValue value)
+{
+	pose->laneParam[c] = 0.0;
+	pose->laneMaxT[c] = kEngineFloatMax;
+	pose->laneX[0][c] = 0.0;
+	pose->laneX[1][c] = 1.0;
+	pose->laneX[2][c] = 0.0;
+	pose->laneX[3][c] = 0.0;
+	pose->laneY[0][c] = value;
+	pose->laneY[1][c] = 0.0;
+	pose->laneY[2][c] = 0.0;
+	pose->laneY[3][c] = 0.0;
+}
+
+/*
+//	Function Name:
+//		poseSection
+//
+//	Description:
+//		A static helper function to place a section of a pose image
+//
+//  Input Arguments:
+//		EtInt *offset				The end of the image so far (updated)
+//		EtInt bytes					The size of the section
+//
+//  Return Value:
+//		EtInt						The offset of the section
+*/
+static EtInt
+poseSection (EtInt *offset, EtInt bytes)
+{
+	EtInt start = (*offset + 7) & ~7;
+	*offset = start + bytes;
+	return (start);
+}
+
+/*
+//	Function Name:
+//		poseLayout
+//
+//	Description:
+//		A static helper function to fill in the header of a pose image
+//
+//  Input Arguments:
+//		EtPoseHeader *header		The header to fill in
+//		EtInt numChannels			The number of channels
+//		EtInt numKeys				The number of keys
+//		EtInt namesSize				The size of the channel names
+//
+//  Return Value:
+//		None
+*/
+static EtVoid
+poseLayout (EtPoseHeader *header, EtInt numChannels, EtInt numKeys, EtInt namesSize)
+{
+	EtInt offset = sizeof (EtPoseHeader);
+
+	memcpy (header->magic, kPoseMagic, 4);
+	header->version = kPoseVersion;
+	header->byteOrder = kPoseByteOrder;
+	header->numChannels = numChannels;
+	header->numKeys = numKeys;
+	header->namesSize = namesSize;
+
+	header->firstKey = poseSection (&offset, numChannels * sizeof (EtInt));
+	header->keyCount = poseSection (&offset, numChannels * sizeof (EtInt));
+	header->isStatic = poseSection (&offset, numChannels * sizeof (EtBoolean));
+	header->preInfinity = poseSection (&offset, numChannels * sizeof (EtInt));
+	header->postInfinity = poseSection (&offset, numChannels * sizeof (EtInt));
+	header->preSlope = poseSection (&offset, numChannels * sizeof (EtValue));
+	header->postSlope = poseSection (&offset, numChannels * sizeof (EtValue));
+	header->nameOffset = poseSection (&offset, numChannels * sizeof (EtInt));
+	header->keyTime = poseSection (&offset, numKeys * sizeof (EtTime));
+	header->keyValue = poseSection (&offset, numKeys * sizeof (EtValue));
+	header->segments = poseSection (&offset, numKeys * sizeof (EtPoseSegment));
+	header->names = poseSection (&offset, namesSize);
+	header->imageSize = poseSection (&offset, 0);
+}
+
+/*
+//	Function Name:
+//		poseValidate
+//
+//	Description:
+//		A static helper function to check that a pose image was written by
+//	this version for this host, and that its sections are consistent
+//
+//  Input Arguments:
+//		EtByte *image				The image
+//		EtInt size					The size of the image
+//
+//  Return Value:
+//		EtBoolean result
+//			kEngineTRUE				the image can be used
+//			kEngineFALSE			the image is not usable
+*/
+static EtBoolean
+poseValidate (EtByte *image, EtInt size)
+{
+	EtPoseHeader *header = (EtPoseHeader *)image;
+	EtPoseHeader expected;
+	EtInt *firstKey;
+	EtInt *keyCount;
+	EtBoolean *isStatic;
+	EtInt *nameOffset;
+	EtByte *names;
+	EtInt c;
+
+	if ((image == kEngineNULL) || (size < (EtInt)sizeof (EtPoseHeader))) {
+		return (kEngineFALSE);
+	}
+	if ((memcmp (header->magic, kPoseMagic, 4) != 0)
+	||	(header->version != kPoseVersion)
+	||	(header->byteOrder != kPoseByteOrder)) {
+		return (kEngineFALSE);
+	}
+	if ((header->numChannels < 0) || (header->numKeys < 0) || (header->namesSize < 0)
+	||	(header->numChannels > size) || (header->numKeys > size) || (header->namesSize > size)) {
+		return (kEngineFALSE);
+	}
+
+	/* the sections must be exactly where this version puts them */
+	poseLayout (&expected, header->numChannels, header->numKeys, header->namesSize);
+	if ((memcmp (&expected, header, sizeof (EtPoseHeader)) != 0)
+	||	(header->imageSize > size)) {
+		return (kEngineFALSE);
+	}
+
+	/* the keys and names of every channel must be in the image, and */
+	/* only static channels can do without keys */
+	firstKey = (EtInt *)(image + header->firstKey);
+	keyCount = (EtInt *)(image + header->keyCount);
+	isStatic = (EtBoolean *)(image + header->isStatic);
+	nameOffset = (EtInt *)(image + header->nameOffset);
+	names = image + header->names;
+	for (c = 0; c < header->numChannels; c++) {
+		if ((firstKey[c] < 0) || (keyCount[c] < 0)
+		||	(keyCount[c] > header->numKeys - firstKey[c])
+		||	((keyCount[c] == 0) && !isStatic[c])
+		||	(nameOffset[c] < 0) || (nameOffset[c] >= header->namesSize)) {
+			return (kEngineFALSE);
+		}
+	}
+	if ((header->namesSize > 0) && (names[header->namesSize - 1] != 0x00)) {
+		return (kEngineFALSE);
+	}
+	return (kEngineTRUE);
+}
+
+/*
+//	Function Name:
+//		poseBind
+//
+//	Description:
+//		A static helper function to point a pose at the sections of its
+//	image, and allocate and initialise its evaluation lanes
+//
+//  Input Arguments:
+//		EtPose *pose				The pose, with image set
+//
+//  Return Value:
+//		EtBoolean result
+//			kEngineTRUE				the pose is ready to evaluate
+//			kEngineFALSE			out of memory
+*/
+static EtBoolean
+poseBind (EtPose *pose)
+{
+	EtPoseHeader *header = (EtPoseHeader *)pose->image;
+	EtInt numChannels = header->numChannels;
+	EtInt lane = (numChannels > 0 ? numChannels : 1);
+	EtInt c, i;
+
+	pose->numChannels = numChannels;
+	pose->numKeys = header->numKeys;
+	pose->firstKey = (EtInt *)(pose->image + header->firstKey);
+	pose->keyCount = (EtInt *)(pose->image + header->keyCount);
+	pose->isStatic = (EtBoolean *)(pose->image + header->isStatic);
+	pose->preInfinity = (EtInt *)(pose->image + header->preInfinity);
+	pose->postInfinity = (EtInt *)(pose->image + header->postInfinity);
+	pose->preSlope = (EtValue *)(pose->image + header->preSlope);
+	pose->postSlope = (EtValue *)(pose->image + header->postSlope);
+	pose->nameOffset = (EtInt *)(pose->image + header->nameOffset);
+	pose->keyTime = (EtTime *)(pose->image + header->keyTime);
+	pose->keyValue = (EtValue *)(pose->image + header->keyValue);
+	pose->segments = (EtPoseSegment *)(pose->image + header->segments);
+	pose->names = pose->image + header->names;
+
+	/* the lanes are the only part of a pose that changes */
+	pose->lanes = engineUtilAllocate (lane * (sizeof (EtInt) + 10 * sizeof (EtValue)));
+	if (pose->lanes == kEngineNULL) {
+		return (kEngineFALSE);
+	}
+	pose->lastSegment = (EtInt *)pose->lanes;
+	pose->laneParam = (EtValue *)(pose->lastSegment + lane);
+	pose->laneMaxT = pose->laneParam + lane;
+	for (i = 0; i < 4; i++) {
+		pose->laneX[i] = pose->laneMaxT + (i + 1) * lane;
+		pose->laneY[i] = pose->laneX[0] + (i + 4) * lane;
+	}
+
+	/* static lanes are filled in once, here */
+	for (c = 0; c < numChannels; c++) {
+		pose->lastSegment[c] = 0;
+		if (pose->isStatic[c]) {
+			setConstantLane (pose, c, (pose->keyCount[c] > 0 ? pose->keyValue[pose->firstKey[c]] : 0.0));
+		}
+	}
+	return (kEngineTRUE);
+}
+
+/*
+//	Function Name:
+//		enginePoseCreate
+//
+//	Description:
+//		A function to compile a channel list into a pose
+//
+//  Input Arguments:
+//		EtChannel *channelList		The channels to compile
+//
+//  Return Value:
+//		EtPose *pose				The compiled pose
+//			kEngineNULL				out of memory
+//
+//	Note:
+//		The pose does not refer to the channel list, which can be freed
+//	once the pose is created.  Use enginePoseFree (pose) to free the pose.
+*/
+EtPose *
+enginePoseCreate (EtChannel *channelList)
+{
+	EtPose *pose;
+	EtPoseHeader header;
+	EtChannel *channel;
+	EtCurve *curve;
+	EtSegment segment;
+	EtPoseSegment *polynomial;
+	EtInt numChannels = 0;
+	EtInt numKeys = 0;
+	EtInt namesSize = 0;
+	EtInt nameLength;
+	EtInt c, k, i, key;
+	EtKey *firstKey;
+	EtKey *lastKey;
+
+	/* count the channels, keys and names */
+	for (channel = channelList; channel != kEngineNULL; channel = channel->next) {
+		if (channel->curve != kEngineNULL) {
+			numChannels++;
+			numKeys += channel->curve->numKeys;
+			if (channel->channel != kEngineNULL) {
+				namesSize += strlen ((const char *)channel->channel);
+			}
+			namesSize++;
+		}
+	}
+
+	pose = (EtPose *)engineUtilAllocate (sizeof (EtPose));
+	if (pose == kEngineNULL) {
+		return (kEngineNULL);
+	}
+	memset (pose, 0, sizeof (EtPose));
+
+	/* allocate the image in one block */
+	poseLayout (&header, numChannels, numKeys, namesSize);
+	pose->image = engineUtilAllocate (header.imageSize);
+	if (pose->image == kEngineNULL) {
+		enginePoseFree (pose);
+		return (kEngineNULL);
+	}
+	memset (pose->image, 0, header.imageSize);
+	memcpy (pose->image, &header, sizeof (EtPoseHeader));
+	pose->imageSize = header.imageSize;
+	if (!poseBind (pose)) {
+		enginePoseFree (pose);
+		return (kEngineNULL);
+	}
+
+	/* compile the curves */
+	c = 0;
+	key = 0;
+	namesSize = 0;
+	for (channel = channelList; channel != kEngineNULL; channel = channel->next) {
+		curve = channel->curve;
+		if (curve == kEngineNULL) continue;
+
+		pose->firstKey[c] = key;
+		pose->keyCount[c] = curve->numKeys;
+		pose->isStatic[c] = (curve->isStatic || (curve->numKeys <= 1));
+		pose->preInfinity[c] = curve->preInfinity;
+		pose->postInfinity[c] = curve->postInfinity;
+		pose->preSlope[c] = 0.0;
+		pose->postSlope[c] = 0.0;
+		if (curve->numKeys > 0) {
+			firstKey = &(curve->keyList[0]);
+			lastKey = &(curve->keyList[curve->numKeys - 1]);
+			if (firstKey->inTanX != 0.0) {
+				pose->preSlope[c] = firstKey->inTanY / firstKey->inTanX;
+			}
+			if (lastKey->outTanX != 0.0) {
+				pose->postSlope[c] = lastKey->outTanY / lastKey->outTanX;
+			}
+		}
+
+		pose->nameOffset[c] = namesSize;
+		if (channel->channel != kEngineNULL) {
+			nameLength = strlen ((const char *)channel->channel);
+			memcpy (pose->names + namesSize, channel->channel, nameLength);
+			namesSize += nameLength;
+		}
+		pose->names[namesSize++] = 0x00;
+
+		for (k = 0; k < curve->numKeys; k++, key++) {
+			pose->keyTime[key] = curve->keyList[k].time;
+			pose->keyValue[key] = curve->keyList[k].value;
+			if (!engineAnimSegment (curve, k, &segment)) {
+				/* the last key starts a constant segment */
+				segment.isWeighted = kEngineFALSE;
+				for (i = 0; i < 4; i++) {
+					segment.x[i] = 0.0;
+					segment.y[i] = 0.0;
+				}
+				segment.x[1] = 1.0;
+				segment.y[0] = curve->keyList[k].value;
+			}
+			polynomial = &(pose->segments[key]);
+			if (segment.isWeighted) {
+				polynomial->range = curve->keyList[k + 1].time - curve->keyList[k].time;
+				polynomial->maxT = 1.0;
+			}
+			else {
+				polynomial->range = 1.0;
+				polynomial->maxT = kEngineFloatMax;
+			}
+			for (i = 0; i < 4; i++) {
+				polynomial->x[i] = segment.x[i];
+				polynomial->y[i] = segment.y[i];
+			}
+		}
+
+		/* static lanes are filled in once, here */
+		if (pose->isStatic[c]) {
+			setConstantLane (pose, c, (curve->numKeys > 0 ? curve->keyList[0].value : 0.0));
+		}
+		c++;
+	}
+	return (pose);
+}
+
+/*
+//	Function Name:
+//		enginePoseSave
+//
+//	Description:
+//		A function to write a pose to a file, which enginePoseLoad can use
+//	without parsing or compiling it again
+//
+//  Input Arguments:
+//		EtPose *pose				The pose to save
+//		EtFileName fileName			The name of the file to write
+//
+//  Return Value:
+//		EtBoolean result
+//			kEngineTRUE				the pose was written
+//			kEngineFALSE			the pose could not be written
+//
+//	Note:
+//		The file is written in the byte order of this host, and can only
+//	be loaded by hosts with the same byte order.
+*/
+EtBoolean
+enginePoseSave (EtPose *pose, EtFileName fileName)
+{
+	FILE *file;
+	EtBoolean written;
+
+	/* make sure we have valid parameters */
+	if ((pose == kEngineNULL) || (pose->image == kEngineNULL) || (fileName == kEngineNULL)) {
+		return (kEngineFALSE);
+	}
+
+	file = fopen (fileName, "wb");
+	if (file == kEngineNULL) {
+		return (kEngineFALSE);
+	}
+	written = (fwrite (pose->image, 1, pose->imageSize, file) == (size_t)pose->imageSize);
+	if (fclose (file) != 0) {
+		written = kEngineFALSE;
+	}
+	return (written);
+}
+
+/*
+//	Function Name:
+//		enginePoseLoad
+//
+//	Description:
+//		A function to load a pose written by enginePoseSave.  The file is
+//	mapped (or read in one go) and evaluated in place; only the evaluation
+//	lanes are allocated.
+//
+//  Input Arguments:
+//		EtFileName fileName			The name of the file to load
+//
+//  Return Value:
+//		EtPose *pose				The loaded pose
+//			kEngineNULL				the file could not be loaded, or was not
+//										written by enginePoseSave on a host
+//										with the same byte order
+//
+//	Note:
+//		Use enginePoseFree (pose) to free the pose.
+*/
+EtPose *
+enginePoseLoad (EtFileName fileName)
+{
+	EtPose *pose;
+	EtByte *image;
+	EtInt size;
+	EtBoolean isMapped;
+
+	/* make sure we have a valid file name */
+	if (fileName == kEngineNULL) {
+		return (kEngineNULL);
+	}
+
+	image = engineFileMap (fileName, &size, &isMapped);
+	if (image == kEngineNULL) {
+		return (kEngineNULL);
+	}
+	if (!poseValidate (image, size)) {
+		engineFileUnmap (image, size, isMapped);
+		return (kEngineNULL);
+	}
+
+	pose = (EtPose *)engineUtilAllocate (sizeof (EtPose));
+	if (pose == kEngineNULL) {
+		engineFileUnmap (image, size, isMapped);
+		return (kEngineNULL);
+	}
+	memset (pose, 0, sizeof (EtPose));
+	pose->image = image;
+	pose->imageSize = size;
+	pose->imageIsFile = kEngineTRUE;
+	pose->imageIsMapped = isMapped;
+	if (!poseBind (pose)) {
+		enginePoseFree (pose);
+		return (kEngineNULL);
+	}
+	return (pose);
+}
+
+/*
+//	Function Name:
+//		enginePoseFree
+//
+//	Description:
+//		A function to free the memory used by a pose
+//
+//  Input Arguments:
+//		EtPose *pose				The pose to free
+//
+//  Return Value:
+//		None
+*/
+EtVoid
+enginePoseFree (EtPose *pose)
+{
+	/* make sure we have something to free */
+	if (pose == kEngineNULL) {
+		return;
+	}
+
+	if (pose->imageIsFile) {
+		engineFileUnmap (pose->image, pose->imageSize, pose->imageIsMapped);
+	}
+	else {
+		engineUtilFree (pose->image);
+	}
+	engineUtilFree (pose->lanes);
+	engineUtilFree ((EtByte *)pose);
+}
+
+/*
+//	Function Name:
+//		enginePoseNumChannels
+//
+//	Description:
+//		A function to return the number of channels in a pose, which is the
+//	number of values enginePoseEvaluate writes
+//
+//  Input Arguments:
+//		EtPose *pose				The pose
+//
+//  Return Value:
+//		EtInt						The number of channels
+*/
+EtInt
+enginePoseNumChannels (EtPose *pose)
+{
+	return (pose == kEngineNULL ? 0 : pose->numChannels);
+}
+
+/*
+//	Function Name:
+//		enginePoseChannelName
+//
+//	Description:
+//		A function to return the name of a channel of a pose
+//
+//  Input Arguments:
+//		EtPose *pose				The pose
+//		EtInt channel				The channel (0 to numChannels - 1)
+//
+//  Return Value:
+//		EtByte *					The name of the channel
+//			kEngineNULL				there is no such channel
+*/
+EtByte *
+enginePoseChannelName (EtPose *pose, EtInt channel)
+{
+	if ((pose == kEngineNULL) || (channel < 0) || (channel >= pose->numChannels)) {
+		return (kEngineNULL);
+	}
+	return (pose->names + pose->nameOffset[channel]);
+}
+
+/*
+//	Function Name:
+//		enginePoseFindChannel
+//
+//	Description:
+//		A function to find a channel of a pose by name
+//
+//  Input Arguments:
+//		EtPose *pose				The pose
+//		EtByte *name				The name of the channel (object.attribute)
+//
+//  Return Value:
+//		EtInt						The channel
+//			-1						there is no channel with that name
+*/
+EtInt
+enginePoseFindChannel (EtPose *pose, EtByte *name)
+{
+	EtInt c;
+
+	if ((pose == kEngineNULL) || (name == kEngineNULL)) {
+		return (-1);
+	}
+	for (c = 0; c < pose->numChannels; c++) {
+		if (engineUtilStringsMatch (pose->names + pose->nameOffset[c], name)) {
+			return (c);
+		}
+	}
+	return (-1);
+}
+
+/*
+//	Function Name:
+//		findSegment
+//
+//	Description:
+//		A static helper function to find the segment of a channel that
+//	contains a time.  The segment last evaluated and the one after it
+//	are tried first, since poses are usually played forwards.
+//
+//  Input Arguments:
+//		EtPose *pose				The pose
+//		EtInt c						The channel
+//		EtTime time					The time (between the first and last key)
+//
+//  Return Value:
+//		EtInt						The index (from the channel's first key)
+//									of the last key at or before time
+*/
+static EtInt
+findSegment (EtPose *pose, EtInt c, EtTime time)
+{
+	EtTime *keyTime = pose->keyTime + pose->firstKey[c];
+	EtInt numKeys = pose->keyCount[c];
+	EtInt segment = pose->lastSegment[c];
+	EtInt low, high, mid;
+
+	if ((keyTime[segment] <= time)
+	&&	((segment == numKeys - 1) || (time < keyTime[segment + 1]))) {
+		return (segment);
+	}
+	if ((segment + 1 < numKeys) && (keyTime[segment + 1] <= time)
+	&&	((segment + 1 == numKeys - 1) || (time < keyTime[segment + 2]))) {
+		return (segment + 1);
+	}
+
+	/* use a binary search for the last key not after time */
+	low = 0;
+	high = numKeys - 1;
+	while (low < high) {
+		mid = (low + high + 1) >> 1;
+		if (keyTime[mid] <= time) {
+			low = mid;
+		}
+		else {
+			high = mid - 1;
+		}
+	}
+	return (low);
+}
+
+/*
+//	Function Name:
+//		fillLane
+//
+//	Description:
+//		A static helper function to find the segment of a channel at a time
+//	and copy its polynomials into the channel's evaluation lane.  This
+//	mirrors engineAnimEvaluate, including the infinities.
+//
+//  Input Arguments:
+//		EtPose *pose				The pose
+//		EtInt c						The channel
+//		EtTime time					The time (in seconds) to evaluate
+//
+//  Return Value:
+//		None
+*/
+static EtVoid
+fillLane (EtPose *pose, EtInt c, EtTime time)
+{
+	EtInt first = pose->firstKey[c];
+	EtInt numKeys = pose->keyCount[c];
+	EtTime *keyTime = pose->keyTime + first;
+	EtValue *keyValue = pose->keyValue + first;
+	EtTime firstTime, lastTime, timeRange, factoredTime;
+	EtValue offset = 0.0;
+	EtFloat remainder;
+	EtInfinityType infinity;
+	EtPoseSegment *polynomial;
+	EtInt segment, i;
+	double numCycles, notUsed;
+
+	/* static lanes never change */
+	if (pose->isStatic[c]) {
+		return;
+	}
+
+	/* map the infinities back onto the range of keys */
+	firstTime = keyTime[0];
+	lastTime = keyTime[numKeys - 1];
+	if ((time < firstTime) || (time > lastTime)) {
+		infinity = (time < firstTime ? pose->preInfinity[c] : pose->postInfinity[c]);
+		if (infinity == kInfinityConstant) {
+			setConstantLane (pose, c, (time < firstTime ? keyValue[0] : keyValue[numKeys - 1]));
+			return;
+		}
+		if (infinity == kInfinityLinear) {
+			if (time < firstTime) {
+				setConstantLane (pose, c, keyValue[0] - (firstTime - time) * pose->preSlope[c]);
+			}
+			else {
+				setConstantLane (pose, c, keyValue[numKeys - 1] + (time - lastTime) * pose->postSlope[c]);
+			}
+			return;
+		}
+		timeRange = lastTime - firstTime;
+		if (timeRange == 0.0) {
+			setConstantLane (pose, c, keyValue[0]);
+			return;
+		}
+		if (time > lastTime) {
+			remainder = fabs (modf ((time - lastTime) / timeRange, &numCycles));
+		}
+		else {
+			remainder = fabs (modf ((time - firstTime) / timeRange, &numCycles));
+		}
+		factoredTime = timeRange * remainder;
+		numCycles = fabs (numCycles) + 1;
+
+		if (infinity == kInfinityOscillate) {
+			if ((modf (numCycles / 2.0, &notUsed) != 0.0) == (time < firstTime)) {
+				factoredTime = firstTime + factoredTime;
+			}
+			else {
+				factoredTime = lastTime - factoredTime;
+			}
+		}
+		else if (time < firstTime) {
+			factoredTime = lastTime - factoredTime;
+		}
+		else {
+			factoredTime = firstTime + factoredTime;
+		}
+		if (infinity == kInfinityCycleRelative) {
+			offset = numCycles * (keyValue[numKeys - 1] - keyValue[0]);
+			if (time < firstTime) offset = -offset;
+		}
+		time = factoredTime;
+	}
+
+	/* keys evaluate to their own value */
+	segment = findSegment (pose, c, time);
+	pose->lastSegment[c] = segment;
+	if ((time == keyTime[segment]) || (segment == numKeys - 1)) {
+		setConstantLane (pose, c, keyValue[segment] + offset);
+		return;
+	}
+
+	/* copy the segment into the lane */
+	polynomial = &(pose->segments[first + segment]);
+	pose->laneParam[c] = (time - keyTime[segment]) / polynomial->range;
+	pose->laneMaxT[c] = polynomial->maxT;
+	for (i = 0; i < 4; i++) {
+		pose->laneX[i][c] = polynomial->x[i];
+		pose->laneY[i][c] = polynomial->y[i];
+	}
+	pose->laneY[0][c] += offset;
+}
+
+/*
+//	Function Name:
+//		evaluateLane
+//
+//	Description:
+//		A static helper function to evaluate one lane.  t is found with
+//	Newton's method, falling back to bisection whenever a step would leave
+//	the bracket.  This assumes the x polynomial is monotonic on
+//	[0, laneMaxT], which engineBezierCreate arranges for most segments but
+//	not for weighted ones whose tangent handles cross.  On such a segment
+//	the solve settles on whichever root its bracket closes on, which need
+//	not be the first one nor the t that engineAnimEvaluate would pick.
+//
+//  Input Arguments:
+//		EtPose *pose				The pose
+//		EtInt c						The channel
+//
+//  Return Value:
+//		EtValue						The value of the channel
+*/
+static EtValue
+evaluateLane (EtPose *pose, EtInt c)
+{
+	EtValue s = pose->laneParam[c];
+	EtValue x0 = pose->laneX[0][c];
+	EtValue x1 = pose->laneX[1][c];
+	EtValue x2 = pose->laneX[2][c];
+	EtValue x3 = pose->laneX[3][c];
+	EtValue lo = 0.0;
+	EtValue hi = pose->laneMaxT[c];
+	EtValue t = s;
+	EtValue f, d, next;
+	EtInt i;
+
+	for (i = 0; i < kPoseMaxIterations; i++) {
+		f = ((x3 * t + x2) * t + x1) * t + x0 - s;
+		if (fabs (f) <= kPoseTolerance) break;
+		if (f > 0.0) hi = t;
+		else lo = t;
+		d = (3.0f * x3 * t + 2.0f * x2) * t + x1;
+		next = (d != 0.0 ? t - f / d : lo);
+		if ((next > lo) && (next < hi)) {
+			t = next;
+		}
+		else {
+			t = (lo + hi) * 0.5f;
+		}
+	}
+	return (((pose->laneY[3][c] * t + pose->laneY[2][c]) * t + pose->laneY[1][c]) * t + pose->laneY[0][c]);
+}
+
+#ifdef kEngineHasSSE
+/*
+//	Function Name:
+//		evaluateLanes
+//
+//	Description:
+//		A static helper function to evaluate four lanes at once.  This is
+//	evaluateLane with the branches turned into masks; lanes which have
+//	converged stop moving while the others carry on.
+//
+//  Input Arguments:
+//		EtPose *pose				The pose
+//		EtInt c						The first of the four channels
+//		EtValue *values				Where to write the four values
+//
+//  Return Value:
+//		None
+*/
+static EtVoid
+evaluateLanes (EtPose *pose, EtInt c, EtValue *values)
+{
+	__m128 s = _mm_loadu_ps (pose->laneParam + c);
+	__m128 x0 = _mm_loadu_ps (pose->laneX[0] + c);
+	__m128 x1 = _mm_loadu_ps (pose->laneX[1] + c);
+	__m128 x2 = _mm_loadu_ps (pose->laneX[2] + c);
+	__m128 x3 = _mm_loadu_ps (pose->laneX[3] + c);
+	__m128 lo = _mm_setzero_ps ();
+	__m128 hi = _mm_loadu_ps (pose->laneMaxT + c);
+	__m128 t = s;
+	__m128 tolerance = _mm_set1_ps (kPoseTolerance);
+	__m128 signMask = _mm_set1_ps (-0.0f);
+	__m128 two = _mm_set1_ps (2.0f);
+	__m128 three = _mm_set1_ps (3.0f);
+	__m128 half = _mm_set1_ps (0.5f);
+	__m128 f, d, next, mid, done, above, inside, value;
+	EtInt i;
+
+	for (i = 0; i < kPoseMaxIterations; i++) {
+		f = _mm_sub_ps (_mm_add_ps (_mm_mul_ps (_mm_add_ps (_mm_mul_ps (_mm_add_ps (
+				_mm_mul_ps (x3, t), x2), t), x1), t), x0), s);
+		done = _mm_cmple_ps (_mm_andnot_ps (signMask, f), tolerance);
+		if (_mm_movemask_ps (done) == 0xf) break;
+
+		/* tighten the bracket */
+		above = _mm_cmpgt_ps (f, _mm_setzero_ps ());
+		hi = _mm_or_ps (_mm_and_ps (above, t), _mm_andnot_ps (above, hi));
+		lo = _mm_or_ps (_mm_andnot_ps (above, t), _mm_and_ps (above, lo));
+
+		/* Newton step, or bisection if it leaves the bracket */
+		d = _mm_add_ps (_mm_mul_ps (_mm_add_ps (_mm_mul_ps (_mm_mul_ps (three, x3), t),
+				_mm_mul_ps (two, x2)), t), x1);
+		next = _mm_sub_ps (t, _mm_div_ps (f, d));
+		inside = _mm_and_ps (_mm_cmpgt_ps (next, lo), _mm_cmplt_ps (next, hi));
+		mid = _mm_mul_ps (_mm_add_ps (lo, hi), half);
+		next = _mm_or_ps (_mm_and_ps (inside, next), _mm_andnot_ps (inside, mid));
+
+		/* converged lanes keep their t */
+		t = _mm_or_ps (_mm_and_ps (done, t), _mm_andnot_ps (done, next));
+	}
+
+	value = _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (pose->laneY[3] + c), t), _mm_loadu_ps (pose->laneY[2] + c));
+	value = _mm_add_ps (_mm_mul_ps (value, t), _mm_loadu_ps (pose->laneY[1] + c));
+	value = _mm_add_ps (_mm_mul_ps (value, t), _mm_loadu_ps (pose->laneY[0] + c));
+	_mm_storeu_ps (values + c, value);
+}
+#endif
+
+/*
+//	Function Name:
+//		enginePoseEvaluateRange
+//
+//	Description:
+//		A function to evaluate some of the channels of a pose at a
+//	specified time
+//
+//  Input Arguments:
+//		EtPose *pose				The pose to evaluate
+//		EtTime time					The time (in seconds) to evaluate
+//		EtValue *values				Where to write the values (indexed by
+//										channel, from 0)
+//		EtInt first					The first channel to evaluate
+//		EtInt last					One past the last channel to evaluate
+//
+//  Return Value:
+//		None
+//
+//	Note:
+//		Different ranges of the same pose may be evaluated concurrently.
+*/
+EtVoid
+enginePoseEvaluateRange (EtPose *pose, EtTime time, EtValue *values, EtInt first, EtInt last)
+{
+	EtInt c;
+
+	/* make sure we have something to evaluate */
+	if ((pose == kEngineNULL) || (values == kEngineNULL)) {
+		return;
+	}
+	if (first < 0) first = 0;
+	if (last > pose->numChannels) last = pose->numChannels;
+
+	/* find the segments */
+	for (c = first; c < last; c++) {
+		fillLane (pose, c, time);
+	}
+
+	/* evaluate them */
+	c = first;
+#ifdef kEngineHasSSE
+	for (; c + kPoseLaneWidth <= last; c += kPoseLaneWidth) {
+		evaluateLanes (pose, c, values);
+	}
+#endif
+	for (; c < last; c++) {
+		values[c] = evaluateLane (pose, c);
+	}
+}
+
+/*
+//	Function Name:
+//		enginePoseEvaluate
+//
+//	Description:
+//		A function to evaluate every channel of a pose at a specified time
+//
+//  Input Arguments:
+//		EtPose *pose				The pose to evaluate
+//		EtTime time					The time (in seconds) to evaluate
+//		EtValue *values				Where to write the values, one per
+//										channel (see enginePoseNumChannels)
+//
+//  Return Value:
+//		None
+*/
+EtVoid
+enginePoseEvaluate (EtPose *pose, EtTime time, EtValue *values)
+{
+	if (pose == kEngineNULL) {
+		return;
+	}
+	enginePoseEvaluateRange (pose, time, values, 0, pose->numChannels);
+}
+
+/* the work given to one thread by enginePoseEvaluateThreaded */
+struct EtPoseTask {
+	EtPose *	pose;
+	EtTime		time;
+	EtValue *	values;
+	EtInt		first;
+	EtInt		last;
+};
+typedef struct EtPoseTask EtPoseTask;
+
+#ifdef WIN32
+typedef HANDLE EtPoseThread;
+#else
+typedef pthread_t EtPoseThread;
+#endif
+
+#ifdef WIN32
+static DWORD WINAPI
+poseThread (LPVOID data)
+#else
+static void *
+poseThread (void *data)
+#endif
+{
+	EtPoseTask *task = (EtPoseTask *)data;
+	enginePoseEvaluateRange (task->pose, task->time, task->values, task->first, task->last);
+	return (0);
+}
+
+/*
+//	Function Name:
+//		enginePoseEvaluateThreaded
+//
+//	Description:
+//		A function to evaluate every channel of a pose at a specified time,
+//	splitting the channels between several threads
+//
+//  Input Arguments:
+//		EtPose *pose				The pose to evaluate
+//		EtTime time					The time (in seconds) to evaluate
+//		EtValue *values				Where to write the values, one per
+//										channel (see enginePoseNumChannels)
+//		EtInt numThreads			The most threads to use (including the
+//										calling thread)
+//
+//  Return Value:
+//		None
+//
+//	Note:
+//		Starting threads costs more than evaluating a few thousand
+//	channels, so small poses (and any threads which could not be started)
+//	are evaluated on the calling thread.  Applications with their own
+//	worker threads should call enginePoseEvaluateRange from them instead.
+*/
+EtVoid
+enginePoseEvaluateThreaded (EtPose *pose, EtTime time, EtValue *values, EtInt numThreads)
+{
+	EtPoseTask *tasks;
+	EtPoseThread *threads;
+	EtInt chunk, t, started;
+
+	/* make sure we have something to evaluate */
+	if ((pose == kEngineNULL) || (values == kEngineNULL)) {
+		return;
+	}
+	if (numThreads > pose->numChannels / kPoseMinThreadChannels) {
+		numThreads = pose->numChannels / kPoseMinThreadChannels;
+	}
+	if (numThreads <= 1) {
+		enginePoseEvaluate (pose, time, values);
+		return;
+	}
+
+	tasks = (EtPoseTask *)engineUtilAllocate (numThreads * sizeof (EtPoseTask));
+	threads = (EtPoseThread *)engineUtilAllocate (numThreads * sizeof (EtPoseThread));
+	if ((tasks == kEngineNULL) || (threads == kEngineNULL)) {
+		engineUtilFree ((EtByte *)tasks);
+		engineUtilFree ((EtByte *)threads);
+		enginePoseEvaluate (pose, time, values);
+		return;
+	}
+
+	/* split the channels on whole lanes */
+	chunk = (pose->numChannels + numThreads - 1) / numThreads;
+	chunk = (chunk + kPoseLaneWidth - 1) / kPoseLaneWidth * kPoseLaneWidth;
+	for (t = 0; t < numThreads; t++) {
+		tasks[t].pose = pose;
+		tasks[t].time = time;
+		tasks[t].values = values;
+		tasks[t].first = t * chunk;
+		tasks[t].last = (t + 1) * chunk;
+		if (tasks[t].first > pose->numChannels) tasks[t].first = pose->numChannels;
+		if (tasks[t].last > pose->numChannels) tasks[t].last = pose->numChannels;
+	}
+
+	/* start a thread for all but the first range, which is ours */
+	for (started = 1; started < numThreads; started++) {
+#ifdef WIN32
+		threads[started] = CreateThread (NULL, 0, poseThread, &tasks[started], 0, NULL);
+		if (threads[started] == NULL) break;
+#else
+		if (pthread_create (&threads[started], NULL, poseThread, &tasks[started]) != 0) break;
+#endif
+	}
+	poseThread (&tasks[0]);
+
+	/* evaluate any ranges whose thread could not be started */
+	for (t = started; t < numThreads; t++) {
+		poseThread (&tasks[t]);
+	}
+
+	/* wait for the threads */
+	for (t = 1; t < started; t++) {
+#ifdef WIN32
+		WaitForSingleObject (threads[t], INFINITE);
+		CloseHandle (threads[t]);
+#else
+		pthread_join (threads[t], NULL);
+#endif
+	}
+
+	engineUtilFree ((EtByte *)tasks);
+	engineUtilFree ((EtByte *)threads);
+}
@@ -0,0 +1,28 @@
+#ifndef _poseEngine
+#define _poseEngine
+
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#include <engine.h>
+
+EtPose *enginePoseCreate (EtChannel *channelList);
+EtVoid enginePoseFree (EtPose *pose);
+EtBoolean enginePoseSave (EtPose *pose, EtFileName fileName);
+EtPose *enginePoseLoad (EtFileName fileName);
+EtInt enginePoseNumChannels (EtPose *pose);
+EtByte *enginePoseChannelName (EtPose *pose, EtInt channel);
+EtInt enginePoseFindChannel (EtPose *pose, EtByte *name);
+EtVoid enginePoseEvaluate (EtPose *pose, EtTime time, EtValue *values);
+EtVoid enginePoseEvaluateRange (EtPose *pose, EtTime time, EtValue *values, EtInt first, EtInt last);
+EtVoid enginePoseEvaluateThreaded (EtPose *pose, EtTime time, EtValue *values, EtInt numThreads);
+
+#endif
@@ -0,0 +1,175 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+/*
+//	A test of enginePoseLoad: a pose compiled from a .anim file must load
+//	again once saved, and the same file must be refused once a channel
+//	that is not static claims to have no keys, since evaluating that
+//	channel would read in front of its keys.
+//
+//	Build it like animBank:
+//		cc -I. -o poseTest poseTest.c animEngine.c fileEngine.c \
+//			poseEngine.c utilEngine.c -lm
+//	and run it with a .anim file and a scratch file name:
+//		poseTest charJointer.anim /tmp/poseTest.pose
+*/
+
+#include <animEngine.h>
+#include <poseEngine.h>
+#include <utilEngine.h>
+
+/*
+//	Function Name:
+//		readImage
+//
+//	Description:
+//		A static helper function to read a whole file into memory
+//
+//  Input Arguments:
+//		EtFileName fileName			The file
+//		EtInt *size					Set to the size of the file
+//
+//  Return Value:
+//		EtByte *image				The contents, or NULL
+*/
+static EtByte *
+readImage (EtFileName fileName, EtInt *size)
+{
+	FILE *fp;
+	EtByte *image = kEngineNULL;
+	long length;
+
+	fp = fopen (fileName, "rb");
+	if (fp == kEngineNULL) {
+		return (kEngineNULL);
+	}
+	if ((fseek (fp, 0, SEEK_END) == 0) && ((length = ftell (fp)) > 0)
+	&&	(fseek (fp, 0, SEEK_SET) == 0)) {
+		image = (EtByte *)engineUtilAllocate ((EtInt)length);
+		if ((image != kEngineNULL)
+		&&	(fread (image, 1, (size_t)length, fp) != (size_t)length)) {
+			engineUtilFree (image);
+			image = kEngineNULL;
+		}
+		*size = (EtInt)length;
+	}
+	fclose (fp);
+	return (image);
+}
+
+/*
+//	Function Name:
+//		writeImage
+//
+//	Description:
+//		A static helper function to write a file from memory
+//
+//  Input Arguments:
+//		EtFileName fileName			The file
+//		EtByte *image				The contents
+//		EtInt size					The size of the contents
+//
+//  Return Value:
+//		EtBoolean result
+//			kEngineTRUE				the file was written
+//			kEngineFALSE			the file could not be written
+*/
+static EtBoolean
+writeImage (EtFileName fileName, EtByte *image, EtInt size)
+{
+	FILE *fp;
+	EtBoolean written;
+
+	fp = fopen (fileName, "wb");
+	if (fp == kEngineNULL) {
+		return (kEngineFALSE);
+	}
+	written = (fwrite (image, 1, (size_t)size, fp) == (size_t)size);
+	if (fclose (fp) != 0) {
+		written = kEngineFALSE;
+	}
+	return (written);
+}
+
+int
+main (int argc, char *argv[])
+{
+	EtChannel *channelList;
+	EtPose *pose;
+	EtPoseHeader *header;
+	EtByte *image;
+	EtInt *keyCount;
+	EtBoolean *isStatic;
+	EtInt numCurves, size, c;
+
+	/* make sure we have been given the names of the files */
+	if (argc < 3) {
+		fprintf (stderr, "##### Usage: %s .anim file scratch .pose file\n", argv[0]);
+		exit (-1);
+	}
+
+	/* compile the channels and save the pose */
+	channelList = engineAnimReadCurves (argv[1], &numCurves);
+	if (channelList == kEngineNULL) {
+		fprintf (stderr, "##### Unable to parse %s\n", argv[1]);
+		exit (-1);
+	}
+	pose = enginePoseCreate (channelList);
+	engineAnimFreeChannelList (channelList);
+	if ((pose == kEngineNULL) || !enginePoseSave (pose, argv[2])) {
+		fprintf (stderr, "##### Unable to compile and save %s\n", argv[1]);
+		exit (-1);
+	}
+	enginePoseFree (pose);
+
+	/* a saved pose loads */
+	pose = enginePoseLoad (argv[2]);
+	if (pose == kEngineNULL) {
+		fprintf (stderr, "##### FAILED: %s does not load\n", argv[2]);
+		exit (-1);
+	}
+	enginePoseFree (pose);
+
+	/* take the keys away from the first channel that is not static */
+	image = readImage (argv[2], &size);
+	if (image == kEngineNULL) {
+		fprintf (stderr, "##### Unable to read %s\n", argv[2]);
+		exit (-1);
+	}
+	header = (EtPoseHeader *)image;
+	keyCount = (EtInt *)(image + header->keyCount);
+	isStatic = (EtBoolean *)(image + header->isStatic);
+	for (c = 0; (c < header->numChannels) && isStatic[c]; c++) {
+		;
+	}
+	if (c == header->numChannels) {
+		fprintf (stderr, "##### %s has no animated channels\n", argv[1]);
+		exit (-1);
+	}
+	keyCount[c] = 0;
+	if (!writeImage (argv[2], image, size)) {
+		fprintf (stderr, "##### Unable to write %s\n", argv[2]);
+		exit (-1);
+	}
+	engineUtilFree (image);
+
+	/* ... which must be refused */
+	pose = enginePoseLoad (argv[2]);
+	if (pose != kEngineNULL) {
+		fprintf (stderr, "##### FAILED: channel %d has no keys but %s loads\n",
+			c, argv[2]);
+		enginePoseFree (pose);
+		exit (-1);
+	}
+
+	printf ("poseTest: passed\n");
+	return (0);
+}
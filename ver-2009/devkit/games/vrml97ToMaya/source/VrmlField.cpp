@@ -560,6 +560,12 @@ void VrmlMFColor::set(int n, float *v)
   if (v) memcpy(d_data->d_v, v, 3*n*sizeof(float));
 }
 
+void VrmlMFColor::adopt(int n, float *v)
+{
+  d_data->deref();
+  d_data = new FData(3*n, v);
+}
+
 VrmlMFColor& VrmlMFColor::operator=(const VrmlMFColor& rhs)
 {
   if (this != &rhs) {
@@ -600,6 +606,12 @@ void VrmlMFFloat::set(int n, float *v)
   if (v) memcpy(d_data->d_v, v, n*sizeof(float));
 }
 
+void VrmlMFFloat::adopt(int n, float *v)
+{
+  d_data->deref();
+  d_data = new FData(n, v);
+}
+
 VrmlMFFloat& VrmlMFFloat::operator=(const VrmlMFFloat& rhs)
 {
   if (this != &rhs) {
@@ -640,6 +652,12 @@ void VrmlMFInt::set(int n, int *v)
   if (v) memcpy(d_data->d_v, v, n*sizeof(int));
 }
 
+void VrmlMFInt::adopt(int n, int *v)
+{
+  d_data->deref();
+  d_data = new IData(n, v);
+}
+
 VrmlMFInt& VrmlMFInt::operator=(const VrmlMFInt& rhs)
 {
   if (this != &rhs) {
@@ -794,6 +812,12 @@ void VrmlMFRotation::set(int n, float *v)
   if (v) memcpy(d_data->d_v, v, 4*n*sizeof(float));
 }
 
+void VrmlMFRotation::adopt(int n, float *v)
+{
+  d_data->deref();
+  d_data = new FData(4*n, v);
+}
+
 VrmlMFRotation& VrmlMFRotation::operator=(const VrmlMFRotation& rhs)
 {
   if (this != &rhs) {
@@ -935,6 +959,12 @@ void VrmlMFVec2f::set(int n, float *v)
   if (v) memcpy(d_data->d_v, v, 2*n*sizeof(float));
 }
 
+void VrmlMFVec2f::adopt(int n, float *v)
+{
+  d_data->deref();
+  d_data = new FData(2*n, v);
+}
+
 VrmlMFVec2f& VrmlMFVec2f::operator=(const VrmlMFVec2f& rhs)
 {
   if (this != &rhs) {
@@ -978,6 +1008,12 @@ void VrmlMFVec3f::set(int n, float *v)
   if (v) memcpy(d_data->d_v, v, 3*n*sizeof(float));
 }
 
+void VrmlMFVec3f::adopt(int n, float *v)
+{
+  d_data->deref();
+  d_data = new FData(3*n, v);
+}
+
 VrmlMFVec3f& VrmlMFVec3f::operator=(const VrmlMFVec3f& rhs)
 {
   if (this != &rhs) {
@@ -21,6 +21,7 @@ private:
   class IData {			// reference counted int data
   public:
     IData(int n=0) : d_refs(1), d_n(n), d_v(n > 0 ? new int[n] : 0) {}
+    IData(int n, int *v) : d_refs(1), d_n(n), d_v(v) {}
     ~IData() { delete [] d_v; }
 
     IData *ref() { ++d_refs; return this; }
@@ -45,6 +46,7 @@ public:
   virtual ostream& print(ostream& os) const;
 
   void set(int n, int *v);
+  void adopt(int n, int *v);	// takes over v, from new []
   VrmlMFInt& operator=(const VrmlMFInt& rhs);
 
   virtual VrmlField *clone() const;
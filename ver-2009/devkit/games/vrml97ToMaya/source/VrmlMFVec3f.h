@@ -21,6 +21,7 @@ private:
   class FData {			// reference counted float data
   public:
     FData(int n=0) : d_refs(1), d_n(n), d_v(n > 0 ? new float[n] : 0) {}
+    FData(int n, float *v) : d_refs(1), d_n(n), d_v(v) {}
     ~FData() { delete [] d_v; }
 
     FData *ref() { ++d_refs; return this; }
@@ -44,6 +45,7 @@ public:
 
   // Assignment.
   void set(int n, float *v);
+  void adopt(int n, float *v);	// takes over v, from new []
   VrmlMFVec3f& operator=(const VrmlMFVec3f& rhs);
 
   virtual VrmlField *clone() const;
@@ -403,8 +403,16 @@ void VrmlNode::eventOut(double timeStamp,
 	  this, eventOut);
 #endif	  
 
-  // Find routes from this eventOut
-  Route *r;
+  // Find routes from this eventOut. The events all share one copy of
+  // the value, which the scene recycles after the last of them.
+  Route *r, *last = 0;
+  for (r=d_routes; r; r=r->next())
+    if (strcmp(eventOut, r->fromEventOut()) == 0)
+      last = r;
+  if (! last)
+    return;
+
+  VrmlField *eventValue = d_scene->eventValue(fieldValue);
   for (r=d_routes; r; r=r->next())
     {
       if (strcmp(eventOut, r->fromEventOut()) == 0)
@@ -418,9 +426,10 @@ void VrmlNode::eventOut(double timeStamp,
 	       << r->toEventIn()
 	       << endl;
 #endif	  
-	  VrmlField *eventValue = fieldValue.clone();
 	  d_scene->queueEvent(timeStamp, eventValue,
-			      r->toNode(), r->toEventIn());
+			      r->toNode(), r->toEventIn(), r == last);
+	  if (r == last)
+	    break;
 	}
     }
 }
@@ -189,6 +189,31 @@ void VrmlNodeTimeSensor::update( VrmlSFTime &inTime )
 
 }
 
+// The earliest time at which update() will have anything to do, if none
+// of the fields change before then. Running sensors need every tick.
+
+double VrmlNodeTimeSensor::nextUpdate()
+{
+  if (! d_enabled.get())
+    return HUGE_VAL;
+  if (d_isActive.get())
+    return d_lastTime;
+
+  // update() only looks for startTimes since the last tick.
+  if (d_startTime.get() >= d_lastTime)
+    return d_startTime.get();
+  return HUGE_VAL;
+}
+
+// The scene stopped calling update() while there was nothing to do. Catch
+// up as if it had been called on each tick up to lastTick.
+
+void VrmlNodeTimeSensor::wake( double lastTick )
+{
+  if (d_enabled.get())
+    d_lastTime = lastTick;
+}
+
 // Ignore set_cycleInterval & set_startTime when active, deactivate
 // if set_enabled FALSE is received when active.
 
@@ -257,6 +282,9 @@ void VrmlNodeTimeSensor::eventIn(double timeStamp,
 void VrmlNodeTimeSensor::setField(const char *fieldName,
 				  const VrmlField &fieldValue)
 {
+  // A sleeping sensor has to look at its new fields on the next tick.
+  if (d_scene) d_scene->wakeTimeSensor(this);
+
   if TRY_FIELD(cycleInterval, SFTime)
   else if TRY_FIELD(enabled, SFBool)
   else if TRY_FIELD(loop, SFBool)
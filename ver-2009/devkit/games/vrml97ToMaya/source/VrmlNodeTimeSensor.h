@@ -37,6 +37,10 @@ public:
 
   void update( VrmlSFTime &now );
 
+  // Used by the scene to skip update() while there is nothing to do
+  double nextUpdate();
+  void wake( double lastTick );
+
   virtual void eventIn(double timeStamp,
 		       const char *eventName,
 		       const VrmlField *fieldValue);
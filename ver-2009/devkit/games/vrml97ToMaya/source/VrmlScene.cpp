@@ -16,6 +16,7 @@
 #include "VrmlScene.h"
 
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -26,6 +27,16 @@
 #include "VrmlNamespace.h"
 #include "VrmlNodeType.h"
 
+// Event values recycled by eventValue()
+#include "VrmlSFBool.h"
+#include "VrmlSFColor.h"
+#include "VrmlSFFloat.h"
+#include "VrmlSFInt.h"
+#include "VrmlSFRotation.h"
+#include "VrmlSFTime.h"
+#include "VrmlSFVec2f.h"
+#include "VrmlSFVec3f.h"
+
 
 // Handle clicks on Anchor nodes
 #include "VrmlNodeAnchor.h"
@@ -76,9 +87,23 @@ VrmlScene::VrmlScene( const char *sceneUrl, const char *localCopy ) :
   d_pendingNodes(0),
   d_pendingScope(0),
   d_frameRate(0.0),
+  d_eventMem(0),
+  d_eventMemSize(MINEVENTS),
   d_firstEvent(0),
-  d_lastEvent(0)
+  d_lastEvent(0),
+  d_deliveringEvent(0),
+  d_eventsDelivered(0),
+  d_maxEventDepth(0),
+  d_eventRate(0.0),
+  d_rateStart(-1.0),
+  d_rateEvents(0),
+  d_timerOrder(0),
+  d_lastTick(-1.0)
 {
+  d_eventMem = new Event[ d_eventMemSize ];
+  for (int t=0; t<NUMFREELISTS; ++t)
+    d_numFreeValues[t] = 0;
+
   d_nodes.addToScene(this, sceneUrl);
   d_backgrounds = new VrmlNodeList;
   d_backgroundStack = new VrmlNodeList;
@@ -90,7 +115,6 @@ VrmlScene::VrmlScene( const char *sceneUrl, const char *localCopy ) :
   d_viewpointStack = new VrmlNodeList;
   d_scopedLights = new VrmlNodeList;
   d_scripts = new VrmlNodeList;
-  d_timers = new VrmlNodeList;
   d_movies = new VrmlNodeList;
   d_audioClips = new VrmlNodeList;
 
@@ -120,7 +144,6 @@ VrmlScene::~VrmlScene()
 
   delete d_scopedLights;
   delete d_scripts;
-  delete d_timers;
   delete d_movies;
   delete d_audioClips;
 
@@ -133,6 +156,12 @@ VrmlScene::~VrmlScene()
   delete d_pendingScope;
 
   delete d_namespace;
+
+  flushEvents();
+  delete [] d_eventMem;
+  for (int t=0; t<NUMFREELISTS; ++t)
+    while (d_numFreeValues[t] > 0)
+      delete d_freeValues[t][ --d_numFreeValues[t] ];
 }
 
 // Load a (possibly non-VRML) file...
@@ -602,32 +631,71 @@ void VrmlScene::queueReplaceNodes( VrmlMFNode *nodes, VrmlNamespace *ns )
     }
 }
 
-// Event processing. Current events are in the array 
+// Event processing. Current events are in the ring
 // d_eventMem[d_firstEvent,d_lastEvent). If d_firstEvent == d_lastEvent,
-// the queue is empty. There is a fixed maximum number of events. If we
-// are so far behind that the queue is filled, the oldest events get
+// the queue is empty. The ring grows as needed up to MAXEVENTS. If we
+// are so far behind that it is full at that size, the oldest events get
 // overwritten.
 
 void VrmlScene::queueEvent(double timeStamp,
 			   VrmlField *value,
 			   VrmlNode *toNode,
-			   const char *toEventIn)
+			   const char *toEventIn,
+			   bool lastUse)
 {
   Event *e = &d_eventMem[d_lastEvent];
   e->timeStamp = timeStamp;
   e->value = value;
   e->toNode = toNode;
   e->toEventIn = toEventIn;
-  d_lastEvent = (d_lastEvent+1) % MAXEVENTS;
+  e->lastUse = lastUse;
+  d_lastEvent = (d_lastEvent+1) % d_eventMemSize;
 
-  // If the event queue is full, discard the oldest (in terms of when it
-  // was put on the queue, not necessarily in terms of earliest timestamp).
   if (d_lastEvent == d_firstEvent)
     {
-      e = &d_eventMem[d_lastEvent];
-      delete e->value;
-      d_firstEvent = (d_firstEvent+1) % MAXEVENTS;
+      // If the event queue is full, discard the oldest (in terms of when
+      // it was put on the queue, not necessarily in terms of earliest
+      // timestamp).
+      if (d_eventMemSize >= MAXEVENTS)
+	{
+	  releaseEvent( &d_eventMem[d_firstEvent] );
+	  d_firstEvent = (d_firstEvent+1) % d_eventMemSize;
+	}
+      else
+	growEventQueue();
+    }
+
+  int depth = eventQueueDepth();
+  if (depth > d_maxEventDepth)
+    d_maxEventDepth = depth;
+}
+
+// Double the size of a full event queue, unrolling the ring so that
+// the oldest event comes first.
+
+void VrmlScene::growEventQueue()
+{
+  Event *mem = new Event[ 2 * d_eventMemSize ];
+  int n = 0;
+  do
+    {
+      mem[n++] = d_eventMem[d_firstEvent];
+      d_firstEvent = (d_firstEvent+1) % d_eventMemSize;
     }
+  while (d_firstEvent != d_lastEvent);
+
+  delete [] d_eventMem;
+  d_eventMem = mem;
+  d_eventMemSize *= 2;
+  d_firstEvent = 0;
+  d_lastEvent = n;
+}
+
+// Number of events waiting to be distributed
+
+int VrmlScene::eventQueueDepth()
+{
+  return (d_lastEvent - d_firstEvent + d_eventMemSize) % d_eventMemSize;
 }
 
 // Any events waiting to be distributed?
@@ -643,9 +711,67 @@ void VrmlScene::flushEvents()
   while (d_firstEvent != d_lastEvent)
     {
       Event *e = &d_eventMem[d_firstEvent];
-      d_firstEvent = (d_firstEvent+1) % MAXEVENTS;
-      delete e->value;
+      d_firstEvent = (d_firstEvent+1) % d_eventMemSize;
+      releaseEvent( e );
+    }
+}
+
+// Copy a value to be sent in an event. Event values are short lived, so
+// SF values that have been delivered are kept to be reused here rather
+// than being deleted and allocated again for every event.
+
+VrmlField *VrmlScene::eventValue( const VrmlField &value )
+{
+  int t = value.fieldType();
+  int list = freeValueList( t );
+  if (list < 0 || d_numFreeValues[list] == 0)
+    return value.clone();
+
+  VrmlField *v = d_freeValues[list][ --d_numFreeValues[list] ];
+  switch (t)
+    {
+    case VrmlField::SFBOOL:	*v->toSFBool() = *value.toSFBool(); break;
+    case VrmlField::SFCOLOR:	*v->toSFColor() = *value.toSFColor(); break;
+    case VrmlField::SFFLOAT:	*v->toSFFloat() = *value.toSFFloat(); break;
+    case VrmlField::SFINT32:	*v->toSFInt() = *value.toSFInt(); break;
+    case VrmlField::SFROTATION:	*v->toSFRotation() = *value.toSFRotation(); break;
+    case VrmlField::SFTIME:	*v->toSFTime() = *value.toSFTime(); break;
+    case VrmlField::SFVEC2F:	*v->toSFVec2f() = *value.toSFVec2f(); break;
+    case VrmlField::SFVEC3F:	*v->toSFVec3f() = *value.toSFVec3f(); break;
     }
+  return v;
+}
+
+// Done with an event. Keep its value for eventValue() unless a later
+// event shares it. An event that shares the value being delivered can
+// be dropped by the eventIn when the queue is full; the value is then
+// only released once that eventIn is done with it.
+
+void VrmlScene::releaseEvent( Event *e )
+{
+  if (! e->lastUse) return;
+
+  if (d_deliveringEvent && e != d_deliveringEvent &&
+      e->value == d_deliveringEvent->value)
+    {
+      d_deliveringEvent->lastUse = true;
+      return;
+    }
+
+  int list = freeValueList( e->value->fieldType() );
+  if (list >= 0 && d_numFreeValues[list] < MAXFREEVALUES)
+    d_freeValues[list][ d_numFreeValues[list]++ ] = e->value;
+  else
+    delete e->value;
+}
+
+// The free list for values of a field type, or -1 if they aren't kept.
+
+int VrmlScene::freeValueList( int fieldType )
+{
+  if (fieldType < VrmlField::SFBOOL || fieldType > VrmlField::SFVEC3F)
+    return -1;
+  return fieldType - VrmlField::SFBOOL;
 }
 
 // Called by the viewer when the cursor passes over, clicks, drags, or
@@ -715,16 +841,49 @@ bool VrmlScene::update( double timeStamp )
 
   d_deltaTime = DEFAULT_DELTA;
 
-  // Update each of the timers.
-  VrmlNodeList::iterator i, end = d_timers->end();
-  for (i = d_timers->begin(); i != end; ++i)
+  // Wake the timers that have something to do now. If time has gone
+  // backwards, wake them all so they can catch up.
+  if (timeStamp < d_lastTick)
+    {
+      TimerStateMap::iterator s, send = d_timerState.end();
+      for (s = d_timerState.begin(); s != send; ++s)
+	wakeTimer( s );
+    }
+  while (! d_timerSchedule.empty() &&
+	 d_timerSchedule.begin()->first <= timeStamp)
+    wakeTimer( d_timerState.find( d_timerSchedule.begin()->second ) );
+
+  // Update each of the awake timers, and put the ones that are idle
+  // back to sleep.
+  TimerList::iterator ti = d_awakeTimers.begin();
+  while (ti != d_awakeTimers.end())
     {
-      VrmlNodeTimeSensor *t = (*i)->toTimeSensor();
-      if (t) t->update( now );
+      VrmlNodeTimeSensor *t = ti->second;
+      t->update( now );
+
+      double wakeTime = t->nextUpdate();
+      if (wakeTime > timeStamp)
+	{
+	  TimerState &state = d_timerState[ t ];
+	  state.asleep = true;
+	  if (wakeTime < HUGE_VAL)
+	    state.wake = d_timerSchedule.insert(
+	      TimerSchedule::value_type( wakeTime, t ) );
+	  else
+	    state.wake = d_timerSchedule.end();
+	  d_awakeTimers.erase( ti++ );
+	}
+      else
+	++ti;
     }
+  d_lastTick = timeStamp;
+
+  // Make sure the viewer is back in time for the next timer to wake.
+  if (! d_timerSchedule.empty())
+    setDelta( d_timerSchedule.begin()->first - timeStamp );
 
   // Update each of the clips.
-  end = d_audioClips->end();
+  VrmlNodeList::iterator i, end = d_audioClips->end();
   for (i = d_audioClips->begin(); i != end; ++i)
     {
       VrmlNodeAudioClip *c = (*i)->toAudioClip();
@@ -752,20 +911,37 @@ bool VrmlScene::update( double timeStamp )
   while (d_firstEvent != d_lastEvent &&
 	 ! d_pendingUrl && ! d_pendingNodes)
     {
-      Event *e = &d_eventMem[d_firstEvent];
-      d_firstEvent = (d_firstEvent+1) % MAXEVENTS;
+      // Copy the event out, the queue may grow while it is delivered.
+      Event e = d_eventMem[d_firstEvent];
+      d_firstEvent = (d_firstEvent+1) % d_eventMemSize;
 
       // Ensure that the node is in the scene graph
-      VrmlNode *n = e->toNode;
+      VrmlNode *n = e.toNode;
       if (this != n->scene())
 	{
 	  theSystem->debug("VrmlScene::update: %s::%s is not in the scene graph yet.\n",
 			   n->nodeType()->getName(), n->name());
 	  n->addToScene((VrmlScene*)this, urlDoc()->url() );
 	}
-      n->eventIn(e->timeStamp, e->toEventIn, e->value);
-      // this needs to change if event values are shared...
-      delete e->value;
+      d_deliveringEvent = &e;
+      n->eventIn(e.timeStamp, e.toEventIn, e.value);
+      d_deliveringEvent = 0;
+      releaseEvent( &e );
+      ++d_eventsDelivered;
+      ++d_rateEvents;
+    }
+
+  // Event statistics, updated about once a second
+  if (d_rateStart < 0.0 || timeStamp < d_rateStart)
+    d_rateStart = timeStamp;
+  else if (timeStamp - d_rateStart >= 1.0)
+    {
+      d_eventRate = d_rateEvents / (timeStamp - d_rateStart);
+      theSystem->debug("VrmlScene::update: %g events/s, %d queued (%d max), %d timers awake\n",
+		       d_eventRate, eventQueueDepth(), d_maxEventDepth,
+		       (int) d_awakeTimers.size());
+      d_rateStart = timeStamp;
+      d_rateEvents = 0;
     }
 
   if (d_pendingNodes)
@@ -1205,14 +1381,54 @@ void VrmlScene::removeScript( VrmlNodeScript *script )
 
 // TimeSensors
 
+// New timers start out awake, and are updated in the order they were
+// added.
+
 void VrmlScene::addTimeSensor( VrmlNodeTimeSensor *timer )
 {
-  d_timers->push_back( timer );
+  if (d_timerState.find( timer ) != d_timerState.end())
+    return;
+
+  TimerState &state = d_timerState[ timer ];
+  state.order = d_timerOrder++;
+  state.asleep = false;
+  state.wake = d_timerSchedule.end();
+  d_awakeTimers[ state.order ] = timer;
 }
 
 void VrmlScene::removeTimeSensor( VrmlNodeTimeSensor *timer )
 {
-  d_timers->remove( timer );
+  TimerStateMap::iterator s = d_timerState.find( timer );
+  if (s == d_timerState.end())
+    return;
+
+  if (! s->second.asleep)
+    d_awakeTimers.erase( s->second.order );
+  else if (s->second.wake != d_timerSchedule.end())
+    d_timerSchedule.erase( s->second.wake );
+  d_timerState.erase( s );
+}
+
+// A sleeping timer must be updated on the next tick if its fields change.
+
+void VrmlScene::wakeTimeSensor( VrmlNodeTimeSensor *timer )
+{
+  wakeTimer( d_timerState.find( timer ) );
+}
+
+void VrmlScene::wakeTimer( TimerStateMap::iterator s )
+{
+  if (s == d_timerState.end() || ! s->second.asleep)
+    return;
+
+  if (s->second.wake != d_timerSchedule.end())
+    d_timerSchedule.erase( s->second.wake );
+  s->second.asleep = false;
+  s->second.wake = d_timerSchedule.end();
+  d_awakeTimers[ s->second.order ] = s->first;
+
+  // It slept through the ticks since it was put to sleep
+  s->first->wake( d_lastTick );
 }
 
 
@@ -14,8 +14,10 @@
 
 #if defined AW_NEW_IOSTREAMS
 #  include <iostream>
+#  include <map>
 #else
 #  include <iostream.h>
+#  include <map.h>
 #endif
 
 // The loaders fill in a Group node
@@ -114,15 +116,27 @@ public:
   void sensitiveEvent( void *object, double timeStamp,
 		       bool isOver, bool isActive, double *point );
 
-  // Queue an event for a given node
+  // Queue an event for a given node. The scene owns the value, and
+  // recycles it when the event is delivered. Several events can share
+  // one value if all but the last of them are queued with lastUse false.
   void queueEvent(double timeStamp,
 		  VrmlField *value,
-		  VrmlNode *toNode, const char *toEventIn);
+		  VrmlNode *toNode, const char *toEventIn,
+		  bool lastUse = true);
+
+  // Copy a value for queueEvent, reusing a delivered one if possible
+  VrmlField *eventValue( const VrmlField &value );
 
   bool eventsPending();
 
   void flushEvents();
 
+  // Event statistics
+  unsigned long eventsDelivered() { return d_eventsDelivered; }
+  double eventRate()		  { return d_eventRate; }
+  int eventQueueDepth();
+  int maxEventQueueDepth()	  { return d_maxEventDepth; }
+
   // Script node API support functions. Can be overridden if desired.
   virtual const char *getName();
   virtual const char *getVersion();
@@ -199,6 +213,7 @@ public:
   // TimeSensors
   void addTimeSensor( VrmlNodeTimeSensor * );
   void removeTimeSensor( VrmlNodeTimeSensor * );
+  void wakeTimeSensor( VrmlNodeTimeSensor * );
 
   // AudioClips
   void addAudioClip( VrmlNodeAudioClip * );
@@ -279,27 +294,67 @@ protected:
     VrmlField *value;
     VrmlNode *toNode;
     const char *toEventIn;
+    bool lastUse;		// No later event shares the value
   } Event;
 
-  // For each scene can have a limited number of pending events.
-  // Repeatedly allocating/freeing events is slow (it would be
-  // nice to get rid of the field cloning, too), and if there are
-  // so many events pending, we are probably running too slow to
-  // handle them effectively anyway.
+  void growEventQueue();
+  void releaseEvent( Event *e );
+  static int freeValueList( int fieldType );
+
+  // Pending events are kept in a ring that doubles in size as needed, up
+  // to MAXEVENTS. If there are so many events pending, we are probably
+  // running too slow to handle them effectively anyway, so after that
+  // the oldest events get overwritten.
   // The event queue ought to be sorted by timeStamp...
-  //static const int MAXEVENTS = 400; MSVC++5 doesn't like this.
-  enum { MAXEVENTS = 400 };
-  Event d_eventMem[MAXEVENTS];
+  //static const int MAXEVENTS = 65536; MSVC++5 doesn't like this.
+  enum { MINEVENTS = 256, MAXEVENTS = 65536 };
+  Event *d_eventMem;
+  int d_eventMemSize;
   int d_firstEvent, d_lastEvent;
 
+  // The event being passed to eventIn, which is no longer in the ring.
+  Event *d_deliveringEvent;
+
+  // Delivered SF values, by field type from SFBOOL to SFVEC3F, for
+  // eventValue() to reuse so that passing events along doesn't allocate.
+  enum { MAXFREEVALUES = 64,
+	 NUMFREELISTS = VrmlField::SFVEC3F - VrmlField::SFBOOL + 1 };
+  VrmlField *d_freeValues[ NUMFREELISTS ][ MAXFREEVALUES ];
+  int d_numFreeValues[ NUMFREELISTS ];
+
+  // Event statistics
+  unsigned long d_eventsDelivered;
+  int d_maxEventDepth;
+  double d_eventRate;		// Events/second over the last second
+  double d_rateStart;		// Start of the current second
+  unsigned long d_rateEvents;	// Events delivered since d_rateStart
+
   // Scene-scoped lights (PointLights and SpotLights)
   VrmlNodeList* d_scopedLights;
 
   // Scripts in this scene
   VrmlNodeList* d_scripts;
 
-  // Time sensors in this scene
-  VrmlNodeList* d_timers;
+  // Time sensors in this scene, by the order they were added. Only the
+  // awake ones are updated each tick; the others sleep until their time
+  // in d_timerSchedule comes up or one of their fields changes, so idle
+  // sensors cost nothing.
+  typedef map< unsigned long, VrmlNodeTimeSensor* > TimerList;
+  typedef multimap< double, VrmlNodeTimeSensor* > TimerSchedule;
+  typedef struct {
+    unsigned long order;
+    bool asleep;
+    TimerSchedule::iterator wake;	// d_timerSchedule.end() if none
+  } TimerState;
+  typedef map< VrmlNodeTimeSensor*, TimerState > TimerStateMap;
+
+  void wakeTimer( TimerStateMap::iterator );
+
+  TimerStateMap d_timerState;
+  TimerList d_awakeTimers;
+  TimerSchedule d_timerSchedule;
+  unsigned long d_timerOrder;
+  double d_lastTick;		// Time the timers were last updated
 
   // Audio clips in this scene
   VrmlNodeList* d_audioClips;
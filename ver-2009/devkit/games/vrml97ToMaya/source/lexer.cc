@@ -3025,12 +3025,81 @@ static void initString()
   sfStringChars[0] = 0;
 }
 
-	/* These are used when parsing MF* fields */
-
-static vector<int> mfInts;
-static vector<float> mfFloats;
+	/* These are used when parsing MF* fields.  The numbers are */
+	/* collected straight into arrays that the finished field */
+	/* takes over, rather than being copied out of vectors. */
+
+static float *mfFloats = 0;
+static int mfFloatsN = 0;
+static int mfFloatsMax = 0;
+static int *mfInts = 0;
+static int mfIntsN = 0;
+static int mfIntsMax = 0;
 static vector<char*> mfStrs;
 
+static void addMFFloat(float f)
+{
+  if (mfFloatsN == mfFloatsMax)
+    {
+      int max = mfFloatsMax ? 2 * mfFloatsMax : 64;
+      float *v = new float[max];
+      if (mfFloatsN) memcpy(v, mfFloats, mfFloatsN * sizeof(float));
+      delete [] mfFloats;
+      mfFloats = v;
+      mfFloatsMax = max;
+    }
+  mfFloats[mfFloatsN++] = f;
+}
+
+static void addMFInt(int i)
+{
+  if (mfIntsN == mfIntsMax)
+    {
+      int max = mfIntsMax ? 2 * mfIntsMax : 64;
+      int *v = new int[max];
+      if (mfIntsN) memcpy(v, mfInts, mfIntsN * sizeof(int));
+      delete [] mfInts;
+      mfInts = v;
+      mfIntsMax = max;
+    }
+  mfInts[mfIntsN++] = i;
+}
+
+	/* Hand over the collected numbers, trimming off any large excess. */
+	/* An empty list keeps its array for the next field. */
+
+static float *takeMFFloats()
+{
+  float *v = mfFloats;
+  if (mfFloatsN == 0)
+    return 0;
+  if (mfFloatsMax - mfFloatsN > mfFloatsN / 4)
+    {
+      v = new float[mfFloatsN];
+      memcpy(v, mfFloats, mfFloatsN * sizeof(float));
+      delete [] mfFloats;
+    }
+  mfFloats = 0;
+  mfFloatsN = mfFloatsMax = 0;
+  return v;
+}
+
+static int *takeMFInts()
+{
+  int *v = mfInts;
+  if (mfIntsN == 0)
+    return 0;
+  if (mfIntsMax - mfIntsN > mfIntsN / 4)
+    {
+      v = new int[mfIntsN];
+      memcpy(v, mfInts, mfIntsN * sizeof(int));
+      delete [] mfInts;
+    }
+  mfInts = 0;
+  mfIntsN = mfIntsMax = 0;
+  return v;
+}
+
 #ifdef __cplusplus
 extern "C"
 #endif
@@ -3061,6 +3130,243 @@ static char *skip_ws(char *s)
   return s;
 }
 
+	/* Read the float at s, and skip the whitespace after it. */
+
+static char *readFloat(char *s, float *f)
+{
+  char *e;
+  *f = (float) strtod(s, &e);
+  return skip_ws(e);
+}
+
+
+	/* Fast path for numeric MF fields.  Rather than matching each */
+	/* number with a rule, scanMFNumbers() parses the list straight */
+	/* out of the flex input buffer.  It stops only at the start of a */
+	/* whole value (all three floats of an MFVec3f, say), and leaves */
+	/* whatever it does not handle itself -- the closing bracket, IS, */
+	/* bad input, or a value that runs off the end of the buffer -- to */
+	/* the rules, which then call it again. */
+
+static int isMFSeparator(char c)
+{
+  return (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' ||
+	  c == '#' || c == ']');
+}
+
+static const double mfPowersOf10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+	/* Parse a {float} at s, not reading past end.  Returns the end */
+	/* of the number, or 0 if there is not a whole number there. */
+
+static char *scanMFFloat(char *s, char *end, float *f)
+{
+  char *p = s;
+  int neg = 0;
+  if (p < end && (*p == '-' || *p == '+'))
+    neg = (*p++ == '-');
+
+  /* Up to 15 significant digits are held exactly in a double. */
+  double m = 0.0;
+  int digits = 0, intDigits = 0, fracDigits = 0, dot = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+    {
+      if (digits || *p != '0') ++digits;
+      m = m * 10.0 + (*p++ - '0');
+      ++intDigits;
+    }
+  if (p < end && *p == '.')
+    {
+      dot = 1;
+      ++p;
+      while (p < end && *p >= '0' && *p <= '9')
+	{
+	  if (digits || *p != '0') ++digits;
+	  m = m * 10.0 + (*p++ - '0');
+	  ++fracDigits;
+	}
+    }
+  if (intDigits == 0 && fracDigits == 0)
+    return 0;
+
+  /* As in {float}, "1." takes no exponent. */
+  int exp = 0;
+  if ((fracDigits > 0 || !dot) && p < end && (*p == 'e' || *p == 'E'))
+    {
+      char *q = p + 1;
+      int expNeg = 0;
+      if (q < end && (*q == '-' || *q == '+'))
+	expNeg = (*q++ == '-');
+      if (q < end && *q >= '0' && *q <= '9')
+	{
+	  while (q < end && *q >= '0' && *q <= '9')
+	    {
+	      if (exp < 10000) exp = exp * 10 + (*q - '0');
+	      ++q;
+	    }
+	  if (expNeg) exp = -exp;
+	  p = q;
+	}
+    }
+  if (p >= end || ! isMFSeparator(*p))
+    return 0;
+
+  /* An exact mantissa and power of ten give the correctly rounded */
+  /* result in one operation; anything else goes to strtod. */
+  int e10 = exp - fracDigits;
+  double v;
+  if (digits <= 15 && e10 >= -22 && e10 <= 22)
+    {
+      v = e10 < 0 ? m / mfPowersOf10[-e10] : m * mfPowersOf10[e10];
+      if (neg) v = -v;
+    }
+  else
+    {
+      char buf[64];
+      if (p - s >= (int) sizeof(buf))
+	return 0;
+      memcpy(buf, s, p - s);
+      buf[p - s] = 0;
+      v = strtod(buf, 0);
+    }
+  *f = (float) v;
+  return p;
+}
+
+	/* Parse an {int} at s, not reading past end, with the same */
+	/* result as strtol(s,0,0). */
+
+static char *scanMFInt(char *s, char *end, int *i)
+{
+  char *p = s;
+  int slow = 0;
+  if (p + 1 < end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    {
+      p += 2;
+      while (p < end && ((*p >= '0' && *p <= '9') ||
+			 (*p >= 'a' && *p <= 'f') ||
+			 (*p >= 'A' && *p <= 'F')))
+	++p;
+      slow = 1;
+    }
+  else
+    {
+      int neg = 0;
+      long v = 0;
+      if (p < end && (*p == '-' || *p == '+'))
+	neg = (*p++ == '-');
+      char *first = p;
+      while (p < end && *p >= '0' && *p <= '9')
+	{
+	  if (p - first < 9) v = v * 10 + (*p - '0');
+	  ++p;
+	}
+      if (p == first)
+	return 0;
+      /* Leading zeros mean octal to strtol, and long ones can overflow */
+      if (p - first > 9 || (*first == '0' && p - first > 1))
+	slow = 1;
+      else
+	*i = (int) (neg ? -v : v);
+    }
+  if (p >= end || ! isMFSeparator(*p))
+    return 0;
+
+  if (slow)
+    {
+      char buf[64];
+      if (p - s >= (int) sizeof(buf))
+	return 0;
+      memcpy(buf, s, p - s);
+      buf[p - s] = 0;
+      *i = (int) strtol(buf, 0, 0);
+    }
+  return p;
+}
+
+static void scanMFNumbers()
+{
+  int perValue;
+  switch (expectToken) {
+  case MF_FLOAT:
+  case MF_INT32: perValue = 1; break;
+  case MF_VEC2F: perValue = 2; break;
+  case MF_COLOR:
+  case MF_VEC3F: perValue = 3; break;
+  case MF_ROTATION: perValue = 4; break;
+  default: return;
+  }
+
+  /* Flex has put a 0 after the text just matched; undo that and */
+  /* carry on from there. */
+  char *p = yy_c_buf_p;
+  char *end = &YY_CURRENT_BUFFER->yy_ch_buf[yy_n_chars];
+  *p = yy_hold_char;
+
+  for (;;)
+    {
+      char *valueStart = p;
+      int valueLine = currentLineNumber;
+      int valueFloats = mfFloatsN;
+      int valueInts = mfIntsN;
+      int n;
+
+      for (n = 0; n < perValue; ++n)
+	{
+	  while (p < end)
+	    {
+	      if (*p == '#')
+		{
+		  char *nl = (char *) memchr(p, '\n', end - p);
+		  if (! nl) break;
+		  p = nl;
+		}
+	      else if (*p == '\n')
+		{
+		  ++p;
+		  ++currentLineNumber;
+		}
+	      else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == ',')
+		++p;
+	      else
+		break;
+	    }
+
+	  char *q;
+	  if (expectToken == MF_INT32)
+	    {
+	      int i;
+	      if (! (q = scanMFInt(p, end, &i))) break;
+	      addMFInt(i);
+	    }
+	  else
+	    {
+	      float f;
+	      if (! (q = scanMFFloat(p, end, &f))) break;
+	      addMFFloat(f);
+	    }
+	  p = q;
+	}
+
+      if (n < perValue)
+	{
+	  p = valueStart;
+	  currentLineNumber = valueLine;
+	  mfFloatsN = valueFloats;
+	  mfIntsN = valueInts;
+	  break;
+	}
+    }
+
+  yy_c_buf_p = p;
+  yy_hold_char = *p;
+  *p = '\0';
+}
+
+
 
 /* Normal state:  parsing nodes.  The initial start state is used */
 /* only to recognize the VRML header. */
@@ -3468,10 +3774,11 @@ case 17:
 YY_RULE_SETUP
 { if (parsing_mf) yyerror("Double [");
 					  parsing_mf = 1;
-					  mfInts.erase(mfInts.begin(), mfInts.end());
-					  mfFloats.erase(mfFloats.begin(), mfFloats.end());
+					  mfIntsN = 0;
+					  mfFloatsN = 0;
 					  /* parse errors can leak memory */
 					  mfStrs.erase(mfStrs.begin(), mfStrs.end());
+					  scanMFNumbers();
 					}
 	YY_BREAK
 case 18:
@@ -3480,44 +3787,70 @@ YY_RULE_SETUP
 					  if (! parsing_mf) yyerror("Unmatched ]");
 					  int fieldType = expectToken;
 
+					  int n = mfFloatsN;
+
 					  switch (fieldType) {
 					  case MF_COLOR:
-					    yylval.field = new VrmlMFColor(mfFloats.size() / 3, &mfFloats[0]);
+					    {
+					      VrmlMFColor *mf = new VrmlMFColor();
+					      mf->adopt(n / 3, takeMFFloats());
+					      yylval.field = mf;
+					    }
 					    break;
 					  case MF_FLOAT:
-					    yylval.field = new VrmlMFFloat(mfFloats.size(), &mfFloats[0]);
+					    {
+					      VrmlMFFloat *mf = new VrmlMFFloat();
+					      mf->adopt(n, takeMFFloats());
+					      yylval.field = mf;
+					    }
 					    break;
 					  case MF_INT32:
 					    if (expectCoordIndex &&
-						mfInts.size() > 0 &&
-						-1 != mfInts[mfInts.size()-1])
-					      mfInts.push_back(-1);
-					    yylval.field = new VrmlMFInt(mfInts.size(), &mfInts[0]);
+						mfIntsN > 0 &&
+						-1 != mfInts[mfIntsN-1])
+					      addMFInt(-1);
+					    {
+					      VrmlMFInt *mf = new VrmlMFInt();
+					      n = mfIntsN;
+					      mf->adopt(n, takeMFInts());
+					      yylval.field = mf;
+					    }
 					    break;
 					  case MF_ROTATION:
-					    yylval.field = new VrmlMFRotation(mfFloats.size() / 4, &mfFloats[0]);
+					    {
+					      VrmlMFRotation *mf = new VrmlMFRotation();
+					      mf->adopt(n / 4, takeMFFloats());
+					      yylval.field = mf;
+					    }
 					    break;
 					  case MF_STRING:
-					    yylval.field = new VrmlMFString(mfStrs.size(), &mfStrs[0]);
-					    vector<char*>::iterator mfs;
-					    for (mfs = mfStrs.begin();
-						 mfs != mfStrs.end(); ++mfs)
-					      delete [] (*mfs);
+					    yylval.field = new VrmlMFString((int)mfStrs.size(), &mfStrs[0]);
+                        {
+					      vector<char*>::iterator mfs;
+					      for (mfs = mfStrs.begin();
+						   mfs != mfStrs.end(); ++mfs)
+					        delete [] (*mfs);
+                        }
 					    mfStrs.erase(mfStrs.begin(), mfStrs.end());
 					    break;
 					  case MF_VEC2F:
-					    yylval.field = new VrmlMFVec2f(mfFloats.size() / 2, &mfFloats[0]);
+					    {
+					      VrmlMFVec2f *mf = new VrmlMFVec2f();
+					      mf->adopt(n / 2, takeMFFloats());
+					      yylval.field = mf;
+					    }
 					    break;
 					  case MF_VEC3F:
-					    yylval.field = new VrmlMFVec3f(mfFloats.size() / 3, &mfFloats[0]);
+					    {
+					      VrmlMFVec3f *mf = new VrmlMFVec3f();
+					      mf->adopt(n / 3, takeMFFloats());
+					      yylval.field = mf;
+					    }
 					    break;
 					  }
 					  BEGIN NODE;
 					  parsing_mf = 0;
 					  expectToken = 0;
-
-					  mfFloats.erase(mfFloats.begin(), mfFloats.end());
-					  mfInts.erase(mfInts.begin(), mfInts.end());
 					  return fieldType;
 					}
 	YY_BREAK
@@ -3542,9 +3875,10 @@ case 22:
 YY_RULE_SETUP
 {
 			  int i = strtol(yytext,0,0);
-			  if (parsing_mf)
-			    mfInts.push_back(i);
-			  else {    /* No open bracket means a single value: */
+			  if (parsing_mf) {
+			    addMFInt(i);
+			    scanMFNumbers();
+			  } else {    /* No open bracket means a single value: */
 			    yylval.field = new VrmlMFInt(i);
 			    BEGIN NODE; expectToken = 0;
 			    return MF_INT32;
@@ -3555,7 +3889,7 @@ YY_RULE_SETUP
 case 23:
 YY_RULE_SETUP
 {
-			  yylval.field = new VrmlSFFloat(atof(yytext));
+			  yylval.field = new VrmlSFFloat((float)atof(yytext));
 			  BEGIN NODE; expectToken = 0;
 			  return SF_FLOAT;
 			}
@@ -3563,10 +3897,11 @@ YY_RULE_SETUP
 case 24:
 YY_RULE_SETUP
 {
-			  float f = atof(yytext);
-			  if (parsing_mf)
-			    mfFloats.push_back(f);
-                  	  else {    /* No open bracket means a single value: */
+			  float f = (float)atof(yytext);
+			  if (parsing_mf) {
+			    addMFFloat(f);
+			    scanMFNumbers();
+			  } else {    /* No open bracket means a single value: */
 			    yylval.field = new VrmlMFFloat(f);
 			    BEGIN NODE; expectToken = 0;
 			    return MF_FLOAT;
@@ -3576,13 +3911,9 @@ YY_RULE_SETUP
 case 25:
 YY_RULE_SETUP
 {
-				  float x = 0.0, y = 0.0;
-				  int n = 0;
-				  char *s = &yytext[0];
-
-				  sscanf(s,"%g%n", &x, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g", &y);
+				  float x, y;
+				  char *s = readFloat(yytext, &x);
+				  readFloat(s, &y);
 				  yylval.field = new VrmlSFVec2f(x,y);
 				  BEGIN NODE; expectToken = 0;
 				  return SF_VEC2F; 
@@ -3591,16 +3922,13 @@ YY_RULE_SETUP
 case 26:
 YY_RULE_SETUP
 {
-				  float x = 0.0, y = 0.0;
-				  int n = 0;
-				  char *s = &yytext[0];
-
-				  sscanf(s,"%g%n", &x, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g", &y);
+				  float x, y;
+				  char *s = readFloat(yytext, &x);
+				  readFloat(s, &y);
 				  if (parsing_mf) {
-				    mfFloats.push_back(x);
-				    mfFloats.push_back(y);
+				    addMFFloat(x);
+				    addMFFloat(y);
+				    scanMFNumbers();
 				  } else {
 				    yylval.field = new VrmlMFVec2f(x,y);
 				    BEGIN NODE; expectToken = 0;
@@ -3611,15 +3939,10 @@ YY_RULE_SETUP
 case 27:
 YY_RULE_SETUP
 {
-				  float x = 0.0, y = 0.0, z = 0.0;
-				  int n = 0;
-				  char *s = &yytext[0];
-
-				  sscanf(s,"%g%n", &x, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g%n", &y, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g", &z);
+				  float x, y, z;
+				  char *s = readFloat(yytext, &x);
+				  s = readFloat(s, &y);
+				  readFloat(s, &z);
 
 				  yylval.field = new VrmlSFVec3f(x,y,z);
 
@@ -3630,20 +3953,16 @@ YY_RULE_SETUP
 case 28:
 YY_RULE_SETUP
 {
-				  float x = 0.0, y = 0.0, z = 0.0;
-				  int n = 0;
-				  char *s = &yytext[0];
-
-				  sscanf(s,"%g%n", &x, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g%n", &y, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g", &z);
+				  float x, y, z;
+				  char *s = readFloat(yytext, &x);
+				  s = readFloat(s, &y);
+				  readFloat(s, &z);
 
 				  if (parsing_mf) {
-				    mfFloats.push_back(x);
-				    mfFloats.push_back(y);
-				    mfFloats.push_back(z);
+				    addMFFloat(x);
+				    addMFFloat(y);
+				    addMFFloat(z);
+				    scanMFNumbers();
 				  } else {
 				    yylval.field = new VrmlMFVec3f(x,y,z);
                                     BEGIN NODE; expectToken = 0;
@@ -3654,16 +3973,11 @@ YY_RULE_SETUP
 case 29:
 YY_RULE_SETUP
 {
-				  float x = 0.0, y = 0.0, z = 0.0, r = 0.0;
-				  int n = 0;
-				  char *s = &yytext[0];
-				  sscanf(s,"%g%n", &x, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g%n", &y, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g%n", &z, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g", &r);
+				  float x, y, z, r;
+				  char *s = readFloat(yytext, &x);
+				  s = readFloat(s, &y);
+				  s = readFloat(s, &z);
+				  readFloat(s, &r);
 				  yylval.field = new VrmlSFRotation(x,y,z,r);
 				  BEGIN NODE; expectToken = 0; 
 				  return SF_ROTATION;
@@ -3672,22 +3986,18 @@ YY_RULE_SETUP
 case 30:
 YY_RULE_SETUP
 {
-				  float x = 0.0, y = 0.0, z = 0.0, r = 0.0;
-				  int n = 0;
-				  char *s = &yytext[0];
-				  sscanf(s,"%g%n", &x, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g%n", &y, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g%n", &z, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g", &r);
+				  float x, y, z, r;
+				  char *s = readFloat(yytext, &x);
+				  s = readFloat(s, &y);
+				  s = readFloat(s, &z);
+				  readFloat(s, &r);
 
 				  if (parsing_mf) {
-				    mfFloats.push_back(x);
-				    mfFloats.push_back(y);
-				    mfFloats.push_back(z);
-				    mfFloats.push_back(r);
+				    addMFFloat(x);
+				    addMFFloat(y);
+				    addMFFloat(z);
+				    addMFFloat(r);
+				    scanMFNumbers();
 				  } else {
 				    yylval.field = new VrmlMFRotation(x,y,z,r);
                                     BEGIN NODE; expectToken = 0;
@@ -3698,14 +4008,10 @@ YY_RULE_SETUP
 case 31:
 YY_RULE_SETUP
 {
-				  float r = 0.0, g = 0.0, b = 0.0;
-				  int n = 0;
-				  char *s = &yytext[0];
-				  sscanf(s,"%g%n", &r, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g%n", &g, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g", &b);
+				  float r, g, b;
+				  char *s = readFloat(yytext, &r);
+				  s = readFloat(s, &g);
+				  readFloat(s, &b);
 
 				  yylval.field = new VrmlSFColor(r,g,b);
 				  BEGIN NODE; expectToken = 0; 
@@ -3715,19 +4021,16 @@ YY_RULE_SETUP
 case 32:
 YY_RULE_SETUP
 {
-				  float r = 0.0, g = 0.0, b = 0.0;
-				  int n = 0;
-				  char *s = &yytext[0];
-				  sscanf(s,"%g%n", &r, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g%n", &g, &n);
-				  s = skip_ws(s+n);
-				  sscanf(s,"%g", &b);
+				  float r, g, b;
+				  char *s = readFloat(yytext, &r);
+				  s = readFloat(s, &g);
+				  readFloat(s, &b);
 
 				  if (parsing_mf) {
-				    mfFloats.push_back(r);
-				    mfFloats.push_back(g);
-				    mfFloats.push_back(b);
+				    addMFFloat(r);
+				    addMFFloat(g);
+				    addMFFloat(b);
+				    scanMFNumbers();
 				  } else {
 				    yylval.field = new VrmlMFColor(r,g,b);
                                     BEGIN NODE; expectToken = 0;
@@ -0,0 +1,231 @@
+#ifdef NT_ENV
+#include "StdAfx.h"
+#endif
+//
+// Class:   AmEdgeMap
+//
+/*
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "AmEdgeMap.h"
+#include "AmOutBuffer.h"
+
+#define kFALSE false
+#define kTRUE true
+
+// Starting number of slots, a power of 2:
+//
+#define kInitialSlots 1024
+
+AmEdgeMap::AmEdgeMap( )
+:	fEdges    ( NULL ),
+	fNumEdges ( 0 ),
+	fMaxEdges ( 0 ),
+	fSlots    ( NULL ),
+	fMask     ( kInitialSlots - 1 )
+{
+	fSlots = (int *) calloc( kInitialSlots, sizeof( int ) );
+}
+
+AmEdgeMap::~AmEdgeMap( )
+{
+	free( fEdges );
+	free( fSlots );
+}
+
+unsigned AmEdgeMap::slotOf( int startIndex, int endIndex )
+//
+// Description:
+//      This function returns the first slot to look in for
+//      the edge between two vertices, in either direction.
+//
+{
+	unsigned lo = (unsigned) ( ( startIndex < endIndex ) ? startIndex : endIndex );
+	unsigned hi = (unsigned) ( ( startIndex < endIndex ) ? endIndex : startIndex );
+
+	unsigned h = lo * 0x9E3779B1u ^ ( hi + 0x7F4A7C15u + ( lo << 6 ) + ( lo >> 2 ) );
+	h ^= h >> 15;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	return h & fMask;
+}
+
+void AmEdgeMap::grow( )
+//
+// Description:
+//      This function doubles the number of slots and puts
+//      every edge back in.
+//
+{
+	unsigned numSlots = 2 * ( fMask + 1 );
+
+	free( fSlots );
+	fSlots = (int *) calloc( numSlots, sizeof( int ) );
+	fMask = numSlots - 1;
+
+	for( int id = 1; id <= fNumEdges; id++ )
+	{
+		Edge &edge = fEdges[id - 1];
+		unsigned slot = slotOf( edge.startIndex, edge.endIndex );
+
+		while( fSlots[slot] )
+			slot = ( slot + 1 ) & fMask;
+		fSlots[slot] = id;
+	}
+}
+
+int AmEdgeMap::addEdge( int startIndex,
+						int endIndex,
+						double *startNormal,
+						double *endNormal )
+//
+// Description:
+//      This function adds an edge that findEdge() did not
+//      find and returns its edge id.
+//
+// Arguments:
+//      startIndex  - index of the start vertex
+//      endIndex    - index of the end vertex
+//
+{
+	if( fNumEdges == fMaxEdges )
+	{
+		fMaxEdges = fMaxEdges ? 2 * fMaxEdges : 1024;
+		fEdges = (Edge *) realloc( fEdges, fMaxEdges * sizeof( Edge ) );
+	}
+
+	Edge &edge = fEdges[fNumEdges++];
+	edge.startIndex = startIndex;
+	edge.endIndex   = endIndex;
+	edge.hardEdge   = kFALSE;
+	for( int i = 0; i < 3; i++ )
+	{
+		edge.startNormal[i] = startNormal[i];
+		edge.endNormal[i]   = endNormal[i];
+	}
+
+	if( (unsigned) fNumEdges * 2 > fMask + 1 )
+		grow();
+	else
+	{
+		unsigned slot = slotOf( startIndex, endIndex );
+
+		while( fSlots[slot] )
+			slot = ( slot + 1 ) & fMask;
+		fSlots[slot] = fNumEdges;
+	}
+
+	return fNumEdges;
+}
+
+int AmEdgeMap::findEdge( int startIndex,
+						 int endIndex,
+						 double *startNormal,
+						 double *endNormal,
+						 int &signEdge,
+						 bool &hardEdge )
+//
+// Description:
+//      This function finds the edge starting/ending
+//      with vertex of startIndex and ending/starting
+//      with vertex of endIndex. If the edge is found,
+//      the edgeId is returned, otherwise -1 is returned.
+//
+//      When normals are given, hardEdge tells whether they
+//      differ from the normals the edge was added with.
+//
+// Arguments:
+//		startIndex   - index of the start vertex
+//      endIndex     - index of the end vertex
+//      signEdge     - indicating the direction of the edge
+//
+{
+	unsigned slot = slotOf( startIndex, endIndex );
+
+	for( ; fSlots[slot]; slot = ( slot + 1 ) & fMask )
+	{
+		int id = fSlots[slot];
+		Edge &edge = fEdges[id - 1];
+		double *wStartNormal;
+		double *wEndNormal;
+
+		if( (startIndex == edge.startIndex) &&
+			(endIndex == edge.endIndex) )
+		{
+			signEdge = 1;
+			wStartNormal = edge.startNormal;
+			wEndNormal = edge.endNormal;
+		}
+		else if( (startIndex == edge.endIndex) &&
+				 (endIndex == edge.startIndex) )
+		{
+			signEdge = -1;
+			wStartNormal = edge.endNormal;
+			wEndNormal = edge.startNormal;
+		}
+		else
+			continue;
+
+		hardEdge = kFALSE;
+		if( ( NULL != startNormal ) &&
+			( NULL != endNormal ) )
+		{
+			for( int i = 0; i < 3; i++ )
+			{
+				if( startNormal[i] != wStartNormal[i] ||
+					endNormal[i] != wEndNormal[i] )
+				{
+					hardEdge = kTRUE;
+					break;
+				}
+			}
+		}
+		return id;
+	}
+
+	return -1;
+}
+
+void AmEdgeMap::hardenEdge( int edgeId )
+{
+	if( edgeId >= 1 && edgeId <= fNumEdges )
+		fEdges[edgeId - 1].hardEdge = kTRUE;
+}
+
+int AmEdgeMap::numEdges( )
+{
+	return fNumEdges;
+}
+
+void AmEdgeMap::printEdges( AmOutBuffer &out )
+//
+// Description:
+//      This function prints the edges in edge id order,
+//      with 0 based vertex indices and a 0 smoothing flag
+//      for hard edges.
+//
+{
+	for( int i = 0; i < fNumEdges; i++ )
+	{
+		Edge &edge = fEdges[i];
+
+		out.add( "\t\t" );
+		out.addInt( edge.startIndex - 1 );
+		out.add( '\t' );
+		out.addInt( edge.endIndex - 1 );
+		out.add( edge.hardEdge ? "\t0\n" : "\t1\n" );
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef _AmEdgeMap
+#define _AmEdgeMap
+//
+// Class:    AmEdgeMap
+//
+// Description:
+//              The object of this class holds the edges of one
+//              polygon mesh, keyed on the pair of vertex indices
+//              they join.  Edges are kept in the order they are
+//              added, so an edge id is its position in that order
+//              (starting at 1), and an open addressed hash table of
+//              edge ids finds an edge from its vertices.
+//
+//              AmEdgeMap:
+//                          ---------------     ---------------
+//                          | fSlots      | --> | fEdges      |
+//                          ---------------     ---------------
+//                          | 0 | 3 | 0 | |     | 1 | 2 | 3 | |
+//                          ---------------     ---------------
+//
+//              The table is doubled whenever it is half full, so
+//              lookups stay short however many edges there are.
+//
+/*
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+*/
+
+class AmOutBuffer;
+
+class AmEdgeMap {
+
+public:
+
+	AmEdgeMap       ( );
+	~AmEdgeMap      ( );
+
+	int addEdge     ( int startIndex, int endIndex,
+					  double *startNormal, double *endNormal );
+
+	int findEdge	( int startIndex, int endIndex,
+					  double *startNormal, double *endNormal,
+					  int &signEdge, bool &hardEdge );
+
+	void hardenEdge ( int edgeId );
+	int numEdges    ( );
+	void printEdges ( AmOutBuffer &out );
+
+private:
+
+	struct Edge {
+		int		startIndex;	// index of the start vertex
+		int		endIndex;	// index of the end vertex
+		double	startNormal[3];
+		double	endNormal[3];
+		bool	hardEdge;
+	};
+
+	unsigned slotOf ( int startIndex, int endIndex );
+	void grow       ( );
+
+	Edge     *fEdges;      // the edges, in the order they were added
+	int      fNumEdges;    // number of edges
+	int      fMaxEdges;    // allocated length of fEdges
+	int      *fSlots;      // edge ids, 0 for an empty slot
+	unsigned fMask;        // number of slots - 1, a power of 2 less 1
+};
+
+#endif /* _AmEdgeMap */
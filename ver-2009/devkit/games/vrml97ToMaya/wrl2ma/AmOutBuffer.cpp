@@ -0,0 +1,169 @@
+#ifdef NT_ENV
+#include "StdAfx.h"
+#endif
+//
+// Class:   AmOutBuffer
+//
+/*
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "AmOutBuffer.h"
+
+#ifdef WIN32
+#define vsnprintf _vsnprintf
+#endif
+
+
+AmOutBuffer::AmOutBuffer( FILE *file, int size )
+:	fFile   ( file ),
+	fText   ( NULL ),
+	fLength ( 0 ),
+	fSize   ( size > 64 ? size : 64 )
+{
+	fText = (char *) malloc( fSize );
+}
+
+AmOutBuffer::~AmOutBuffer( )
+//
+// Description:
+//      This function writes out anything left for the file
+//      and frees the text.
+//
+{
+	flush();
+	free( fText );
+}
+
+void AmOutBuffer::reserve( int count )
+//
+// Description:
+//      This function makes room for count more characters,
+//      writing the text out first if there is a file.
+//
+// Arguments:
+//      count        - number of characters about to be added
+//
+{
+	if( fLength + count <= fSize )
+		return;
+
+	flush();
+	if( fLength + count <= fSize )
+		return;
+
+	while( fLength + count > fSize )
+		fSize *= 2;
+	fText = (char *) realloc( fText, fSize );
+}
+
+void AmOutBuffer::add( const char *text )
+{
+	int count = (int) strlen( text );
+
+	reserve( count );
+	memcpy( fText + fLength, text, count );
+	fLength += count;
+}
+
+void AmOutBuffer::add( char c )
+{
+	reserve( 1 );
+	fText[fLength++] = c;
+}
+
+void AmOutBuffer::addInt( int value )
+//
+// Description:
+//      This function adds value as "%d" would print it.
+//
+{
+	char digits[16];
+	int n = 0;
+	unsigned int u = ( value < 0 ) ? 0u - (unsigned int) value
+								   : (unsigned int) value;
+
+	do {
+		digits[n++] = (char) ( '0' + u % 10 );
+		u /= 10;
+	} while( u );
+
+	reserve( n + 1 );
+	if( value < 0 )
+		fText[fLength++] = '-';
+	while( n > 0 )
+		fText[fLength++] = digits[--n];
+}
+
+void AmOutBuffer::format( const char *format, ... )
+//
+// Description:
+//      This function adds text as fprintf would print it.
+//
+{
+	va_list args;
+	int     n;
+
+	reserve( 256 );
+	for( ;; )
+	{
+		int room = fSize - fLength;
+
+		va_start( args, format );
+		n = vsnprintf( fText + fLength, room, format, args );
+		va_end( args );
+
+		// Older C libraries return -1 rather than the length
+		// when the text does not fit.
+		//
+		if( n >= 0 && n < room )
+			break;
+		reserve( n >= 0 ? n + 1 : 2 * fSize );
+	}
+	fLength += n;
+}
+
+void AmOutBuffer::flush( )
+//
+// Description:
+//      This function writes the text to the file, if there
+//      is one, and empties the buffer.
+//
+{
+	if( fFile )
+	{
+		writeTo( fFile );
+		fLength = 0;
+	}
+}
+
+void AmOutBuffer::writeTo( FILE *file )
+//
+// Description:
+//      This function writes the text to file, keeping it
+//      in the buffer.
+//
+{
+	if( fLength > 0 )
+		fwrite( fText, 1, fLength, file );
+}
+
+int AmOutBuffer::length( )
+{
+	return fLength;
+}
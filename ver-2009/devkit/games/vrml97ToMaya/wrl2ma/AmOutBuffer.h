@@ -0,0 +1,58 @@
+#ifndef _AmOutBuffer
+#define _AmOutBuffer
+//
+// Class:    AmOutBuffer
+//
+// Description:
+//              The object of this class collects text for the
+//              output file in one large block of memory.  Integers
+//              are formatted by hand, since the edge and face lists
+//              of a big mesh are nothing but integers; everything
+//              else goes through vsnprintf.
+//
+//              If a file is given, the text is written to it each
+//              time the block fills up, and by flush().  Without a
+//              file the block grows to hold everything written.
+//
+/*
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+*/
+
+#include <stdio.h>
+
+class AmOutBuffer {
+
+public:
+
+	AmOutBuffer     ( FILE *file = NULL, int size = 1 << 20 );
+	~AmOutBuffer    ( );
+
+	void add        ( const char *text );
+	void add        ( char c );
+	void addInt     ( int value );
+	void format     ( const char *format, ... );
+
+	void flush      ( );
+	void writeTo    ( FILE *file );
+	int length      ( );
+
+private:
+
+	void reserve    ( int count );
+
+	FILE     *fFile;       // where full blocks go, or NULL
+	char     *fText;       // the text not yet written
+	int      fLength;      // length of the text
+	int      fSize;        // allocated length of fText
+};
+
+#endif /* _AmOutBuffer */
@@ -43,6 +43,7 @@ const char usage_body[] =
 "            -d           \tdump out new WRL file as parsed\n"
 "            -e           \tuse Hard Edges on polygons\n" \
 "            -i inputFile \tinput file to convert\n" \
+"            -j threads   \tthreads to convert meshes on\n" \
 "            -m           \tassume input file was output by Maya\n" \
 "            -n           \tuse defined material names\n" \
 "            -o outputFile\toutput file to save to\n" \
@@ -51,7 +52,7 @@ const char usage_body[] =
 "  Default settings are: Maya7.0 format primitives, \n" \
 "  do Not dump a WRL file as input is read, Use hard edges on polygons,\n" \
 "  input is Not from Maya, will generate unique Material names,\n" \
-"  No verbose output.\n\n" \
+"  One thread per processor, No verbose output.\n\n" \
 "  Extensions are needed on the file names.\n"
 ;
 
@@ -104,6 +105,14 @@ const char usage_body[] =
 
 #include <string.h>
 
+#include <vector>
+#include <map>
+
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 #ifdef _WIN32
 #include <io.h>
 #elif defined(OSMac_)
@@ -115,8 +124,8 @@ const char usage_body[] =
 #include <getopt.h>
 #endif //_WIN32
 
-#include "AmEdge.h"
-#include "AmEdgeList.h"
+#include "AmEdgeMap.h"
+#include "AmOutBuffer.h"
 
 #ifdef DEBUG_ROTATIONS
 #include "maya/mocapserver.h"
@@ -125,11 +134,6 @@ const char usage_body[] =
 #define kFALSE false
 #define kTRUE  true
 
-
-// Column size of the hash table for polygon edges:
-//
-#define kHashSize 500
-
 VrmlScene* g_pTheScene;
 
 VrmlNode* root_node;
@@ -264,77 +268,8 @@ if ( verbose )				\
 	cerr << indentSpace() << (MSG) << endl
 
 
-int hashFindEdge( AmEdgeList *hashTable,
-				  int        startIndex,
-				  int        endIndex,
-				  double     *startNormal,
-				  double	 *endNormal,
-				  int        &signEdge,
-				  bool       &hardEdge )
-//
-// Description:
-// 	    This function tries to find the edge with a certain
-//      start vertex index and a centain end vertex index.
-//      The edgeId is returned.
-//
-// Arguments:
-//      hashTable   - edge hash table as describe in function
-//                    "printPolyset"
-//      startIndex  - index of the start vertex
-//      endIndex    - index of the end vertex
-//      signEdge    - indicating whether the edge found has
-//                    the same direction of the give edge
-//
-// Notes:
-//      Two edges are considered the same even if their signs
-//      are opposite.
-//
-{
-	int max = ( ( startIndex < endIndex ) ?
-				endIndex : startIndex ) % kHashSize;
-
-	int edgeId = hashTable[max].findEdge( startIndex,
-										  endIndex,
-										  startNormal,
-										  endNormal,
-										  signEdge,
-										  hardEdge );
-	return edgeId;
-}
-
-void hashAddEdge( AmEdgeList *hashTable,
-				  int        startIndex,
-				  int        endIndex,
-				  double     *startNormal,
-				  double     *endNormal,
-				  int        edgeId )
-//
-// Description:
-//      This function adds a new edge to the edge hash table
-//      by recording its start vertex index, end vertex index,
-//      and the edge Id.
-//
-// Arguments:
-//      hashTable   - edge hash table as described in function
-//                    "printPolyset"
-//		startIndex  - index of the start vertex
-//      endIndex    - index of the end vertex
-//      edgeId      - identification of the edge, the order
-//                    in which it is processed
-//
-{
-	int max = ( ( startIndex < endIndex ) ?
-				endIndex : startIndex ) % kHashSize;
-
-	hashTable[max].addEdge( edgeId, startIndex, endIndex,
-							startNormal, endNormal );
-}
-
-
 void printEdges( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
-				 AmEdgeList *hashTable,
-				 int        &edgeId,
-				 AmEdgeList *edgePrintList )
+				 AmEdgeMap  &edgeMap )
 //
 // Description:
 //      This function goes through the vertices and
@@ -349,28 +284,30 @@ void printEdges( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 //      ifsNode       - a polygon in the polyset
 //		polyIdx		  - current polygon id
 //		Idx			  - current Index of vertices/pointers
-//      hashTable     - the edge table
-//      edgeId        - the identification of a particular edge
-//      edgePrintList - a list of edges to be printed out in
-//                      the order of processing
+//      edgeMap       - the edge table, which numbers the
+//                      edges in the order they are added
 //
 {
 	//if( !polygon )
 	//	return;
 
-	VrmlMFInt polygon = ifsNode->getCoordIndex();
+	// The fields are used through references, not copies, since
+	// copying a field changes its reference count and the shapes
+	// are converted on several threads.
+
+	const VrmlMFInt &polygon = ifsNode->getCoordIndex();
 
 	VrmlNode *normals = ifsNode->getNormal();
-	VrmlMFVec3f nrmValues;
+	VrmlMFVec3f *nrmValues = NULL;
 
 	int nNorm = 0;
 	if ( normals )
     {
-		nrmValues = normals->toNormal()->normal();
-		nNorm = nrmValues.size();
+		nrmValues = &normals->toNormal()->normal();
+		nNorm = nrmValues->size();
 	}
 
-	VrmlMFInt nrmIndices = ifsNode->getNormalIndex();
+	const VrmlMFInt &nrmIndices = ifsNode->getNormalIndex();
 	int nNormIdx = nrmIndices.size();
 
 	int startVertex = 0;
@@ -393,7 +330,9 @@ void printEdges( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 	int startIndex  = 0;
 	int endIndex    = 0;
 
-	double startNormal[3];
+	// Without normals both ends stay at zero, so the hard edge test
+	// compares like with like; startNormal used to be left unset here.
+	double startNormal[3] = { 0.0, 0.0, 0.0 };
 	double endNormal[3];
 	double nx = 0.0;
 	double ny = 0.0;
@@ -442,9 +381,9 @@ void printEdges( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 				useIdx = 0;
 			}
 
-			startNormal[0] = nrmValues[useIdx][0];
-			startNormal[1] = nrmValues[useIdx][1];
-			startNormal[2] = nrmValues[useIdx][2];
+			startNormal[0] = (*nrmValues)[useIdx][0];
+			startNormal[1] = (*nrmValues)[useIdx][1];
+			startNormal[2] = (*nrmValues)[useIdx][2];
 
 		}
 
@@ -489,9 +428,9 @@ void printEdges( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 
 				if ( nNorm )
 				{
-					nx = nrmValues[useIdx][0];
-					ny = nrmValues[useIdx][1];
-					nz = nrmValues[useIdx][2];
+					nx = (*nrmValues)[useIdx][0];
+					ny = (*nrmValues)[useIdx][1];
+					nz = (*nrmValues)[useIdx][2];
 				}
 
 			} else {
@@ -515,30 +454,23 @@ void printEdges( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 
 		int signEdge = 0;
 		bool hardEdge = !nrmPerVertex;
-		int idFound = hashFindEdge( hashTable, startIndex, endIndex,
-									startNormal, endNormal, signEdge, hardEdge );
+		int idFound = edgeMap.findEdge( startIndex, endIndex,
+										startNormal, endNormal, signEdge, hardEdge );
 		if( -1 == idFound )
 		{
-//			printf( "add edge: start/end %d/%d, ID = %d\n",
-//						startIndex, endIndex, edgeId );
-
-			hashAddEdge( hashTable, startIndex, endIndex,
-						 startNormal, endNormal, edgeId );
+			edgeMap.addEdge( startIndex, endIndex, startNormal, endNormal );
 			signEdge = 1;
-
-			edgePrintList->addEdge( edgeId, startIndex, endIndex,
-									startNormal, endNormal );
-			edgeId++;
 		}
 		else if( (hardEdge == true) && use_HardEdges )
-			edgePrintList->hardenEdge( idFound );
+			edgeMap.hardenEdge( idFound );
 
 	}
 }
 
 void printFacets( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
-				  AmEdgeList *hashTable,
-				  int        &vtCount )
+				  AmEdgeMap   &edgeMap,
+				  int         &vtCount,
+				  AmOutBuffer &out )
 //
 // Description:
 //      This function prints out the facet information
@@ -546,16 +478,17 @@ void printFacets( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 //
 // Arguments:
 //      polygon   - a polygon in the polyset
-//      hashTable - the edge hash table
+//      edgeMap   - the edge hash table
 //      vtCount   - the index to the vetex texture list
+//      out       - where the facet is printed
 //
 {
 //	if( NULL == polygon )
 //		return;
 
-	VrmlMFInt polygon = ifsNode->getCoordIndex();
-	VrmlMFInt texIndices = ifsNode->getTexCoordIndex();
-	VrmlMFInt clrIndices = ifsNode->getColorIndex();
+	const VrmlMFInt &polygon = ifsNode->getCoordIndex();
+	const VrmlMFInt &texIndices = ifsNode->getTexCoordIndex();
+	const VrmlMFInt &clrIndices = ifsNode->getColorIndex();
 	VrmlNodeColor *colors = ifsNode->color();
 
 	int		nClrIndices = clrIndices.size();
@@ -587,7 +520,8 @@ void printFacets( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 	int j           = 0;
 
 
-	fprintf( fp, "\t\tf\t%d", numVertices );
+	out.add( "\t\tf\t" );
+	out.addInt( numVertices );
 
 	int *colorIndex = new int [numVertices];
 	//bool hasColor = clrPerVertex;
@@ -641,8 +575,8 @@ void printFacets( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 
 		int signEdge = 0;
 		bool hardEdge = kTRUE;
-		int idFound = hashFindEdge( hashTable, startIndex,
-									endIndex, NULL, NULL, signEdge, hardEdge );
+		int idFound = edgeMap.findEdge( startIndex, endIndex,
+										NULL, NULL, signEdge, hardEdge );
 		if( -1 == idFound )
 		{
 			cerr << "Error: edge of face not found!\n";
@@ -654,11 +588,13 @@ void printFacets( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 			//
 			if( 1 == signEdge )
 			{
-				fprintf( fp, " %d", (idFound-1)*signEdge );
+				out.add( ' ' );
+				out.addInt( (idFound-1)*signEdge );
 			}
 			else if( -1 == signEdge )
 			{
-				fprintf( fp, " %d", (idFound-1+1)*signEdge );
+				out.add( ' ' );
+				out.addInt( (idFound-1+1)*signEdge );
 			}
 		}
 
@@ -669,11 +605,13 @@ void printFacets( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 	//
 	if ( texIndices.size() > 0 )
 		{
-		fprintf( fp, "\tmf\t%d", numVertices );
+		out.add( "\tmf\t" );
+		out.addInt( numVertices );
 		//for( i = 0; i < numVertices; i++ )
 		for( i = Idx; i < Idx+numVertices; i++ )
 			{
-			fprintf( fp, " %d", texIndices[i] );
+			out.add( ' ' );
+			out.addInt( texIndices[i] );
 			vtCount++;
 			}
 	
@@ -688,20 +626,24 @@ void printFacets( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 			// are no texIndices
 			if ( polygon.size() > 0 )
 				{
-				fprintf( fp, "\tmf\t%d", numVertices );
+				out.add( "\tmf\t" );
+				out.addInt( numVertices );
 	        	for( i = Idx; i < Idx+numVertices; i++ )
 		        	{
-					fprintf( fp, " %d", polygon[i]);
+					out.add( ' ' );
+					out.addInt( polygon[i] );
 					vtCount++;
 					}
 				}
 			else
 				{
 				// as a fall back will output index values
-				fprintf( fp, "\tmf\t%d", numVertices );
+				out.add( "\tmf\t" );
+				out.addInt( numVertices );
 	    	    for( i = Idx; i < Idx+numVertices; i++ )
 		    	    {
-	    	        fprintf( fp, " %d", i);
+	    	        out.add( ' ' );
+	    	        out.addInt( i );
 					vtCount++;
 					}
 				}
@@ -718,13 +660,15 @@ void printFacets( VrmlNodeIFaceSet *ifsNode, int polyIdx, int Idx,
 	// Also need to check that we have colours to output
 
 	if( colors && (clrPerVertex || force_CPV) ) {
-	    fprintf( fp, "\tfc\t%d", numVertices );
+	    out.add( "\tfc\t" );
+	    out.addInt( numVertices );
 	    for( i = 0; i < numVertices; i++ )
 		{
-		    fprintf( fp, " %d", colorIndex[i] );
+		    out.add( ' ' );
+		    out.addInt( colorIndex[i] );
 		}
 	}
-	fprintf( fp, "\n" );
+	out.add( '\n' );
 
 	if( NULL != colorIndex ) {
 	    delete [] colorIndex;
@@ -780,7 +724,7 @@ int uniqueID()
 	return id;
 }
 
-int	findNumFaces( VrmlMFInt &cindex )
+int	findNumFaces( const VrmlMFInt &cindex )
 {
 	int nfaces = 0;
 
@@ -1579,26 +1523,30 @@ void outputGroup( VrmlNode *node, char *name, char *parent, char *fullParent )
 
 }
 
-void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
+int outputShapeGeo( VrmlNodeIFaceSet *ifsNode, AmOutBuffer &out )
+//
+// Description:
+//      This function prints the vertices, colors, uvs, edges
+//      and faces of an Indexed Face Set into out, and returns
+//      the number of faces.  It only reads the scene and the
+//      option globals, so several shapes can be converted at
+//      once; see convertShapes().
+//
 {
 	int		nverts;
 
-	// VrmlNodeIFaceSet *ifsNode = node->toIFaceSet();
-
 	VrmlNode *coords = ifsNode->getCoordinate();
 
-	verboseNameNL( ifsNode, "Index Face Set" );
-
 	if ( coords )
     {
 		VrmlMFVec3f &coord = coords->toCoordinate()->coordinate();
 		nverts = coord.size();
 
-		fprintf( fp, "\tsetAttr -s %d \".vt[0:%d]\"", nverts, nverts - 1 );
+		out.format( "\tsetAttr -s %d \".vt[0:%d]\"", nverts, nverts - 1 );
 		for ( int i=0; i < nverts; i++ )
-			fprintf( fp, "\n\t\t%f %f %f",
+			out.format( "\n\t\t%f %f %f",
 					coord[i][0], coord[i][1], coord[i][2] );
-		fprintf( fp, ";\n" );
+		out.add( ";\n" );
 	}
 
 	// Output Vertex colors
@@ -1606,18 +1554,18 @@ void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
 	VrmlNodeColor *colors = ifsNode->color();
 	if ( colors )
 	{
-		VrmlMFColor Vtx_Colors = colors->color();
+		VrmlMFColor &Vtx_Colors = colors->color();
 		nverts = Vtx_Colors.size();
 
 		if ( nverts > 0 )
 		{
-			fprintf( fp, "\tsetAttr -s %d \".clr[0:%d]\"", nverts, nverts - 1 );
+			out.format( "\tsetAttr -s %d \".clr[0:%d]\"", nverts, nverts - 1 );
 			for ( int i=0; i < nverts; i++ )
 			{
-				fprintf( fp, "\n\t\t%f %f %f 1",
+				out.format( "\n\t\t%f %f %f 1",
 						Vtx_Colors[i][0], Vtx_Colors[i][1], Vtx_Colors[i][2] );
 			}
-			fprintf( fp, ";\n" );
+			out.add( ";\n" );
 		}
 	}
 
@@ -1629,11 +1577,11 @@ void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
 		VrmlMFVec2f &coord = texCoords->toTextureCoordinate()->coordinate();
 		nverts = coord.size();
 
-		fprintf( fp, "\tsetAttr -s %d \".uv[0:%d]\"", nverts, nverts - 1 );
+		out.format( "\tsetAttr -s %d \".uv[0:%d]\"", nverts, nverts - 1 );
 		for ( int i=0; i < nverts; i++ )
-			fprintf( fp, "\n\t\t%f %f",
+			out.format( "\n\t\t%f %f",
 					coord[i][0], coord[i][1] );
-		fprintf( fp, ";\n" );
+		out.add( ";\n" );
 	}
 
 
@@ -1642,23 +1590,21 @@ void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
 
 	int numPolygons = 0;
 
-	VrmlMFInt cindex = ifsNode->getCoordIndex();
+	const VrmlMFInt &cindex = ifsNode->getCoordIndex();
 
-	AmEdgeList *hashTable = new AmEdgeList [kHashSize];
-	AmEdgeList *edgePrintList = new AmEdgeList;
+	AmEdgeMap edgeMap;
 
 	if ( cindex.size() )
     {
 		numPolygons = findNumFaces( cindex );
 
 		int	curIdx = 0;
-		int edgeId = 1;
 
 //		printf( "numPolygons = %d\n", numPolygons );
 
 		for( int i = 0; i < numPolygons; i++ )
 		{
-			printEdges( ifsNode, i, curIdx, hashTable, edgeId, edgePrintList );
+			printEdges( ifsNode, i, curIdx, edgeMap );
 
 			for ( ; curIdx < cindex.size(); curIdx++ )
 			{
@@ -1670,14 +1616,13 @@ void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
 			}
 		}
 
-		fprintf( fp, "\tsetAttr -s %d \".ed[0:%d]\" -type \"long3\"\n",
-					(edgeId - 1), (edgeId-2) );
+		int numEdges = edgeMap.numEdges();
+		out.format( "\tsetAttr -s %d \".ed[0:%d]\" -type \"long3\"\n",
+					numEdges, (numEdges-1) );
 
-		edgePrintList->printEdges();
-		delete edgePrintList;
-		edgePrintList = NULL;
+		edgeMap.printEdges( out );
 
-		fprintf( fp, "\t\t;\n" );
+		out.add( "\t\t;\n" );
 
 	}
 
@@ -1690,7 +1635,7 @@ void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
 	int vtCount = 1;
 	if ( numPolygons > 0 )
 	{
-		fprintf( fp, "\tsetAttr -s %d \".fc[0:%d]\" -type \"polyFaces\"\n",
+		out.format( "\tsetAttr -s %d \".fc[0:%d]\" -type \"polyFaces\"\n",
 			   numPolygons, numPolygons-1 );
 	}
 	
@@ -1700,7 +1645,7 @@ void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
 
 	for( int i = 0; i < numPolygons; i++ )
 	{
-		printFacets( ifsNode, i, curIdx, hashTable, vtCount );
+		printFacets( ifsNode, i, curIdx, edgeMap, vtCount, out );
 		for ( ; curIdx < cindex.size(); curIdx++ )
 		{
 			if ( cindex[curIdx] == -1 )
@@ -1711,8 +1656,9 @@ void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
 		}
 	}
 
-	fprintf( fp, "\t\t;\n" );
+	out.add( "\t\t;\n" );
 
+	return numPolygons;
 
 #if 0
 	// Output Render Info for this shape
@@ -1733,16 +1679,300 @@ void outputShapeGeo( VrmlNodeIFaceSet *ifsNode )
 	else
 		printFile( "%s%s \".smo\" no;\n", indentSpace(), kSetAttrCommand );
 #endif
+}
 
-	//
-	// Now assign the current Material to the current Mesh
-	//
 
+//
+//	Converting the Indexed Face Sets.
+//
+//	When more than one thread is used, walking the scene writes
+//	everything but the mesh geometry to a temporary file, and
+//	addShapeGeo() notes where each mesh's geometry belongs.
+//	convertShapes() then converts the meshes on several threads,
+//	a batch at a time, and splices them into the output file in
+//	scene order, so the file is the same whatever the number of
+//	threads.  An Indexed Face Set USEd by several shapes is only
+//	converted once.
+//
+
+// Meshes to convert together, per thread:
+//
+#define kShapesPerThread 4
+
+int		numThreads = 0;		// 0 for one per processor
+bool	deferShapes = false;
+
+struct shapeGeo {
+	VrmlNodeIFaceSet	*ifsNode;
+	AmOutBuffer			*text;			// NULL when not converted
+	int					numPolygons;
+	int					lastItem;		// the last shapeItem using it
+};
+
+struct shapeItem {
+	long		offset;			// where it goes in the scene text
+	int			geo;			// index in shapeGeos
+	char		*shadingGrp;
+	char		*fullName;
+};
+
+static vector<shapeGeo>					shapeGeos;
+static vector<shapeItem>				shapeItems;
+static map<VrmlNodeIFaceSet *, int>		shapeGeoIndex;
+
+void outputShapeSets( FILE *out, int numPolygons,
+					  const char *group, const char *fullName )
+//
+// Description:
+//      Assign the shading group to the mesh.
+//
+{
 	if ( numPolygons > 0 )
 	{
-		fprintf( fp, "sets -e -forceElement %s %s;\n",
-				shadingGrp, current_fullName ); // use globals
+		fprintf( out, "sets -e -forceElement %s %s;\n",
+				group, fullName );
+	}
+}
+
+void addShapeGeo( VrmlNodeIFaceSet *ifsNode )
+{
+	verboseNameNL( ifsNode, "Index Face Set" );
+
+	if ( !deferShapes )
+	{
+		AmOutBuffer text( fp );
+		int numPolygons = outputShapeGeo( ifsNode, text );
+
+		text.flush();
+		outputShapeSets( fp, numPolygons,
+						 shadingGrp, current_fullName ); // use globals
+		return;
+	}
+
+	int geo;
+	map<VrmlNodeIFaceSet *, int>::iterator found = shapeGeoIndex.find( ifsNode );
+
+	if ( found != shapeGeoIndex.end() )
+		geo = found->second;
+	else
+	{
+		shapeGeo newGeo;
+		newGeo.ifsNode = ifsNode;
+		newGeo.text = NULL;
+		newGeo.numPolygons = 0;
+
+		geo = (int) shapeGeos.size();
+		shapeGeos.push_back( newGeo );
+		shapeGeoIndex[ifsNode] = geo;
 	}
+
+	shapeItem item;
+	item.offset = ftell( fp );
+	item.geo = geo;
+	item.shadingGrp = strdup( shadingGrp );		// use globals
+	item.fullName = strdup( current_fullName );
+
+	shapeGeos[geo].lastItem = (int) shapeItems.size();
+	shapeItems.push_back( item );
+}
+
+int numProcessors()
+{
+#ifdef WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (int) info.dwNumberOfProcessors;
+#else
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	return ( n > 0 ) ? (int) n : 1;
+#endif
+}
+
+// The meshes of one batch, shared by the threads converting them.
+//
+struct convertTask {
+	int		*todo;			// shapeGeos indices
+	int		numTodo;
+	int		next;			// the next one to take
+#ifdef WIN32
+	CRITICAL_SECTION	lock;
+#else
+	pthread_mutex_t		lock;
+#endif
+};
+
+static int takeShapeGeo( convertTask *task )
+{
+	int geo = -1;
+
+#ifdef WIN32
+	EnterCriticalSection( &task->lock );
+#else
+	pthread_mutex_lock( &task->lock );
+#endif
+	if ( task->next < task->numTodo )
+		geo = task->todo[task->next++];
+#ifdef WIN32
+	LeaveCriticalSection( &task->lock );
+#else
+	pthread_mutex_unlock( &task->lock );
+#endif
+
+	return geo;
+}
+
+#ifdef WIN32
+static DWORD WINAPI
+convertThread( LPVOID data )
+#else
+static void *
+convertThread( void *data )
+#endif
+{
+	convertTask *task = (convertTask *) data;
+	int geo;
+
+	while ( ( geo = takeShapeGeo( task ) ) >= 0 )
+	{
+		shapeGeo &g = shapeGeos[geo];
+		g.numPolygons = outputShapeGeo( g.ifsNode, *g.text );
+	}
+	return 0;
+}
+
+static void copySceneText( FILE *scene, FILE *out, long count )
+//
+// Description:
+//      Copy count bytes of the scene text, or all that is
+//      left if count is negative.
+//
+{
+	char	buffer[65536];
+
+	while ( count != 0 )
+	{
+		size_t want = sizeof( buffer );
+		if ( count > 0 && (size_t) count < want )
+			want = (size_t) count;
+
+		size_t got = fread( buffer, 1, want, scene );
+		if ( got == 0 )
+			break;
+		fwrite( buffer, 1, got, out );
+		if ( count > 0 )
+			count -= (long) got;
+	}
+}
+
+void convertShapes( FILE *scene, FILE *out, int threads )
+//
+// Description:
+//      Convert the meshes noted by addShapeGeo(), and write
+//      them with the scene text to out.
+//
+// Arguments:
+//      scene     - the scene text, with the meshes left out
+//      out       - the output file
+//      threads   - the most threads to use
+//
+{
+	int		numItems = (int) shapeItems.size();
+	int		batch = kShapesPerThread * threads;
+	long	copied = 0;
+	int		first, i, t;
+
+	convertTask task;
+	task.todo = new int [batch];
+#ifdef WIN32
+	InitializeCriticalSection( &task.lock );
+	HANDLE *thread = new HANDLE [threads];
+#else
+	pthread_mutex_init( &task.lock, NULL );
+	pthread_t *thread = new pthread_t [threads];
+#endif
+
+	rewind( scene );
+
+	for ( first = 0; first < numItems; first += batch )
+	{
+		int last = first + batch;
+		if ( last > numItems )
+			last = numItems;
+
+		// The meshes this batch needs that are not converted yet
+
+		task.numTodo = 0;
+		task.next = 0;
+		for ( i = first; i < last; i++ )
+		{
+			shapeGeo &g = shapeGeos[shapeItems[i].geo];
+			if ( NULL == g.text )
+			{
+				g.text = new AmOutBuffer( NULL, 1 << 16 );
+				task.todo[task.numTodo++] = shapeItems[i].geo;
+			}
+		}
+
+		int started = 1;
+		int useThreads = ( threads < task.numTodo ) ? threads : task.numTodo;
+		for ( ; started < useThreads; started++ )
+		{
+#ifdef WIN32
+			thread[started] = CreateThread( NULL, 0, convertThread, &task, 0, NULL );
+			if ( thread[started] == NULL )
+				break;
+#else
+			if ( pthread_create( &thread[started], NULL, convertThread, &task ) != 0 )
+				break;
+#endif
+		}
+		convertThread( &task );
+		for ( t = 1; t < started; t++ )
+		{
+#ifdef WIN32
+			WaitForSingleObject( thread[t], INFINITE );
+			CloseHandle( thread[t] );
+#else
+			pthread_join( thread[t], NULL );
+#endif
+		}
+
+		// Splice them in, in order
+
+		for ( i = first; i < last; i++ )
+		{
+			shapeItem &item = shapeItems[i];
+			shapeGeo &g = shapeGeos[item.geo];
+
+			copySceneText( scene, out, item.offset - copied );
+			copied = item.offset;
+
+			g.text->writeTo( out );
+			outputShapeSets( out, g.numPolygons, item.shadingGrp, item.fullName );
+
+			free( item.shadingGrp );
+			free( item.fullName );
+			if ( g.lastItem == i )
+			{
+				delete g.text;
+				g.text = NULL;
+			}
+		}
+	}
+
+	copySceneText( scene, out, -1 );
+
+#ifdef WIN32
+	DeleteCriticalSection( &task.lock );
+#else
+	pthread_mutex_destroy( &task.lock );
+#endif
+	delete [] thread;
+	delete [] task.todo;
+
+	shapeItems.clear();
+	shapeGeos.clear();
+	shapeGeoIndex.clear();
 }
 
 
@@ -2109,7 +2339,7 @@ void checkShape( VrmlNode *node,
 
 		// VrmlNodeIFaceSet *IFaceSet = geo->toIFaceSet();
 		if ( geo->toIFaceSet() )
-			outputShapeGeo( geo->toIFaceSet() );
+			addShapeGeo( geo->toIFaceSet() );
 		else if ( geo->toSphere() )
 			outputPrimSphere( geo->toSphere() );
 		else if ( geo->toBox() )
@@ -2443,7 +2673,7 @@ main( int argc, char **argv)
 	// Parse the options
 	//
 	
-	while ((opt = getopt(argc, argv, "a:A:cCdDeEhHmMnNI:i:L:l:O:o:vVt:T:Ww")) != -1)
+	while ((opt = getopt(argc, argv, "a:A:cCdDeEhHmMnNI:i:J:j:L:l:O:o:vVt:T:Ww")) != -1)
 	{
 		switch (opt) {
 		case 'H':
@@ -2481,6 +2711,11 @@ main( int argc, char **argv)
 			inputFile = strdup( optarg );			
 			break;
 
+		case 'J' :
+		case 'j' :
+			numThreads = atoi( optarg );
+			break;
+
 		case 'O' :
 		case 'o' :
 			outputFile = strdup( optarg );
@@ -2542,10 +2777,20 @@ main( int argc, char **argv)
 		if ( verbose )
 			cerr << "root" << root_node->name() << endl;
 
-		fp = fopen( outputFile, "wb" );
+		FILE *out = fopen( outputFile, "wb" );
 
-		if ( fp != NULL )
+		if ( out != NULL )
 		{
+			// With more than one thread the meshes are converted
+			// after the rest of the scene; see convertShapes().
+
+			int threads = ( numThreads > 0 ) ? numThreads : numProcessors();
+
+			fp = ( threads > 1 ) ? tmpfile() : NULL;
+			deferShapes = ( fp != NULL );
+			if ( !deferShapes )
+				fp = out;
+
 			outputHeader( outputFile );
 
 			node = root_node;
@@ -2564,7 +2809,14 @@ main( int argc, char **argv)
 
 			fprintf( fp, "connectAttr \"lightLinker1.msg\" \":lightList1.ln\" -na;\n" );
 
-			fclose( fp );
+			if ( deferShapes )
+			{
+				convertShapes( fp, out, threads );
+				fclose( fp );
+				fp = out;
+			}
+
+			fclose( out );
 
 		} else {
 
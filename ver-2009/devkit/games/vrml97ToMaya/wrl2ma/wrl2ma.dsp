@@ -122,19 +122,19 @@ PostBuild_Cmds=T:\bin\perl.exe -I T:\lib\perl     ..\..\OpenMaya\MakeNT\releaseD
 # Name "wrl2ma - Win32 ReleaseDebug"
 # Begin Source File
 
-SOURCE=.\AmEdge.cpp
+SOURCE=.\AmEdgeMap.cpp
 # End Source File
 # Begin Source File
 
-SOURCE=.\AmEdge.h
+SOURCE=.\AmEdgeMap.h
 # End Source File
 # Begin Source File
 
-SOURCE=.\AmEdgeList.cpp
+SOURCE=.\AmOutBuffer.cpp
 # End Source File
 # Begin Source File
 
-SOURCE=.\AmEdgeList.h
+SOURCE=.\AmOutBuffer.h
 # End Source File
 # Begin Source File
 
@@ -2,4 +2,5 @@ gcc-4.0.2 -c -O3 -fexpensive-optimizations -finline-functions -funroll-loops -fo
 gcc-4.0.2 -c -O3 -fexpensive-optimizations -finline-functions -funroll-loops -fomit-frame-pointer -frerun-cse-after-loop -fstrength-reduce -fforce-addr -Wall -fPIC -pthread -m64 -DQMC -DMI_MODULE= -DMI_PRODUCT_RAY -DLINUX -DLINUX_X86 -DX86 -DBIT64 -DMI_LITTLE_ENDIAN -D_GNU_SOURCE -D_REENTRANT -DSVR4 -Dinline=__inline__ -DSSE_INTRINSICS -DNV_CG -D__NO_CTYPE -DHYPERTHREAD -I/usr/X11R6/include -D__NO_CTYPE -DHYPERTHREAD -D_STLP_LITTLE_ENDIAN=1 -D_STLP_SHORT_STRING_SZ=32 -D_STLP_REAL_LOCALE_IMPLEMENTED -D_STLP_NATIVE_INCLUDE_PATH=../c++ -I/h/misrc/ray/3.7.1/src/base/system/stlport -I/h/misrc/ray/3.7.1/src/shaders/.. -I../.. -I.  ./outimgshade.c
 gcc-4.0.2 -c -O3 -fexpensive-optimizations -finline-functions -funroll-loops -fomit-frame-pointer -frerun-cse-after-loop -fstrength-reduce -fforce-addr -Wall -fPIC -pthread -m64 -DQMC -DMI_MODULE= -DMI_PRODUCT_RAY -DLINUX -DLINUX_X86 -DX86 -DBIT64 -DMI_LITTLE_ENDIAN -D_GNU_SOURCE -D_REENTRANT -DSVR4 -Dinline=__inline__ -DSSE_INTRINSICS -DNV_CG -D__NO_CTYPE -DHYPERTHREAD -I/usr/X11R6/include -D__NO_CTYPE -DHYPERTHREAD -D_STLP_LITTLE_ENDIAN=1 -D_STLP_SHORT_STRING_SZ=32 -D_STLP_REAL_LOCALE_IMPLEMENTED -D_STLP_NATIVE_INCLUDE_PATH=../c++ -I/h/misrc/ray/3.7.1/src/base/system/stlport -I/h/misrc/ray/3.7.1/src/shaders/.. -I../.. -I.  ./outpsshade.c
 g++-4.0.2 -shared -export-dynamic -Wl,--whole-archive -Bsymbolic -m64 -o contour.so build-contourshade.o.sh build-outimgshade.o.sh build-outpsshade.o.sh -Wl,--no-whole-archive
+gcc-4.0.2 -O3 -fexpensive-optimizations -finline-functions -funroll-loops -fomit-frame-pointer -frerun-cse-after-loop -fstrength-reduce -fforce-addr -Wall -pthread -m64 -DQMC -DMI_MODULE= -DMI_PRODUCT_RAY -DLINUX -DLINUX_X86 -DX86 -DBIT64 -DMI_LITTLE_ENDIAN -D_GNU_SOURCE -D_REENTRANT -DSVR4 -Dinline=__inline__ -DSSE_INTRINSICS -DNV_CG -D__NO_CTYPE -DHYPERTHREAD -I/usr/X11R6/include -D__NO_CTYPE -DHYPERTHREAD -D_STLP_LITTLE_ENDIAN=1 -D_STLP_SHORT_STRING_SZ=32 -D_STLP_REAL_LOCALE_IMPLEMENTED -D_STLP_NATIVE_INCLUDE_PATH=../c++ -I/h/misrc/ray/3.7.1/src/base/system/stlport -I/h/misrc/ray/3.7.1/src/shaders/.. -I../.. -I.  -o contourTest ./contourTest.c -lm
 
@@ -0,0 +1,552 @@
+/******************************************************************************
+ * Created:	18.10.26
+ * Module:	contour
+ * Purpose:	standalone test of the contour output shaders
+ *
+ * Description:
+ * Tests the rasterizing and filtering of outimgshade.c without mental ray.
+ * outimgshade.c is compiled in, and the few mental ray functions it calls
+ * are replaced below: memory comes from calloc, and the output image is a
+ * plain array of colors. The test
+ *
+ *  - draws a large opaque square with draw_polygon_screen, which must come
+ *    out in its own color once filtered,
+ *  - draws random wide lines with draw_line and filters them with the
+ *    tiled float filter, which must match the old double precision
+ *    lanczos2_filter_y/x, box filter and compositing within 1e-5,
+ *  - filters the same lines on one and on several threads, which must
+ *    give identical images,
+ *  - and times filter_contour_image on a larger image for several thread
+ *    counts.
+ *
+ * The Linux build scripts build it after the shader. To build and run it
+ * by hand in this directory:
+ *
+ *	gcc -O3 -pthread -DLINUX -DLINUX_X86 -DX86 -DBIT64 -D_GNU_SOURCE \
+ *		-DSSE_INTRINSICS -I../../include -I. -o contourTest \
+ *		contourTest.c -lm
+ *	./contourTest [width height lines]
+ *
+ * The thread count is set through sysconf, which outimgshade.c asks for
+ * the number of processors.
+ *****************************************************************************/
+
+#include <sys/time.h>
+#include <sys/sysinfo.h>
+
+#define sysconf	test_sysconf
+#include "outimgshade.c"
+#undef sysconf
+
+#define TEST_TOLERANCE	1e-5	/* float filter against double filter */
+
+
+/*
+ * The output image
+ */
+
+typedef struct {
+	int	xsize;
+	int	ysize;
+	miColor	*color;
+} testImage;
+
+static int	test_threads = 1;	/* processors reported to the shader */
+static unsigned	test_seed;
+
+
+/*
+ * The mental ray functions used by outimgshade.c
+ */
+
+long test_sysconf(
+	int		name)
+{
+	return(test_threads);
+}
+
+void *mi_mem_int_allocate(
+	const char * const file,
+	const int	line,
+	const miUint	size)
+{
+	void		*mem = calloc(1, size);
+
+	if (!mem) {
+		fprintf(stderr, "contourTest: out of memory\n");
+		exit(1);
+	}
+	return(mem);
+}
+
+void mi_mem_int_release(
+	const char * const file,
+	const int	line,
+	void		*mem)
+{
+	free(mem);
+}
+
+void mi_info(const char * const fmt, ...) {}
+void mi_progress(const char * const fmt, ...) {}
+void mi_debug(const char * const fmt, ...) {}
+int  mi_par_aborted(void) {return(0);}
+
+void mi_img_put_color(
+	miImg_image	*image,
+	const miColor	*color,
+	int		x,
+	int		y)
+{
+	testImage	*img = (testImage *)image;
+
+	img->color[y * img->xsize + x] = *color;
+}
+
+void mi_img_get_color(
+	const miImg_image *image,
+	miColor		*color,
+	int		x,
+	int		y)
+{
+	const testImage	*img = (const testImage *)image;
+
+	*color = img->color[y * img->xsize + x];
+}
+
+/* contour_composite() is not run; the test draws and filters itself */
+
+miImg_image *mi_output_image_open(
+	miState		*state,
+	miUint		idx)
+{
+	return(NULL);
+}
+
+void mi_output_image_close(
+	miState		*state,
+	miUint		idx)
+{
+}
+
+miBoolean mi_get_contour_line(
+	miContour_endpoint *p1,
+	miContour_endpoint *p2)
+{
+	return(miFALSE);
+}
+
+
+/*
+ * Helpers
+ */
+
+static int	failures = 0;
+
+static void check(
+	miBoolean	ok,
+	const char	*what)
+{
+	printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+	if (!ok)
+		failures++;
+}
+
+static double test_random(void)
+{
+	test_seed = test_seed * 1103515245u + 12345u;
+	return(((test_seed >> 8) & 0xffffff) / 16777216.0);
+}
+
+static double test_time(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec + 1e-6 * tv.tv_usec);
+}
+
+/* Start a contour image of xsize * ysize pixels */
+
+static void test_begin(
+	int		xsize,
+	int		ysize)
+{
+	image_xsize   = xsize;
+	image_ysize   = ysize;
+	glow	      = miFALSE;
+	max_composite = miFALSE;
+	init_hires_contourimg(xsize, ysize);
+}
+
+/* A non-black background for the contours to be composited over */
+
+static void test_background(
+	testImage	*img)
+{
+	int		i;
+
+	for (i=0; i < img->xsize * img->ysize; i++) {
+		img->color[i].r = (i % 7) / 7.0f;
+		img->color[i].g = 0.2f;
+		img->color[i].b = (i % 13) / 13.0f;
+		img->color[i].a = 1.0f;
+	}
+}
+
+static void test_image(
+	testImage	*img)
+{
+	img->xsize = image_xsize;
+	img->ysize = image_ysize;
+	img->color = (miColor *)
+		mi_mem_allocate(image_xsize * image_ysize * sizeof(miColor));
+	test_background(img);
+}
+
+/* Draw n random lines, of up to 4 pixels wide and 20 pixels long */
+
+static void test_lines(
+	int		n)
+{
+	miContour_endpoint p1, p2;
+	double		x, y, a, len;
+	int		i;
+
+	for (i=0; i < n; i++) {
+		memset(&p1, 0, sizeof(p1));
+		memset(&p2, 0, sizeof(p2));
+		x   = test_random() * image_xsize;
+		y   = test_random() * image_ysize;
+		a   = test_random() * 2 * M_PI;
+		len = 0.5 + test_random() * 20;
+		p1.point.x = x;
+		p1.point.y = y;
+		p1.point.z = -1 - 9 * test_random();
+		p2.point.x = x + len * cos(a);
+		p2.point.y = y + len * sin(a);
+		p2.point.z = -1 - 9 * test_random();
+		p1.width   = 0.3 + 3.5 * test_random();
+		p2.width   = 0.3 + 3.5 * test_random();
+		p1.color.r = test_random();
+		p1.color.g = test_random();
+		p1.color.b = test_random();
+		p1.color.a = 0.3 + 0.7 * test_random();
+		p2.color   = p1.color;
+		p2.color.g = test_random();
+		draw_line(&p1, &p2);
+	}
+}
+
+/* Filter the contour image over the background on the given threads */
+
+static double test_filter(
+	testImage	*img,
+	int		threads)
+{
+	double		start;
+
+	test_background(img);
+	test_threads = threads;
+	start = test_time();
+	filter_contour_image((miImg_image *)img);
+	return(test_time() - start);
+}
+
+static double max_difference(
+	const testImage	*a,
+	const testImage	*b)
+{
+	const float	*p = &a->color[0].r;
+	const float	*q = &b->color[0].r;
+	double		diff = 0.0;
+	int		i;
+
+	for (i=0; i < 4 * a->xsize * a->ysize; i++)
+		diff = mi_MAX(diff, fabs((double)p[i] - q[i]));
+	return(diff);
+}
+
+
+/*
+ * The reference: the filters as they were before the image was tiled,
+ * in double precision, running over whole subpixel columns and rows
+ */
+
+static double	ref_table[FILTER_SUPPORT];
+
+static void ref_tabulate_filter(void)
+{
+	double		sum = 0;
+	int		i;
+
+	for (i=0; i < FILTER_SUPPORT; i++) {
+		ref_table[i] = lanczos_2(2.0/FILTER_R * (i-FILTER_R + 0.5));
+		sum += ref_table[i];
+	}
+	for (i=0; i < FILTER_SUPPORT; i++)
+		ref_table[i] /= sum;
+}
+
+/* Subpixel sy, sx of the contour image, NULL if it is black */
+
+static const miColor *ref_subpixel(
+	int		sy,
+	int		sx)
+{
+	miTile		*tile = get_tile(sy / TILESUB, sx / TILESUB);
+	const miColor	*color;
+
+	if (!tile)
+		return(NULL);
+	color = &tile->color[sy % TILESUB][sx % TILESUB];
+	return(color->r > miEPS || color->g > miEPS ||
+	       color->b > miEPS || color->a > miEPS ? color : NULL);
+}
+
+/* Keep sums that are non-black within miEPS */
+
+static void ref_clip(
+	double		*sum)
+{
+	if (!(sum[0] > miEPS || sum[1] > miEPS ||
+	      sum[2] > miEPS || sum[3] > miEPS))
+		sum[0] = sum[1] = sum[2] = sum[3] = 0.0;
+}
+
+/* Filter in y direction, into 4 doubles per subpixel */
+
+static void ref_filter_y(
+	double		*dst)
+{
+	int		xsub = image_xsize * SUBXRES;
+	int		ysub = image_ysize * SUBYRES;
+	const miColor	*color;
+	double		*sum;
+	int		i, ii, j, k;
+
+	for (i=0; i < ysub; i++)
+		for (j=0; j < xsub; j++) {
+			sum = &dst[4 * (i*xsub + j)];
+			sum[0] = sum[1] = sum[2] = sum[3] = 0.0;
+			for (k=0; k < FILTER_SUPPORT; k++) {
+				ii = i - FILTER_R + 1 + k;
+				if (ii < 0 || ii >= ysub ||
+				    !(color = ref_subpixel(ii, j)))
+					continue;
+				sum[0] += ref_table[k] * color->r;
+				sum[1] += ref_table[k] * color->g;
+				sum[2] += ref_table[k] * color->b;
+				sum[3] += ref_table[k] * color->a;
+			}
+			ref_clip(sum);
+		}
+}
+
+/*
+ * Filter src in x direction, average each pixel's 8x8 subpixels and
+ * composite the result over img
+ */
+
+static void ref_filter_x(
+	testImage	*img,
+	const double	*src)
+{
+	int		xsub = image_xsize * SUBXRES;
+	int		ysub = image_ysize * SUBYRES;
+	double		*box = (double *)
+			mi_mem_allocate(image_xsize * 4 * sizeof(double));
+	const double	*in;
+	double		sum[4], alpha;
+	miColor		*pixel;
+	int		i, j, jj, k, c, x;
+
+	for (i=0; i < ysub; i++) {
+		if (i % SUBYRES == 0)
+			memset(box, 0, image_xsize * 4 * sizeof(double));
+		for (j=0; j < xsub; j++) {
+			sum[0] = sum[1] = sum[2] = sum[3] = 0.0;
+			for (k=0; k < FILTER_SUPPORT; k++) {
+				jj = j - FILTER_R + 1 + k;
+				if (jj < 0 || jj >= xsub)
+					continue;
+				in = &src[4 * (i*xsub + jj)];
+				for (c=0; c < 4; c++)
+					sum[c] += ref_table[k] * in[c];
+			}
+			ref_clip(sum);
+			for (c=0; c < 4; c++)
+				box[4 * (j/SUBXRES) + c] += sum[c];
+		}
+		if (i % SUBYRES != SUBYRES-1)
+			continue;
+
+		for (x=0; x < image_xsize; x++) {
+			for (c=0; c < 4; c++)
+				sum[c] = box[4*x + c] / (SUBXRES*SUBYRES);
+			if (!(sum[3] > miEPS))
+				continue;
+			pixel = &img->color[(i/SUBYRES) * image_xsize + x];
+			alpha = sum[3];
+			pixel->r = sum[0] + (1-alpha) * pixel->r;
+			pixel->g = sum[1] + (1-alpha) * pixel->g;
+			pixel->b = sum[2] + (1-alpha) * pixel->b;
+			pixel->a = sum[3] + (1-alpha) * pixel->a;
+		}
+	}
+	mi_mem_release(box);
+}
+
+static void ref_filter(
+	testImage	*img)
+{
+	double		*ybuf = (double *)mi_mem_allocate(4 * sizeof(double) *
+				image_xsize*SUBXRES * image_ysize*SUBYRES);
+
+	test_background(img);
+	ref_tabulate_filter();
+	ref_filter_y(ybuf);
+	ref_filter_x(img, ybuf);
+	mi_mem_release(ybuf);
+}
+
+
+/*
+ * The tests
+ */
+
+/* An opaque square is its own color inside, and leaves the rest alone */
+
+static void test_square(void)
+{
+	miPolygonVertex	square[4];
+	miContour_endpoint p1, p2;
+	testImage	img;
+	miColor		*inside, *outside;
+
+	test_begin(64, 48);
+	memset(&p1, 0, sizeof(p1));
+	memset(&p2, 0, sizeof(p2));
+	p1.point.x = 10.0;  p1.point.y = 20.0;	p1.point.z = -1.0;
+	p2.point.x = 40.0;  p2.point.y = 20.0;	p2.point.z = -1.0;
+	p1.width   = p2.width = 20.0;
+	p1.color.r = 1.0;   p1.color.g = 0.5;	p1.color.a = 1.0;
+	p2.color   = p1.color;
+
+	/* clockwise in raster space, which runs downwards */
+	square[0].x = 10.0;  square[0].y = 10.0;
+	square[1].x = 10.0;  square[1].y = 30.0;
+	square[2].x = 40.0;  square[2].y = 30.0;
+	square[3].x = 40.0;  square[3].y = 10.0;
+	draw_polygon_screen(square, 4, &p1, &p2);
+
+	test_image(&img);
+	test_filter(&img, 1);
+	inside  = &img.color[20 * img.xsize + 25];
+	outside = &img.color[40 * img.xsize + 55];
+	check(fabs(inside->r - 1.0) < TEST_TOLERANCE &&
+	      fabs(inside->g - 0.5) < TEST_TOLERANCE &&
+	      fabs(inside->b)	    < TEST_TOLERANCE &&
+	      fabs(inside->a - 1.0) < TEST_TOLERANCE,
+	      "a square drawn by draw_polygon_screen keeps its color");
+	check(outside->g == 0.2f && outside->a == 1.0f,
+	      "the image away from the square is untouched");
+
+	mi_mem_release(img.color);
+	fini_hires_contourimg();
+}
+
+/*
+ * Random lines filter to the same image as with the double precision
+ * filters, and to exactly the same image on any number of threads
+ */
+
+static void test_lines_filter(
+	int		xsize,
+	int		ysize,
+	int		nlines)
+{
+	testImage	one, many, ref;
+	int		threads = mi_MIN(MAXTHREADS,
+				(xsize/TILERES + REGIONTILES-1) / REGIONTILES);
+	char		what[100];
+	double		diff;
+
+	test_begin(xsize, ysize);
+	test_seed = 1;
+	test_lines(nlines);
+
+	test_image(&one);
+	test_image(&many);
+	test_image(&ref);
+	test_filter(&one, 1);
+	test_filter(&many, threads);
+	ref_filter(&ref);
+
+	diff = max_difference(&one, &ref);
+	sprintf(what, "%d lines match the double filter (largest difference "
+		"%.2g)", nlines, diff);
+	check(diff <= TEST_TOLERANCE, what);
+
+	sprintf(what, "1 and %d threads give the same image", threads);
+	check(threads > 1 && !memcmp(one.color, many.color,
+			xsize * ysize * sizeof(miColor)), what);
+
+	mi_mem_release(one.color);
+	mi_mem_release(many.color);
+	mi_mem_release(ref.color);
+	fini_hires_contourimg();
+}
+
+/*
+ * Time the filter on a 1920x1080 image, doubling the threads up to the
+ * number of processors (and at least to 2)
+ */
+
+static void time_filter(void)
+{
+	testImage	img;
+	int		nprocs = get_nprocs();
+	int		maxthreads = mi_MIN(mi_MAX(nprocs, 2), MAXTHREADS);
+	double		one = 0.0, t;
+	int		threads;
+
+	test_begin(1920, 1080);
+	test_seed = 2;
+	test_lines(5000);
+	test_image(&img);
+
+	printf("filter_contour_image, 1920x1080, 5000 lines, %d "
+	       "processors:\n", nprocs);
+	for (threads=1; ; threads = mi_MIN(2*threads, maxthreads)) {
+		t = test_filter(&img, threads);
+		if (threads == 1)
+			one = t;
+		printf("  %2d threads: %.3fs (%.2fx)\n", threads, t,
+							one / t);
+		if (threads == maxthreads)
+			break;
+	}
+	mi_mem_release(img.color);
+	fini_hires_contourimg();
+}
+
+int main(
+	int		argc,
+	char		*argv[])
+{
+	int		xsize  = argc > 1 ? atoi(argv[1]) : 203;
+	int		ysize  = argc > 2 ? atoi(argv[2]) : 157;
+	int		nlines = argc > 3 ? atoi(argv[3]) : 1000;
+
+	if (xsize < 1 || ysize < 1 || nlines < 0) {
+		fprintf(stderr, "usage: contourTest [width height lines]\n");
+		return(1);
+	}
+	test_square();
+	test_lines_filter(xsize, ysize, nlines);
+	time_filter();
+
+	printf("contourTest: %s\n", failures ? "FAILED" : "passed");
+	return(failures ? 1 : 0);
+}
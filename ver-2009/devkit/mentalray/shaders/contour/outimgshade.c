@@ -14,32 +14,45 @@
  *
  * History:
  *	14.9.01: reindented in manual style for publication
+ *	18.10.26: tiled subpixel storage, separable filter on several threads
  *
  * Description:
  * Get contour line segments and convert them into polygons. The polygons are
  * rasterized at high resolution and then downsampled (to avoid aliasing).
  *
- * It would be fairly easy to parallelize the filtering of the high-resolution
- * contour image (it is already filtered in little blocks/tasks at a time).
- * Unfortunately the computation of the contour image cannot be done at the
- * individual tasks without generating incorrect contours when the contours
- * are wide and at a grazing angle to the task boundary. Therefore this has
- * to be done at the master host.
+ * The filtering of the high-resolution contour image is split into regions,
+ * which are filtered on as many threads as there are processors. The
+ * computation of the contour image cannot be done at the individual tasks
+ * without generating incorrect contours when the contours are wide and at a
+ * grazing angle to the task boundary. Therefore this has to be done at the
+ * master host.
  *****************************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#endif
+#ifdef SSE_INTRINSICS
+#include <xmmintrin.h>
+#endif
 #include <shader.h>
 #include "mi_contourshade.h"
 
-#define REGIONSIZEX	64		/* Region size for filter (in pixels)*/
-#define REGIONSIZEY	64
+#define REGIONTILES	16		/* Region size for filter (in tiles) */
+#define TILERES		4		/* Tile size (in pixels) */
 #define SUBYRES		8		/* Subpixel resolution per pixel */
 #define SUBXRES		8
+#define TILESUB		(TILERES*SUBXRES) /* Tile size (in subpixels) */
 #define MODRES(y)	((y) & 7)	/* Subpixel Y modulo */
+#define MAXTHREADS	32		/* Most threads used for filtering */
 #define miEPS		0.0001
 
 #define mi_MIN(a, b)	((a) < (b) ? (a) : (b))
@@ -56,13 +69,24 @@ typedef struct {	/* polygon vertex */
 	double x, y;	/* subpixel display coordinate */
 } miPolygonVertex;
 
+/*
+ * A tile of the high-resolution image consists of TILERES*TILERES pixels of
+ * SUBXRES*SUBYRES colors and depths each, stored as whole rows of subpixels
+ * so that the filters can run along them.
+ */
 typedef struct {
-	miColor color;
-	double	depth;
-} miColorDepth;
+	miColor	color[TILESUB][TILESUB];
+	double	depth[TILESUB][TILESUB];
+} miTile;
 
-/* A high-resolution pixel consists of SUBXRES*SUBYRES colors and depths */
-typedef miColorDepth	miPixel[SUBXRES*SUBYRES];
+/* One thread's share of filtering a band of regions */
+typedef struct {
+	int	ty;			/* first tile row of the band */
+	int	first;			/* first region of the band for this */
+	int	step;			/* thread, and step to its next one */
+	miColor	*ybuf;			/* y-filtered subpixels of a region */
+	miColor	*band;			/* filtered contour pixels of the band */
+} miFilterTask;
 
 
 
@@ -70,18 +94,15 @@ typedef miColorDepth	miPixel[SUBXRES*SUBYRES];
  * Global variables
  */
 
-static miMemblk	*pixel_pages = NULL;	/* Pages for mi_mem_blkcreate() */
-static miMemblk *region_pixel_pages = NULL;
 static int	 image_xsize;		/* image size in pixels */
 static int	 image_ysize;
+static int	 tiles_x;		/* image size in tiles */
+static int	 tiles_y;
 static miBoolean max_composite;		/* max composite or alpha composite? */
 static miBoolean glow;			/* glowing contours? */
-static int	 npixels=0, npixels2=0;	/* for debugging */
 
-/* Color high-resolution images: 2d array of pointers to miColorDepth */
-static miColorDepth ***hires_image;
-static miColorDepth ***region_image2;
-static miColorDepth ***region_image3;
+/* Color high-resolution image: 2d array of pointers to tiles */
+static miTile	**hires_tiles;
 
 
 /* these are all static (i.e. local) */
@@ -103,15 +124,22 @@ static void interpolate_color_depth(miColor *color, double *depth,
 static void set_subpixels(unsigned char *mask, int i, int j, miColor *color,
 			double depth);
 
+static miTile *get_tile(int ty, int tx);
+
 static void filter_contour_image(miImg_image *image);
 static double lanczos_2( double arg);
 static void tabulate_filter(void);
-static void init_region_images(void);
-static void fini_region_images(void);
-static void lanczos2_filter_y(int xmin, int ymin, int xmax, int ymax);
-static void lanczos2_filter_x(int xmin, int ymin, int xmax, int ymax);
-static void box_filter(miImg_image *image, int xmin, int ymin, int xmax,
-			int ymax );
+static void clean_tiles(void);
+static int  num_processors(void);
+static void run_filter_tasks(miFilterTask *task, int ntasks);
+static void filter_band(miFilterTask *task);
+static void filter_region(miColor *ybuf, miColor *band, int ty, int tx);
+static miBoolean lanczos2_filter_y(miColor *dst, int ty, int tx);
+static void lanczos2_filter_x(miColor *band, miColor *src, int y, int x);
+static void convolve(miColor *sum, const miColor *row[]);
+static miBoolean clip_black(miColor *dst, const miColor *src, int n);
+static void composite_band(miImg_image *image, miColor *band, int ymin,
+			int ymax);
 
 
 
@@ -617,10 +645,11 @@ static void interpolate_color_depth(
  * The contour image is huge, it is eight times the regular image in
  * each dimension, that is 64 times as big!	This requires an enormous
  * amount of memory at the master.	Fortunately, the contour image is
- * also very sparse, so we use a representation where there's an image-
- * resolution array of pointers.	If an entire pixel is black, the
- * corresponding pointer is NULL.	If some subpixels of the pixel are
- * non-black, the pixel points to an 8x8 array of subpixels.
+ * also very sparse, so we use a representation where there's an array of
+ * pointers to tiles of TILERES*TILERES pixels.	If an entire tile is
+ * black, the corresponding pointer is NULL.	If some subpixels of the
+ * tile are non-black, the pointer points to all of its subpixels, which
+ * lie in one contiguous block of memory.
  */
 
 /* Initialize high-resolution contour image */
@@ -628,20 +657,14 @@ static void init_hires_contourimg(
 	int		xsize,
 	int		ysize)
 {
-	miColorDepth	**hires_pixels, **pixel_ptr;
-	int		i;
-
 	mi_debug("allocate high-resolution contourimage");
 
-	/* Sparse color hires image (8*8 miColorDepths) */
-	hires_image  = (miColorDepth ***)
-			mi_mem_allocate(ysize * sizeof(miColorDepth **));
-	hires_pixels = (miColorDepth **)
-			mi_mem_allocate(xsize * ysize * sizeof(miColorDepth*));
-	for (i=0, pixel_ptr=hires_pixels; i < ysize; i++, pixel_ptr += xsize)
-		hires_image[i] = pixel_ptr;
+	/* Sparse color hires image (tiles of 32*32 miColors and depths) */
+	tiles_x	    = (xsize + TILERES-1) / TILERES;
+	tiles_y	    = (ysize + TILERES-1) / TILERES;
+	hires_tiles = (miTile **)
+			mi_mem_allocate(tiles_x * tiles_y * sizeof(miTile *));
 
-	pixel_pages  = mi_mem_blkcreate(sizeof(miPixel));
 	/* free'd in fini_hires_contourimg() */
 	mi_debug("high-resolution contourimage allocated");
 }
@@ -653,11 +676,29 @@ static void init_hires_contourimg(
 
 static void fini_hires_contourimg(void)
 {
+	int		i;
+
 	mi_debug("deallocating high-resolution contourimage");
-	mi_mem_release(hires_image[0]);	/* hires_pixels */
-	mi_mem_release(hires_image);
-	mi_mem_blkdelete(pixel_pages);
-	pixel_pages = NULL;
+	for (i=0; i < tiles_x * tiles_y; i++)
+		if (hires_tiles[i])
+			mi_mem_release(hires_tiles[i]);
+	mi_mem_release(hires_tiles);
+	hires_tiles = NULL;
+}
+
+
+/*
+ * Return the tile at tile row ty and column tx, NULL if it is black or
+ * outside the image
+ */
+
+static miTile *get_tile(
+	int		ty,
+	int		tx)
+{
+	if (ty < 0 || ty >= tiles_y || tx < 0 || tx >= tiles_x)
+		return(NULL);
+	return(hires_tiles[ty*tiles_x + tx]);
 }
 
 
@@ -672,63 +713,62 @@ static void set_subpixels(
 	miColor		*color,
 	double		depth)
 {
-	miColorDepth	*pixel, *subpixel;
-	int		k, l, idx = 0;
+	miTile		**tile = &hires_tiles[(i/TILERES)*tiles_x + j/TILERES];
+	miColor		*subcolor;
+	double		*subdepth;
+	int		k, l;
+	int		y0 = (i % TILERES) * SUBYRES;	/* pixel in tile */
+	int		x0 = (j % TILERES) * SUBXRES;
 
 	/*
-	 * If pixel is unwritten, allocate memory for its 8x8 subpixels
-	 * and set these to black and infinite distant (depth 0).
+	 * If tile is unwritten, allocate memory for its subpixels and set
+	 * these to black and infinite distant (depth 0).
 	 */
-	if (hires_image[i][j] == NULL)
-		hires_image[i][j] = (miColorDepth *)
-					mi_mem_blkallocate(pixel_pages);
+	if (*tile == NULL)
+		*tile = (miTile *)mi_mem_allocate(sizeof(miTile));
 
 	/* Blend with existing color */
-	pixel = hires_image[i][j];
-	for (k=0, idx=0; k < SUBYRES; k++)
-		for (l=0; l < SUBYRES; l++, idx++) {
+	for (k=0; k < SUBYRES; k++)
+		for (l=0; l < SUBYRES; l++) {
 			if (!(mask[k] & (0x80 >> l)))
 				continue;
-			subpixel = &(pixel[idx]);
-			if (subpixel->depth == 0.0) {
+			subcolor = &(*tile)->color[y0+k][x0+l];
+			subdepth = &(*tile)->depth[y0+k][x0+l];
+			if (*subdepth == 0.0) {
 				/* New color (no previous color) */
-				subpixel->color = *color;
-				subpixel->depth = depth;
+				*subcolor = *color;
+				*subdepth = depth;
 
 			} else if (max_composite) {
 				/* Max compositing */
-				subpixel->color.r = mi_MAX(subpixel->color.r,
-								     color->r);
-				subpixel->color.g = mi_MAX(subpixel->color.g,
-								     color->g);
-				subpixel->color.b = mi_MAX(subpixel->color.b,
-								     color->b);
-				subpixel->color.a = mi_MAX(subpixel->color.a,
-								     color->a);
+				subcolor->r = mi_MAX(subcolor->r, color->r);
+				subcolor->g = mi_MAX(subcolor->g, color->g);
+				subcolor->b = mi_MAX(subcolor->b, color->b);
+				subcolor->a = mi_MAX(subcolor->a, color->a);
 			} else {
 				/* Alpha compositing */
-				if (depth > subpixel->depth) {
+				if (depth > *subdepth) {
 					/* New color is in front of old color */
 					float a = color->a;
-					subpixel->color.r = color->r +
-						(1-a) * subpixel->color.r;
-					subpixel->color.g = color->g +
-						(1-a) * subpixel->color.g;
-					subpixel->color.b = color->b +
-						(1-a) * subpixel->color.b;
-					subpixel->color.a = color->a +
-						(1-a) * subpixel->color.a;
-					subpixel->depth = depth;
+					subcolor->r = color->r +
+						(1-a) * subcolor->r;
+					subcolor->g = color->g +
+						(1-a) * subcolor->g;
+					subcolor->b = color->b +
+						(1-a) * subcolor->b;
+					subcolor->a = color->a +
+						(1-a) * subcolor->a;
+					*subdepth = depth;
 				} else {
 					/* New color is behind old color */
-					float a = subpixel->color.a;
-					subpixel->color.r = subpixel->color.r +
+					float a = subcolor->a;
+					subcolor->r = subcolor->r +
 						(1-a) * color->r;
-					subpixel->color.g = subpixel->color.g +
+					subcolor->g = subcolor->g +
 						(1-a) * color->g;
-					subpixel->color.b = subpixel->color.b +
+					subcolor->b = subcolor->b +
 						(1-a) * color->b;
-					subpixel->color.a = subpixel->color.a +
+					subcolor->a = subcolor->a +
 						(1-a) * color->a;
 				}
 			}
@@ -736,90 +776,6 @@ static void set_subpixels(
 }
 
 
-static void set_subpixel2(
-	int		i,		/* y */
-	int		j,		/* x */
-	int		k,		/* subpixel y */
-	int		l,		/* subpixel x */
-	miColor		*color)
-{
-	miColorDepth	*pixel, *subpixel;
-
-	pixel = region_image2[i][j];
-	if (pixel == NULL) {
-		/* Allocate a pixel and set all subpixels to black and inf
-		   distance */
-		pixel = (miColorDepth *)mi_mem_blkallocate(region_pixel_pages);
-		region_image2[i][j] = pixel;
-		++npixels2;
-	}
-
-	/* Set this subpixel */
-	subpixel = &pixel[k*SUBXRES+l];
-	subpixel->color.r = color->r;
-	subpixel->color.g = color->g;
-	subpixel->color.b = color->b;
-	subpixel->color.a = color->a;
-	subpixel->depth   = 0.0;
-}
-
-
-static void set_subpixel3(		/* region_image, */
-	int		i,		/* y */
-	int		j,		/* x */
-	int		k,		/* subpixel y */
-	int		l,		/* subpixel x */
-	miColor		*color)
-{
-	miColorDepth	*pixel, *subpixel;
-
-	pixel = region_image3[i][j];
-	if (pixel == NULL) {
-		/* Allocate a pixel and set all subpixels to black and inf.
-		   distance */
-		pixel = (miColorDepth *)mi_mem_blkallocate(region_pixel_pages);
-		region_image3[i][j] = pixel;
-		++npixels;
-	}
-
-	/* Set this subpixel */
-	subpixel = &pixel[k*SUBXRES+l];
-	subpixel->color.r = color->r;
-	subpixel->color.g = color->g;
-	subpixel->color.b = color->b;
-	subpixel->color.a = color->a;
-	subpixel->depth   = 0.0;
-}
-
-
-/*
- * Are the five nearest pixels all black (NULL)?
- */
-
-static void test_nearby_pixels(
-	miBoolean	*nearby_nonblack_pixel,
-	miColorDepth	**pixels,
-	int		n)	/* # of elements in 'pixels' (array of ptrs) */
-{
-	int		i;
-
-	miASSERT(n >= 2);
-	nearby_nonblack_pixel[0] = (miBoolean)
-			(pixels[0] || pixels[1] || pixels[2]);
-	nearby_nonblack_pixel[1] = (miBoolean)
-			(pixels[0] || pixels[1] || pixels[2] || pixels[3]);
-	for (i=2; i < n-2; i++)
-		nearby_nonblack_pixel[i] = (miBoolean)
-			(pixels[i-2] || pixels[i-1] || pixels[i] ||
-			 pixels[i+1] || pixels[i+2]);
-
-	nearby_nonblack_pixel[n-2] = (miBoolean)
-		(pixels[n-4] || pixels[n-3] || pixels[n-2] || pixels[n-1]);
-	nearby_nonblack_pixel[n-1] = (miBoolean)
-		(pixels[n-3] || pixels[n-2] || pixels[n-1]);
-}
-
-
 
 /*
  * Filtering:
@@ -831,9 +787,12 @@ static void test_nearby_pixels(
 
 #define FILTER_R	16	/* filter radius: 16 subpixels = 2 pixels */
 #define FILTER_SUPPORT	32	/* Filter support: $2r+1$ */
-#define OLAP		2	/* image filtering task overlap: 2 pixels */
 
-static double filter_table[FILTER_SUPPORT];
+/* y-filtered subpixels of a region and one tile either side of it */
+#define YBUF_XSIZE	((REGIONTILES+2) * TILESUB)
+#define YBUF_YSIZE	(REGIONTILES * TILESUB)
+
+static float filter_table[FILTER_SUPPORT];
 
 /* The constant ${1 \over \pi} {2 \over \pi}$ */
 #define C_1_PI_2_PI	0.202642367284675542888
@@ -861,52 +820,75 @@ static double lanczos_2(double arg)
 
 
 /*
- * Filter the high-resolution contours in hires_image to form a contour image.
+ * Filter the high-resolution contours in hires_tiles to form a contour image.
  * Then alpha-composite "over" the regular image.
  *
- * The filtering and compositing is done in regions of size REGIONSIZEX *
- * REGIONSIZEY pixels. The outermost 2 pixels are not filtered correctly, so
- * only the inner pixels are assigned to the output image. The tasks overlap
- * by 4 pixels. Filtering the whole image at once is simpler, but requires a
- * *lot* of memory even though only the areas covered by contours are filtered.
- * The two procedures lanczos2_filter_y() and lanczos2_filter_x() take up to
- * 9% of total runtime.
+ * The filtering is done in regions of REGIONTILES * REGIONTILES tiles, a
+ * band of regions at a time. The regions of a band are shared out among
+ * the threads, which filter them into a buffer for the band; then the band
+ * is composited over the image here, since only this thread may write to
+ * the image. Since the filter only reaches 2 pixels, half a tile, beyond a
+ * region, the regions need not overlap. Only the areas covered by contours
+ * are filtered.
  */
 
 static void filter_contour_image(
 	miImg_image	*image)
 {
-	int		size = image_xsize * image_ysize;
+	miFilterTask	task[MAXTHREADS];
+	miColor		*band;
+	int		band_ysize = REGIONTILES * TILERES;
+	int		nregions = (tiles_x + REGIONTILES-1) / REGIONTILES;
+	int		nthreads, t, ty, ymin, ymax;
 	int		done = 0;
-	int		xmin, ymin, xmax, ymax;
+	miBoolean	aborted = miFALSE;
 
 	mi_progress("filtering high-resolution contour image");
 
 	tabulate_filter();
-	for (ymin=-OLAP; ymin < image_ysize-OLAP; ymin+=REGIONSIZEY-2*OLAP)
-		for (xmin=-OLAP; xmin < image_xsize-OLAP;
-						  xmin+=REGIONSIZEX-2*OLAP) {
- 			xmax = mi_MIN(xmin + REGIONSIZEX, image_xsize+OLAP);
-			ymax = mi_MIN(ymin + REGIONSIZEY, image_ysize+OLAP);
-			mi_debug("filtering contours in region [%i:%i] x "
-					"[%i:%i]", xmin, xmax, ymin, ymax);
-			init_region_images();
-			/* hires_image -> region_image2 */
-			lanczos2_filter_y(xmin, ymin, xmax, ymax);
-			/* region_image2 -> region_image3 */
-			lanczos2_filter_x(xmin, ymin, xmax, ymax);
-			/* region_image3 -> output image */
-			box_filter(image, xmin+OLAP, ymin+OLAP,
-					  xmax-OLAP, ymax-OLAP);
-			fini_region_images();
-			done += (xmax - xmin - 2*OLAP)*(ymax - ymin - 2*OLAP);
-			mi_progress("%5.1f%%", 100.0 * done / size);
-			if(mi_par_aborted()) {
-				mi_progress("contour filtering aborted");
-				return;
-			}
+	clean_tiles();
+
+	nthreads = mi_MIN(num_processors(), mi_MIN(nregions, MAXTHREADS));
+	if (nthreads < 1)
+		nthreads = 1;
+	mi_debug("filtering contours on %i threads", nthreads);
+
+	/* Local arrays --- released at the end of this procedure */
+	band = (miColor *)
+		mi_mem_allocate(image_xsize * band_ysize * sizeof(miColor));
+	for (t=0; t < nthreads; t++) {
+		task[t].first = t;
+		task[t].step  = nthreads;
+		task[t].band  = band;
+		task[t].ybuf  = (miColor *)
+			mi_mem_allocate(YBUF_XSIZE * YBUF_YSIZE *
+							sizeof(miColor));
+	}
+
+	for (ty=0; ty < tiles_y && !aborted; ty += REGIONTILES) {
+		ymin = ty * TILERES;
+		ymax = mi_MIN(ymin + band_ysize, image_ysize);
+		mi_debug("filtering contours in rows [%i:%i]", ymin, ymax);
+		memset(band, 0, image_xsize * band_ysize * sizeof(miColor));
+		for (t=0; t < nthreads; t++)
+			task[t].ty = ty;
+		run_filter_tasks(task, nthreads);
+		composite_band(image, band, ymin, ymax);
+
+		done += ymax - ymin;
+		mi_progress("%5.1f%%", 100.0 * done / image_ysize);
+		if (mi_par_aborted()) {
+			mi_progress("contour filtering aborted");
+			aborted = miTRUE;
 		}
-	mi_progress("filtering finished");
+	}
+
+	/* Release local arrays */
+	for (t=0; t < nthreads; t++)
+		mi_mem_release(task[t].ybuf);
+	mi_mem_release(band);
+	if (!aborted)
+		mi_progress("filtering finished");
 }
 
 
@@ -916,389 +898,386 @@ static void filter_contour_image(
 
 static void tabulate_filter(void)
 {
+	double		table[FILTER_SUPPORT];
 	double		sum = 0, inv_norm;
 	int		i;
 
 	for (i=0; i < FILTER_SUPPORT; i++) {
-		filter_table[i] = lanczos_2(2.0/FILTER_R * (i-FILTER_R + 0.5));
-		sum += filter_table[i];
+		table[i] = lanczos_2(2.0/FILTER_R * (i-FILTER_R + 0.5));
+		sum += table[i];
 	}
 	inv_norm = 1.0 / sum;
 	for (i = 0; i < FILTER_SUPPORT; i++)
-		filter_table[i] *= inv_norm;
+		filter_table[i] = (float)(table[i] * inv_norm);
 }
 
 
-static void init_region_images(void)
+/*
+ * Set subpixels that are black within miEPS to exactly black, so that
+ * the filters can convolve whole rows of subpixels without testing them
+ */
+
+static void clean_tiles(void)
 {
-	miColorDepth	**hires_pixels, **pixel_ptr;
-	int		i;
+	miTile		*tile;
+	miColor		*color;
+	int		i, n;
+
+	for (i=0; i < tiles_x * tiles_y; i++) {
+		if (!(tile = hires_tiles[i]))
+			continue;
+		color = &tile->color[0][0];
+		for (n=0; n < TILESUB*TILESUB; n++, color++)
+			if (!(color->r > miEPS || color->g > miEPS ||
+			      color->b > miEPS || color->a > miEPS))
+				color->r = color->g = color->b = color->a = 0.0;
+	}
+}
 
-	/* Init region_image2[][] --- could move to init_hires_contourimg() */
-	region_image2 = (miColorDepth ***)
-			mi_mem_allocate(REGIONSIZEY * sizeof(miColorDepth **));
-	hires_pixels = (miColorDepth **)
-			mi_mem_allocate(REGIONSIZEX *
-					REGIONSIZEY * sizeof(miColorDepth *));
-	for (i=0, pixel_ptr=hires_pixels; i < REGIONSIZEY;
-						i++, pixel_ptr += REGIONSIZEX)
-		region_image2[i] = pixel_ptr;
-
-	/* Init region_image3[][] --- could move to init_hires_contourimg() */
-	region_image3 = (miColorDepth ***)
-			mi_mem_allocate(REGIONSIZEY * sizeof(miColorDepth **));
-	hires_pixels = (miColorDepth **)
-			mi_mem_allocate(REGIONSIZEX *
-					REGIONSIZEY * sizeof(miColorDepth *));
-	for (i=0, pixel_ptr=hires_pixels; i < REGIONSIZEY;
-						i++, pixel_ptr += REGIONSIZEX)
-		region_image3[i] = pixel_ptr;
-
-	region_pixel_pages = mi_mem_blkcreate(sizeof(miPixel));
+
+/*
+ * Number of processors to filter on
+ */
+
+static int num_processors(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO	info;
+
+	GetSystemInfo(&info);
+	return((int)info.dwNumberOfProcessors);
+#else
+	long		n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return(n > 0 ? (int)n : 1);
+#endif
 }
 
 
-static void fini_region_images(void)
+/*
+ * Run the filter tasks, the first on this thread and each of the others on
+ * a thread of its own. A task whose thread cannot be started is run here.
+ */
+
+#ifdef _WIN32
+static DWORD WINAPI filter_thread(
+	LPVOID		arg)
+#else
+static void *filter_thread(
+	void		*arg)
+#endif
 {
-	mi_mem_release(region_image2[0]);
-	mi_mem_release(region_image2);
-	mi_mem_release(region_image3[0]);
-	mi_mem_release(region_image3);
-	mi_mem_blkdelete(region_pixel_pages);
-	region_pixel_pages = NULL;
+	filter_band((miFilterTask *)arg);
+	return(0);
 }
 
 
-static void lanczos2_filter_y(
-	int		xmin,
-	int		ymin,
-	int		xmax,
-	int		ymax)
+static void run_filter_tasks(
+	miFilterTask	*task,
+	int		ntasks)
+{
+#ifdef _WIN32
+	HANDLE		thread[MAXTHREADS];
+#else
+	pthread_t	thread[MAXTHREADS];
+#endif
+	miBoolean	started[MAXTHREADS];
+	int		t;
+
+	for (t=1; t < ntasks; t++) {
+#ifdef _WIN32
+		thread[t]  = CreateThread(NULL, 0, filter_thread, &task[t],
+								0, NULL);
+		started[t] = (miBoolean)(thread[t] != NULL);
+#else
+		started[t] = (miBoolean)!pthread_create(&thread[t], NULL,
+							filter_thread, &task[t]);
+#endif
+	}
+	filter_band(&task[0]);
+
+	for (t=1; t < ntasks; t++) {
+		if (!started[t]) {
+			filter_band(&task[t]);
+			continue;
+		}
+#ifdef _WIN32
+		WaitForSingleObject(thread[t], INFINITE);
+		CloseHandle(thread[t]);
+#else
+		pthread_join(thread[t], NULL);
+#endif
+	}
+}
+
+
+/*
+ * Filter this task's regions of a band
+ */
+
+static void filter_band(
+	miFilterTask	*task)
 {
-	/* 'register' since these are used in the inner convolution loop: */
-	register miColorDepth **pixels, **subpixels, *pixel, *subpixel;
-	register miColor contourcolor, *color;
-	register double	weight;
-	register int	ii, i_min, i_max;
-	/* Not used in the inner loop: */
-	miColor		contourcolor2;
-	int		i, j, i_pixel, j_pixel, j_subpixel, offset, i_subpixel;
-	int		xsize = xmax - xmin;	/* size of image region */
-	int		ysize = ymax - ymin;
-	int		hires_xsize = SUBXRES * xsize;	/* size of highres
-							   image region */
-	int		hires_ysize = SUBYRES * ysize;
-	miBoolean	*nearby_nonblack_pixel;
-
-	mi_debug("filtering in y direction using Lanczos_2 filter");
+	int		r;
 
-	/* Local arrays --- released at the end of this procedure */
-	pixels = (miColorDepth **)
-			mi_mem_allocate(hires_ysize * sizeof(miColorDepth *));
-	nearby_nonblack_pixel = (miBoolean *)
-			mi_mem_allocate(hires_ysize * sizeof(miBoolean));
-	subpixels = (miColorDepth **)
-			mi_mem_allocate(hires_ysize * sizeof(miColorDepth *));
+	for (r=task->first; r*REGIONTILES < tiles_x; r += task->step)
+		filter_region(task->ybuf, task->band, task->ty,
+							r*REGIONTILES);
+}
 
-	for (j=0; j < hires_xsize; j++) {
-		j_pixel = j/SUBXRES;
-		j_subpixel = j%SUBXRES;
 
-		/*
-		 * Compute array of pointers to pixels. This is faster and
-		 * simpler to look-up in than the original array
-		 */
-		if (j % SUBXRES == 0) {
-			for (i=0; i < ysize; i++)
-				pixels[i] = 0		 <= ymin+i	 &&
-					    ymin+i	 <  image_ysize  &&
-					    0		 <= j_pixel+xmin &&
-					    j_pixel+xmin <  image_xsize ?
-					hires_image[ymin+i][j_pixel+xmin] : 0;
-			test_nearby_pixels(nearby_nonblack_pixel,
-								pixels, ysize);
+/*
+ * Filter the region with top left tile ty, tx into the band: filter the
+ * tiles of the region and the tiles either side of it in y direction into
+ * ybuf, then filter those in x direction into the band. Tiles that are too
+ * far from any contour to come out non-black are skipped.
+ */
+
+static void filter_region(
+	miColor		*ybuf,
+	miColor		*band,
+	int		ty,
+	int		tx)
+{
+	miBoolean	nonblack[REGIONTILES][REGIONTILES+2];
+	miBoolean	any = miFALSE;
+	miColor		*block;
+	int		nrows = mi_MIN(REGIONTILES, tiles_y - ty);
+	int		ncols = mi_MIN(REGIONTILES, tiles_x - tx);
+	int		r, c, i;
+
+	/* hires_tiles -> ybuf */
+	for (r=0; r < nrows; r++)
+		for (c=0; c < ncols+2; c++) {
+			block = ybuf + r*TILESUB*YBUF_XSIZE + c*TILESUB;
+			nonblack[r][c] = lanczos2_filter_y(block, ty+r, tx+c-1);
+			any |= nonblack[r][c];
 		}
+	if (!any)
+		return;
 
-		/*
-		 * Compute array of pointers to subpixels. The subpixel is
-		 * NULL if the subpixel color in the hires image is black
-		 */
-		for (i=ii=0; i < ysize; i++, ii+=8) {
-			pixel = pixels[i];
-			if (pixel) {
-				for (i_subpixel=0; i_subpixel < SUBYRES;
-								i_subpixel++) {
-					subpixel = &pixel[(i_subpixel<<3) +
-								j_subpixel];
-					color = &subpixel->color;
-					subpixels[ii+i_subpixel] =
-						color->r > miEPS ||
-						color->g > miEPS ||
-						color->b > miEPS ||
-						color->a > miEPS ?
-								subpixel : 0;
-				}
-			}
+	/*
+	 * The x filter reads black tiles up to two tiles from non-black
+	 * ones, so those have to be cleared
+	 */
+	for (r=0; r < nrows; r++)
+		for (c=0; c < ncols+2; c++) {
+			if (nonblack[r][c])
+				continue;
+			for (i=mi_MAX(c-2, 0); i <= mi_MIN(c+2, ncols+1); i++)
+				if (nonblack[r][i])
+					break;
+			if (i > mi_MIN(c+2, ncols+1))
+				continue;
+			block = ybuf + r*TILESUB*YBUF_XSIZE + c*TILESUB;
+			for (i=0; i < TILESUB; i++, block += YBUF_XSIZE)
+				memset(block, 0, TILESUB * sizeof(miColor));
 		}
 
-		/* Convolution */
-		for (i=0; i < hires_ysize; i++) {
-			i_pixel = i/SUBYRES;
-			offset  = -i+FILTER_R-1;
-
-			if (nearby_nonblack_pixel[i_pixel]) {
-
-				/* Convolute hires_image with filter in i
-				   direction */
-				i_min = i - FILTER_R + 1;
-				if (i_min < 0)
-					i_min = 0;
-				i_max = i + FILTER_R;
-				if (i_max > hires_ysize - 1)
-					i_max = hires_ysize - 1;
-
-				contourcolor.r = contourcolor.g =
-				contourcolor.b = contourcolor.a = 0.0;
-
-				pixel = pixels[i_min>>3];
-				ii = i_min;
-				while (ii <= i_max) {
-					if (!(ii & 0x7))
-						pixel = pixels[ii>>3];
-					if (pixel) {
-						subpixel = subpixels[ii];
-						if (subpixel) {
-							color  =
-							     &subpixel->color;
-							weight =
-							     filter_table[ii +
-							     	       offset];
-							contourcolor.r +=
-							     weight * color->r;
-							contourcolor.g +=
-							     weight * color->g;
-							contourcolor.b +=
-							     weight * color->b;
-							contourcolor.a +=
-							     weight * color->a;
-						}
-						ii++;
-					} else
-						/* skip ahead to next pixel (8
-						   subpixels or less) */
-						ii = (ii | 0x7) + 1;
-				}
+	/* ybuf -> band */
+	for (r=0; r < nrows; r++)
+		for (c=0; c < ncols; c++)
+			if (nonblack[r][c] || nonblack[r][c+1] ||
+			    nonblack[r][c+2])
+				lanczos2_filter_x(band,
+					ybuf + r*TILESUB*YBUF_XSIZE +
+							(c+1)*TILESUB,
+					r*TILERES, (tx+c)*TILERES);
+}
 
-				/* Write result in region_image2[][] */
-				if (contourcolor.r > miEPS ||
-				    contourcolor.g > miEPS ||
-				    contourcolor.b > miEPS ||
-				    contourcolor.a > miEPS) {
-					/*
-					 * This assignment is necessary since
-					 * we want contourcolor to be register,
-					 * and then we can't pass a ptr to it
-					 */
-					contourcolor2 = contourcolor;
-					set_subpixel2(i_pixel, j_pixel, i%8,
-						   j_subpixel, &contourcolor2);
-				}
-			} else
-				/* skip ahead to next pixel (8 subpixels
-				   or less) */
-				i = (i | 0x7) + 1;
+
+/*
+ * Filter tile ty, tx in y direction into dst, whose rows are YBUF_XSIZE
+ * apart. Each subpixel row is the weighted sum of the 32 rows around it,
+ * which lie in this tile and the tiles above and below it. Returns whether
+ * any of the result is non-black; if the three tiles are all black, nothing
+ * is written.
+ */
+
+static miBoolean lanczos2_filter_y(
+	miColor		*dst,
+	int		ty,
+	int		tx)
+{
+	miTile		*above = get_tile(ty-1, tx);
+	miTile		*here  = get_tile(ty,   tx);
+	miTile		*below = get_tile(ty+1, tx);
+	miTile		*src;
+	const miColor	*row[FILTER_SUPPORT];
+	miColor		sum[TILESUB];
+	miBoolean	nonblack = miFALSE;
+	int		i, ii, k;
+
+	if (!above && !here && !below)
+		return(miFALSE);
+
+	for (i=0; i < TILESUB; i++, dst += YBUF_XSIZE) {
+		for (k=0; k < FILTER_SUPPORT; k++) {
+			ii     = i - FILTER_R + 1 + k;
+			src    = ii < 0 ? above : ii < TILESUB ? here : below;
+			row[k] = src ? src->color[(ii + TILESUB) % TILESUB]
+				     : NULL;
 		}
+		convolve(sum, row);
+		if (clip_black(dst, sum, TILESUB))
+			nonblack = miTRUE;
 	}
-
-	/* Release local arrays */
-	mi_mem_release(pixels);
-	mi_mem_release(nearby_nonblack_pixel);
-	mi_mem_release(subpixels);
-	mi_debug("npixels2 = %i", npixels2);
+	return(nonblack);
 }
 
 
+/*
+ * Filter one tile of ybuf in x direction, starting at src, and average
+ * each pixel's 8x8 subpixels into the band at pixel row y, column x.
+ * The 32 subpixels around each one lie in the same row of ybuf.
+ */
+
 static void lanczos2_filter_x(
-	int		xmin,
-	int		ymin,
-	int		xmax,
-	int		ymax)
+	miColor		*band,
+	miColor		*src,
+	int		y,
+	int		x)
 {
-	register miColorDepth	*pixel, *subpixel;
-	register miColorDepth	**pixels, **subpixels;
-	register miColor	contourcolor, *color;
-	miColor		contourcolor2;
-	register	double weight;
-	register int	i,j, jj, j_min, j_max, i_pixel, j_pixel, idx_i, offset;
-	register int	j_subpixel;
-	int		xsize = xmax - xmin;	/* size of image region */
-	int		ysize = ymax - ymin;
-	int		hires_xsize = SUBXRES * xsize;	/* size of highres
-							   image region */
-	int		hires_ysize = SUBYRES * ysize;
-	miBoolean	*nearby_nonblack_pixel;
-
-	mi_debug("filtering in x direction using Lanczos_2 filter");
+	const miColor	*row[FILTER_SUPPORT];
+	miColor		sum[TILESUB];
+	miColor		line[TILESUB];
+	miColor		box[TILERES];	/* sums of the tile's pixels */
+	miColor		*pixel;
+	int		npixels = mi_MIN(TILERES, image_xsize - x);
+	int		i, j, k, p;
+
+	for (i=0; i < TILESUB; i++, src += YBUF_XSIZE) {
+		for (k=0; k < FILTER_SUPPORT; k++)
+			row[k] = src + k - FILTER_R + 1;
+		convolve(sum, row);
+		clip_black(line, sum, TILESUB);
+
+		/* Compute average over SUBXRES*SUBYRES (8x8) subpixels */
+		if (i % SUBYRES == 0)
+			memset(box, 0, sizeof(box));
+		for (j=0; j < TILESUB; j++) {
+			pixel = &box[j / SUBXRES];
+			pixel->r += line[j].r;
+			pixel->g += line[j].g;
+			pixel->b += line[j].b;
+			pixel->a += line[j].a;
+		}
+		if (i % SUBYRES != SUBYRES-1)
+			continue;
+
+		pixel = &band[(y + i/SUBYRES) * image_xsize + x];
+		for (p=0; p < npixels; p++, pixel++) {
+			pixel->r = box[p].r * (1.0 / (SUBXRES*SUBYRES));
+			pixel->g = box[p].g * (1.0 / (SUBXRES*SUBYRES));
+			pixel->b = box[p].b * (1.0 / (SUBXRES*SUBYRES));
+			pixel->a = box[p].a * (1.0 / (SUBXRES*SUBYRES));
+		}
+	}
+}
 
-	/* Local arrays --- released at the end of this procedure */
-	pixels = (miColorDepth **)
-			mi_mem_allocate(xsize * sizeof(miColorDepth *));
-	nearby_nonblack_pixel = (miBoolean *)
-			mi_mem_allocate(xsize * sizeof(miBoolean));
-	subpixels = (miColorDepth **)
-			mi_mem_allocate(hires_xsize * sizeof(miColorDepth *));
 
-	for (i=0; i < hires_ysize; i++) {
-		i_pixel = i/SUBYRES;
-		idx_i = (i % SUBYRES) * SUBXRES;
+/*
+ * Convolve TILESUB colors with the filter: sum[j] is the sum of
+ * filter_table[k] * row[k][j], leaving out black (NULL) rows. This is the
+ * inner loop of both filters; with SSE each color is one vector, and eight
+ * colors are summed at a time in registers.
+ */
 
-		/*
-		 * Compute array of pointers to pixels. This is faster
-		 * and simpler to look-up in than the original array
-		 */
-		if (i % SUBXRES == 0) {
-			for (j=0; j < xsize; j++)
-				pixels[j] = region_image2[i_pixel][j];
-			test_nearby_pixels(nearby_nonblack_pixel,pixels,xsize);
+static void convolve(
+	miColor		*sum,
+	const miColor	*row[])
+{
+	int		j, k;
+#ifdef SSE_INTRINSICS
+	__m128		w, s0, s1, s2, s3, s4, s5, s6, s7;
+	const float	*src;
+
+	for (j=0; j < TILESUB; j += 8) {
+		s0 = s1 = s2 = s3 = s4 = s5 = s6 = s7 = _mm_setzero_ps();
+		for (k=0; k < FILTER_SUPPORT; k++) {
+			if (!row[k])
+				continue;
+			src = &row[k][j].r;
+			w   = _mm_set1_ps(filter_table[k]);
+			s0  = _mm_add_ps(s0, _mm_mul_ps(w, _mm_loadu_ps(src)));
+			s1  = _mm_add_ps(s1, _mm_mul_ps(w, _mm_loadu_ps(src+4)));
+			s2  = _mm_add_ps(s2, _mm_mul_ps(w, _mm_loadu_ps(src+8)));
+			s3  = _mm_add_ps(s3, _mm_mul_ps(w, _mm_loadu_ps(src+12)));
+			s4  = _mm_add_ps(s4, _mm_mul_ps(w, _mm_loadu_ps(src+16)));
+			s5  = _mm_add_ps(s5, _mm_mul_ps(w, _mm_loadu_ps(src+20)));
+			s6  = _mm_add_ps(s6, _mm_mul_ps(w, _mm_loadu_ps(src+24)));
+			s7  = _mm_add_ps(s7, _mm_mul_ps(w, _mm_loadu_ps(src+28)));
 		}
-
-		/*
-		 * Compute array of Booleans, saying whether subpixels
-		 * are black
-		 */
-		for (j=jj=0; j < xsize; j++, jj += 8) {
-			pixel = pixels[j];
-			if (pixel) {
-				for (j_subpixel=0; j_subpixel < SUBXRES;
-								j_subpixel++) {
-					subpixel = &pixel[idx_i + j_subpixel];
-					color = &(subpixel->color);
-					subpixels[jj+j_subpixel] =
-						color->r > miEPS ||
-						color->g > miEPS ||
-				 		color->b > miEPS ||
-						color->a > miEPS ? subpixel :0;
-				}
-			}
+		_mm_storeu_ps(&sum[j  ].r, s0);
+		_mm_storeu_ps(&sum[j+1].r, s1);
+		_mm_storeu_ps(&sum[j+2].r, s2);
+		_mm_storeu_ps(&sum[j+3].r, s3);
+		_mm_storeu_ps(&sum[j+4].r, s4);
+		_mm_storeu_ps(&sum[j+5].r, s5);
+		_mm_storeu_ps(&sum[j+6].r, s6);
+		_mm_storeu_ps(&sum[j+7].r, s7);
+	}
+#else
+	float		weight;
+
+	memset(sum, 0, TILESUB * sizeof(miColor));
+	for (k=0; k < FILTER_SUPPORT; k++) {
+		if (!row[k])
+			continue;
+		weight = filter_table[k];
+		for (j=0; j < TILESUB; j++) {
+			sum[j].r += weight * row[k][j].r;
+			sum[j].g += weight * row[k][j].g;
+			sum[j].b += weight * row[k][j].b;
+			sum[j].a += weight * row[k][j].a;
 		}
+	}
+#endif
+}
 
-		/* Convolution */
-		for (j=0; j < hires_xsize; j++) {
-			j_pixel = j/SUBXRES;
-			offset  = -j+FILTER_R-1;
-
-			if (nearby_nonblack_pixel[j_pixel]) {
-				/* Convolute hires_image2 with filter in j
-				   direction (x dir) */
-				j_min = j - FILTER_R + 1;
-				if (j_min < 0)
-					j_min = 0;
-				j_max = j + FILTER_R;
-				if (j_max > hires_xsize - 1)
-					j_max = hires_xsize - 1;
-
-				contourcolor.r = contourcolor.g =
-				contourcolor.b = contourcolor.a = 0.0;
-
-				pixel = pixels[j_min>>3];
-				jj = j_min;
-				while (jj <= j_max) {
-					if (!(jj & 0x7))
-						pixel = pixels[jj>>3];
-					if (pixel) {
-						subpixel = subpixels[jj];
-						if (subpixel) {
-							color=&subpixel->color;
-							weight = filter_table[
-								    jj+offset];
-							contourcolor.r +=
-							     weight * color->r;
-							contourcolor.g +=
-							     weight * color->g;
-							contourcolor.b +=
-							     weight * color->b;
-							contourcolor.a +=
-							     weight * color->a;
-						}
-						jj++;
-					} else {
-						/* skip ahead to next pixel
-						   (8 subpixels or less) */
-						jj = (jj | 0x7) + 1;
-					}
-				}
 
-				/* Write result in region_image3[][] */
-				if (contourcolor.r > miEPS ||
-				    contourcolor.g > miEPS ||
-				    contourcolor.b > miEPS ||
-				    contourcolor.a > miEPS) {
-					/*
-					 * This assignment is necessary since
-					 * we want contourcolor to be register,
-					 * and then we cant pass a ptr to it
-					 */
-					contourcolor2 = contourcolor;
-					set_subpixel3(i_pixel, j_pixel, i%8,
-							j%8, &contourcolor2);
-				}
-			} else
-				/* skip ahead to next pixel (8 subpixels or
-				   less) */
-				j = (j | 0x7) + 1;
-		}
-	}
+/*
+ * Copy n colors, setting those that are black within miEPS to black.
+ * Returns whether any are non-black.
+ */
 
-	/* Release local arrays */
-	mi_mem_release(pixels);
-	mi_mem_release(nearby_nonblack_pixel);
-	mi_mem_release(subpixels);
-	mi_debug("npixels = %i", npixels);
+static miBoolean clip_black(
+	miColor		*dst,
+	const miColor	*src,
+	int		n)
+{
+	miBoolean	nonblack = miFALSE;
+
+	for (; n > 0; n--, dst++, src++)
+		if (src->r > miEPS || src->g > miEPS ||
+		    src->b > miEPS || src->a > miEPS) {
+			*dst = *src;
+			nonblack = miTRUE;
+		} else
+			dst->r = dst->g = dst->b = dst->a = 0.0;
+	return(nonblack);
 }
 
 
 /*
- * Compute average of 8x8 subpixels and composite over image
+ * Composite the filtered contour pixels of a band over image rows ymin
+ * to ymax
  */
 
-static void box_filter(
+static void composite_band(
 	miImg_image	*image,
-	int		xmin,
+	miColor		*band,
 	int		ymin,
-	int		xmax,
 	int		ymax)
 {
-	miColorDepth	*pixel;
 	miColor		contourcolor;
-	miColor		imagecolor, *subpixel_color;
+	miColor		imagecolor;
 	double		alpha;
-	int		xsize = xmax - xmin;
-	int		ysize = ymax - ymin;
-	int		i, j, k, l, idx;
-
-	mi_debug("box filter");
-	for (i=0; i < ysize; i++) {
-		for (j=0; j < xsize; j++) {
-			pixel = region_image3[i+OLAP][j+OLAP];
-			if (pixel == NULL)
-				continue;
+	int		x, y;
 
-			/* Compute average over SUBXRES*SUBYRES (8x8) subpix */
-			contourcolor.r = contourcolor.g =
-			contourcolor.b = contourcolor.a = 0.0;
-			idx = 0;
-			for (k=0; k < SUBXRES; k++)
-				for (l = 0; l < SUBYRES; l++, idx++) {
-					subpixel_color = &pixel[idx].color;
-					contourcolor.r += subpixel_color->r;
-					contourcolor.g += subpixel_color->g;
-					contourcolor.b += subpixel_color->b;
-					contourcolor.a += subpixel_color->a;
-				}
-			contourcolor.r *= 1.0 / (SUBXRES*SUBYRES);
-			contourcolor.g *= 1.0 / (SUBXRES*SUBYRES);
-			contourcolor.b *= 1.0 / (SUBXRES*SUBYRES);
-			contourcolor.a *= 1.0 / (SUBXRES*SUBYRES);
+	for (y=ymin; y < ymax; y++)
+		for (x=0; x < image_xsize; x++) {
+			contourcolor = band[(y-ymin) * image_xsize + x];
 
 			/*
 			 * Composite contour color with image color: contour
@@ -1308,8 +1287,7 @@ static void box_filter(
 			 * image with alpha 1.
 			 */
 			if (contourcolor.a > miEPS) {
-				mi_img_get_color(image, &imagecolor,
-							xmin+j, ymin+i);
+				mi_img_get_color(image, &imagecolor, x, y);
 				alpha = contourcolor.a;
 				contourcolor.r = contourcolor.r +
 						(1-alpha) * imagecolor.r;
@@ -1320,9 +1298,7 @@ static void box_filter(
 				contourcolor.a = contourcolor.a +
 						(1-alpha) * imagecolor.a;
 
-				mi_img_put_color(image, &contourcolor,
-							xmin+j, ymin+i);
+				mi_img_put_color(image, &contourcolor, x, y);
 			}
 		}
-	}
 }
@@ -0,0 +1,324 @@
+/*
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+*/
+
+/*
+ * Times cooking records with channelInfoSetData against a compiled
+ * channelCook. By default the channels and data are made up, in the
+ * style of rotTest.cfg and rotTest.txt; -c and -f replay real files.
+ */
+
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <windows.h>
+#define PATH_MAX _MAX_PATH
+#endif
+#include "channelParse.h"
+#include "pacer.h"
+
+#ifdef  LINUX
+#define GETOPTHUH '?'
+#endif  /* LINUX */
+
+#ifdef _WIN32
+char *   optarg = NULL;
+int	    optind = 1;
+int	    opterr = 0;
+int     optlast = 0;
+#define GETOPTHUH 0
+
+int getopt(int argc, char **argv, char *pargs)
+{
+	if (optind >= argc) return EOF;
+
+	if (optarg==NULL || optlast==':')
+	{
+		optarg = argv[optind];
+		if (*optarg!='-' && *optarg!='/')
+			return EOF;
+	}
+
+	if (*optarg=='-' || *optarg=='/') optarg++;
+	pargs = strchr(pargs, *optarg);
+	if (*optarg) optarg++;
+	if (*optarg=='\0')
+	{
+		optind++;
+		optarg = NULL;
+	}
+	if (pargs == NULL) return 0;  //error
+	if (*(pargs+1)==':')
+	{
+		if (optarg==NULL)
+		{
+			if (optind >= argc) return EOF;
+			// we want a second paramter
+			optarg = argv[optind];
+		}
+		optind++;
+	}
+	optlast = *(pargs+1);
+
+	return *pargs;
+}
+#endif
+
+int		gNumChannels = 1000;
+int		gNumRecords  = 100;
+int		gNumPasses   = 20;
+int		gShowUsage   = 0;
+char gProgramName[PATH_MAX] = { 0 };
+char gConfigPath[PATH_MAX] = { 0 };
+char gDataPath[PATH_MAX] = { 0 };
+
+void printUsage()
+{
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "    %s [-h] [-n channels] [-N records] [-p passes]\n",
+			gProgramName);
+    fprintf(stderr, "    %s [-h] [-p passes] -c config -f file\n",
+			gProgramName);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "        -h        Print this help message\n");
+	fprintf(stderr, "        -n        made up channels (default %d)\n",
+			gNumChannels);
+	fprintf(stderr, "        -N        made up records (default %d)\n",
+			gNumRecords);
+	fprintf(stderr, "        -p        times to replay the records (default %d)\n",
+			gNumPasses);
+	fprintf(stderr, "        -c config channel config file to use\n");
+	fprintf(stderr, "        -f file   data file to replay\n");
+    fprintf(stderr, "\n");
+
+    exit(1);
+}
+
+void parseArgs(int argc, char **argv)
+{
+	int opt;
+	char *cptr;
+
+	/*
+	 * Grab a copy of the program name
+	 */
+#ifdef _WIN32
+		_splitpath (argv[0], NULL, NULL, gProgramName, NULL);
+#else
+	cptr = strrchr(argv[0], '/');
+	if (cptr)
+	{
+		strcpy(gProgramName, (cptr + 1));
+	}
+	else
+	{
+		strcpy(gProgramName, argv[0]);
+	}
+#endif
+
+	while ((opt = getopt(argc, argv, "hn:N:p:c:f:")) != -1) {
+		switch (opt) {
+		case 'h':
+			gShowUsage++;
+			break;
+		case 'n' :
+			gNumChannels = atoi(optarg);
+			break;
+		case 'N' :
+			gNumRecords = atoi(optarg);
+			break;
+		case 'p' :
+			gNumPasses = atoi(optarg);
+			break;
+		case 'c' :
+			strcpy(gConfigPath, optarg);
+			break;
+		case 'f' :
+			strcpy(gDataPath, optarg);
+			break;
+		case GETOPTHUH:
+		default :
+			gShowUsage++;
+		}
+	}
+
+	if ( gNumChannels < 1 || gNumRecords < 1 || gNumPasses < 1 )
+		gShowUsage++;
+
+	if ( !gConfigPath[0] != !gDataPath[0] )
+		gShowUsage++;
+
+	if (gShowUsage)
+		printUsage();
+}
+
+/*
+ * A config of gNumChannels channels, cycling through the channel types
+ * and rotation orders that need cooking.
+ */
+static FILE *makeConfig()
+{
+	static const char *types[] = { "PR", "ROT", "POS", "RX", "PQ", "SXYZ" };
+	static const char *orders[] = { "XYZ", "ZXY", "YZX" };
+	FILE *config = tmpfile();
+	int i;
+
+	if ( NULL == config )
+		return NULL;
+
+	fprintf(config, "BEGIN_CHANNEL_INFO\n");
+	fprintf(config, "UNIT DEG\n");
+	fprintf(config, "UNIT CM\n");
+	fprintf(config, "OFFSETPOS 1 2 3\n");
+	fprintf(config, "SCALEROT 1 -1 1\n");
+	for ( i = 0; i < gNumChannels; i++ ) {
+		if ( i % 100 == 0 )
+			fprintf(config, "ROTORDER %s\n", orders[(i / 100) % 3]);
+		fprintf(config, "%s c%d\n", types[i % 6], i);
+	}
+	fprintf(config, "END_CHANNEL_INFO\n");
+
+	rewind(config);
+	return config;
+}
+
+/*
+ * Records that turn every column a little each frame, like rotTest.txt.
+ */
+static float *makeData(int numCols)
+{
+	float *data = (float *)malloc(sizeof(float) * numCols * gNumRecords);
+	int r, c;
+
+	if ( NULL == data )
+		return NULL;
+
+	for ( r = 0; r < gNumRecords; r++ )
+		for ( c = 0; c < numCols; c++ )
+			data[r * numCols + c] = (float)((r * 10 + c * 7) % 360);
+
+	return data;
+}
+
+/*
+ * Read whitespace separated records of numCols values.
+ */
+static float *readData(FILE *file, int numCols)
+{
+	int size = 0;
+	int count = 0;
+	float *data = NULL;
+	float val;
+
+	while ( 1 == fscanf(file, "%g", &val) ) {
+		if ( count == size ) {
+			float *grown;
+			size = size ? 2 * size : 1024;
+			grown = (float *)realloc(data, sizeof(float) * size);
+			if ( NULL == grown ) {
+				free(data);
+				return NULL;
+			}
+			data = grown;
+		}
+		data[count++] = val;
+	}
+
+	gNumRecords = count / numCols;
+	if ( gNumRecords < 1 ) {
+		free(data);
+		return NULL;
+	}
+	return data;
+}
+
+int main( int argc, char *argv[] )
+{
+	FILE *config;
+	channelInfo *head;
+	channelCook *cook;
+	float *data;
+	double start, listTime, cookTime;
+	double samples;
+	int pass, r;
+
+	parseArgs( argc, argv);
+
+	if ( gConfigPath[0] )
+		config = fopen(gConfigPath, "r");
+	else
+		config = makeConfig();
+	if ( NULL == config ) {
+		fprintf(stderr, "%s: could not open the config file\n",
+				gProgramName);
+		exit(1);
+	}
+
+	head = channelInfoCreate(config, 1, NULL);
+	fclose(config);
+	cook = channelCookCreate(head);
+	if ( NULL == head || NULL == cook ) {
+		fprintf(stderr, "%s: no channels\n", gProgramName);
+		exit(1);
+	}
+
+	if ( gDataPath[0] ) {
+		FILE *file = fopen(gDataPath, "r");
+		if ( NULL == file ) {
+			fprintf(stderr, "%s: could not open file %s\n",
+					gProgramName, gDataPath);
+			exit(1);
+		}
+		data = readData(file, cook->numCols);
+		fclose(file);
+	} else
+		data = makeData(cook->numCols);
+	if ( NULL == data ) {
+		fprintf(stderr, "%s: no data\n", gProgramName);
+		exit(1);
+	}
+
+	/* one pass of each to warm up, then the timed passes */
+	for ( r = 0; r < gNumRecords; r++ ) {
+		channelInfoSetData(head, 1, data + r * cook->numCols);
+		channelCookSetData(cook, data + r * cook->numCols);
+	}
+
+	start = pacerNow();
+	for ( pass = 0; pass < gNumPasses; pass++ )
+		for ( r = 0; r < gNumRecords; r++ )
+			channelInfoSetData(head, 1, data + r * cook->numCols);
+	listTime = pacerNow() - start;
+
+	start = pacerNow();
+	for ( pass = 0; pass < gNumPasses; pass++ )
+		for ( r = 0; r < gNumRecords; r++ )
+			channelCookSetData(cook, data + r * cook->numCols);
+	cookTime = pacerNow() - start;
+
+	samples = (double)gNumPasses * gNumRecords * cook->numOps;
+	printf("%d channels, %d columns, %d records x %d passes\n",
+		   cook->numOps, cook->numCols, gNumRecords, gNumPasses);
+	printf("    channelInfoSetData  %8.1f ns/channel\n",
+		   1e9 * listTime / samples);
+	printf("    channelCookSetData  %8.1f ns/channel  (%.2fx)\n",
+		   1e9 * cookTime / samples,
+		   cookTime > 0. ? listTime / cookTime : 0.);
+
+	channelCookDestroy(cook);
+	free(data);
+	return 0;
+}
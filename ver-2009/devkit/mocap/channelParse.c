@@ -12,6 +12,8 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #ifndef _WIN32
 #include <strings.h>
@@ -441,7 +443,7 @@ void channelInfoRot2Quat(float *cooked, CapRotationOrder order )
 	float y = cooked[1];
 	float z = cooked[2];
 	CapEuler2Quat(order, x, y, z, cooked );
-#if 1 /* TEST CODE */
+#if 0 /* TEST CODE */
 	CapQuat2Euler(order, cooked,
 		   &x, &y, &z);
 #endif
@@ -511,3 +513,161 @@ void channelInfoSetData(channelInfo *chan, int follow, float *rawData)
 
 	}
 }
+
+static void channelCookFactors(channelCook *cook, channelInfo *chan,
+							   int col, int dim, int typ, int off)
+/* Description:
+ *	the flat equivalent of channelInfoCookData
+ */
+{
+	int i;
+	for (i=0; i < dim; i++) {
+		cook->offset[col+i] = chan->factors[kOffset][typ][i+off];
+		cook->scale [col+i] = chan->factors[kMult  ][typ][i+off];
+	}
+}
+
+static void channelCookCopy(channelCook *cook, int col, int dim)
+/* Description:
+ *	columns that are passed through as they are. Adding -0. leaves every
+ *	value, including -0., unchanged.
+ */
+{
+	int i;
+	for (i=0; i < dim; i++) {
+		cook->offset[col+i] = -0.f;
+		cook->scale [col+i] = 1.f;
+	}
+}
+
+channelCook *channelCookCreate(channelInfo *head)
+/* Description:
+ *	Compile the channel list "head" for channelCookSetData. The list must
+ *	not be changed while the result is in use.
+ */
+{
+	channelCook *cook;
+	channelInfo *chan;
+	int numQuats = 0;
+	int op;
+
+	cook = (channelCook *)calloc(1, sizeof(channelCook));
+	if ( NULL == cook ) {
+		channelInfoErr(kBadAlloc, "channelCookCreate");
+		return NULL;
+	}
+
+	for ( chan = head; chan != NULL; chan = chan->next ) {
+		cook->numCols += chan->info->p1.dim;
+		cook->numOps++;
+	}
+
+	cook->offset = (float *)malloc(sizeof(float) * (cook->numCols + 1));
+	cook->scale  = (float *)malloc(sizeof(float) * (cook->numCols + 1));
+	cook->cooked = (float *)malloc(sizeof(float) * (cook->numCols + 1));
+	cook->ops    = (channelCookOp *)malloc(sizeof(channelCookOp) *
+										   (cook->numOps + 1));
+	cook->quats  = (float *)malloc(sizeof(float) * 7 * (cook->numOps + 1));
+	if ( NULL == cook->offset || NULL == cook->scale || 
+		 NULL == cook->cooked || NULL == cook->ops || NULL == cook->quats ) {
+		channelInfoErr(kBadAlloc, "channelCookCreate");
+		channelCookDestroy(cook);
+		return NULL;
+	}
+
+	for ( chan = head, op = 0; chan != NULL; chan = chan->next, op++ ) {
+		channelCookOp *o = &cook->ops[op];
+		const int dim = chan->info->p1.dim;
+		const int typ = chan->info->typeOffset;
+		const int off = chan->info->p3.axisOffset;
+		const int col = chan->startingCol;
+		int rotate = 0;
+
+		o->chan     = chan->chan;
+		o->rawCol   = col;
+		o->posDim   = 0;
+		o->rotOrder = chan->rotOrder;
+
+		if ( dim < 4 ) {
+			if ( typ < 0 || off < 0 )
+				channelCookCopy(cook, col, dim);
+			else
+				channelCookFactors(cook, chan, col, dim, typ, off);
+			rotate = ( 1 == chan->info->p2.extra );
+		} else if ( dim == 4 ) {
+			channelCookCopy(cook, col, dim);
+		} else if ( dim == 6 ) {
+			/* position & rotation */
+			channelCookFactors(cook, chan, col,     3, kPosition, 0);
+			channelCookFactors(cook, chan, col + 3, 3, kRotation, 0);
+			o->posDim = 3;
+			rotate = 1;
+		} else if ( dim == 7 ) {
+			/* position & quaternion */
+			channelCookFactors(cook, chan, col, 3, kPosition, 0);
+			channelCookCopy(cook, col + 3, 4);
+		} else {
+			channelInfoErr(kUnknownDimSize,kGreaterThan7);
+			channelCookDestroy(cook);
+			return NULL;
+		}
+
+		if ( rotate ) {
+			o->quatCol = numQuats;
+			numQuats += 7;
+		} else
+			o->quatCol = -1;
+	}
+
+	return cook;
+}
+
+void channelCookSetData(channelCook *cook, const float *rawData)
+/* Description:
+ *	Cook one record of raw data, in the column order of the channel list
+ *	the cook was created from, and set it in every channel. This gives
+ *	the same values as channelInfoSetData(head, 1, rawData).
+ */
+{
+	const float *offset = cook->offset;
+	const float *scale  = cook->scale;
+	float *cooked = cook->cooked;
+	const int n = cook->numCols;
+	int i;
+
+	/*
+	 * one fused offset and scale for all of the columns; the loop has
+	 * no dependencies between iterations, so the compiler vectorizes it
+	 */
+	for (i=0; i < n; i++)
+		cooked[i] = ( rawData[i] + offset[i] ) * scale[i];
+
+	for (i=0; i < cook->numOps; i++) {
+		const channelCookOp *o = &cook->ops[i];
+		const float *src = cooked + o->rawCol;
+
+		if ( o->quatCol < 0 ) {
+			CapSetData(o->chan, (void *)src);
+		} else {
+			float *out = cook->quats + o->quatCol;
+			int k;
+			for (k=0; k < o->posDim; k++)
+				out[k] = src[k];
+			CapEuler2Quat(o->rotOrder, src[o->posDim], src[o->posDim+1],
+						  src[o->posDim+2], out + o->posDim);
+			CapSetData(o->chan, out);
+		}
+	}
+}
+
+void channelCookDestroy(channelCook *cook)
+{
+	if ( NULL == cook )
+		return;
+	free(cook->offset);
+	free(cook->scale);
+	free(cook->cooked);
+	free(cook->ops);
+	free(cook->quats);
+	free(cook);
+}
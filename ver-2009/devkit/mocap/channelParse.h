@@ -100,7 +100,34 @@ typedef struct channelInfo {
 	struct channelInfo *next;
 } channelInfo;
 
+/*
+ * A channel list compiled for cooking. The offset and scale of every raw
+ * column are flattened into arrays, so one pass over a record cooks all
+ * of the channels; only the Euler rotations need per channel work.
+ */
+typedef struct channelCookOp {
+	CapChannel       chan;
+	int              rawCol;	/* first raw column of the channel */
+	int              quatCol;	/* offset in quats[], or -1 if no rotation */
+	int              posDim;	/* columns before the rotation */
+	CapRotationOrder rotOrder;
+} channelCookOp;
+
+typedef struct channelCook {
+	int              numCols;
+	float            *offset;	/* numCols: added to the raw value */
+	float            *scale;	/* numCols: then multiplied by this */
+	float            *cooked;	/* numCols */
+	int              numOps;
+	channelCookOp    *ops;		/* one per channel */
+	float            *quats;	/* 7 per op with a rotation */
+} channelCook;
+
 void channelInfoSetData(channelInfo *chan, int follow, float *rawData);
 channelInfo *channelInfoCreate(FILE *configFile, 
 							   int lookForBegin,
 							   channelInfo *head);
+
+channelCook *channelCookCreate(channelInfo *head);
+void channelCookSetData(channelCook *cook, const float *rawData);
+void channelCookDestroy(channelCook *cook);
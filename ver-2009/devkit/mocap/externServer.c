@@ -38,7 +38,16 @@
 #include <bstring.h>
 #endif
 #include <fcntl.h>
+#ifdef LINUX
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#endif
 #include "channelParse.h"
+#include "pacer.h"
 
 #ifndef FALSE
 #	define FALSE 0
@@ -135,26 +144,81 @@ static int gDebugMode  = 0;
 static int gReadReopen = FALSE;
 static int gReadRewind = FALSE;
 static int gReadNext   = FALSE;
+static int gReadBinary = FALSE;
+static int gReportLatency = FALSE;
 static int gBufferSize = 4096;
 static float	gMinRecordRate = 1.;
 static float	gMaxRecordRate = 300.;
 static float	gDefRecordRate = 60.;
 
 static channelInfo *gChannels = NULL;
+static channelCook *gCook = NULL;
 static char gProgramName[PATH_MAX] = { 0 };
 static char gConfigFile[PATH_MAX]  = { 0 };
 static char gServerName[PATH_MAX]  = { 0 };
 static char gDataPath[PATH_MAX]    = { 0 };
-static FILE *gDataFile = NULL;
-static char *gBuffers[2] = { NULL, NULL };
-static int  gReadBuffer	 = 0;
-static int  gBufferOffset= 0;
+
+/*
+ * The data file. Pipes and FIFOs are read as data arrives (on Linux);
+ * regular files are read when a sample is needed, as before.
+ */
+static int  gDataFd      = -1;
+static int  gDataIsFile  = FALSE;
+static char *gReadBuffer = NULL;	/* -b bytes of unparsed input */
+static int  gReadLength  = 0;
+
+/*
+ * Parsed samples. Every record read from the data file is parsed once
+ * into the ring, and all clients are sent samples from it. With -N each
+ * client is sent the samples in order, otherwise the newest one.
+ */
+#define RING_SIZE	64
+
+typedef struct sample {
+	unsigned long	sequence;	/* 1, 2, ... 0 is an empty slot */
+	double			stamp;		/* monotonic time the record was read */
+	float			*values;	/* gNumColumns values */
+} sample;
+
+static sample	gRing[RING_SIZE];
+static unsigned long gNewest = 0;	/* sequence of the newest sample */
+static int		gNumColumns  = 0;
+static unsigned long gChannelSequence = 0;	/* the sample in gChannels */
+
+/*
+ * Connected clients.
+ */
+#define MAX_CLIENTS	32
+
+typedef struct serverClient {
+	int				fd;
+	unsigned long	lastSequence;	/* last sample sent (for -N) */
+	unsigned long	sent;			/* latency statistics */
+	double			latencySum;
+	double			latencyMax;
+	double			reportNext;
+} serverClient;
+
+static serverClient gClients[MAX_CLIENTS];
+static serverClient *gRecordingClient = NULL;
+static double	gRecordNext   = 0.;
+static double	gRecordPeriod = 0.;
+
 static void parseArgs(int argc, char **argv);
 static void printUsage();
 static void nonBlockFifo(int client_fd);
-static int handle_client(int client_fd);
+static int open_data(int client_fd);
+static int read_data(int client_fd, int maxRecords);
 static void get_data(int client_fd);
+static int send_data(serverClient *client);
+static int client_command(serverClient *client);
+static void report_latency(serverClient *client, int force);
 static channelInfo * create_channels(char *config, int client_fd);
+#ifdef LINUX
+static int serve_clients(int inetd_fd);
+#else
+static int handle_client(int client_fd);
+#endif
 
 
 double toDouble(const struct timeval t) {
@@ -171,12 +235,12 @@ struct timeval	toTimeval(double sec)
 	return tim;
 }
 
-
 int main(int argc, char **argv)
 {
 
 	int status;
 	int client_fd = -1;
+	int i;
 
 	/*
 	 * on err, this exits...
@@ -187,15 +251,14 @@ int main(int argc, char **argv)
 	/*
 	 * Initialization...
 	 */
-	gBuffers[0] = malloc(gBufferSize);
-	gBuffers[1] = malloc(gBufferSize);
-	if ( ( NULL == gBuffers[0] ) || ( NULL == gBuffers[1] ) ) {
+	gReadBuffer = malloc(gBufferSize);
+	if ( NULL == gReadBuffer ) {
 		CapError(-1, CAP_SEV_FATAL, gProgramName, 
 				 "out of memory, -b %d failed",gBufferSize);
 		exit(1);
 	}
-	*(gBuffers[0]) = '\0';
-	*(gBuffers[1]) = '\0';
+	for ( i = 0; i < MAX_CLIENTS; i++ )
+		gClients[i].fd = -1;
 
 
 	if (gInetdMode) {
@@ -228,22 +291,53 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
-	if ( 0 == strcmp(gDataPath,"-") ) {
-		gDataFile = stdin;
-	} else {
-		/*
-		 * RFE: delay opening until first read
-		 */
-		gDataFile = fopen(gDataPath, "r");
-		if ( !gReadReopen && (NULL == gDataFile) ) {
-			CapError(-1, CAP_SEV_FATAL, gProgramName, NULL);
+	/*
+	 * compile the channels for cooking; one sample holds the raw columns
+	 * of every channel
+	 */
+	gCook = channelCookCreate(gChannels);
+	if ( NULL == gCook ) {
+		CapError(-1, CAP_SEV_FATAL, gProgramName, "Bad config file");
+		exit(1);
+	}
+	gNumColumns = gCook->numCols;
+	for ( i = 0; i < RING_SIZE; i++ ) {
+		gRing[i].sequence = 0;
+		gRing[i].values = calloc(gNumColumns + 1, sizeof(float));
+		if ( NULL == gRing[i].values ) {
+			CapError(-1, CAP_SEV_FATAL, gProgramName, "out of memory");
 			exit(1);
 		}
 	}
+	/* read_data keeps a byte free for parse_record's terminator */
+	if ( gReadBinary && gBufferSize <= gNumColumns * (int)sizeof(float) ) {
+		CapError(-1, CAP_SEV_FATAL, gProgramName, 
+				 "-b %d must be larger than a binary record (%d bytes)",
+				 gBufferSize, gNumColumns * (int)sizeof(float));
+		exit(1);
+	}
 
-	if ( NULL != gDataFile ) 
-		nonBlockFifo(-1);
+	/*
+	 * RFE: delay opening until first read
+	 */
+	if ( open_data(client_fd) < 0 && !gReadReopen ) {
+		CapError(-1, CAP_SEV_FATAL, gProgramName, NULL);
+		exit(1);
+	}
 			
+#ifdef LINUX
+	/*
+	 * Serve any number of clients (or the one inetd client) until the
+	 * inetd client quits.
+	 */
+	status = serve_clients(gInetdMode ? client_fd : -1);
+	if (status < 0)
+	{
+		CapError(-1, CAP_SEV_FATAL, gProgramName, NULL);
+		exit(1);
+	}
+	exit(0);
+#else
 	if (gInetdMode)
 	{
 		/*
@@ -283,52 +377,285 @@ int main(int argc, char **argv)
 			continue;
 		}
 	}
+#endif
 }
 
+#ifdef LINUX
+
+/*
+ * Create the listening socket for a server name, which like CapServe
+ * is either <host>:<port> (the host is ignored) or a path for a Unix
+ * socket, relative to /tmp/ if it does not start with a '/'.
+ */
+static int create_listener(char *name)
+{
+	int fd;
+	int on = 1;
+	char *colon = strchr(name, ':');
+
+	if (colon != NULL) {
+		struct sockaddr_in addr;
+		struct servent *service;
+		int port = atoi(colon + 1);
+
+		if ( port <= 0 ) {
+			service = getservbyname(colon + 1, "tcp");
+			if ( NULL == service ) {
+				errno = EINVAL;
+				return -1;
+			}
+			port = ntohs(service->s_port);
+		}
+
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(port);
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			close(fd);
+			return -1;
+		}
+	} else {
+		struct sockaddr_un addr;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (name[0] == '/')
+			snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", name);
+		else
+			snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/%s", name);
+		unlink(addr.sun_path);
+
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			close(fd);
+			return -1;
+		}
+	}
+
+	if (listen(fd, MAX_CLIENTS) < 0) {
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	return fd;
+}
+
+static serverClient *add_client(int epoll_fd, int fd)
+{
+	struct epoll_event event;
+	int i;
+
+	for ( i = 0; i < MAX_CLIENTS; i++ ) {
+		if ( gClients[i].fd < 0 ) {
+			memset(&gClients[i], 0, sizeof(serverClient));
+			gClients[i].fd = fd;
+			gClients[i].lastSequence = gNewest;
+			gClients[i].reportNext = pacerNow() + 1.;
+
+			memset(&event, 0, sizeof(event));
+			event.events = EPOLLIN;
+			event.data.ptr = &gClients[i];
+			if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+				gClients[i].fd = -1;
+				return NULL;
+			}
+			return &gClients[i];
+		}
+	}
+	return NULL;
+}
+
+static void remove_client(int epoll_fd, serverClient *client)
+{
+	report_latency(client, TRUE);
+	if ( client == gRecordingClient )
+		gRecordingClient = NULL;
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+	closesocket(client->fd);
+	client->fd = -1;
+}
+
+/*
+ * Arm the record timer for the next sample of the recording client, or
+ * disarm it.
+ */
+static void set_record_timer(int timer_fd)
+{
+	struct itimerspec when;
+
+	memset(&when, 0, sizeof(when));
+	if ( NULL != gRecordingClient ) {
+		when.it_value.tv_sec  = (time_t)gRecordNext;
+		when.it_value.tv_nsec = (long)((gRecordNext - 
+										(double)when.it_value.tv_sec) * 1e9);
+		if ( 0 == when.it_value.tv_sec && 0 == when.it_value.tv_nsec )
+			when.it_value.tv_nsec = 1;
+	}
+	timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &when, NULL);
+}
+
+/*
+ * The server loop. The listening socket, the clients, the data file
+ * (when it is a pipe or FIFO) and the record timer are all waited on
+ * with one epoll set, so no client waits on another's sample rate.
+ */
+static int serve_clients(int inetd_fd)
+{
+	/* tags for the descriptors that are not clients */
+	static int listenTag, dataTag, timerTag;
+	struct epoll_event event, events[MAX_CLIENTS + 3];
+	int epoll_fd, listen_fd = -1, timer_fd;
+	int n, i;
+
+	/* a client that goes away must not take the others with it */
+	signal(SIGPIPE, SIG_IGN);
+
+	epoll_fd = epoll_create(MAX_CLIENTS + 3);
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (epoll_fd < 0 || timer_fd < 0)
+		return -1;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = &timerTag;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+
+	if ( gDataFd >= 0 && !gDataIsFile && !gReadReopen ) {
+		event.data.ptr = &dataTag;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, gDataFd, &event);
+	}
+
+	if ( inetd_fd >= 0 ) {
+		if ( NULL == add_client(epoll_fd, inetd_fd) )
+			return -1;
+	} else {
+		listen_fd = create_listener(gServerName);
+		if (listen_fd < 0)
+			return -1;
+		event.data.ptr = &listenTag;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+	}
+
+	while (1)
+	{
+		n = epoll_wait(epoll_fd, events, lengthof(events), 
+					   gReportLatency ? 1000 : -1);
+		if (n < 0) {
+			if (errno == EINTR) {
+				/* Ignore signals and try again */
+				continue;
+			}
+
+			/* Otherwise, give a fatal error message */
+			CapError(-1, CAP_SEV_FATAL, gProgramName, "epoll_wait failed");
+			CapError(-1, CAP_SEV_FATAL, "epoll_wait", NULL);
+			exit(1);
+		}
+
+		for ( i = 0; i < n; i++ ) {
+			void *tag = events[i].data.ptr;
+
+			if ( tag == &listenTag ) {
+				int fd = accept(listen_fd, NULL, NULL);
+				if ( fd >= 0 && NULL == add_client(epoll_fd, fd) ) {
+					CapError(-1, CAP_SEV_WARNING, gProgramName,
+							 "too many clients, connection refused");
+					closesocket(fd);
+				}
+			} else if ( tag == &dataTag ) {
+				/* parse everything the pipe has for us */
+				if ( read_data(-1, 0) < 0 ) {
+					/* the writer has gone: wait for the next one, but
+					 * there is no more to come on stdin */
+					epoll_ctl(epoll_fd, EPOLL_CTL_DEL, gDataFd, NULL);
+					if ( 0 == gDataFd ) {
+						gDataFd = -1;
+					} else if ( open_data(-1) >= 0 && !gDataIsFile ) {
+						event.events = EPOLLIN;
+						event.data.ptr = &dataTag;
+						epoll_ctl(epoll_fd, EPOLL_CTL_ADD, gDataFd, &event);
+					}
+				}
+			} else if ( tag == &timerTag ) {
+				unsigned long long expirations;
+				double now = pacerNow();
+
+				read(timer_fd, &expirations, sizeof(expirations));
+				if ( NULL != gRecordingClient ) {
+					/* record and schedule the next recording */
+					while ( gRecordNext <= now ) {
+						get_data(gRecordingClient->fd);
+						gRecordNext += gRecordPeriod;
+					}
+					set_record_timer(timer_fd);
+				}
+			} else {
+				serverClient *client = (serverClient *)tag;
+				int wasRecording = (client == gRecordingClient);
+				int status = client_command(client);
+
+				if ( status != 0 ) {
+					int quitting = (inetd_fd >= 0 && client->fd == inetd_fd);
+					remove_client(epoll_fd, client);
+					if ( quitting )
+						return status < 0 ? -1 : 0;
+				}
+				if ( wasRecording != (client == gRecordingClient) )
+					set_record_timer(timer_fd);
+			}
+		}
+
+		if ( gReportLatency ) {
+			for ( i = 0; i < MAX_CLIENTS; i++ )
+				if ( gClients[i].fd >= 0 )
+					report_latency(&gClients[i], FALSE);
+		}
+	}
+}
+
+#else /* LINUX */
+
 static int handle_client(int client_fd)
 {
 	int status;
-	size_t size, nitems;
-	FILE *serial_file;
-	char buf[1024];	/* buffer for serial IO */
-	CapCommand cmd;
-	char ruser[64], rhost[64], realhost[64];
-	double rate, time;
 	fd_set rd_fds;
-	struct timeval timeout, now, *timeoutPtr;
-	int    recording = 0;
-	double recordNow    = 0.;
-	double recordNext   = 0.;
-	double recordPeriod = 0.;
-	double recordDelta  = 0.;
+	struct timeval timeout, *timeoutPtr;
+	serverClient *client = &gClients[0];
+	double recordNow;
 #ifdef _WIN32
 	int ms;
 #endif
 
+	memset(client, 0, sizeof(serverClient));
+	client->fd = client_fd;
+	client->lastSequence = gNewest;
+	client->reportNext = pacerNow() + 1.;
+
 	while (1)
 	{
 		FD_ZERO(&rd_fds);
 		FD_SET(client_fd, &rd_fds);
 
-		if ( !recording ) {
+		if ( NULL == gRecordingClient ) {
 			timeoutPtr = NULL;
 		} else {
 			/* record and schedule the next recording */
-#ifdef LINUX
-			gettimeofday(&now, NULL);
-#else
-			gettimeofday(&now);
-#endif
-			recordNow   = toDouble(now);
-			if ( recordNext == 0.0 ) /* The first record */
-				recordNext = recordNow;
-
-			while ( recordNext <= recordNow ) {
+			recordNow = pacerNow();
+			while ( gRecordNext <= recordNow ) {
 				get_data(client_fd);
-				recordNext = recordNext + recordPeriod;
+				gRecordNext = gRecordNext + gRecordPeriod;
 			}
 			
-			timeout = toTimeval( recordNext - recordNow );
+			timeout = toTimeval( gRecordNext - recordNow );
 			timeoutPtr = &timeout;
 		}
 
@@ -363,182 +690,416 @@ static int handle_client(int client_fd)
 		}
 
 		/* There is data on the client file descriptor */
-		cmd = CapGetCommand(client_fd);
-		switch (cmd) {
-		case CAP_CMD_QUIT:
-			return 0;
+		status = client_command(client);
+		if ( gReportLatency )
+			report_latency(client, status != 0);
+		if (status != 0)
+		{
+			gRecordingClient = NULL;
+			return status < 0 ? -1 : 0;
+		}
+	}
 
-		case CAP_CMD_AUTHORIZE:
-			status = CapGetAuthInfo(client_fd, ruser, rhost, realhost);
-			if (status < 0)
-			{
-				return -1;
-			}
+	/* return 0; */
+}
 
-			/*
-			 * If user@host is not authorized to use this server then:
-			 *
-			 * status = CapAuthorize(client_fd, 0);
-			 */
-			status = CapAuthorize(client_fd, 1);
-			break;
+#endif /* LINUX */
 
-		case CAP_CMD_INIT:	/* Initial client/server handshake */
-			status = CapInitialize(client_fd, gProgramName);
-			break;
+/*
+ * Read and answer one command from a client.
+ *
+ * Returns 0 to keep serving the client, 1 when it has quit and -1 on an
+ * error.
+ */
+static int client_command(serverClient *client)
+{
+	int client_fd = client->fd;
+	int status;
+	size_t size;
+	CapCommand cmd;
+	char ruser[64], rhost[64], realhost[64];
+	double rate;
 
-		case CAP_CMD_VERSION:	/* Send version information */
-			status = CapVersion(client_fd, gProgramName, "1.0",
-								"Extern server (example) - v1.0");
-			break;
+	cmd = CapGetCommand(client_fd);
+	switch (cmd) {
+	case CAP_CMD_QUIT:
+		return 1;
 
-		case CAP_CMD_INFO:
-			if (NULL == gChannels)
-			{
-				/* Only create the channel data once */
-				gChannels = create_channels(gConfigFile, client_fd);
-				if ( NULL == gChannels)
-				{
-					status = CapError(client_fd, CAP_SEV_ERROR, 
-									  gProgramName,
-									  "Missing or empty config file");  
-				}
-			}
-			/* Return the recording information. gMaxRecordRate <= 0.
-			 * says recording is not supported
-			 */
-			{
-				size_t buf_size = 0;
-				if ( 0. < gMaxRecordRate) 
-					buf_size = INT_MAX;
-				status = CapInfo(client_fd, gMinRecordRate, 
-								 gMaxRecordRate, gDefRecordRate, 
-								 buf_size, 1);
-			}
-			break;
-	  
-		case CAP_CMD_DATA:	/* Send frame data */
-			if (!recording )
-				get_data(client_fd);
-			status = CapData(client_fd);
-			break;
+	case CAP_CMD_ERROR:	/* The client has gone away */
+		return -1;
 
+	case CAP_CMD_AUTHORIZE:
+		status = CapGetAuthInfo(client_fd, ruser, rhost, realhost);
+		if (status < 0)
+		{
+			return -1;
+		}
 
-		case CAP_CMD_START_RECORD:	/* Start recording */
-			rate = CapGetRequestedRecordRate(client_fd);
-			size = CapGetRequestedRecordSize(client_fd);
+		/*
+		 * If user@host is not authorized to use this server then:
+		 *
+		 * status = CapAuthorize(client_fd, 0);
+		 */
+		status = CapAuthorize(client_fd, 1);
+		break;
 
-			/* 
-			 * Set up for recording operations
-			 */
-			if (rate < gMinRecordRate ) 
-				rate = gMinRecordRate;
-			else if (rate > gMaxRecordRate ) 
-				rate = gMaxRecordRate;
+	case CAP_CMD_INIT:	/* Initial client/server handshake */
+		status = CapInitialize(client_fd, gProgramName);
+		break;
 
-			status = CapStartRecord(client_fd, rate, size);
-			if (status != -1)
+	case CAP_CMD_VERSION:	/* Send version information */
+		status = CapVersion(client_fd, gProgramName, "1.0",
+							"Extern server (example) - v1.0");
+		break;
+
+	case CAP_CMD_INFO:
+		if (NULL == gChannels)
+		{
+			/* Only create the channel data once */
+			gChannels = create_channels(gConfigFile, client_fd);
+			if ( NULL == gChannels)
 			{
-				recordPeriod = 1.0 / rate;
-				recordNext   = 0.;
-				recording = 1;
+				status = CapError(client_fd, CAP_SEV_ERROR, 
+								  gProgramName,
+								  "Missing or empty config file");  
 			}
-			break;
+		}
+		/* Return the recording information. gMaxRecordRate <= 0.
+		 * says recording is not supported
+		 */
+		{
+			size_t buf_size = 0;
+			if ( 0. < gMaxRecordRate) 
+				buf_size = INT_MAX;
+			status = CapInfo(client_fd, gMinRecordRate, 
+							 gMaxRecordRate, gDefRecordRate, 
+							 buf_size, 1);
+		}
+		break;
+  
+	case CAP_CMD_DATA:	/* Send frame data */
+		status = send_data(client);
+		break;
 
-		case CAP_CMD_STOP_RECORD:		/* Stop recording */
-			status = CapStopRecord(client_fd);
-			recording = 0;
-			break;
 
-		default:			/* Ignore unknown commands */
+	case CAP_CMD_START_RECORD:	/* Start recording */
+		rate = CapGetRequestedRecordRate(client_fd);
+		size = CapGetRequestedRecordSize(client_fd);
+
+		/*
+		 * The channel data is shared, so only one client records at
+		 * a time.
+		 */
+		if ( NULL != gRecordingClient && client != gRecordingClient ) {
 			status = CapError(client_fd, CAP_SEV_ERROR, gProgramName,
-							  "Unknown server command.");
+							  "Another client is recording.");
 			break;
 		}
 
-		if (status < 0)
+		/* 
+		 * Set up for recording operations
+		 */
+		if (rate < gMinRecordRate ) 
+			rate = gMinRecordRate;
+		else if (rate > gMaxRecordRate ) 
+			rate = gMaxRecordRate;
+
+		status = CapStartRecord(client_fd, rate, size);
+		if (status != -1)
 		{
-			return -1;
+			gRecordPeriod = 1.0 / rate;
+			gRecordNext   = pacerNow();	/* The first record */
+			gRecordingClient = client;
 		}
-		
+		break;
+
+	case CAP_CMD_STOP_RECORD:		/* Stop recording */
+		status = CapStopRecord(client_fd);
+		if ( client == gRecordingClient )
+			gRecordingClient = NULL;
+		break;
+
+	default:			/* Ignore unknown commands */
+		status = CapError(client_fd, CAP_SEV_ERROR, gProgramName,
+						  "Unknown server command.");
+		break;
 	}
 
-	/* return 0; */
+	return (status < 0) ? -1 : 0;
 }
 
-static void get_data(int client_fd)
+/*
+ * Open (or reopen) the data file. Returns -1 if it cannot be opened.
+ */
+static int open_data(int client_fd)
 {
+	struct stat info;
+
+	if ( gDataFd >= 0 && gDataFd != 0 )
+		close(gDataFd);
+	gDataFd = -1;
+	gReadLength = 0;
+
+	if ( 0 == strcmp(gDataPath,"-") ) {
+		gDataFd = 0;
+	} else {
+#ifdef _WIN32
+		gDataFd = open(gDataPath, O_RDONLY | O_BINARY);
+#else
+		gDataFd = open(gDataPath, O_RDONLY | O_NONBLOCK);
+#endif
+		if ( gDataFd < 0 )
+			return -1;
+	}
 
-	channelInfo *chan = gChannels;
-	char *tokBuffer;
-	char *lp;
+	gDataIsFile = ( 0 == fstat(gDataFd, &info) && 
+					(info.st_mode & S_IFMT) == S_IFREG );
+	nonBlockFifo(client_fd);
+	return 0;
+}
+
+/*
+ * Parse one complete record into a new sample. Columns that are missing
+ * or cannot be parsed keep the values of the previous sample, from the
+ * first bad column of a text record on.
+ */
+static void parse_record(char *record, int length)
+{
+	sample *newest = &gRing[gNewest % RING_SIZE];
+	sample *next   = &gRing[(gNewest + 1) % RING_SIZE];
 	int i;
-	char *errOverFlow =
-		"Input buffer overflow line length greater than -b %d";
 
-	if ( gReadReopen ) {
-		if ( NULL != gDataFile )
-			fclose(gDataFile);
+	if ( gNewest != 0 )
+		memcpy(next->values, newest->values, gNumColumns * sizeof(float));
 
-		gDataFile = fopen(gDataPath, "r");
+	if ( gReadBinary ) {
+		memcpy(next->values, record, gNumColumns * sizeof(float));
+	} else {
+		char *cp = record;
+		char *end = record + length;
+		*end = '\0';		/* there is always room for the terminator */
+		for ( i = 0; i < gNumColumns; i++ ) {
+			char *stop;
+			float val;
+			while ( cp < end && (*cp == ' ' || *cp == '\t' || 
+								 *cp == '\n' || *cp == '\r') )
+				cp++;
+			if ( cp >= end )
+				break;
+			val = (float)strtod(cp, &stop);
+			if ( stop == cp )
+				break;
+			next->values[i] = val;
+			/* like sscanf, ignore anything after the number */
+			cp = stop;
+			while ( cp < end && *cp != ' ' && *cp != '\t' && *cp != '\n' )
+				cp++;
+		}
+	}
 
-		if (NULL == gDataFile) {
-			CapError(client_fd, CAP_SEV_FATAL, gProgramName, NULL);
-			exit(1);
+	next->stamp = pacerNow();
+	next->sequence = ++gNewest;
+}
+
+/*
+ * Read what is available from the data file and parse every complete
+ * record in it, or at most maxRecords of them if that is not 0.
+ *
+ * Returns the number of records parsed, or -1 at the end of a pipe or FIFO.
+ */
+static int read_data(int client_fd, int maxRecords)
+{
+	char *errOverFlow =
+		"Input buffer overflow line length greater than -b %d";
+	int recordSize = gNumColumns * (int)sizeof(float);
+	int records = 0;
+	int length;
+
+	if ( gDataFd < 0 )
+		return 0;
+
+	while ( 1 ) {
+		int consumed = 0;
+
+		/* parse the complete records already in the buffer */
+		while ( maxRecords == 0 || records < maxRecords ) {
+			char *start = gReadBuffer + consumed;
+			int available = gReadLength - consumed;
+
+			if ( gReadBinary ) {
+				if ( available < recordSize )
+					break;
+				parse_record(start, recordSize);
+				consumed += recordSize;
+			} else {
+				char *newLine = memchr(start, '\n', available);
+				if ( NULL == newLine )
+					break;
+				/*
+				 * RFE: add support for leading character "comments"
+				 */
+				parse_record(start, (int)(newLine - start));
+				consumed += (int)(newLine - start) + 1;
+			}
+			records++;
 		}
 
-		nonBlockFifo(client_fd);
-	} else if ( gReadRewind )
-		rewind(gDataFile);
+		/* keep the partial record for the next read */
+		memmove(gReadBuffer, gReadBuffer + consumed, gReadLength - consumed);
+		gReadLength -= consumed;
 
+		if ( maxRecords != 0 && records >= maxRecords )
+			break;
 
-	/*
-	 * find the data record
-	 */
-	while ( lp = fgets(gBuffers[gReadBuffer] + gBufferOffset,
-					   gBufferSize - gBufferOffset, gDataFile) )
-	{
-		gBufferOffset = strlen(lp);
-				
-		if ( '\n' == lp[gBufferOffset-1] ) {
-			/* This completes a full record */
-			gReadBuffer   = 1 - gReadBuffer;
-			gBufferOffset = 0;
-			/*
-			 * RFE: add support for leading character "comments"
-			 */
-			if (gReadNext)
-				break;
-		} else if ( gBufferSize <= gBufferOffset ) {
+		if ( gReadLength >= gBufferSize - 1 ) {
 			CapError(client_fd, CAP_SEV_FATAL, gProgramName, 
 					 errOverFlow, gBufferSize );
 			exit(1);
 		}
+
+		/* leave room for the terminator parse_record adds */
+		length = read(gDataFd, gReadBuffer + gReadLength, 
+					  gBufferSize - 1 - gReadLength);
+		if ( length == 0 && !gDataIsFile )
+			return -1;
+		if ( length <= 0 )
+			break;
+		gReadLength += length;
 	}
 
 	/*
-	 * gReadBuffer is the buffer to read or in process 1-grb is complete!
+	 * In -N mode a regular file is read one record at a time, so leave
+	 * the rest of it in the file.
 	 */
-	tokBuffer = gBuffers[1 - gReadBuffer];
-	while (chan != NULL) {
-		float val;
-		channelInfo *next = chan->next;
-		for ( i = 0; i< chan->info->p1.dim; i++) {
-			char *tok = strtok(tokBuffer," \n\t");
-			tokBuffer = NULL; /* how strtok works ;-o */
-			if ( NULL == tok || ( 1 != sscanf(tok,"%g", &val) )) {
-				next = NULL;
-				break;
+	if ( maxRecords != 0 && gDataIsFile && gReadLength > 0 ) {
+		lseek(gDataFd, -(off_t)gReadLength, SEEK_CUR);
+		gReadLength = 0;
+	}
+
+	return records;
+}
+
+/*
+ * Set a sample into the channels. The channels are shared by all the
+ * clients, so this is skipped when they already hold it, to keep the
+ * samples a recording sees from being repeated.
+ */
+static void set_channels(unsigned long sequence)
+{
+	if ( sequence != 0 && sequence != gChannelSequence ) {
+		channelCookSetData(gCook, gRing[sequence % RING_SIZE].values);
+		gChannelSequence = sequence;
+	}
+}
+
+/*
+ * Bring the ring up to date before a sample is used. Pipes and FIFOs
+ * are read as data arrives on Linux; everything else is read here.
+ */
+static void get_data(int client_fd)
+{
+	if ( gReadReopen ) {
+		/*
+		 * Only reopen the file when it has been replaced; otherwise
+		 * reading it again from the start is enough.
+		 */
+		struct stat pathInfo, fdInfo;
+		if ( gDataFd < 0 || !gDataIsFile || 
+			 0 != stat(gDataPath, &pathInfo) ||
+			 0 != fstat(gDataFd, &fdInfo) ||
+			 pathInfo.st_ino != fdInfo.st_ino ||
+			 pathInfo.st_dev != fdInfo.st_dev ) {
+			if ( open_data(client_fd) < 0 ) {
+				CapError(client_fd, CAP_SEV_FATAL, gProgramName, NULL);
+				exit(1);
 			}
-			chan->data[i] = val;
+		} else {
+			lseek(gDataFd, 0, SEEK_SET);
+			gReadLength = 0;
 		}
-		chan = next;
+	} else if ( gReadRewind ) {
+		lseek(gDataFd, 0, SEEK_SET);
+		gReadLength = 0;
 	}
 
+#ifdef LINUX
+	if ( gDataIsFile || gReadReopen )
+#endif
+		read_data(client_fd, gReadNext ? 1 : 0);
+
+	/* a recording takes the newest sample */
+	set_channels(gNewest);
+}
 
-	channelInfoSetData(gChannels, 1, NULL);
+/*
+ * Send a client the newest sample, or with -N the one after the last it
+ * was sent (or the oldest still in the ring, if it has fallen behind).
+ *
+ * While a client records, setting the channels adds to its recording,
+ * so the other clients are only sent the sample it last took.
+ */
+static int send_data(serverClient *client)
+{
+	unsigned long sequence;
+	sample *s = NULL;
 
-	return;
+	if ( NULL != gRecordingClient && client != gRecordingClient ) {
+		sequence = gChannelSequence;
+		if ( gNewest - sequence >= RING_SIZE )
+			sequence = 0;		/* the sample's stamp is gone */
+	} else {
+		if ( NULL == gRecordingClient )
+			get_data(client->fd);
+
+		sequence = gNewest;
+		if ( gNewest != 0 && gReadNext && client->lastSequence < gNewest ) {
+			sequence = client->lastSequence + 1;
+			if ( gNewest - sequence >= RING_SIZE )
+				sequence = gNewest - RING_SIZE + 1;
+		}
+		set_channels(sequence);
+	}
+	if ( sequence != 0 ) {
+		s = &gRing[sequence % RING_SIZE];
+		client->lastSequence = sequence;
+	}
+
+	if ( CapData(client->fd) < 0 )
+		return -1;
+
+	if ( NULL != s ) {
+		double latency = pacerNow() - s->stamp;
+		client->sent++;
+		client->latencySum += latency;
+		if ( latency > client->latencyMax )
+			client->latencyMax = latency;
+	}
+	return 0;
+}
+
+/*
+ * With -l, report the time from reading a sample to sending it, once a
+ * second and when a client disconnects.
+ */
+static void report_latency(serverClient *client, int force)
+{
+	double now = pacerNow();
+
+	if ( !gReportLatency || client->sent == 0 )
+		return;
+	if ( !force && now < client->reportNext )
+		return;
+
+	CapError(-1, CAP_SEV_INFO, gProgramName, 
+			 "client %d: %lu samples, latency mean %.3f ms, max %.3f ms",
+			 client->fd, client->sent, 
+			 1000. * client->latencySum / client->sent,
+			 1000. * client->latencyMax);
+
+	client->sent = 0;
+	client->latencySum = 0.;
+	client->latencyMax = 0.;
+	client->reportNext = now + 1.;
 }
 
 
@@ -570,11 +1131,11 @@ void printUsage()
     fprintf(stderr, "Usage:\n");
 #ifdef DEVEL
     fprintf(stderr, 
-			"    %s [-hdNRrvDi] [-b size] [-c config] [-n name] [-f file]\n",
+			"    %s [-hdNRrBlvDi] [-b size] [-c config] [-n name] [-f file]\n",
 			gProgramName);
 #else /* DEVEL */
     fprintf(stderr, 
-			"    %s [-hdNRr] [-b size] [-c config] [-n name] [-f file]\n", 
+			"    %s [-hdNRrBl] [-b size] [-c config] [-n name] [-f file]\n", 
 			gProgramName);
 #endif /* DEVEL */
     fprintf(stderr, "\n");
@@ -582,7 +1143,10 @@ void printUsage()
     fprintf(stderr, "        -d        Run as a daemon in the background\n");
 	fprintf(stderr, "        -N        read next record, instead of last\n");
 	fprintf(stderr, "        -r        rewind file on reread\n");
-	fprintf(stderr, "        -R        reopen file on reread\n");
+	fprintf(stderr, "        -R        reopen file on reread if it was replaced\n");
+	fprintf(stderr, "        -B        file has binary records of 32-bit floats,\n");
+	fprintf(stderr, "                  one per column, in host byte order\n");
+	fprintf(stderr, "        -l        report sample-to-send latency\n");
 	fprintf(stderr, "        -t        minimum record frequency in Hz\n");
 	fprintf(stderr, "        -T        maximum record frequency in Hz\n");
 	fprintf(stderr, "        -H        default record frequency in Hz\n");
@@ -636,6 +1200,8 @@ void parseArgs(int argc, char **argv)
 	gReadReopen = FALSE;
 	gReadRewind = FALSE;
 	gReadNext   = FALSE;
+	gReadBinary = FALSE;
+	gReportLatency = FALSE;
 	gBufferSize = 4096;
 	gDaemonMode = 0;
 	gShowUsage  = 0;
@@ -648,9 +1214,9 @@ void parseArgs(int argc, char **argv)
 	 * Parse the options
 	 */
 #ifdef DEVEL
-	while ((opt = getopt(argc, argv, "hdNRrb:c:f:n:t:T:H:Div")) != -1)
+	while ((opt = getopt(argc, argv, "hdNRrBlb:c:f:n:t:T:H:Div")) != -1)
 #else /* DEVEL */
-		while ((opt = getopt(argc, argv, "hdNRrb:c:f:n:t:T:H:")) != -1)
+		while ((opt = getopt(argc, argv, "hdNRrBlb:c:f:n:t:T:H:")) != -1)
 #endif /* DEVEL */
 		{
 			switch (opt)
@@ -675,6 +1241,14 @@ void parseArgs(int argc, char **argv)
 				gReadRewind = TRUE;
 				break;
 
+			case 'B' :
+				gReadBinary = TRUE;
+				break;
+
+			case 'l' :
+				gReportLatency = TRUE;
+				break;
+
 			case 'b' :
 				gBufferSize = atoi(optarg);
 				break;
@@ -754,7 +1328,7 @@ void parseArgs(int argc, char **argv)
 	if (optind < argc) 
 		gShowUsage++;
 
-	if ( gBufferSize < 1 )
+	if ( gBufferSize < 2 )
 		gShowUsage++;
 
 	if (gShowUsage) 
@@ -773,7 +1347,7 @@ void nonBlockFifo(int clientFd)
 {
 	struct stat info;
 	int flags;
-	int dataFd = fileno(gDataFile);
+	int dataFd = gDataFd;
 	fstat(dataFd, &info);
 	if ( info.st_mode & S_IFIFO ) {
 		if ( gReadRewind ) {
@@ -95,5 +95,13 @@ SOURCE=.\channelParse.h
 
 SOURCE=.\externServer.c
 # End Source File
+# Begin Source File
+
+SOURCE=.\pacer.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\pacer.h
+# End Source File
 # End Target
 # End Project
@@ -0,0 +1,251 @@
+/*
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+*/
+
+/*
+ * Tests externServer's handling of several clients, without Maya or the
+ * server library. externServer.c is compiled in, and the library calls
+ * it makes are replaced below: commands are single characters read from
+ * a socket pair per client, and CapSetData counts the samples that would
+ * go into a recording.
+ *
+ * One client records while a second asks for data; the recording must
+ * hold only the samples taken for the recording client, and the second
+ * client must still be answered.
+ *
+ * Build and run it in this directory (on Linux):
+ *
+ *	cc -DLINUX -I../../include -o externServerTest externServerTest.c \
+ *		channelParse.c pacer.c -lm
+ *	./externServerTest
+ */
+
+#include <stdarg.h>
+
+#define main externServerMain
+#include "externServer.c"
+#undef main
+
+/*
+ * The server library
+ */
+
+struct _CapChannel {
+	int		size;
+};
+
+static CapChannel	gFirstChannel = NULL;
+static int			gRecordFd     = -1;
+static int			gRecorded     = 0;	/* samples set while recording */
+static int			gDataSent[FD_SETSIZE];
+
+CapChannel CapCreateChannel(char *name, CapChannelUsage usage, int data_type)
+{
+	CapChannel channel = calloc(1, sizeof(struct _CapChannel));
+	channel->size = data_type;
+	if ( NULL == gFirstChannel )
+		gFirstChannel = channel;
+	return channel;
+}
+
+int CapSetData(CapChannel channel, void *data)
+{
+	/* every sample sets each channel once */
+	if ( gRecordFd >= 0 && channel == gFirstChannel )
+		gRecorded++;
+	return 0;
+}
+
+CapCommand CapGetCommand(int client_fd)
+{
+	char c;
+
+	if ( read(client_fd, &c, 1) != 1 )
+		return CAP_CMD_ERROR;
+	switch (c) {
+	case 'd':	return CAP_CMD_DATA;
+	case 'r':	return CAP_CMD_START_RECORD;
+	case 's':	return CAP_CMD_STOP_RECORD;
+	case 'q':	return CAP_CMD_QUIT;
+	}
+	return CAP_CMD_VERSION;
+}
+
+int CapData(int client_fd)
+{
+	gDataSent[client_fd]++;
+	return 0;
+}
+
+int CapStartRecord(int client_fd, float sample_rate, unsigned int buf_size)
+{
+	gRecordFd = client_fd;
+	gRecorded = 0;
+	return 0;
+}
+
+int CapStopRecord(int client_fd)
+{
+	gRecordFd = -1;
+	return 0;
+}
+
+int CapError(int client_fd, CapSeverity sev, char *pgm, char *fmt, ...)
+{
+	va_list args;
+
+	fprintf(stderr, "%s: ", pgm);
+	va_start(args, fmt);
+	if ( NULL != fmt )
+		vfprintf(stderr, fmt, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+	return 0;
+}
+
+float CapGetRequestedRecordRate(int client_fd)		{ return 60.; }
+int CapGetRequestedRecordSize(int client_fd)		{ return 0; }
+int CapWaitTimeout(int fd, int msec)				{ return 1; }
+int CapDaemonize(void)								{ return 0; }
+int CapServe(char *server)							{ return -1; }
+int CapInitialize(int client_fd, char *name)		{ return 0; }
+int CapAuthorize(int client_fd, int authorized)	{ return 0; }
+int CapGetAuthInfo(int client_fd, char *ruser, char *rhost, char *realhost)
+{
+	return 0;
+}
+int CapVersion(int client_fd, char *server_name, char *version, char *info)
+{
+	return 0;
+}
+int CapInfo(int client_fd, float min_rate, float max_rate, float def_rate,
+			unsigned int buf_size, int can_inc_time)
+{
+	return 0;
+}
+void CapQuat2Euler(CapRotationOrder order, CapQuaternion q,
+				   float *x, float *y, float *z)
+{
+	*x = *y = *z = 0.;
+}
+void CapEuler2Quat(CapRotationOrder order, float x, float y, float z,
+				   CapQuaternion q)
+{
+	q[0] = q[1] = q[2] = 0.;
+	q[3] = 1.;
+}
+
+/*
+ * The test
+ */
+
+static int gFailures = 0;
+
+static void check(int ok, const char *what)
+{
+	printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+	if ( !ok )
+		gFailures++;
+}
+
+/*
+ * Connect a client, returning the end of the socket pair the test
+ * writes its commands to.
+ */
+static int connect_client(serverClient *client)
+{
+	int fds[2];
+
+	if ( socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0 ) {
+		perror("socketpair");
+		exit(1);
+	}
+	memset(client, 0, sizeof(serverClient));
+	client->fd = fds[0];
+	return fds[1];
+}
+
+/*
+ * Send a client one command and have the server answer it.
+ */
+static int command(serverClient *client, int fd, char c)
+{
+	if ( write(fd, &c, 1) != 1 ) {
+		perror("write");
+		exit(1);
+	}
+	return client_command(client);
+}
+
+int main(int argc, char **argv)
+{
+	char *args[] = { "externServerTest", "-N",
+					 "-c", "rotTest.cfg", "-f", "rotTest.txt", NULL };
+	serverClient *a = &gClients[0];
+	serverClient *b = &gClients[1];
+	int aFd, bFd;
+	int i;
+
+	/* set up as main() does, reading a sample for each request */
+	parseArgs(lengthof(args) - 1, args);
+	gReadBuffer = malloc(gBufferSize);
+	gChannels = create_channels(gConfigFile, -1);
+	gCook = (NULL != gChannels) ? channelCookCreate(gChannels) : NULL;
+	if ( NULL == gReadBuffer || NULL == gCook ) {
+		fprintf(stderr, "externServerTest: cannot read %s\n", gConfigFile);
+		return 1;
+	}
+	gNumColumns = gCook->numCols;
+	for ( i = 0; i < RING_SIZE; i++ )
+		gRing[i].values = calloc(gNumColumns + 1, sizeof(float));
+	if ( open_data(-1) < 0 ) {
+		fprintf(stderr, "externServerTest: cannot read %s\n", gDataPath);
+		return 1;
+	}
+
+	aFd = connect_client(a);
+	bFd = connect_client(b);
+
+	/* both clients are served while neither records */
+	command(a, aFd, 'd');
+	command(b, bFd, 'd');
+	check(gDataSent[a->fd] == 1 && gDataSent[b->fd] == 1,
+		  "two clients are sent data");
+
+	/* a records three samples, as the record timer would take them */
+	command(a, aFd, 'r');
+	check(gRecordingClient == a, "the first client records");
+	for ( i = 0; i < 3; i++ )
+		get_data(gRecordingClient->fd);
+
+	/* b asks for data in the middle of the recording */
+	for ( i = 0; i < 5; i++ )
+		command(b, bFd, 'd');
+	check(gDataSent[b->fd] == 6,
+		  "the other client is answered during the recording");
+
+	/* only one client may record at a time */
+	command(b, bFd, 'r');
+	check(gRecordingClient == a, "a second recording is refused");
+
+	get_data(gRecordingClient->fd);
+	check(gRecorded == 4, "the recording holds only its own samples");
+
+	command(a, aFd, 's');
+	check(gRecordingClient == NULL, "the recording stops");
+
+	check(command(a, aFd, 'q') == 1 && command(b, bFd, 'q') == 1,
+		  "both clients quit");
+
+	printf("externServerTest: %s\n", gFailures ? "FAILED" : "passed");
+	return gFailures ? 1 : 0;
+}
@@ -23,6 +23,8 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include "pacer.h"
 
 #ifdef  LINUX
 #define GETOPTHUH '?'
@@ -91,6 +93,10 @@ char gProgramName[PATH_MAX] = { 0 };
 char gDataPath[PATH_MAX] = { 0 };
 FILE *gDataFile = NULL;
 char *gBuffer;
+pacer gPacer;
+
+/* set by the signal handler, acted on in the play loop */
+static volatile sig_atomic_t gReportRequested = 0;
 
 double toDouble(const struct timeval t) {
 	return (double)(t.tv_sec) + (double)(t.tv_usec) / 1000000.0;
@@ -106,6 +112,24 @@ struct timeval	toTimeval(double sec)
 	return tim;
 }
 
+static void requestReport(int sig)
+{
+	(void)sig;
+	gReportRequested = 1;
+}
+
+/*
+ * Print how late the records have been written, on SIGUSR1 and at exit.
+ * SIGINT and SIGTERM are left alone, so that they stop it at once
+ * wherever it is blocked; they end it without a report.
+ */
+static void report()
+{
+	char line[256];
+
+	pacerReport(&gPacer, line, sizeof(line));
+	fprintf(stderr, "%s: %s\n", gProgramName, line);
+}
 
 void printUsage()
 {
@@ -117,6 +141,11 @@ void printUsage()
     fprintf(stderr, "        -h        Print this help message\n");
 	fprintf(stderr, "        -H        default record frequency in Hz\n");
     fprintf(stderr, "\n");
+#ifdef SIGUSR1
+	fprintf(stderr, "    Send SIGUSR1 to print how late the records are written;\n");
+	fprintf(stderr, "    this is also printed when it exits by itself.\n");
+    fprintf(stderr, "\n");
+#endif
 
     exit(1);
 }
@@ -196,15 +225,11 @@ void parseArgs(int argc, char **argv)
 
 main( int argc, char *argv[] ) {
 	
-	double playNow    = 0;
-	double playNext   = 0;
-	double playPeriod = 1./30.;
 	FILE   *dataFile  = NULL;
+	int    due;
 
 	parseArgs( argc, argv);
 
-	playPeriod = 1./ gPlayFreq;
-
 	dataFile = fopen(gDataPath, "r");
 	if ( NULL == dataFile ) {
 		fprintf(stderr,
@@ -221,20 +246,30 @@ main( int argc, char *argv[] ) {
 
 	strcpy(gBuffer,"");
 
+#ifdef SIGUSR1
+	signal(SIGUSR1, requestReport);
+#endif
+	atexit(report);
 
+	/*
+	 * The records are written on a fixed grid of deadlines, so time spent
+	 * writing or oversleeping does not add up to drift.
+	 */
+	pacerReset(&gPacer);
+	pacerStart(&gPacer, 1./ gPlayFreq);
 
 	while (1) {
-		struct timeval timeout, now;
-#ifdef LINUX
-	    gettimeofday(&now,NULL);
-#else
-		gettimeofday(&now);
-#endif            
-		playNow   = toDouble(now);
-		if ( playNext == 0.0 ) /* The first record */
-			playNext = playNow;
+		due = pacerWait(&gPacer);
+
+		if ( gReportRequested ) {
+			gReportRequested = 0;
+			report();
+		}
+		if ( due < 0 )		/* interrupted, the record is still due */
+			continue;
 
-		while ( playNext <= playNow ) {
+		/* if we fell behind, catch up with the records that were due */
+		while ( due-- > 0 ) {
 			if ( NULL == fgets(gBuffer, gBufferSize, dataFile ) ) {
 				rewind( dataFile); 
 				if ( NULL == fgets(gBuffer, gBufferSize, dataFile ) ) {
@@ -245,16 +280,8 @@ main( int argc, char *argv[] ) {
 			}
 				
 			printf( "%s", gBuffer );				
-			playNext = playNext + playPeriod;
 		}
 		fflush(stdout);
-			
-		/*
-		 * wait for commands or a timeout
-		 */
-		timeout = toTimeval( playNext - playNow );
-		select(FD_SETSIZE, NULL, NULL, NULL, &timeout);
-
 	}
 
 }
@@ -86,5 +86,13 @@ LINK32=link.exe
 
 SOURCE=.\loopfile.c
 # End Source File
+# Begin Source File
+
+SOURCE=.\pacer.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\pacer.h
+# End Source File
 # End Target
 # End Project
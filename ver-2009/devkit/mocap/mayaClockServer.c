@@ -17,6 +17,7 @@
 #include <errno.h>
 #include <time.h>
 #include <math.h>
+#include <signal.h>
 #include <sys/types.h>
 #ifndef _WIN32
 # include <sys/time.h>
@@ -93,6 +94,8 @@ int getopt(int argc, char **argv, char *pargs)
 #include <mocapserial.h>
 #endif 
 
+#include "pacer.h"
+
 #ifndef lengthof
 #define lengthof(array)	(sizeof(array) / sizeof(array[0]))
 #endif /* lengthof */
@@ -109,9 +112,45 @@ static char *server_name = program;
 
 static CapChannel	hours, minutes, seconds;
 
+/*
+ * Recording ticks, and how late they ran
+ */
+static pacer recorder;
+static volatile sig_atomic_t report_requested = 0;
+
 static int handle_client(int client_fd);
 static void get_data(int client_fd);
 static int create_channels(int client_fd);
+static void check_requests(void);
+
+static void request_report(int sig)
+{
+  (void)sig;
+  report_requested = 1;
+}
+
+/*
+ * Log how late the recording ticks have been, on SIGUSR1 and at exit.
+ * SIGINT and SIGTERM are left alone, so that they still stop the server
+ * while it waits for a client; they end it without a report.
+ */
+static void report(void)
+{
+  char line[256];
+
+  if (recorder.late.total == 0) return;
+  pacerReport(&recorder, line, sizeof(line));
+  CapError(-1, CAP_SEV_INFO, program, "%s", line);
+}
+
+static void check_requests(void)
+{
+  if (report_requested)
+  {
+    report_requested = 0;
+    report();
+  }
+}
 
 int main(int argc, char **argv)
 {
@@ -207,10 +246,21 @@ int main(int argc, char **argv)
     fprintf(stderr, "Defaults:\n");
     fprintf(stderr, "    %s -n %s\n", program, program);
     fprintf(stderr, "\n");
+#ifdef SIGUSR1
+    fprintf(stderr, "Send SIGUSR1 to log how late the recording ticks are;\n");
+    fprintf(stderr, "this is also logged when it exits by itself.\n");
+    fprintf(stderr, "\n");
+#endif /* SIGUSR1 */
 
     exit(1);
   }
 
+  pacerReset(&recorder);
+#ifdef SIGUSR1
+  signal(SIGUSR1, request_report);
+#endif /* SIGUSR1 */
+  atexit(report);
+
   if (inetd_mode)
   {
     /*
@@ -283,22 +333,32 @@ static int handle_client(int client_fd)
   CapCommand cmd;
   char ruser[64], rhost[64], realhost[64];
   fd_set rd_fds;
-  struct timeval base_timeout, timeout;
+  struct timeval timeout;
   int recording = 0;
 
   static int channels_created = 0;
 
-  base_timeout.tv_sec  = 1;
-  base_timeout.tv_usec = 0;
-
   while (1)
   {
     FD_ZERO(&rd_fds);
     FD_SET((unsigned int)client_fd, &rd_fds);
-    timeout.tv_sec  = base_timeout.tv_sec;
-    timeout.tv_usec = base_timeout.tv_usec;
+
+    /*
+     * While recording, wake up just before the next tick is due and
+     * let the pacer sleep the rest of the way to it.
+     */
+    if (recording)
+    {
+      pacerTimeout(&recorder, &timeout);
+    }
+    else
+    {
+      timeout.tv_sec  = 1;
+      timeout.tv_usec = 0;
+    }
     
 	status = select(FD_SETSIZE, &rd_fds, NULL, NULL, &timeout);
+    check_requests();
     if (status < 0)
     {
 #ifndef _WIN32
@@ -317,7 +377,7 @@ static int handle_client(int client_fd)
     else if (status == 0)
     {
       /* We got a timeout */
-      if (recording) get_data(client_fd);
+      if (recording && pacerWait(&recorder) > 0) get_data(client_fd);
 
       /* Try again */
       continue;
@@ -395,21 +455,18 @@ static int handle_client(int client_fd)
 	case CAP_CMD_START_RECORD:	/* Start recording */
     {
       int size = 0;
-      float rate = 0.0f, time = 0.0f;
+      float rate = 0.0f;
 	  rate = CapGetRequestedRecordRate(client_fd);
 	  size = CapGetRequestedRecordSize(client_fd);
 
-	  /* Convert rate in Hz to a timeout value in a timeval structure */
+	  /* Record on a fixed grid of deadlines, starting now */
 	  if (rate <   1.0) rate =   1.0;
 	  if (rate > 100.0) rate = 100.0;
 
-	  time = 1.0 / rate;
-	  base_timeout.tv_sec  = time;
-	  base_timeout.tv_usec = (time - base_timeout.tv_sec) * 1000000;
-
 	  status = CapStartRecord(client_fd, rate, size);
 	  if (status != -1)
 	  {
+	    pacerStart(&recorder, 1.0 / rate);
 	    recording = 1;
 	  }
 	  break;
@@ -418,8 +475,6 @@ static int handle_client(int client_fd)
 	case CAP_CMD_STOP_RECORD:		/* Stop recording */
 	  status = CapStopRecord(client_fd);
 	  recording = 0;
-	  base_timeout.tv_sec  = 1;
-	  base_timeout.tv_usec = 0;
 	  break;
 #endif /* server side recording */
 
@@ -51,7 +51,7 @@ BSC32=bscmake.exe
 # ADD BSC32 /nologo
 LINK32=link.exe
 # ADD BASE LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /subsystem:console /machine:I386
-# ADD LINK32 kernel32.lib user32.lib gdi32.lib ws2_32.lib libMocap.lib /nologo /subsystem:console /machine:I386 /out:"..\..\..\Products\buildrelease\bin\mayaClockServer.exe" /libpath:"$(AW_REPO_PRODUCTS_DIR)\lib\Release"
+# ADD LINK32 kernel32.lib user32.lib gdi32.lib ws2_32.lib Winmm.lib libMocap.lib /nologo /subsystem:console /machine:I386 /out:"..\..\..\Products\buildrelease\bin\mayaClockServer.exe" /libpath:"$(AW_REPO_PRODUCTS_DIR)\lib\Release"
 
 !ELSEIF  "$(CFG)" == "mayaClockServer - Win32 Debug"
 
@@ -75,7 +75,7 @@ BSC32=bscmake.exe
 # ADD BSC32 /nologo
 LINK32=link.exe
 # ADD BASE LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /subsystem:console /debug /machine:I386 /pdbtype:sept
-# ADD LINK32 kernel32.lib user32.lib gdi32.lib ws2_32.lib libMocapd.lib /nologo /subsystem:console /debug /machine:I386 /out:"..\..\..\Products\BuildDebug\bin\mayaClockServer.exe" /libpath:"$(AW_REPO_PRODUCTS_DIR)\lib\Debug"
+# ADD LINK32 kernel32.lib user32.lib gdi32.lib ws2_32.lib Winmm.lib libMocapd.lib /nologo /subsystem:console /debug /machine:I386 /out:"..\..\..\Products\BuildDebug\bin\mayaClockServer.exe" /libpath:"$(AW_REPO_PRODUCTS_DIR)\lib\Debug"
 # Begin Special Build Tool
 SOURCE="$(InputPath)"
 PostBuild_Cmds=T:\bin\perl.exe -I T:\lib\perl     ..\..\OpenMaya\MakeNT\releaseDevkit.pl MotionCapture\clock mocap Debug
@@ -104,7 +104,7 @@ BSC32=bscmake.exe
 # ADD BSC32 /nologo
 LINK32=link.exe
 # ADD BASE LINK32 kernel32.lib user32.lib gdi32.lib ws2_32.lib /nologo /subsystem:console /machine:I386 /out:"..\..\..\Products\buildrelease\bin\mayaClockServer.exe"
-# ADD LINK32 kernel32.lib user32.lib gdi32.lib ws2_32.lib libMocap.lib /nologo /subsystem:console /debug /machine:I386 /out:"..\..\..\Products\buildrelease\bin\mayaClockServer.exe" /libpath:"$(AW_REPO_PRODUCTS_DIR)\lib\ReleaseDebug"
+# ADD LINK32 kernel32.lib user32.lib gdi32.lib ws2_32.lib Winmm.lib libMocap.lib /nologo /subsystem:console /debug /machine:I386 /out:"..\..\..\Products\buildrelease\bin\mayaClockServer.exe" /libpath:"$(AW_REPO_PRODUCTS_DIR)\lib\ReleaseDebug"
 # Begin Special Build Tool
 SOURCE="$(InputPath)"
 PostBuild_Cmds=T:\bin\perl.exe -I T:\lib\perl     ..\..\OpenMaya\MakeNT\releaseDevkit.pl MotionCapture\clock mocap ReleaseDebug
@@ -121,5 +121,13 @@ PostBuild_Cmds=T:\bin\perl.exe -I T:\lib\perl     ..\..\OpenMaya\MakeNT\releaseD
 
 SOURCE=.\mayaClockServer.c
 # End Source File
+# Begin Source File
+
+SOURCE=.\pacer.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\pacer.h
+# End Source File
 # End Target
 # End Project
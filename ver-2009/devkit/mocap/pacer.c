@@ -0,0 +1,242 @@
+/*
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/time.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#define snprintf _snprintf
+#endif
+#include "pacer.h"
+
+/*
+ * select() is only trusted to within this many seconds; pacerWait()
+ * sleeps the rest of the way to the deadline.
+ */
+#define kPacerSlack		0.002
+
+double pacerNow(void)
+/*
+ * Description:
+ *	Seconds on a clock that is not affected by changes to the time of day.
+ */
+{
+#ifdef LINUX
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1000000000.0;
+#elif defined(_WIN32)
+	return (double)timeGetTime() / 1000.0;
+#else
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (double)now.tv_sec + (double)now.tv_usec / 1000000.0;
+#endif
+}
+
+void pacerStart(pacer *p, double period)
+/*
+ * Description:
+ *	Start ticking every "period" seconds, with the first tick due now.
+ *	The histogram is kept, so restarting at another rate adds to it.
+ */
+{
+	p->period = period;
+	p->next   = pacerNow();
+}
+
+void pacerReset(pacer *p)
+/*
+ * Description:
+ *	Clear the tick counts and the histogram.
+ */
+{
+	p->ticks   = 0;
+	p->skipped = 0;
+	memset(&p->late, 0, sizeof(p->late));
+}
+
+static int pacerBucket(double usec)
+/*
+ * Description:
+ *	The histogram bucket for a lateness in microseconds.
+ */
+{
+	unsigned long long v;
+	int e = 5;		/* 2^5 == kPacerExactBuckets */
+	int index;
+
+	if ( usec < kPacerExactBuckets )
+		return usec < 0. ? 0 : (int)usec;
+	if ( usec >= 35184372088832. )		/* 2^45 */
+		return kPacerBuckets - 1;
+
+	v = (unsigned long long)usec;
+	while ( (v >> (e + 1)) != 0 )
+		e++;
+	index = kPacerExactBuckets + (e - 5) * kPacerSubBuckets +
+		(int)((v >> (e - 4)) & (kPacerSubBuckets - 1));
+	return index;
+}
+
+static double pacerBucketTop(int index)
+/*
+ * Description:
+ *	The largest lateness, in microseconds, that goes in a bucket.
+ */
+{
+	int e, sub;
+	double low, width;
+
+	if ( index < kPacerExactBuckets )
+		return (double)index;
+
+	e   = (index - kPacerExactBuckets) / kPacerSubBuckets + 5;
+	sub = (index - kPacerExactBuckets) % kPacerSubBuckets;
+	width = (double)(1ULL << (e - 4));
+	low   = (double)(kPacerSubBuckets + sub) * width;
+	return low + width - 1.;
+}
+
+void pacerTimeout(const pacer *p, struct timeval *timeout)
+/*
+ * Description:
+ *	A select() timeout that ends just before the next deadline. Call
+ *	pacerWait() when it expires to finish the wait precisely.
+ */
+{
+	double left = p->next - pacerNow() - kPacerSlack;
+
+	if ( left < 0. )
+		left = 0.;
+	timeout->tv_sec  = (long)left;
+	timeout->tv_usec = (long)((left - (double)timeout->tv_sec) * 1000000.);
+}
+
+int pacerWait(pacer *p)
+/*
+ * Description:
+ *	Sleep until the next deadline and record how late the wake up was.
+ *
+ *	Returns the number of ticks that are due (more than one when the
+ *	caller has fallen behind), or -1 if a signal interrupted the sleep;
+ *	the deadline is then left in place for the next call.
+ */
+{
+	double now;
+	double usec;
+	int due;
+
+#ifdef LINUX
+	struct timespec deadline;
+	int status;
+
+	deadline.tv_sec  = (time_t)p->next;
+	deadline.tv_nsec = (long)((p->next - (double)deadline.tv_sec) * 1000000000.);
+	if ( deadline.tv_nsec >= 1000000000L ) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	status = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+	if ( status == EINTR ) {
+		errno = EINTR;
+		return -1;
+	}
+#elif defined(_WIN32)
+	double left = p->next - pacerNow();
+	if ( left > 0. )
+		Sleep((DWORD)(left * 1000. + 0.5));
+#else
+	struct timeval timeout;
+	double left = p->next - pacerNow();
+	if ( left > 0. ) {
+		timeout.tv_sec  = (long)left;
+		timeout.tv_usec = (long)((left - (double)timeout.tv_sec) * 1000000.);
+		if ( select(0, NULL, NULL, NULL, &timeout) < 0 && errno == EINTR )
+			return -1;
+	}
+#endif
+
+	now  = pacerNow();
+	usec = (now - p->next) * 1000000.;
+	if ( usec < 0. )
+		usec = 0.;
+
+	p->late.counts[pacerBucket(usec)]++;
+	p->late.total++;
+	p->late.sum += usec;
+	if ( usec > p->late.max )
+		p->late.max = usec;
+
+	/* the deadlines stay on the grid, however late this tick is */
+	due = 1;
+	p->next += p->period;
+	while ( p->next <= now ) {
+		p->next += p->period;
+		due++;
+	}
+	p->ticks   += due;
+	p->skipped += due - 1;
+
+	return due;
+}
+
+double pacerPercentile(const pacer *p, double percent)
+/*
+ * Description:
+ *	The lateness, in microseconds, that "percent" of the ticks were
+ *	no later than.
+ */
+{
+	unsigned long want, seen = 0;
+	double top;
+	int i;
+
+	if ( p->late.total == 0 )
+		return 0.;
+
+	want = (unsigned long)(percent / 100. * (double)p->late.total + 0.5);
+	if ( want < 1 )
+		want = 1;
+	for ( i = 0; i < kPacerBuckets; i++ ) {
+		seen += p->late.counts[i];
+		if ( seen >= want )
+			break;
+	}
+	top = pacerBucketTop(i < kPacerBuckets ? i : kPacerBuckets - 1);
+	return top < p->late.max ? top : p->late.max;
+}
+
+int pacerReport(const pacer *p, char *buffer, int size)
+/*
+ * Description:
+ *	Print a one line summary of the ticks and their lateness.
+ */
+{
+	if ( p->late.total == 0 )
+		return snprintf(buffer, size, "no ticks");
+
+	return snprintf(buffer, size,
+					"%lu ticks at %.2f Hz, %lu skipped, late (us): "
+					"mean %.1f p50 %.0f p90 %.0f p99 %.0f p99.9 %.0f max %.0f",
+					p->ticks, 1. / p->period, p->skipped,
+					p->late.sum / (double)p->late.total,
+					pacerPercentile(p, 50.), pacerPercentile(p, 90.),
+					pacerPercentile(p, 99.), pacerPercentile(p, 99.9),
+					p->late.max);
+}
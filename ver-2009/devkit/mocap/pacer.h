@@ -0,0 +1,61 @@
+/*
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+*/
+
+#ifndef _pacer_h
+#define _pacer_h
+
+#ifndef _WIN32
+#include <sys/time.h>
+#else
+#include <winsock2.h>
+#endif
+
+/*
+ * A pacer runs ticks at a fixed rate for the example servers. The ticks
+ * are scheduled on absolute deadlines of a monotonic clock, so the time
+ * spent between ticks, and any oversleeping, does not accumulate as
+ * drift. How late each tick runs is kept in a histogram.
+ *
+ * The histogram buckets are exact below 32 microseconds; above that each
+ * power of two is split into 16 buckets, so a recorded value is within
+ * 1/16 (6.25%) of the true lateness.
+ */
+
+#define kPacerExactBuckets	32
+#define kPacerSubBuckets	16
+#define kPacerBuckets		(kPacerExactBuckets + 40 * kPacerSubBuckets)
+
+typedef struct pacerHistogram {
+	unsigned long	counts[kPacerBuckets];
+	unsigned long	total;
+	double			sum;		/* microseconds */
+	double			max;		/* microseconds */
+} pacerHistogram;
+
+typedef struct pacer {
+	double			period;		/* seconds */
+	double			next;		/* the next deadline, in pacerNow() time */
+	unsigned long	ticks;
+	unsigned long	skipped;	/* ticks that were due together */
+	pacerHistogram	late;
+} pacer;
+
+double	pacerNow(void);
+void	pacerStart(pacer *p, double period);
+void	pacerTimeout(const pacer *p, struct timeval *timeout);
+int		pacerWait(pacer *p);
+void	pacerReset(pacer *p);
+double	pacerPercentile(const pacer *p, double percent);
+int		pacerReport(const pacer *p, char *buffer, int size);
+
+#endif /* _pacer_h */
@@ -21,20 +21,48 @@
 #include <maya/MFnPlugin.h>
 #include <maya/MStringArray.h>
 #include <maya/MIOStream.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
+#include <maya/MAtomic.h>
+
+#include <string.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
 
 #if _WIN32   
 #pragma warning( disable : 4290 )		// Disable STL warnings.
 #pragma warning( disable : 4244 )		// Disable conversion from unsigned int to unsigned short 
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPENEXR_SSE2
+#include <emmintrin.h>
+#endif
+
 #undef min
 #undef max
+#include <ImfInputFile.h>
 #include <ImfRgbaFile.h>
-#include <ImfArray.h>
+#include <ImfHeader.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfTileDescription.h>
+#include <ImathBox.h>
 #include <half.h>
 #define INVALID_PIXEL_TYPE Imf::NUM_PIXELTYPES
 MString kImagePluginName( "OpenEXR");
 
+// Scanline files are compressed in blocks of 1, 16 or 32 lines depending
+// on the compression. Bands are kept to multiples of this so no block is
+// decoded by two threads.
+//
+#define EXR_SCANLINE_BLOCK	32
+
+// Bands handed out per thread; more bands balance better, fewer cost less
+//
+#define EXR_BANDS_PER_THREAD	4
+
 class OpenEXRImageFile : public MPxImageFile
 {
 public:
@@ -44,20 +72,284 @@ public:
 	virtual MStatus open( MString pathname, MImageFileInfo* info);
 	virtual MStatus load( MImage& image, unsigned int idx);
 
+	// Load the pixels in [xMin, xMax] x [yMin, yMax] of the data window,
+	// in file pixel coordinates. The region is clipped to the data window
+	// and the image is created with the size of the clipped region.
+	//
+	MStatus			loadRegion( MImage& image, int xMin, int yMin, int xMax, int yMax);
+
 protected:
 	int				fWidth;
 	int				fHeight;
 	int				fChannels;
 	int				fLayers;
 	Imf::PixelType	fPixelType;
-	Imf::RgbaInputFile*	fInputFile;
+	bool			fLuminance;
+	MString			fPathname;
+	Imf::InputFile*	fInputFile;
 };
 
+// Shared state for one load. Each task opens its own copy of the file
+// and pulls bands of scanlines until none are left. nextBand and failed
+// are only written through MAtomic.
+//
+struct OpenEXRLoadRegion
+{
+	const char*		pathname;
+	bool			luminance;
+	bool			halfPixels;
+	int				channels;
+	Imath::Box2i	dataWindow;
+	int				xMin, yMin, xMax, yMax;
+	int				firstBandY;
+	int				bandHeight;
+	int				numBands;
+	int				numTasks;
+	float*			dest;
+	volatile int	nextBand;
+	volatile int	failed;
+};
+
+//
+// DESCRIPTION:
+//		Reverse the order of n rows of rowBytes bytes, in place.
+///////////////////////////////////////////////////////
+static void reverseRows( char* rows, int n, ptrdiff_t rowBytes)
+{
+	char* top = rows;
+	char* bottom = rows + (ptrdiff_t)(n - 1) * rowBytes;
+	for( ; top < bottom; top += rowBytes, bottom -= rowBytes)
+		std::swap_ranges( top, top + rowBytes, bottom);
+}
+
+//
+// DESCRIPTION:
+//		Convert n halfs to floats. Denormals are scaled up from an
+//		integer conversion so the result does not depend on the
+//		denormals-are-zero mode of the calling thread.
+///////////////////////////////////////////////////////
+static void halfToFloat( float* dest, const half* src, size_t n)
+{
+	size_t i = 0;
+#ifdef OPENEXR_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i expMant = _mm_set1_epi32( 0x7fff);
+	const __m128i expBias = _mm_set1_epi32( (127 - 15) << 23);
+	const __m128i infNan = _mm_set1_epi32( 0x7bff);
+	const __m128i denormal = _mm_set1_epi32( 0x0400);
+	const __m128 denormalScale = _mm_set1_ps( 1.0f / 16777216.0f);
+	for( ; i + 8 <= n; i += 8)
+	{
+		__m128i h8 = _mm_loadu_si128( (const __m128i*)(src + i));
+		for( int k = 0; k < 2; k++)
+		{
+			__m128i h = k ? _mm_unpackhi_epi16( h8, zero) : _mm_unpacklo_epi16( h8, zero);
+			__m128i em = _mm_and_si128( h, expMant);
+			__m128i sign = _mm_slli_epi32( _mm_xor_si128( h, em), 16);
+
+			// normals: rebias the exponent; inf and nan get it twice
+			// so the exponent saturates at 255
+			__m128i bits = _mm_add_epi32( _mm_slli_epi32( em, 13), expBias);
+			bits = _mm_add_epi32( bits, _mm_and_si128( _mm_cmpgt_epi32( em, infNan), expBias));
+
+			// zeros and denormals: mantissa * 2^-24
+			__m128i isDenormal = _mm_cmplt_epi32( em, denormal);
+			__m128i small = _mm_castps_si128( _mm_mul_ps( _mm_cvtepi32_ps( em), denormalScale));
+			bits = _mm_or_si128( _mm_and_si128( isDenormal, small), _mm_andnot_si128( isDenormal, bits));
+
+			_mm_storeu_ps( dest + i + 4 * k, _mm_castsi128_ps( _mm_or_si128( bits, sign)));
+		}
+	}
+#endif
+	for( ; i < n; i++)
+		dest[i] = src[i];
+}
+
+//
+// DESCRIPTION:
+//		Rows [y0, y1] of the file covered by one band.
+///////////////////////////////////////////////////////
+static void bandRows( const OpenEXRLoadRegion* region, int band, int& y0, int& y1)
+{
+	y0 = region->firstBandY + band * region->bandHeight;
+	y1 = y0 + region->bandHeight - 1;
+	if( y0 < region->yMin) y0 = region->yMin;
+	if( y1 > region->yMax) y1 = region->yMax;
+}
+
+//
+// DESCRIPTION:
+//		Read bands through the general channel interface. Float files
+//		covering the full width are read straight into the image;
+//		otherwise each band goes through a buffer holding that band only.
+///////////////////////////////////////////////////////
+static void readChannelBands( OpenEXRLoadRegion* region)
+{
+	static const char* channelNames[4] = { "R", "G", "B", "A" };
+
+	Imf::InputFile file( region->pathname);
+
+	const Imath::Box2i& dw = region->dataWindow;
+	const int channels = region->channels;
+	const int fullWidth = dw.max.x - dw.min.x + 1;
+	const int width = region->xMax - region->xMin + 1;
+	const bool direct = !region->halfPixels && width == fullWidth;
+	const Imf::PixelType type = region->halfPixels ? Imf::HALF : Imf::FLOAT;
+	const size_t channelSize = region->halfPixels ? sizeof(half) : sizeof(float);
+	const size_t pixelSize = channels * channelSize;
+
+	std::vector<char> band;
+	if( !direct)
+		band.resize( (size_t)fullWidth * region->bandHeight * pixelSize);
+
+	for( ;;)
+	{
+		if( region->failed)
+			break;
+		int b = MAtomic::postIncrement( &region->nextBand);
+		if( b >= region->numBands)
+			break;
+
+		int y0, y1;
+		bandRows( region, b, y0, y1);
+
+		char* base;
+		char* span = NULL;
+		ptrdiff_t xStride = (ptrdiff_t)pixelSize;
+		ptrdiff_t yStride;
+		if( direct)
+		{
+			// File rows y0..y1 land in image rows yMax - y1..yMax - y0,
+			// since MImage rows run bottom to top. The library only
+			// takes unsigned strides, so rather than read with a
+			// negative one the band is read top down into that span
+			// and its rows are reversed afterwards.
+			yStride = (ptrdiff_t)width * xStride;
+			span = (char*)region->dest + (ptrdiff_t)(region->yMax - y1) * yStride;
+			base = span - (ptrdiff_t)y0 * yStride - (ptrdiff_t)region->xMin * xStride;
+		}
+		else
+		{
+			yStride = (ptrdiff_t)fullWidth * xStride;
+			base = &band[0] - ((ptrdiff_t)y0 * fullWidth + dw.min.x) * xStride;
+		}
+
+		Imf::FrameBuffer frameBuffer;
+		for( int c = 0; c < channels; c++)
+			frameBuffer.insert( channelNames[c],
+				Imf::Slice( type, base + c * channelSize,
+							(size_t)xStride, (size_t)yStride,
+							1, 1, c == 3 ? 1.0 : 0.0));
+		file.setFrameBuffer( frameBuffer);
+		file.readPixels( y0, y1);
+
+		if( direct)
+		{
+			reverseRows( span, y1 - y0 + 1, yStride);
+			continue;
+		}
+
+		// Copy the region's columns into the flipped destination rows
+		for( int y = y0; y <= y1; y++)
+		{
+			const char* src = &band[0] + (ptrdiff_t)(y - y0) * yStride
+							+ (ptrdiff_t)(region->xMin - dw.min.x) * xStride;
+			float* dest = region->dest + (ptrdiff_t)(region->yMax - y) * width * channels;
+			if( region->halfPixels)
+				halfToFloat( dest, (const half*)src, (size_t)width * channels);
+			else
+				memcpy( dest, src, (size_t)width * pixelSize);
+		}
+	}
+}
+
+//
+// DESCRIPTION:
+//		Read bands through the RGBA interface, which converts
+//		luminance / chroma files to RGB.
+///////////////////////////////////////////////////////
+static void readLuminanceBands( OpenEXRLoadRegion* region)
+{
+	Imf::RgbaInputFile file( region->pathname);
+
+	const Imath::Box2i& dw = region->dataWindow;
+	const int channels = region->channels;
+	const int fullWidth = dw.max.x - dw.min.x + 1;
+	const int width = region->xMax - region->xMin + 1;
+
+	std::vector<Imf::Rgba> band( (size_t)fullWidth * region->bandHeight);
+
+	for( ;;)
+	{
+		if( region->failed)
+			break;
+		int b = MAtomic::postIncrement( &region->nextBand);
+		if( b >= region->numBands)
+			break;
+
+		int y0, y1;
+		bandRows( region, b, y0, y1);
+
+		file.setFrameBuffer( &band[0] - dw.min.x - (ptrdiff_t)y0 * fullWidth, 1, fullWidth);
+		file.readPixels( y0, y1);
+
+		for( int y = y0; y <= y1; y++)
+		{
+			const Imf::Rgba* src = &band[0] + (ptrdiff_t)(y - y0) * fullWidth + (region->xMin - dw.min.x);
+			float* dest = region->dest + (ptrdiff_t)(region->yMax - y) * width * channels;
+			if( channels == 4)
+			{
+				halfToFloat( dest, &src->r, (size_t)width * 4);
+			}
+			else
+			{
+				for( int x = 0; x < width; x++, src++)
+				{
+					*dest++ = src->r;
+					*dest++ = src->g;
+					*dest++ = src->b;
+				}
+			}
+		}
+	}
+}
+
+//
+// DESCRIPTION:
+///////////////////////////////////////////////////////
+static MThreadRetVal readBands( void* data)
+{
+	OpenEXRLoadRegion* region = (OpenEXRLoadRegion*)data;
+	try
+	{
+		if( region->luminance)
+			readLuminanceBands( region);
+		else
+			readChannelBands( region);
+	}
+	catch( ... )
+	{
+		MAtomic::set( &region->failed, 1);
+	}
+	return (MThreadRetVal)0;
+}
+
+//
+// DESCRIPTION:
+///////////////////////////////////////////////////////
+static void decomposeBands( void* data, MThreadRootTask* root)
+{
+	OpenEXRLoadRegion* region = (OpenEXRLoadRegion*)data;
+	for( int i = 0; i < region->numTasks; i++)
+		MThreadPool::createTask( readBands, data, root);
+	MThreadPool::executeAndJoin( root);
+}
+
 //
 // DESCRIPTION:
 ///////////////////////////////////////////////////////
 OpenEXRImageFile::OpenEXRImageFile()
-: fInputFile( NULL), fChannels( 0), fLayers( 0), fPixelType( INVALID_PIXEL_TYPE)
+: fInputFile( NULL), fChannels( 0), fLayers( 0), fPixelType( INVALID_PIXEL_TYPE), fLuminance( false)
 {
 
 }
@@ -86,10 +378,11 @@ MStatus OpenEXRImageFile::open( MString pathname, MImageFileInfo* info)
 {
 	if( fInputFile) 
 		delete fInputFile;
+	fInputFile = NULL;
 
 	try
 	{
-		fInputFile = new Imf::RgbaInputFile( pathname.asChar());
+		fInputFile = new Imf::InputFile( pathname.asChar());
 	}
 	catch( ... )
 	{
@@ -98,17 +391,34 @@ MStatus OpenEXRImageFile::open( MString pathname, MImageFileInfo* info)
 	if( !fInputFile)
 		return MS::kFailure;
 
+	fPathname = pathname;
+
+	const Imf::Header& header = fInputFile->header();
+	fWidth = header.dataWindow().max.x - header.dataWindow().min.x + 1;
+	fHeight = header.dataWindow().max.y - header.dataWindow().min.y + 1;
+
+	// Files without any of R, G and B are luminance / chroma images,
+	// which are read through the RGBA interface to convert them.
+	const Imf::ChannelList& channels = header.channels();
+	const Imf::Channel* rgba[4] = {
+		channels.findChannel( "R"), channels.findChannel( "G"),
+		channels.findChannel( "B"), channels.findChannel( "A") };
+	fLuminance = !rgba[0] && !rgba[1] && !rgba[2];
+	fChannels = rgba[3] ? 4 : 3;
+
+	// Read halfs and convert them ourselves only if every channel we
+	// load is half; anything else is converted to float by the library.
+	fPixelType = Imf::HALF;
+	for( int c = 0; c < 4; c++)
+	{
+		if( rgba[c] && rgba[c]->type != Imf::HALF)
+			fPixelType = Imf::FLOAT;
+	}
+
 	if( info)
 	{
-		const Imf::Header& header = fInputFile->header();
-		fWidth = header.dataWindow().max.x - header.dataWindow().min.x + 1;
-		fHeight = header.dataWindow().max.y - header.dataWindow().min.y + 1;
 		info->width( fWidth);
 		info->height( fHeight);
-		const Imf::RgbaChannels channels = fInputFile->channels();
-		//printf( "Found rgbaChannels %d\n", (int)channels);
-		fChannels = channels & Imf::WRITE_A ? 4 : 3;
-
 		info->channels( fChannels);
 		info->numberOfImages( fLayers);
 		info->pixelType( MImage::kFloat);
@@ -123,54 +433,86 @@ MStatus OpenEXRImageFile::open( MString pathname, MImageFileInfo* info)
 ///////////////////////////////////////////////////////
 MStatus OpenEXRImageFile::load( MImage& image, unsigned int imageNumber)
 {
-	MStatus rval = MS::kFailure;
-	Imf::Array<Imf::Rgba> pixels;
-	try
+	if( !fInputFile)
+		return MS::kFailure;
+
+	const Imath::Box2i& dw = fInputFile->header().dataWindow();
+	return loadRegion( image, dw.min.x, dw.min.y, dw.max.x, dw.max.y);
+}
+
+//
+// DESCRIPTION:
+//		The region is split into bands of scanlines aligned to the
+//		file's compression blocks or tiles. Bands are read in parallel,
+//		each task with its own handle on the file, and written straight
+//		into the image rows so the whole frame is never held twice.
+///////////////////////////////////////////////////////
+MStatus OpenEXRImageFile::loadRegion( MImage& image, int xMin, int yMin, int xMax, int yMax)
+{
+	if( !fInputFile)
+		return MS::kFailure;
+
+	const Imf::Header& header = fInputFile->header();
+	const Imath::Box2i& dw = header.dataWindow();
+	if( xMin < dw.min.x) xMin = dw.min.x;
+	if( yMin < dw.min.y) yMin = dw.min.y;
+	if( xMax > dw.max.x) xMax = dw.max.x;
+	if( yMax > dw.max.y) yMax = dw.max.y;
+	if( xMin > xMax || yMin > yMax)
+		return MS::kInvalidParameter;
+
+	int width = xMax - xMin + 1;
+	int height = yMax - yMin + 1;
+
+	// Configure our Maya image to hold the result
+	MStatus rval = image.create( width, height, fChannels, MImage::kFloat);
+	if( MS::kSuccess != rval)
+		return rval;
+
+	int blockHeight = EXR_SCANLINE_BLOCK;
+	if( header.hasTileDescription())
+		blockHeight = header.tileDescription().ySize;
+
+	int numThreads = MThreadUtils::getNumThreads();
+	if( numThreads < 1)
+		numThreads = 1;
+
+	OpenEXRLoadRegion region;
+	region.pathname = fPathname.asChar();
+	region.luminance = fLuminance;
+	region.halfPixels = fPixelType == Imf::HALF;
+	region.channels = fChannels;
+	region.dataWindow = dw;
+	region.xMin = xMin;
+	region.yMin = yMin;
+	region.xMax = xMax;
+	region.yMax = yMax;
+	region.firstBandY = dw.min.y + ((yMin - dw.min.y) / blockHeight) * blockHeight;
+
+	int blocks = (yMax - region.firstBandY) / blockHeight + 1;
+	int blocksPerBand = blocks / (numThreads * EXR_BANDS_PER_THREAD);
+	if( blocksPerBand < 1)
+		blocksPerBand = 1;
+	region.bandHeight = blocksPerBand * blockHeight;
+	region.numBands = (yMax - region.firstBandY) / region.bandHeight + 1;
+	region.numTasks = region.numBands < numThreads ? region.numBands : numThreads;
+	region.dest = image.floatPixels();
+	region.nextBand = 0;
+	region.failed = 0;
+
+	if( region.numTasks == 1 || MS::kSuccess != MThreadPool::init())
 	{
-		// Setup a frame buffer to hold the image
-		int dw = fWidth;
-		int dh = fHeight;
-		int dx = fInputFile->dataWindow().min.x;
-		int dy = fInputFile->dataWindow().min.y;
-		pixels.resizeErase (dw * dh);
-		fInputFile->setFrameBuffer (pixels - dx - dy * dw, 1, dw);
-		fInputFile->readPixels( fInputFile->dataWindow().min.y, fInputFile->dataWindow().max.y);
-
-		// Configure our Maya image to hold the result
-		image.create( fWidth, fHeight, fChannels, MImage::kFloat);
-
-		// Now transfer the channels in
-		bool flipVertically = true;
-		float* dest = image.floatPixels();
-		if( flipVertically)
-		{
-			Imf::Rgba* src = pixels + (fHeight - 1) * fWidth;
-			for( int y = 0; y < fHeight; y++)
-			{
-				for( int x = 0; x < fWidth; x++)
-				{
-					*dest++ = src->r;
-					*dest++ = src->g;
-					*dest++ = src->b;
-					if( fChannels == 4)
-						*dest++ = src->a;
-					*src++;
-				}
-				src -= fWidth * 2;
-			}
-		}
-		else
-		{
-//			half* src = pixels;
-//			for( int y = 0; y < fHeight; y++)
-//				for( int x = 0; x < fWidth; x++)
-//					for( int c = 0; c < fChannels; c++)
-//						*dest++ = *src++;
-		}
+		readBands( &region);
+	}
+	else
+	{
+		MThreadPool::newParallelRegion( decomposeBands, &region);
 
-		rval = MS::kSuccess;
+		// release the reference taken by init()
+		MThreadPool::release();
 	}
-	catch (...)
+
+	if( region.failed)
 	{
 		//
 		// If some of the pixels in the file cannot be read,
@@ -179,9 +521,10 @@ MStatus OpenEXRImageFile::load( MImage& image, unsigned int imageNumber)
 		//
 
 		cerr << "OpenEXRImageFile::load() failed to load image." << endl;
+		return MS::kFailure;
 	}
 
-	return rval;
+	return MS::kSuccess;
 }
 
 
@@ -14,16 +14,24 @@
 
 #include <string>
 #include <stack>
+#include <vector>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
 #include <maya/MFnPlugin.h>
 #include <maya/MGlobal.h>
 #include <maya/MString.h>
 #include <maya/MPxCacheFormat.h>
 
+#include "mappedFile.h"
+
 using namespace std;
 
 class XmlCacheFormat : public MPxCacheFormat
@@ -854,6 +862,837 @@ void XmlCacheFormat::writeXmlValue( int value )
 }
 
 
+// ****************************************
+//
+//  IndexedCacheFormat
+//
+//  Binary form of the same cache data, for playback. Every value is
+//  stored as a record with a 16 byte header (four character tag, 32 bit
+//  count, 64 bit payload size) followed by the payload padded to a
+//  multiple of 8 bytes, so array payloads stay aligned in a mapped file.
+//  Everything is little endian.
+//
+//	MCXB version				file header, 8 bytes
+//	VERS STIM ETIM				cache header
+//	CHNK TIME [CHNM SIZE array]* ENDC	one chunk per cached time
+//	INDX					(time, chunk offset) pairs, sorted by time
+//	index offset, MCXI			16 byte trailer
+//
+//  Readers map the file and look times up with a binary search of the
+//  index rather than parsing every chunk in front of the one they want.
+//  Arrays are written and read as single blocks. The xml format remains
+//  available for caches that need to be read by eye.
+//
+
+#define MCX_TAG(a,b,c,d)	((unsigned)(a) | ((unsigned)(b) << 8) | \
+							 ((unsigned)(c) << 16) | ((unsigned)(d) << 24))
+
+static const unsigned kFileMagic	= MCX_TAG('M','C','X','B');
+static const unsigned kIndexMagic	= MCX_TAG('M','C','X','I');
+static const unsigned kFileVersion	= 1;
+static const unsigned kTagVersion	= MCX_TAG('V','E','R','S');
+static const unsigned kTagStartTime	= MCX_TAG('S','T','I','M');
+static const unsigned kTagEndTime	= MCX_TAG('E','T','I','M');
+static const unsigned kTagChunk		= MCX_TAG('C','H','N','K');
+static const unsigned kTagEndChunk	= MCX_TAG('E','N','D','C');
+static const unsigned kTagTime		= MCX_TAG('T','I','M','E');
+static const unsigned kTagChannel	= MCX_TAG('C','H','N','M');
+static const unsigned kTagSize		= MCX_TAG('S','I','Z','E');
+static const unsigned kTagInt32		= MCX_TAG('I','N','T','4');
+static const unsigned kTagDoubleArray		= MCX_TAG('D','B','L','A');
+static const unsigned kTagFloatArray		= MCX_TAG('F','L','T','A');
+static const unsigned kTagDoubleVectorArray	= MCX_TAG('D','V','C','A');
+static const unsigned kTagFloatVectorArray	= MCX_TAG('F','V','C','A');
+static const unsigned kTagIndex		= MCX_TAG('I','N','D','X');
+
+static const size_t kFileHeaderSize		= 8;
+static const size_t kRecordHeaderSize	= 16;
+static const size_t kTrailerSize		= 16;
+static const size_t kIndexEntrySize		= 16;
+
+// Cached times differing by less than this, in 6000fps ticks, match.
+//
+static const double kTimeTolerance	= 1.0e-6;
+
+static bool hostIsLittleEndian()
+{
+	const unsigned one = 1;
+	return *(const unsigned char*)&one == 1;
+}
+
+// Seek to an offset from the start of the file. long is only 32 bits
+// on Windows, so fseek() cannot reach past 2GB there.
+//
+static int seekFile( FILE* fp, unsigned long long offset )
+{
+#if defined(_WIN32)
+	return _fseeki64( fp, (__int64)offset, SEEK_SET );
+#else
+	return fseeko( fp, (off_t)offset, SEEK_SET );
+#endif
+}
+
+static void swapBytes( char* data, size_t elementSize, size_t count )
+{
+	for( size_t i = 0; i < count; i++, data += elementSize ) {
+		std::reverse( data, data + elementSize );
+	}
+}
+
+static unsigned getU32( const char* p )
+{
+	const unsigned char* b = (const unsigned char*)p;
+	return (unsigned)b[0] | ((unsigned)b[1] << 8) |
+		   ((unsigned)b[2] << 16) | ((unsigned)b[3] << 24);
+}
+
+static unsigned long long getU64( const char* p )
+{
+	return (unsigned long long)getU32( p ) | ((unsigned long long)getU32( p + 4 ) << 32);
+}
+
+static double getDouble( const char* p )
+{
+	unsigned long long bits = getU64( p );
+	double value;
+	memcpy( &value, &bits, sizeof(value) );
+	return value;
+}
+
+static void putU32( char* p, unsigned value )
+{
+	for( int i = 0; i < 4; i++ ) p[i] = (char)((value >> (8 * i)) & 0xff);
+}
+
+static void putU64( char* p, unsigned long long value )
+{
+	putU32( p, (unsigned)(value & 0xffffffff) );
+	putU32( p + 4, (unsigned)(value >> 32) );
+}
+
+static void putDouble( char* p, double value )
+{
+	unsigned long long bits;
+	memcpy( &bits, &value, sizeof(bits) );
+	putU64( p, bits );
+}
+
+class IndexedCacheFormat : public MPxCacheFormat
+{
+public:
+	IndexedCacheFormat();
+	~IndexedCacheFormat();
+
+	static void*	creator();
+	static MString	translatorName();
+
+	MStatus		isValid();
+
+	MStatus		open( const MString& fileName, FileAccessMode mode);
+	void		close();
+
+	MStatus		readHeader();
+	MStatus		writeHeader(const MString& version, MTime& startTime, MTime& endTime);
+
+	void		beginWriteChunk();
+	void		endWriteChunk();
+	MStatus		beginReadChunk();
+	void		endReadChunk();
+
+	MStatus		writeTime(MTime& time);
+	MStatus		readTime(MTime& time);
+	MStatus		findTime(MTime& time, MTime& foundTime);
+	MStatus		readNextTime(MTime& foundTime);
+
+	unsigned	readArraySize();
+
+	MStatus		writeDoubleArray(const MDoubleArray&);
+	MStatus		readDoubleArray(MDoubleArray&, unsigned size);
+	MStatus		writeFloatArray(const MFloatArray&);
+	MStatus		readFloatArray(MFloatArray&, unsigned size);
+	MStatus		writeDoubleVectorArray(const MVectorArray& array);
+	MStatus		readDoubleVectorArray(MVectorArray&, unsigned arraySize);
+	MStatus		writeFloatVectorArray(const MFloatVectorArray& array);
+	MStatus		readFloatVectorArray(MFloatVectorArray& array, unsigned arraySize);
+
+	MStatus		writeChannelName(const MString & name);
+	MStatus		findChannelName(const MString & name);
+	MStatus		readChannelName(MString& name);
+
+	MStatus		writeInt32(int);
+	int			readInt32();
+	MStatus		rewind();
+
+	MString		extension();
+
+protected:
+	static MString	fExtension;
+	static MString	fCacheFormatName;
+
+private:
+	struct IndexEntry
+	{
+		double				time;		// 6000fps ticks
+		unsigned long long	offset;		// of the chunk record
+	};
+	struct IndexEntryLess
+	{
+		bool operator()( const IndexEntry& a, const IndexEntry& b ) const { return a.time < b.time; }
+		bool operator()( const IndexEntry& a, double t ) const { return a.time < t; }
+	};
+
+	// Writing
+	bool		writeRecord( unsigned tag, unsigned count, const char* data, size_t bytes );
+	bool		writeArrayRecord( unsigned tag, unsigned count, size_t scalarSize, size_t scalars );
+	bool		writeIndex();
+
+	// Reading
+	bool		openForRead( const MString& fileName );
+	bool		nextRecord( size_t& pos, unsigned& tag, unsigned& count,
+							const char*& payload, size_t& bytes ) const;
+	bool		findRecord( unsigned tag, bool inChunk, unsigned& count,
+							const char*& payload, size_t& bytes );
+	const char*	littleEndianView( const char* payload, size_t scalarSize, size_t scalars );
+
+	MString					fFileName;
+	FileAccessMode			fMode;
+
+	FILE*					fOut;
+	unsigned long long		fWriteOffset;
+	unsigned long long		fChunkOffset;
+	bool					fChunkIndexed;
+
+	mappedFile				fIn;
+	size_t					fDataStart;		// first chunk
+	size_t					fDataEnd;		// index record
+	size_t					fPos;
+
+	std::vector<IndexEntry>	fIndex;
+	std::vector<char>		fScratch;
+};
+
+MString IndexedCacheFormat::fExtension = "mci";
+MString IndexedCacheFormat::fCacheFormatName = "indexed";
+
+inline MString IndexedCacheFormat::translatorName()
+{	return fCacheFormatName; }
+
+void* IndexedCacheFormat::creator()
+{
+	return new IndexedCacheFormat();
+}
+
+IndexedCacheFormat::IndexedCacheFormat()
+:	fMode( kRead ),
+	fOut( NULL ),
+	fWriteOffset( 0 ),
+	fChunkOffset( 0 ),
+	fChunkIndexed( true ),
+	fDataStart( 0 ),
+	fDataEnd( 0 ),
+	fPos( 0 )
+{
+}
+
+IndexedCacheFormat::~IndexedCacheFormat()
+{
+	close();
+}
+
+MString
+IndexedCacheFormat::extension()
+{
+	return fExtension;
+}
+
+MStatus
+IndexedCacheFormat::open(const MString& fileName, FileAccessMode mode)
+{
+	assert((fileName.length() > 0));
+
+	close();
+	fFileName = fileName;
+	fMode = mode;
+
+	if( mode == kRead ) {
+		return openForRead( fileName ) ? MS::kSuccess : MS::kFailure;
+	}
+
+	if( mode == kReadWrite ) {
+		// Append after the last chunk. The new index is written over
+		// the old one when the file is closed.
+		if( openForRead( fileName ) ) {
+			fWriteOffset = fDataEnd;
+			fIn.close();
+			fOut = fopen( fFileName.asChar(), "r+b" );
+			if( NULL == fOut || 0 != seekFile( fOut, fWriteOffset ) ) {
+				close();
+				return MS::kFailure;
+			}
+			setvbuf( fOut, NULL, _IOFBF, 1 << 20 );
+			return MS::kSuccess;
+		}
+		fIndex.clear();
+	}
+
+	fOut = fopen( fFileName.asChar(), "wb" );
+	if( NULL == fOut ) {
+		return MS::kFailure;
+	}
+	setvbuf( fOut, NULL, _IOFBF, 1 << 20 );
+
+	char header[kFileHeaderSize];
+	putU32( header, kFileMagic );
+	putU32( header + 4, kFileVersion );
+	fWriteOffset = 0;
+	if( fwrite( header, 1, sizeof(header), fOut ) != sizeof(header) ) {
+		close();
+		return MS::kFailure;
+	}
+	fWriteOffset = sizeof(header);
+	return MS::kSuccess;
+}
+
+bool
+IndexedCacheFormat::openForRead(const MString& fileName)
+//
+//  Map the file, check the header and trailer and load the index.
+//  Only files written by this format are accepted.
+//
+{
+	if( !fIn.open( fileName.asChar() ) ) {
+		return false;
+	}
+
+	const char* data = fIn.data();
+	size_t size = fIn.size();
+	if( size < kFileHeaderSize + kTrailerSize ||
+		getU32( data ) != kFileMagic ||
+		getU32( data + 4 ) != kFileVersion ||
+		getU32( data + size - kTrailerSize + 8 ) != kIndexMagic )
+	{
+		fIn.close();
+		return false;
+	}
+
+	unsigned long long indexOffset = getU64( data + size - kTrailerSize );
+	if( indexOffset < kFileHeaderSize || indexOffset > size - kTrailerSize ) {
+		fIn.close();
+		return false;
+	}
+	fDataEnd = size - kTrailerSize;
+
+	size_t pos = (size_t)indexOffset;
+	unsigned tag, count;
+	const char* payload;
+	size_t bytes;
+	if( !nextRecord( pos, tag, count, payload, bytes ) || tag != kTagIndex ||
+		bytes != (size_t)count * kIndexEntrySize )
+	{
+		fIn.close();
+		return false;
+	}
+
+	fIndex.resize( count );
+	for( unsigned i = 0; i < count; i++ ) {
+		fIndex[i].time = getDouble( payload + i * kIndexEntrySize );
+		fIndex[i].offset = getU64( payload + i * kIndexEntrySize + 8 );
+	}
+
+	fDataEnd = (size_t)indexOffset;
+	fPos = kFileHeaderSize;
+	fDataStart = kFileHeaderSize;
+	return MS::kSuccess == readHeader();
+}
+
+MStatus
+IndexedCacheFormat::isValid()
+{
+	bool rtn = fIn.isOpen() || fOut != NULL;
+	return rtn ? MS::kSuccess : MS::kFailure ;
+}
+
+void IndexedCacheFormat::close()
+{
+	if( fOut ) {
+		writeIndex();
+		if( fclose( fOut ) != 0 ) {
+			cerr << "IndexedCacheFormat: error writing " << fFileName.asChar() << "\n";
+		}
+		fOut = NULL;
+	}
+	fIn.close();
+	fIndex.clear();
+	fChunkIndexed = true;
+	fDataStart = fDataEnd = fPos = 0;
+}
+
+MStatus
+IndexedCacheFormat::rewind()
+{
+	if( !fIn.isOpen() ) {
+		return MS::kFailure;
+	}
+	fPos = fDataStart;
+	return MS::kSuccess;
+}
+
+MStatus
+IndexedCacheFormat::readHeader()
+{
+	if( !fIn.isOpen() ) {
+		return MS::kFailure;
+	}
+
+	// The version and time range are not used, as in the xml format,
+	// but they must be present.
+	size_t pos = kFileHeaderSize;
+	unsigned tag, count;
+	const char* payload;
+	size_t bytes;
+	if( !nextRecord( pos, tag, count, payload, bytes ) || tag != kTagVersion ||
+		!nextRecord( pos, tag, count, payload, bytes ) || tag != kTagStartTime ||
+		!nextRecord( pos, tag, count, payload, bytes ) || tag != kTagEndTime )
+	{
+		return MS::kFailure;
+	}
+
+	fDataStart = fPos = pos;
+	return MS::kSuccess;
+}
+
+MStatus
+IndexedCacheFormat::writeHeader(const MString& version, MTime& startTime, MTime& endTime)
+{
+	char time[8];
+	bool rtn = writeRecord( kTagVersion, version.length(), version.asChar(), version.length() );
+
+	putDouble( time, startTime.as( MTime::k6000FPS ) );
+	rtn = rtn && writeRecord( kTagStartTime, 1, time, sizeof(time) );
+
+	putDouble( time, endTime.as( MTime::k6000FPS ) );
+	rtn = rtn && writeRecord( kTagEndTime, 1, time, sizeof(time) );
+
+	return rtn ? MS::kSuccess : MS::kFailure ;
+}
+
+void IndexedCacheFormat::beginWriteChunk()
+{
+	fChunkOffset = fWriteOffset;
+	fChunkIndexed = false;
+	writeRecord( kTagChunk, 0, NULL, 0 );
+}
+
+void IndexedCacheFormat::endWriteChunk()
+{
+	writeRecord( kTagEndChunk, 0, NULL, 0 );
+	fChunkIndexed = true;
+}
+
+MStatus
+IndexedCacheFormat::writeTime(MTime& time)
+{
+	double ticks = time.as( MTime::k6000FPS );
+
+	// The first time in a chunk is the one it is indexed under
+	if( !fChunkIndexed ) {
+		IndexEntry entry;
+		entry.time = ticks;
+		entry.offset = fChunkOffset;
+		fIndex.push_back( entry );
+		fChunkIndexed = true;
+	}
+
+	char value[8];
+	putDouble( value, ticks );
+	return writeRecord( kTagTime, 1, value, sizeof(value) ) ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus
+IndexedCacheFormat::writeChannelName(const MString& name)
+{
+	return writeRecord( kTagChannel, name.length(), name.asChar(), name.length() ) ?
+		MS::kSuccess : MS::kFailure;
+}
+
+MStatus IndexedCacheFormat::writeInt32(int i)
+{
+	return writeRecord( kTagInt32, (unsigned)i, NULL, 0 ) ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus
+IndexedCacheFormat::writeDoubleArray(const MDoubleArray& array)
+{
+	unsigned size = array.length();
+	fScratch.resize( (size ? size : 1) * sizeof(double) );
+	array.get( (double*)&fScratch[0] );
+	return writeArrayRecord( kTagDoubleArray, size, sizeof(double), size ) ?
+		MS::kSuccess : MS::kFailure;
+}
+
+MStatus
+IndexedCacheFormat::writeFloatArray(const MFloatArray& array)
+{
+	unsigned size = array.length();
+	fScratch.resize( (size ? size : 1) * sizeof(float) );
+	array.get( (float*)&fScratch[0] );
+	return writeArrayRecord( kTagFloatArray, size, sizeof(float), size ) ?
+		MS::kSuccess : MS::kFailure;
+}
+
+MStatus
+IndexedCacheFormat::writeDoubleVectorArray(const MVectorArray& array)
+{
+	unsigned size = array.length();
+	fScratch.resize( (size ? size : 1) * 3 * sizeof(double) );
+	array.get( (double (*)[3])&fScratch[0] );
+	return writeArrayRecord( kTagDoubleVectorArray, size, sizeof(double), 3 * (size_t)size ) ?
+		MS::kSuccess : MS::kFailure;
+}
+
+MStatus
+IndexedCacheFormat::writeFloatVectorArray(const MFloatVectorArray& array)
+{
+	unsigned size = array.length();
+	fScratch.resize( (size ? size : 1) * 3 * sizeof(float) );
+	array.get( (float (*)[3])&fScratch[0] );
+	return writeArrayRecord( kTagFloatVectorArray, size, sizeof(float), 3 * (size_t)size ) ?
+		MS::kSuccess : MS::kFailure;
+}
+
+bool IndexedCacheFormat::writeArrayRecord( unsigned tag, unsigned count,
+										   size_t scalarSize, size_t scalars )
+//
+//  Write the size record and the array held in fScratch.
+//
+{
+	if( !hostIsLittleEndian() ) {
+		swapBytes( &fScratch[0], scalarSize, scalars );
+	}
+	return writeRecord( kTagSize, count, NULL, 0 ) &&
+		   writeRecord( tag, count, &fScratch[0], scalarSize * scalars );
+}
+
+bool IndexedCacheFormat::writeRecord( unsigned tag, unsigned count,
+									  const char* data, size_t bytes )
+{
+	if( NULL == fOut ) {
+		return false;
+	}
+
+	static const char padding[8] = { 0 };
+	size_t pad = (8 - (bytes & 7)) & 7;
+
+	char header[kRecordHeaderSize];
+	putU32( header, tag );
+	putU32( header + 4, count );
+	putU64( header + 8, bytes );
+
+	bool rtn = fwrite( header, 1, sizeof(header), fOut ) == sizeof(header);
+	if( bytes ) {
+		rtn = rtn && fwrite( data, 1, bytes, fOut ) == bytes;
+	}
+	if( pad ) {
+		rtn = rtn && fwrite( padding, 1, pad, fOut ) == pad;
+	}
+	fWriteOffset += sizeof(header) + bytes + pad;
+	return rtn;
+}
+
+bool IndexedCacheFormat::writeIndex()
+//
+//  Write the index, sorted by time, and the trailer pointing at it.
+//  A chunk appended at a time that is already cached replaces the
+//  older one, which stays in the file but is no longer indexed.
+//
+{
+	std::stable_sort( fIndex.begin(), fIndex.end(), IndexEntryLess() );
+
+	// the sort is stable, so the newest of equal times comes last
+	size_t kept = 0;
+	for( size_t i = 0; i < fIndex.size(); i++ ) {
+		if( i + 1 < fIndex.size() &&
+			fIndex[i + 1].time - fIndex[i].time < kTimeTolerance ) {
+			continue;
+		}
+		fIndex[kept++] = fIndex[i];
+	}
+	fIndex.resize( kept );
+
+	unsigned long long indexOffset = fWriteOffset;
+	fScratch.resize( fIndex.size() * kIndexEntrySize + 1 );
+	for( size_t i = 0; i < fIndex.size(); i++ ) {
+		putDouble( &fScratch[i * kIndexEntrySize], fIndex[i].time );
+		putU64( &fScratch[i * kIndexEntrySize + 8], fIndex[i].offset );
+	}
+	bool rtn = writeRecord( kTagIndex, (unsigned)fIndex.size(), &fScratch[0],
+							fIndex.size() * kIndexEntrySize );
+
+	char trailer[kTrailerSize];
+	putU64( trailer, indexOffset );
+	putU32( trailer + 8, kIndexMagic );
+	putU32( trailer + 12, 0 );
+	rtn = rtn && fwrite( trailer, 1, sizeof(trailer), fOut ) == sizeof(trailer);
+	return rtn;
+}
+
+bool IndexedCacheFormat::nextRecord( size_t& pos, unsigned& tag, unsigned& count,
+									 const char*& payload, size_t& bytes ) const
+//
+//  Decode the record at pos and advance past it. Fails at the end of
+//  the chunk data or if the record runs past it.
+//
+{
+	if( pos + kRecordHeaderSize > fDataEnd || pos + kRecordHeaderSize < pos ) {
+		return false;
+	}
+
+	const char* header = fIn.data() + pos;
+	unsigned long long size = getU64( header + 8 );
+	unsigned long long padded = (size + 7) & ~(unsigned long long)7;
+	if( padded < size || padded > fDataEnd - pos - kRecordHeaderSize ) {
+		return false;
+	}
+
+	tag = getU32( header );
+	count = getU32( header + 4 );
+	payload = header + kRecordHeaderSize;
+	bytes = (size_t)size;
+	pos += kRecordHeaderSize + (size_t)padded;
+	return true;
+}
+
+bool IndexedCacheFormat::findRecord( unsigned tag, bool inChunk, unsigned& count,
+									 const char*& payload, size_t& bytes )
+//
+//  Skip forward to the next record with the given tag. When inChunk is
+//  set the search stops in front of the end of the current chunk.
+//
+{
+	if( !fIn.isOpen() ) {
+		return false;
+	}
+
+	size_t pos = fPos;
+	unsigned found;
+	while( nextRecord( pos, found, count, payload, bytes ) ) {
+		if( found == tag ) {
+			fPos = pos;
+			return true;
+		}
+		if( inChunk && (found == kTagEndChunk || found == kTagChunk) ) {
+			break;
+		}
+		fPos = pos;
+	}
+	return false;
+}
+
+const char* IndexedCacheFormat::littleEndianView( const char* payload,
+												  size_t scalarSize, size_t scalars )
+//
+//  Arrays are used in place when the host is little endian, which the
+//  record alignment keeps aligned; otherwise they are swapped in a copy.
+//
+{
+	if( hostIsLittleEndian() && ((size_t)payload % scalarSize) == 0 ) {
+		return payload;
+	}
+	fScratch.resize( scalarSize * scalars + 1 );
+	memcpy( &fScratch[0], payload, scalarSize * scalars );
+	if( !hostIsLittleEndian() ) {
+		swapBytes( &fScratch[0], scalarSize, scalars );
+	}
+	return &fScratch[0];
+}
+
+MStatus
+IndexedCacheFormat::readTime(MTime& time)
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	if( !findRecord( kTagTime, false, count, payload, bytes ) || bytes != 8 ) {
+		return MS::kFailure;
+	}
+	time = MTime( getDouble( payload ), MTime::k6000FPS );
+	return MS::kSuccess;
+}
+
+MStatus
+IndexedCacheFormat::readNextTime(MTime& foundTime)
+{
+	return readTime( foundTime );
+}
+
+MStatus
+IndexedCacheFormat::findTime(MTime& time, MTime& foundTime)
+//
+//  Look the time up in the index and position the reader just after
+//  the time record of its chunk, as the xml format does.
+//
+{
+	if( !fIn.isOpen() ) {
+		return MS::kFailure;
+	}
+
+	double seek = time.as( MTime::k6000FPS );
+	std::vector<IndexEntry>::const_iterator entry =
+		std::lower_bound( fIndex.begin(), fIndex.end(), seek - kTimeTolerance, IndexEntryLess() );
+	if( entry == fIndex.end() || entry->time > seek + kTimeTolerance ||
+		entry->offset < fDataStart || entry->offset >= fDataEnd )
+	{
+		return MS::kFailure;
+	}
+
+	size_t pos = (size_t)entry->offset;
+	unsigned tag, count;
+	const char* payload;
+	size_t bytes;
+	if( !nextRecord( pos, tag, count, payload, bytes ) || tag != kTagChunk ) {
+		return MS::kFailure;
+	}
+	fPos = pos;
+
+	return readTime( foundTime );
+}
+
+MStatus IndexedCacheFormat::beginReadChunk()
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	return findRecord( kTagChunk, false, count, payload, bytes ) ? MS::kSuccess : MS::kFailure;
+}
+
+void IndexedCacheFormat::endReadChunk()
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	findRecord( kTagEndChunk, false, count, payload, bytes );
+}
+
+MStatus
+IndexedCacheFormat::findChannelName(const MString& name)
+{
+	MString channel;
+	while( readChannelName( channel ) ) {
+		if( channel == name ) {
+			return MS::kSuccess;
+		}
+	}
+	return MS::kFailure;
+}
+
+MStatus
+IndexedCacheFormat::readChannelName(MString& name)
+//
+//  If no more channels exist in the chunk, return failure. As in the
+//  xml format, callers rely on this to stop scanning for channels.
+//
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	name.clear();
+	if( findRecord( kTagChannel, true, count, payload, bytes ) ) {
+		name = MString( payload, (int)bytes );
+	}
+	return name.length() == 0 ? MS::kFailure : MS::kSuccess;
+}
+
+int
+IndexedCacheFormat::readInt32()
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	if( !findRecord( kTagInt32, true, count, payload, bytes ) ) {
+		return 0;
+	}
+	return (int)count;
+}
+
+unsigned
+IndexedCacheFormat::readArraySize()
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	if( !findRecord( kTagSize, true, count, payload, bytes ) ) {
+		return 0;
+	}
+	return count;
+}
+
+MStatus
+IndexedCacheFormat::readDoubleArray(MDoubleArray& array, unsigned arraySize)
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	if( !findRecord( kTagDoubleArray, true, count, payload, bytes ) ||
+		count != arraySize || bytes != (size_t)count * sizeof(double) )
+	{
+		return MS::kFailure;
+	}
+	const double* values = (const double*)littleEndianView( payload, sizeof(double), count );
+	array = MDoubleArray( values, count );
+	return MS::kSuccess;
+}
+
+MStatus
+IndexedCacheFormat::readFloatArray(MFloatArray& array, unsigned arraySize)
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	if( !findRecord( kTagFloatArray, true, count, payload, bytes ) ||
+		count != arraySize || bytes != (size_t)count * sizeof(float) )
+	{
+		return MS::kFailure;
+	}
+	const float* values = (const float*)littleEndianView( payload, sizeof(float), count );
+	array = MFloatArray( values, count );
+	return MS::kSuccess;
+}
+
+MStatus
+IndexedCacheFormat::readDoubleVectorArray(MVectorArray& array, unsigned arraySize)
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	if( !findRecord( kTagDoubleVectorArray, true, count, payload, bytes ) ||
+		count != arraySize || bytes != (size_t)count * 3 * sizeof(double) )
+	{
+		return MS::kFailure;
+	}
+	const double (*values)[3] =
+		(const double (*)[3])littleEndianView( payload, sizeof(double), 3 * (size_t)count );
+	array = MVectorArray( values, count );
+	return MS::kSuccess;
+}
+
+MStatus
+IndexedCacheFormat::readFloatVectorArray(MFloatVectorArray& array, unsigned arraySize)
+{
+	unsigned count;
+	const char* payload;
+	size_t bytes;
+	if( !findRecord( kTagFloatVectorArray, true, count, payload, bytes ) ||
+		count != arraySize || bytes != (size_t)count * 3 * sizeof(float) )
+	{
+		return MS::kFailure;
+	}
+	const float (*values)[3] =
+		(const float (*)[3])littleEndianView( payload, sizeof(float), 3 * (size_t)count );
+	array = MFloatVectorArray( values, count );
+	return MS::kSuccess;
+}
+
+
 
 // ****************************************
 
@@ -868,6 +1707,11 @@ MStatus initializePlugin(MObject obj)
 		XmlCacheFormat::creator
 	);
 
+	plugin.registerCacheFormat(
+		IndexedCacheFormat::translatorName(),
+		IndexedCacheFormat::creator
+	);
+
 	return MS::kSuccess;
 }
 
@@ -877,6 +1721,7 @@ MStatus uninitializePlugin(MObject obj)
 	MFnPlugin plugin( obj );
 
 	plugin.deregisterCacheFormat(XmlCacheFormat::translatorName());
+	plugin.deregisterCacheFormat(IndexedCacheFormat::translatorName());
 
 	return MS::kSuccess;
 }
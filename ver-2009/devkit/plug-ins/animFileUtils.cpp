@@ -61,6 +61,8 @@
 #include <maya/MAnimCurveClipboard.h>
 #include <maya/MAnimCurveClipboardItem.h>
 #include <maya/MAnimCurveClipboardItemArray.h>
+#include <maya/MTimeArray.h>
+#include <maya/MDoubleArray.h>
 
 #if defined (OSMac_)
 using namespace std;
@@ -528,6 +530,19 @@ const char *kInputUnitString = "inputUnit";
 const char *kOutputUnitString = "outputUnit";
 const char *kTanAngleUnitString = "tangentAngleUnit";
 const char *kKeysString = "keys";
+const char *kKeysBinaryString = "keysBinary";
+
+//	A keysBinary block holds one fixed size record per key, in place of
+//	the lines of a keys block: six little-endian IEEE doubles (time, value,
+//	in angle, in weight, out angle, out weight), the in and out tangent
+//	types and a byte of flags. Values and angles are in Maya's internal
+//	units rather than the units of the file, so a curve survives an
+//	export and import unchanged.
+//
+const size_t kBinaryKeySize = 6 * 8 + 4;
+const unsigned char kBinaryTangentsLocked	= 0x01;
+const unsigned char kBinaryWeightsLocked	= 0x02;
+const unsigned char kBinaryBreakdown		= 0x04;
 
 //	special characters
 //
@@ -962,6 +977,229 @@ bool animBase::isEquivalent(double a, double b)
 	return ((a > b) ? (a - b <= tolerance) : (b - a <= tolerance));
 }
 
+//-----------------------------------------------------------------------------
+//	Class animBuffer
+//-----------------------------------------------------------------------------
+
+void animBuffer::ignoreLine()
+//
+//	Description:
+//		Skips past the next newline, like ifstream::ignore(INT_MAX, '\n').
+//
+{
+	const char *newLine = (const char *) memchr(pos, kNewLineChar, end - pos);
+	pos = (newLine != NULL) ? newLine + 1 : end;
+}
+
+//	Exact powers of ten. Every double up to 1e22 is exactly representable,
+//	so a mantissa below 2^53 scaled by one of these is correctly rounded.
+//
+static const double kPowersOfTen[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool parseDouble(const char *&pos, const char *end, double &value)
+//
+//	Description:
+//		Parses a decimal number at pos, leaving pos after it. Numbers whose
+//		significant digits form an integer below 2^53 (every number of up
+//		to 15 digits, and some of 16 to 19) and whose decimal exponent is
+//		at most 22 either way, which covers all that animWriter produces,
+//		are converted directly; anything else is handed to strtod.
+//
+//		false is returned if there is no number at pos.
+//
+{
+	const char *p = pos;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+	for (; p < end && *p >= '0' && *p <= '9'; p++) {
+		any = true;
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) digits++;
+		} else {
+			exponent++;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+			any = true;
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) digits++;
+				exponent--;
+			}
+		}
+	}
+	if (!any) {
+		return false;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char *e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+')) {
+			negativeExponent = (*e == '-');
+			e++;
+		}
+		if (e < end && *e >= '0' && *e <= '9') {
+			int power = 0;
+			for (; e < end && *e >= '0' && *e <= '9'; e++) {
+				if (power < 10000) power = power * 10 + (*e - '0');
+			}
+			exponent += negativeExponent ? -power : power;
+			p = e;
+		}
+	}
+
+	if (mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+		value = (double) mantissa;
+		if (exponent < 0) {
+			value /= kPowersOfTen[-exponent];
+		} else {
+			value *= kPowersOfTen[exponent];
+		}
+		if (negative) value = -value;
+	} else {
+		char number[128];
+		size_t length = p - pos;
+		if (length >= sizeof(number)) {
+			return false;
+		}
+		memcpy(number, pos, length);
+		number[length] = 0x00;
+		value = strtod(number, NULL);
+	}
+	pos = p;
+	return true;
+}
+
+void animBase::advance (animBuffer &clipFile)
+//
+//	Description:
+//		The method skips past all of the whitespace and commented lines
+//		in the buffer. It will also ignore semi-colons.
+//
+{
+	while (!clipFile.eof()) {
+		char next = *clipFile.pos;
+
+		if (next == kSpaceChar || next == kTabChar || next == kNewLineChar ||
+			next == '\r' || next == '\v' || next == '\f' ||
+			next == kSemiColonChar) {
+			clipFile.pos++;
+			continue;
+		}
+
+		if (next == kSlashChar || next == kHashChar) {
+			clipFile.ignoreLine();
+			continue;
+		}
+
+		break;
+	}
+}
+
+double animBase::asDouble (animBuffer &clipFile)
+//
+//	Description:
+//		Reads the next bit of valid data as a double. If there is no
+//		number, the rest of the buffer is skipped, as an ifstream
+//		would stop reading once it failed.
+//
+{
+	advance(clipFile);
+
+	double value = 0.0;
+	if (!parseDouble(clipFile.pos, clipFile.end, value)) {
+		clipFile.pos = clipFile.end;
+		clipFile.failed = true;
+	}
+
+	return (value);
+}
+
+bool animBase::isNextNumeric(animBuffer &clipFile)
+//
+//	Description:
+//		The method skips past whitespace and comments and checks if
+//		the next character is numeric.
+//		
+//		true is returned if the character is numeric.
+//
+{
+	advance(clipFile);
+
+	char next = clipFile.peek();
+	return (next >= '0' && next <= '9');
+}
+
+char* animBase::asWord (animBuffer &clipFile, bool includeWS /* false */)
+//
+//	Description:
+//		Returns the next word in the buffer, with the same rules as 
+//		asWord(ifstream &).
+//
+//		This method returns a pointer to a static variable, so its contents
+//		should be used immediately.
+//		
+{
+	static const int kBufLength = 1024;
+	static char string[kBufLength];
+
+	advance(clipFile);
+
+	char *c = string;
+	if (clipFile.eof()) {
+		*c = 0x00;
+		return (string);
+	}
+
+	char first = *clipFile.pos++;
+	if (first == kDoubleQuoteChar) {
+		while (!clipFile.eof() && (*clipFile.pos != kDoubleQuoteChar)) {
+			if (c - string >= kBufLength - 1) {
+				break;
+			}
+			*c++ = *clipFile.pos++;
+		}
+		if (!clipFile.eof() && *clipFile.pos == kDoubleQuoteChar) {
+			clipFile.pos++;
+		}
+	} else if (first == kBraceLeftChar || first == kBraceRightChar) {
+		//	Get the case of the '{' or '}' character
+		//
+		*c++ = first;
+	} else if (first != kSemiColonChar) {
+		*c++ = first;
+		while (!clipFile.eof()) {
+			char next = *clipFile.pos++;
+			if (next == kSemiColonChar) {
+				break;
+			}
+			if (!includeWS && ((next == kSpaceChar) || (next == kTabChar))) {
+				break;
+			}
+			if (c - string >= kBufLength - 1) {
+				break;
+			}
+			*c++ = next;
+		}
+	}
+	*c = 0x00;
+
+	return (string);
+}
+
 //-----------------------------------------------------------------------------
 //	Class animReader
 //-----------------------------------------------------------------------------
@@ -993,7 +1231,37 @@ animReader::readClipboard(ifstream &readAnim, MAnimCurveClipboard& cb)
 //		all of the anim curves described in ther stream into the 
 //		API clipboard.
 //
+//		The rest of the stream is read into memory and parsed from there.
+//
+{
+	std::vector<char> contents;
+	if (readAnim) {
+		streampos start = readAnim.tellg();
+		readAnim.seekg(0, ios::end);
+		streampos finish = readAnim.tellg();
+		readAnim.seekg(start);
+		if (start >= 0 && finish > start) {
+			contents.resize((size_t) (finish - start));
+			readAnim.read(&contents[0], contents.size());
+			contents.resize((size_t) readAnim.gcount());
+		}
+	}
+
+	return readClipboard(contents.empty() ? NULL : &contents[0], 
+						 contents.size(), cb);
+}
+
+MStatus 
+animReader::readClipboard(const char *data, size_t length, 
+						  MAnimCurveClipboard& cb)
+//
+//	Description:
+//		Given a clipboard and the contents of a .anim file, add all of
+//		the anim curves described in the file into the API clipboard.
+//
 {
+	animBuffer readAnim(data, length);
+
 	//	Set the default values for the start and end of the clipboard.
 	//	The MAnimCurveClipboard::set() method will examine all of the
 	//	anim curves are determine the proper start and end values, if the
@@ -1222,7 +1490,7 @@ animReader::readClipboard(ifstream &readAnim, MAnimCurveClipboard& cb)
 
 				//	Skip to the next line, this one is invalid.
 				//
-				readAnim.ignore(INT_MAX, kNewLineChar);
+				readAnim.ignoreLine();
 			} else {
 				//	The end of the file was reached. 
 				//
@@ -1401,10 +1669,10 @@ void animReader::convertAnglesAndWeights2To3(MFnAnimCurve::AnimCurveType type,
 }
 
 bool animReader::readAnimCurve(
-ifstream &clipFile, MAnimCurveClipboardItem &item)
+animBuffer &clipFile, MAnimCurveClipboardItem &item)
 //
 //	Description:
-//		Read a block of the ifstream that should contain anim curve
+//		Read a block of the buffer that should contain anim curve
 //		data in the format determined by the animData keyword.
 //
 {
@@ -1423,6 +1691,8 @@ ifstream &clipFile, MAnimCurveClipboardItem &item)
 	MString outputUnitName;
 	MAngle::Unit tanAngleUnit = angularUnit;
 	bool isWeighted (false);
+	bool binaryKeys (false);
+	unsigned numBinaryKeys = 0;
 
 	char *dataType;
 	while (!clipFile.eof()) {
@@ -1461,7 +1731,14 @@ ifstream &clipFile, MAnimCurveClipboardItem &item)
 		} else if (strcmp(dataType, kKeysString) == 0) {
 			//	Ignore the rest of this line.
 			//
-			clipFile.ignore(INT_MAX, kNewLineChar);
+			clipFile.ignoreLine();
+			break;
+		} else if (strcmp(dataType, kKeysBinaryString) == 0) {
+			//	The records start on the line after the brace.
+			//
+			binaryKeys = true;
+			numBinaryKeys = (unsigned) asDouble(clipFile);
+			clipFile.ignoreLine();
 			break;
 		} else if (strcmp(dataType, "{") == 0) {
 			//	Skippping the '{' character. Just ignore it.
@@ -1580,40 +1857,119 @@ ifstream &clipFile, MAnimCurveClipboardItem &item)
 		}
 	}
 
-	// Now read each keyframe
+	// Now read each keyframe. All of the keys are read before any of
+	//	them are added, so that they can be added to the curve in one go.
 	//
+	std::vector<animKey> keys;
+	if (binaryKeys) {
+		conversion = 1.0;
+		tanAngleUnit = MAngle::internalUnit();
+	}
+	if (binaryKeys && !readBinaryKeys(clipFile, numBinaryKeys, keys)) {
+		MStatus stringStat;
+		MString msg = MStringResource::getString(kCouldNotKey, stringStat);
+		MGlobal::displayError(msg);
+	}
 	advance(clipFile);
 	char c = clipFile.peek();
-	while (clipFile && c != kBraceRightChar) {
-		double t = asDouble (clipFile);
-		double val = asDouble (clipFile);
+	while (!binaryKeys && !clipFile.eof() && c != kBraceRightChar) {
+		animKey key;
+		if (!readKey(clipFile, key)) {
+			break;
+		}
+		keys.push_back(key);
 
-		MFnAnimCurve::TangentType tanIn = wordAsTangentType(asWord(clipFile));
-		MFnAnimCurve::TangentType tanOut = wordAsTangentType(asWord(clipFile));
+		//	There should be no additional data on this line. Go to the
+		//	next line of data.
+		//
+		clipFile.ignoreLine();
+
+		//	Skip any comments.
+		//
+		advance(clipFile);
+		c = clipFile.peek();
+	}
+
+	unsigned numKeys = (unsigned) keys.size();
+
+	//	Curves with a time input can be keyed with a single addKeys call,
+	//	which is far cheaper than adding the keys one at a time. It takes
+	//	a single pair of tangent types, so the keys are added with the
+	//	types of the first key and any that differ are set afterwards.
+	//
+	bool keysAdded = false;
+	if ((type == MFnAnimCurve::kAnimCurveTL ||
+		 type == MFnAnimCurve::kAnimCurveTA ||
+		 type == MFnAnimCurve::kAnimCurveTU) && numKeys > 1) {
+
+		bool isIncreasing = true;
+		MTimeArray times(numKeys, MTime());
+		MDoubleArray values(numKeys);
+		for (unsigned k = 0; k < numKeys; k++) {
+			if (k > 0 && keys[k].time <= keys[k-1].time) {
+				isIncreasing = false;
+				break;
+			}
+			times.set(MTime(keys[k].time, inputTimeUnit), k);
+			values.set(keys[k].value*conversion, k);
+		}
+
+		//	Keys out of order or at the same time would be merged or
+		//	reordered by addKeys, so those are added one at a time.
+		//
+		if (isIncreasing) {
+			MFnAnimCurve::TangentType tanIn = keys[0].tanIn;
+			MFnAnimCurve::TangentType tanOut = keys[0].tanOut;
+			status = animCurve.addKeys(&times, &values, tanIn, tanOut);
+			if (status == MS::kSuccess && animCurve.numKeys() == numKeys) {
+				for (unsigned k = 0; k < numKeys; k++) {
+					if (keys[k].tanIn != tanIn) {
+						animCurve.setInTangentType(k, keys[k].tanIn);
+					}
+					if (keys[k].tanOut != tanOut) {
+						animCurve.setOutTangentType(k, keys[k].tanOut);
+					}
+					setKeyAttributes(animCurve, k, keys[k], type, 
+									 isWeighted, tanAngleUnit);
+				}
+				keysAdded = true;
+			} else {
+				while (animCurve.numKeys() > 0) {
+					animCurve.remove(0);
+				}
+			}
+		}
+	}
+
+	for (unsigned k = 0; !keysAdded && k < numKeys; k++) {
+		const animKey &key = keys[k];
 
 		switch (type) {
 			case MFnAnimCurve::kAnimCurveTT:
-				index = animCurve.addKey(	MTime(val, inputTimeUnit),
-											MTime(val, outputTimeUnit),
-											tanIn, tanOut, NULL, &status);
+				index = animCurve.addKey(	MTime(key.value, inputTimeUnit),
+											MTime(key.value, outputTimeUnit),
+											key.tanIn, key.tanOut, 
+											NULL, &status);
 				break;
 			case MFnAnimCurve::kAnimCurveTL:
 			case MFnAnimCurve::kAnimCurveTA:
 			case MFnAnimCurve::kAnimCurveTU:
-				index = animCurve.addKey(	MTime(t, inputTimeUnit),
-											val*conversion, tanIn, tanOut,
+				index = animCurve.addKey(	MTime(key.time, inputTimeUnit),
+											key.value*conversion, 
+											key.tanIn, key.tanOut,
 											NULL, &status);
 				break;
 			case MFnAnimCurve::kAnimCurveUL:
 			case MFnAnimCurve::kAnimCurveUA:
 			case MFnAnimCurve::kAnimCurveUU:
-				index = animCurve.addKey(	t, val*conversion, 
-											tanIn, tanOut,
+				index = animCurve.addKey(	key.time, key.value*conversion, 
+											key.tanIn, key.tanOut,
 											NULL, &status);
 				break;
 			case MFnAnimCurve::kAnimCurveUT:
-				index = animCurve.addKey(	t, MTime(val, outputTimeUnit),
-											tanIn, tanOut,
+				index = animCurve.addKey(	key.time, 
+											MTime(key.value, outputTimeUnit),
+											key.tanIn, key.tanOut,
 											NULL, &status);
 				break;
 			default:
@@ -1628,92 +1984,20 @@ ifstream &clipFile, MAnimCurveClipboardItem &item)
 			MGlobal::displayError(msg);
 		}
 
-		//	Tangent locking needs to be called after the weights and 
-		//	angles are set for the fixed tangents.
-		//
-		bool tLocked = bool(asDouble(clipFile) == 1.0);
-		bool swLocked = bool(asDouble(clipFile) == 1.0);
-		bool isBreakdown (false);
-		if (animVersion >= kVersionNonWeightedAndBreakdowns) {
-			isBreakdown = (asDouble(clipFile) == 1.0);
-		}
-
-		//	Only fixed tangents need additional information.
-		//
-		if (tanIn == MFnAnimCurve::kTangentFixed) {
-			MAngle inAngle(asDouble(clipFile), tanAngleUnit);
-			double inWeight = asDouble(clipFile);
-
-			//	If this is from a pre-Maya3.0 file, the tangent angles will 
-			//	need to be converted.
-			//
-			if (convertAnglesFromV2To3) {
-				convertAnglesAndWeights2To3(type,isWeighted,inAngle,inWeight);
-			} else if (convertAnglesFromV3To2) {
-				convertAnglesAndWeights3To2(type,isWeighted,inAngle,inWeight);
-			}
-
-			//  By default, the tangents are locked. When the tangents
-			//	are locked, setting the angle and weight of a fixed in
-			//	tangent may change the tangent type of the out tangent.
-			//
-			animCurve.setTangentsLocked(index, false);
-			animCurve.setTangent(index, inAngle, inWeight, true);
-		}
-
-		//	Only fixed tangents need additional information.
-		//
-		if (tanOut == MFnAnimCurve::kTangentFixed) {
-			MAngle outAngle(asDouble(clipFile), tanAngleUnit);
-			double outWeight = asDouble(clipFile);
-
-			//	If this is from a pre-Maya3.0 file, the tangent angles will 
-			//	need to be converted.
-			//
-			if (convertAnglesFromV2To3) {
-				convertAnglesAndWeights2To3(type,isWeighted,outAngle,outWeight);
-			} else if (convertAnglesFromV3To2) {
-				convertAnglesAndWeights3To2(type,isWeighted,outAngle,outWeight);
-			}
-			
-			//  By default, the tangents are locked. When the tangents
-			//	are locked, setting the angle and weight of a fixed out 
-			//	tangent may change the tangent type of the in tangent.
-			//
-			animCurve.setTangentsLocked(index, false);
-			animCurve.setTangent(index, outAngle, outWeight, false);
-		}
-
-		//	To prevent tangent types from unexpectedly changing, tangent 
-		//	locking should be the last operation. See the above comments
-		//	about fixed tangent types for more information.
-		//
-		animCurve.setWeightsLocked(index, swLocked);
-		animCurve.setTangentsLocked(index, tLocked);
-		animCurve.setIsBreakdown (index, isBreakdown);
-
-		//	There should be no additional data on this line. Go to the
-		//	next line of data.
-		//
-		clipFile.ignore(INT_MAX, kNewLineChar);
-
-		//	Skip any comments.
-		//
-		advance(clipFile);
-		c = clipFile.peek();
+		setKeyAttributes(animCurve, index, key, type, isWeighted, tanAngleUnit);
 	}
 
 	//	Ignore the brace that marks the end of the keys block.
 	//
 	if (c == kBraceRightChar) {
-		clipFile.ignore(INT_MAX, kNewLineChar);
+		clipFile.ignoreLine();
 	}
 
 	//	Ignore the brace that marks the end of the animData block.
 	//
 	advance(clipFile);
 	if (clipFile.peek() == kBraceRightChar) {
-		clipFile.ignore(INT_MAX, kNewLineChar);
+		clipFile.ignoreLine();
 	} else {
 		//	Something is wrong.
 		//
@@ -1735,6 +2019,186 @@ ifstream &clipFile, MAnimCurveClipboardItem &item)
 	return true;
 }
 
+bool animReader::readKey(animBuffer &clipFile, animKey &key)
+//
+//	Description:
+//		Reads one line of the keys block. The fixed tangent angles and
+//		weights are only present for fixed tangents.
+//
+//		false is returned if the line could not be read.
+//
+{
+	key.time = asDouble(clipFile);
+	key.value = asDouble(clipFile);
+
+	key.tanIn = wordAsTangentType(asWord(clipFile));
+	key.tanOut = wordAsTangentType(asWord(clipFile));
+
+	key.tLocked = (asDouble(clipFile) == 1.0);
+	key.swLocked = (asDouble(clipFile) == 1.0);
+	key.isBreakdown = false;
+	if (animVersion >= kVersionNonWeightedAndBreakdowns) {
+		key.isBreakdown = (asDouble(clipFile) == 1.0);
+	}
+
+	key.inAngle = key.inWeight = 0.0;
+	if (key.tanIn == MFnAnimCurve::kTangentFixed) {
+		key.inAngle = asDouble(clipFile);
+		key.inWeight = asDouble(clipFile);
+	}
+	key.outAngle = key.outWeight = 0.0;
+	if (key.tanOut == MFnAnimCurve::kTangentFixed) {
+		key.outAngle = asDouble(clipFile);
+		key.outWeight = asDouble(clipFile);
+	}
+
+	return !clipFile.failed;
+}
+
+//	Little-endian encoding of the keysBinary records, independent of the
+//	byte order of the host.
+//
+static void appendBinaryDouble(std::string &out, double value)
+{
+	unsigned long long bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int b = 0; b < 8; b++) {
+		out += (char) ((bits >> (8 * b)) & 0xff);
+	}
+}
+
+static double binaryAsDouble(const char *data)
+{
+	const unsigned char *bytes = (const unsigned char *) data;
+	unsigned long long bits = 0;
+	for (int b = 7; b >= 0; b--) {
+		bits = (bits << 8) | bytes[b];
+	}
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+bool animReader::readBinaryKeys(animBuffer &clipFile, unsigned numKeys,
+								std::vector<animKey> &keys)
+//
+//	Description:
+//		Reads the records of a keysBinary block, leaving the buffer after
+//		them.
+//
+//		false is returned if the buffer is too short, or a record has
+//		a tangent type that this version does not know.
+//
+{
+	size_t available = (size_t) (clipFile.end - clipFile.pos);
+	if (numKeys > available / kBinaryKeySize) {
+		clipFile.pos = clipFile.end;
+		return false;
+	}
+
+	keys.resize(numKeys);
+	const char *record = clipFile.pos;
+	for (unsigned k = 0; k < numKeys; k++, record += kBinaryKeySize) {
+		animKey &key = keys[k];
+		key.time = binaryAsDouble(record);
+		key.value = binaryAsDouble(record + 8);
+		key.inAngle = binaryAsDouble(record + 16);
+		key.inWeight = binaryAsDouble(record + 24);
+		key.outAngle = binaryAsDouble(record + 32);
+		key.outWeight = binaryAsDouble(record + 40);
+
+		unsigned char tanIn = (unsigned char) record[48];
+		unsigned char tanOut = (unsigned char) record[49];
+		unsigned char flags = (unsigned char) record[50];
+		if (tanIn > MFnAnimCurve::kTangentStepNext ||
+			tanOut > MFnAnimCurve::kTangentStepNext) {
+			keys.resize(k);
+			clipFile.pos = clipFile.end;
+			return false;
+		}
+		key.tanIn = (MFnAnimCurve::TangentType) tanIn;
+		key.tanOut = (MFnAnimCurve::TangentType) tanOut;
+		key.tLocked = (flags & kBinaryTangentsLocked) != 0;
+		key.swLocked = (flags & kBinaryWeightsLocked) != 0;
+		key.isBreakdown = (flags & kBinaryBreakdown) != 0;
+	}
+	clipFile.pos = record;
+
+	return true;
+}
+
+void animReader::setKeyAttributes(MFnAnimCurve &animCurve, unsigned index,
+								  const animKey &key,
+								  MFnAnimCurve::AnimCurveType type,
+								  bool isWeighted, MAngle::Unit tanAngleUnit)
+//
+//	Description:
+//		Sets the fixed tangents, locking and breakdown state of a key
+//		that has been added to the curve. Only the values that differ from
+//		those of a new key are set.
+//
+{
+	//	Only fixed tangents need additional information.
+	//
+	if (key.tanIn == MFnAnimCurve::kTangentFixed) {
+		MAngle inAngle(key.inAngle, tanAngleUnit);
+		double inWeight = key.inWeight;
+
+		//	If this is from a pre-Maya3.0 file, the tangent angles will 
+		//	need to be converted.
+		//
+		if (convertAnglesFromV2To3) {
+			convertAnglesAndWeights2To3(type,isWeighted,inAngle,inWeight);
+		} else if (convertAnglesFromV3To2) {
+			convertAnglesAndWeights3To2(type,isWeighted,inAngle,inWeight);
+		}
+
+		//  By default, the tangents are locked. When the tangents
+		//	are locked, setting the angle and weight of a fixed in
+		//	tangent may change the tangent type of the out tangent.
+		//
+		animCurve.setTangentsLocked(index, false);
+		animCurve.setTangent(index, inAngle, inWeight, true);
+	}
+
+	//	Only fixed tangents need additional information.
+	//
+	if (key.tanOut == MFnAnimCurve::kTangentFixed) {
+		MAngle outAngle(key.outAngle, tanAngleUnit);
+		double outWeight = key.outWeight;
+
+		//	If this is from a pre-Maya3.0 file, the tangent angles will 
+		//	need to be converted.
+		//
+		if (convertAnglesFromV2To3) {
+			convertAnglesAndWeights2To3(type,isWeighted,outAngle,outWeight);
+		} else if (convertAnglesFromV3To2) {
+			convertAnglesAndWeights3To2(type,isWeighted,outAngle,outWeight);
+		}
+		
+		//  By default, the tangents are locked. When the tangents
+		//	are locked, setting the angle and weight of a fixed out 
+		//	tangent may change the tangent type of the in tangent.
+		//
+		animCurve.setTangentsLocked(index, false);
+		animCurve.setTangent(index, outAngle, outWeight, false);
+	}
+
+	//	To prevent tangent types from unexpectedly changing, tangent 
+	//	locking should be the last operation. See the above comments
+	//	about fixed tangent types for more information.
+	//
+	if (animCurve.weightsLocked(index) != key.swLocked) {
+		animCurve.setWeightsLocked(index, key.swLocked);
+	}
+	if (animCurve.tangentsLocked(index) != key.tLocked) {
+		animCurve.setTangentsLocked(index, key.tLocked);
+	}
+	if (key.isBreakdown) {
+		animCurve.setIsBreakdown(index, true);
+	}
+}
+
 //-------------------------------------------------------------------------
 //	Class animWriter
 //-------------------------------------------------------------------------
@@ -1759,11 +2223,16 @@ MStatus
 animWriter::writeClipboard(	ofstream& animFile, 
 							const MAnimCurveClipboard &cb, 
 							bool nodeNames /* false */,
-							bool verboseUnits /* false */)
+							bool verboseUnits /* false */,
+							bool binaryKeys /* false */)
 //
 //	Description:
 //		Write the contents of the clipboard to the ofstream.
 //
+//		If binaryKeys is true, the keys of each curve are written as a
+//		keysBinary block, which animReader reads back exactly. The ofstream
+//		should then be opened in binary mode.
+//
 {
 	MStatus status = MS::kFailure;
 
@@ -1819,7 +2288,7 @@ animWriter::writeClipboard(	ofstream& animFile,
 		//
 		if (!writeAnimCurve(animFile, &animCurveObj, 
 							clipboardItem.animCurveType(),
-							verboseUnits)) {
+							verboseUnits, binaryKeys)) {
 			return (MS::kFailure);
 		}
 	}
@@ -1912,7 +2381,7 @@ bool animWriter::writeAnim(	ofstream &clip,
 	clip << kSpaceChar << rowCount;
 	clip << kSpaceChar << childCount;
 	clip << kSpaceChar << attrCount;
-	clip << kSemiColonChar << endl;
+	clip << kSemiColonChar << kNewLineChar;
 
 	return true;
 }
@@ -1920,7 +2389,8 @@ bool animWriter::writeAnim(	ofstream &clip,
 bool animWriter::writeAnimCurve(ofstream &clip, 
 								const MObject *animCurveObj,
 								MFnAnimCurve::AnimCurveType type,
-								bool verboseUnits /* false */)
+								bool verboseUnits /* false */,
+								bool binaryKeys /* false */)
 //
 //	Description:
 //		Write out the anim curve from the clipboard item into the
@@ -1941,17 +2411,17 @@ bool animWriter::writeAnimCurve(ofstream &clip,
 		return false;
 	}
 
-	clip << kAnimData << kSpaceChar << kBraceLeftChar << endl;
+	clip << kAnimData << kSpaceChar << kBraceLeftChar << kNewLineChar;
 
 	clip << kTwoSpace << kInputString << kSpaceChar <<
 			boolInputTypeAsWord(animCurve.isUnitlessInput()) << 
-			kSemiColonChar << endl;
+			kSemiColonChar << kNewLineChar;
 
 	clip << kTwoSpace << kOutputString << kSpaceChar <<
-			outputTypeAsWord(type) << kSemiColonChar << endl;
+			outputTypeAsWord(type) << kSemiColonChar << kNewLineChar;
 
 	clip << kTwoSpace << kWeightedString << kSpaceChar <<
-			(animCurve.isWeighted() ? 1 : 0) << kSemiColonChar << endl;
+			(animCurve.isWeighted() ? 1 : 0) << kSemiColonChar << kNewLineChar;
 
 	//	These units default to the units in the header of the file.
 	//	
@@ -1966,7 +2436,7 @@ bool animWriter::writeAnimCurve(ofstream &clip,
 			//
 			clip << kUnitlessString;
 		}
-		clip << kSemiColonChar << endl;
+		clip << kSemiColonChar << kNewLineChar;
 
 		clip << kTwoSpace << kOutputUnitString << kSpaceChar;
 	}
@@ -2001,72 +2471,285 @@ bool animWriter::writeAnimCurve(ofstream &clip,
 			if (verboseUnits) clip << kUnitlessString;
 			break;
 	}
-	if (verboseUnits) clip << kSemiColonChar << endl;
+	if (verboseUnits) clip << kSemiColonChar << kNewLineChar;
 
 	if (verboseUnits) {
 		MString angleUnitName;
 		animUnitNames::setToShortName(angularUnit, angleUnitName);
 		clip << kTwoSpace << kTanAngleUnitString << 
-				kSpaceChar << angleUnitName << kSemiColonChar << endl;
+				kSpaceChar << angleUnitName << kSemiColonChar << kNewLineChar;
 	}
 
 	clip << kTwoSpace << kPreInfinityString << kSpaceChar <<
 			infinityTypeAsWord(animCurve.preInfinityType()) << 
-			kSemiColonChar << endl;
+			kSemiColonChar << kNewLineChar;
 
 	clip << kTwoSpace << kPostInfinityString << kSpaceChar <<
 			infinityTypeAsWord(animCurve.postInfinityType()) << 
-			kSemiColonChar << endl;
+			kSemiColonChar << kNewLineChar;
 
-	clip << kTwoSpace << kKeysString << kSpaceChar << kBraceLeftChar << endl;
-
-	// And then write out each keyframe
+	// And then write out each keyframe. The keys are fetched from the
+	//	curve in one pass and formatted into a single buffer, which is
+	//	written to the file at once.
 	//
+	std::vector<animKey> keys;
+	std::string block;
+	if (binaryKeys) {
+		getKeys(animCurve, 1.0, MAngle::internalUnit(), keys);
+
+		char count[32];
+		sprintf(count, "%u", (unsigned) keys.size());
+		block += kTwoSpace;
+		block += kKeysBinaryString;
+		block += kSpaceChar;
+		block += count;
+		block += kSpaceChar;
+		block += kBraceLeftChar;
+		block += kNewLineChar;
+		formatBinaryKeys(keys, block);
+		block += kNewLineChar;
+	} else {
+		getKeys(animCurve, conversion, angularUnit, keys);
+
+		block += kTwoSpace;
+		block += kKeysString;
+		block += kSpaceChar;
+		block += kBraceLeftChar;
+		block += kNewLineChar;
+		formatKeys(keys, (int) clip.precision(), block);
+	}
+	block += kTwoSpace;
+	block += kBraceRightChar;
+	block += kNewLineChar;
+	block += kBraceRightChar;
+	block += kNewLineChar;
+
+	clip.write(block.data(), block.size());
+
+	return true;
+}
+
+void animWriter::getKeys(	MFnAnimCurve &animCurve, double conversion,
+							MAngle::Unit angleUnit, std::vector<animKey> &keys)
+//
+//	Description:
+//		Fetches every key of the anim curve, with its value multiplied by
+//		conversion and its fixed tangent angles in angleUnit.
+//
+{
 	unsigned numKeys = animCurve.numKeyframes();
+	bool isUnitless = animCurve.isUnitlessInput();
+
+	keys.resize(numKeys);
 	for (unsigned i = 0; i < numKeys; i++) {
-		clip << kTwoSpace << kTwoSpace;
-		if (animCurve.isUnitlessInput()) {
-			clip << animCurve.unitlessInput(i);
+		animKey &key = keys[i];
+		if (isUnitless) {
+			key.time = animCurve.unitlessInput(i);
+		} else {
+			key.time = animCurve.time(i).value();
+		}
+		key.value = conversion*animCurve.value(i);
+
+		key.tanIn = animCurve.inTangentType(i);
+		key.tanOut = animCurve.outTangentType(i);
+		key.tLocked = animCurve.tangentsLocked(i);
+		key.swLocked = animCurve.weightsLocked(i);
+		key.isBreakdown = animCurve.isBreakdown(i);
+
+		key.inAngle = key.inWeight = 0.0;
+		if (key.tanIn == MFnAnimCurve::kTangentFixed) {
+			MAngle angle;
+			animCurve.getTangent(i, angle, key.inWeight, true);
+			key.inAngle = angle.as(angleUnit);
 		}
-		else {
-			clip << animCurve.time(i).value();
+		key.outAngle = key.outWeight = 0.0;
+		if (key.tanOut == MFnAnimCurve::kTangentFixed) {
+			MAngle angle;
+			animCurve.getTangent(i, angle, key.outWeight, false);
+			key.outAngle = angle.as(angleUnit);
 		}
+	}
+}
 
-		// clamp tiny values so that it isn't so small it can't be read in
+static char *formatDouble(char *out, double value, int precision)
+//
+//	Description:
+//		Writes value as ostream::operator<< would with the given precision,
+//		i.e. as printf's "%.*g", and returns the end of the text. Integers,
+//		and values that print in fixed notation with at most 9 significant
+//		digits, are formatted directly. Everything else, including values
+//		too close to a rounding tie to be sure of, goes through sprintf.
+//
+{
+	static const double kPowers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+		1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	if (precision <= 0) precision = 6;
+
+	unsigned long long bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bool negative = (bits >> 63) != 0;
+	double magnitude = negative ? -value : value;
+
+	char digits[24];
+	int numDigits = 0;
+	int exponent = 0;
+
+	if (magnitude < 1e15 && magnitude == floor(magnitude) &&
+		(precision > 22 || magnitude < kPowers[precision])) {
+		//	An integer, which %g prints without a decimal point.
 		//
-		double animValue = (conversion*animCurve.value(i));
-		if (animBase::isEquivalent(animValue,0.0)) animValue = 0.0;
-		clip << kSpaceChar << animValue;
+		unsigned long long n = (unsigned long long) magnitude;
+		char reversed[24];
+		do {
+			reversed[numDigits++] = (char) ('0' + (int) (n % 10));
+			n /= 10;
+		} while (n > 0);
+		for (int d = 0; d < numDigits; d++) {
+			digits[d] = reversed[numDigits - 1 - d];
+		}
+		exponent = numDigits - 1;
+	} else if (precision <= 9 && magnitude >= 1e-4 && magnitude < kPowers[precision]) {
+		//	Fixed notation. An estimate of the exponent that is off by
+		//	one gives too many or too few digits and is caught below.
+		//
+		if (magnitude >= 1.0) {
+			while (exponent + 1 < precision && magnitude >= kPowers[exponent + 1]) {
+				exponent++;
+			}
+		} else {
+			exponent = -1;
+			while (exponent > -4 && magnitude * kPowers[-exponent] < 1.0) {
+				exponent--;
+			}
+		}
 
-		clip << kSpaceChar << tangentTypeAsWord(animCurve.inTangentType(i));
-		clip << kSpaceChar << tangentTypeAsWord(animCurve.outTangentType(i));
+		double scaled = magnitude * kPowers[precision - 1 - exponent];
+		double rounded = floor(scaled + 0.5);
+		double fraction = scaled - floor(scaled);
+		if (rounded < kPowers[precision - 1] || rounded >= kPowers[precision] ||
+			(fraction > 0.5 - 1e-6 && fraction < 0.5 + 1e-6)) {
+			return out + sprintf(out, "%.*g", precision, value);
+		}
 
-		clip << kSpaceChar << (animCurve.tangentsLocked(i) ? 1 : 0);
-		clip << kSpaceChar << (animCurve.weightsLocked(i) ? 1 : 0);
-		clip << kSpaceChar << (animCurve.isBreakdown(i) ? 1 : 0);
+		unsigned long n = (unsigned long) rounded;
+		for (int d = precision - 1; d >= 0; d--) {
+			digits[d] = (char) ('0' + (int) (n % 10));
+			n /= 10;
+		}
 
-		if (animCurve.inTangentType(i) == MFnAnimCurve::kTangentFixed) {
-			MAngle angle;
-			double weight;
-			animCurve.getTangent(i, angle, weight, true);
+		//	Drop the trailing zeros of the fraction.
+		//
+		numDigits = precision;
+		while (numDigits > exponent + 1 && digits[numDigits - 1] == '0') {
+			numDigits--;
+		}
+	} else {
+		return out + sprintf(out, "%.*g", precision, value);
+	}
 
-			clip << kSpaceChar << angle.as(angularUnit);
-			clip << kSpaceChar << weight;
+	char *c = out;
+	if (negative) *c++ = '-';
+	if (exponent < 0) {
+		*c++ = '0';
+		*c++ = '.';
+		for (int z = -1; z > exponent; z--) *c++ = '0';
+		for (int d = 0; d < numDigits; d++) *c++ = digits[d];
+	} else {
+		for (int d = 0; d < numDigits; d++) {
+			if (d == exponent + 1) *c++ = '.';
+			*c++ = digits[d];
 		}
-		if (animCurve.outTangentType(i) == MFnAnimCurve::kTangentFixed) {
-			MAngle angle;
-			double weight;
-			animCurve.getTangent(i, angle, weight, false);
+	}
+	*c = 0x00;
+	return c;
+}
 
-			clip << kSpaceChar << angle.as(angularUnit);
-			clip << kSpaceChar << weight;
+void animWriter::formatKeys(const std::vector<animKey> &keys, int precision,
+							std::string &block)
+//
+//	Description:
+//		Appends the lines of a keys block for the keys to block.
+//
+{
+	char line[512];
+	unsigned numKeys = (unsigned) keys.size();
+
+	block.reserve(block.size() + numKeys * 64);
+	for (unsigned i = 0; i < numKeys; i++) {
+		const animKey &key = keys[i];
+
+		char *c = line;
+		*c++ = kSpaceChar; *c++ = kSpaceChar; *c++ = kSpaceChar; *c++ = kSpaceChar;
+		c = formatDouble(c, key.time, precision);
+
+		// clamp tiny values so that it isn't so small it can't be read in
+		//
+		double animValue = key.value;
+		if (animBase::isEquivalent(animValue,0.0)) animValue = 0.0;
+		*c++ = kSpaceChar;
+		c = formatDouble(c, animValue, precision);
+
+		const char *word = tangentTypeAsWord(key.tanIn);
+		*c++ = kSpaceChar;
+		while (*word) *c++ = *word++;
+		word = tangentTypeAsWord(key.tanOut);
+		*c++ = kSpaceChar;
+		while (*word) *c++ = *word++;
+
+		*c++ = kSpaceChar; *c++ = key.tLocked ? '1' : '0';
+		*c++ = kSpaceChar; *c++ = key.swLocked ? '1' : '0';
+		*c++ = kSpaceChar; *c++ = key.isBreakdown ? '1' : '0';
+
+		if (key.tanIn == MFnAnimCurve::kTangentFixed) {
+			*c++ = kSpaceChar;
+			c = formatDouble(c, key.inAngle, precision);
+			*c++ = kSpaceChar;
+			c = formatDouble(c, key.inWeight, precision);
+		}
+		if (key.tanOut == MFnAnimCurve::kTangentFixed) {
+			*c++ = kSpaceChar;
+			c = formatDouble(c, key.outAngle, precision);
+			*c++ = kSpaceChar;
+			c = formatDouble(c, key.outWeight, precision);
 		}
 
-		clip << kSemiColonChar << endl;
+		*c++ = kSemiColonChar;
+		*c++ = kNewLineChar;
+		block.append(line, c - line);
 	}
-	clip << kTwoSpace << kBraceRightChar << endl;
+}
 
-	clip << kBraceRightChar << endl;
+void animWriter::formatBinaryKeys(const std::vector<animKey> &keys,
+								  std::string &block)
+//
+//	Description:
+//		Appends the records of a keysBinary block for the keys to block.
+//
+{
+	unsigned numKeys = (unsigned) keys.size();
 
-	return true;
+	block.reserve(block.size() + numKeys * kBinaryKeySize);
+	for (unsigned i = 0; i < numKeys; i++) {
+		const animKey &key = keys[i];
+
+		appendBinaryDouble(block, key.time);
+		appendBinaryDouble(block, key.value);
+		appendBinaryDouble(block, key.inAngle);
+		appendBinaryDouble(block, key.inWeight);
+		appendBinaryDouble(block, key.outAngle);
+		appendBinaryDouble(block, key.outWeight);
+
+		unsigned char flags = 0;
+		if (key.tLocked) flags |= kBinaryTangentsLocked;
+		if (key.swLocked) flags |= kBinaryWeightsLocked;
+		if (key.isBreakdown) flags |= kBinaryBreakdown;
+
+		block += (char) key.tanIn;
+		block += (char) key.tanOut;
+		block += (char) flags;
+		block += (char) 0;
+	}
 }
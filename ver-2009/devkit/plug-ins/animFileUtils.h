@@ -46,6 +46,10 @@
 #ifndef _animFileUtils
 #define _animFileUtils
 
+#include <stddef.h>
+#include <vector>
+#include <string>
+
 #include <maya/MFnAnimCurve.h>
 #include <maya/MAngle.h>
 #include <maya/MTime.h>
@@ -53,6 +57,24 @@
 
 class MArgList;
 
+// A read position in a whole .anim file held in memory. The reader
+// tokenizes straight out of the buffer instead of going through an
+// ifstream one character at a time.
+//
+class animBuffer {
+public:
+	animBuffer(const char *data, size_t length)
+	:	pos(data), end(data + length), failed(false) {}
+
+	bool						eof() const		{ return pos >= end; }
+	char						peek() const	{ return (pos < end) ? *pos : 0x00; }
+	void						ignoreLine();
+
+	const char *				pos;
+	const char *				end;
+	bool						failed;		// a number could not be read
+};
+
 // The base class for the translators.
 //
 class animBase {
@@ -80,11 +102,33 @@ public:
 	char *						asWord(ifstream &, bool = false);
 	char 						asChar(ifstream &);
 
+	double						asDouble(animBuffer &);
+	char *						asWord(animBuffer &, bool = false);
+
 	bool						isNextNumeric(ifstream &);
+	bool						isNextNumeric(animBuffer &);
 	bool						isEquivalent(double, double);
 protected:
+	// One line of the keys block of an animData. The angles are in
+	// the tangent angle unit.
+	//
+	struct animKey {
+		double						time;
+		double						value;
+		MFnAnimCurve::TangentType	tanIn;
+		MFnAnimCurve::TangentType	tanOut;
+		bool						tLocked;
+		bool						swLocked;
+		bool						isBreakdown;
+		double						inAngle;
+		double						inWeight;
+		double						outAngle;
+		double						outWeight;
+	};
+
 	void						resetUnits();
 	void						advance(ifstream &);
+	void						advance(animBuffer &);
 
 	MTime::Unit					timeUnit;
 	MAngle::Unit				angularUnit;
@@ -99,8 +143,13 @@ public:
 	virtual ~animReader();
 
 	MStatus	readClipboard(ifstream &, MAnimCurveClipboard&);
+	MStatus	readClipboard(const char *, size_t, MAnimCurveClipboard&);
 protected:
-	bool	readAnimCurve(ifstream&, MAnimCurveClipboardItem&);
+	bool	readAnimCurve(animBuffer&, MAnimCurveClipboardItem&);
+	bool	readKey(animBuffer&, animKey&);
+	bool	readBinaryKeys(animBuffer&, unsigned, std::vector<animKey>&);
+	void	setKeyAttributes(MFnAnimCurve&, unsigned, const animKey&,
+							 MFnAnimCurve::AnimCurveType, bool, MAngle::Unit);
 	void	convertAnglesAndWeights2To3(MFnAnimCurve::AnimCurveType, bool,
 										MAngle &, double &);
 	void	convertAnglesAndWeights3To2(MFnAnimCurve::AnimCurveType, bool,
@@ -117,14 +166,17 @@ public:
 	virtual ~animWriter();
 	
 	MStatus	writeClipboard(	ofstream&, const MAnimCurveClipboard&, 
-							bool = false, bool = false);
+							bool = false, bool = false, bool = false);
 protected:
 	bool	writeHeader(ofstream&);
 	bool	writeAnim(	ofstream&, const MAnimCurveClipboardItem&, 
 						bool = false, bool = false);
 	bool 	writeAnimCurve(	ofstream&, const MObject *, 
 							MFnAnimCurve::AnimCurveType,
-							bool = false);
+							bool = false, bool = false);
+	void	getKeys(MFnAnimCurve&, double, MAngle::Unit, std::vector<animKey>&);
+	void	formatKeys(const std::vector<animKey>&, int, std::string&);
+	void	formatBinaryKeys(const std::vector<animKey>&, std::string&);
 };
 
 class animUnitNames {
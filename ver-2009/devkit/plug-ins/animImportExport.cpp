@@ -63,6 +63,7 @@
 #include "animImportExport.h"
 #include "animFileUtils.h"
 #include "animImportExportStrings.h"
+#include "mappedFile.h"
 
 #if defined (OSMac_)
 #	include <sys/param.h>
@@ -126,10 +127,16 @@ MStatus animImport::reader(	const MFileObject& file,
 #if defined (OSMac_)	
 	char fname[MAXPATHLEN];
 	strcpy (fname, fileName.asChar());
-	ifstream animFile(fname);
 #else
-	ifstream animFile(fileName.asChar());
+	const char *fname = fileName.asChar();
 #endif
+	//	The whole file is mapped and parsed in place. If it cannot be
+	//	opened, the reader is given an empty buffer and reports the file
+	//	as missing its header.
+	//
+	mappedFile animFile;
+	animFile.open(fname);
+
 	// 	Parse the options. The options syntax is in the form of
 	//	"flag=val;flag1=val;flag2=val"
 	//
@@ -202,7 +209,7 @@ MStatus animImport::reader(	const MFileObject& file,
 	}
 
 	if (mode == kImportAccessMode) {
-		status = importAnim(animFile, pasteFlags);
+		status = importAnim(animFile.data(), animFile.size(), pasteFlags);
 	}
 
 	animFile.close();
@@ -252,7 +259,8 @@ MPxFileTranslator::MFileKind animImport::identifyFile(
 }
 
 MStatus 
-animImport::importAnim(ifstream &animFile, const MString &pasteFlags)
+animImport::importAnim(const char *animData, size_t animSize,
+					   const MString &pasteFlags)
 {
 	MStatus status = MS::kFailure;
 	MAnimCurveClipboard::theAPIClipboard().clear();
@@ -268,7 +276,7 @@ animImport::importAnim(ifstream &animFile, const MString &pasteFlags)
 	}
 
 	if (MS::kSuccess != 
-			(status = fReader.readClipboard(animFile, 
+			(status = fReader.readClipboard(animData, animSize,
 			MAnimCurveClipboard::theAPIClipboard()))) {
 
 		return status;
@@ -297,7 +305,7 @@ animImport::importAnim(ifstream &animFile, const MString &pasteFlags)
 //-----------------------------------------------------------------------------
 
 const char *const animExportOptionScript = "animExportOptions";
-const char *const animExportDefaultOptions = "precision=8;nodeNames=1;verboseUnits=0;whichRange=1;range=0:10;options=keys;hierarchy=none;controlPoints=0;shapes=1;helpPictures=0;useChannelBox=0;copyKeyCmd=";
+const char *const animExportDefaultOptions = "precision=8;nodeNames=1;verboseUnits=0;binaryKeys=0;whichRange=1;range=0:10;options=keys;hierarchy=none;controlPoints=0;shapes=1;helpPictures=0;useChannelBox=0;copyKeyCmd=";
 
 const int kDefaultPrecision = 8;	//	float precision.
 
@@ -330,9 +338,8 @@ MStatus animExport::writer(	const MFileObject& file,
 #if defined (OSMac_)
 	char fname[MAXPATHLEN];
 	strcpy (fname, fileName.asChar());
-	ofstream animFile(fname);
 #else
-	ofstream animFile(fileName.asChar());
+	const char *fname = fileName.asChar();
 #endif
 	//	Defaults.
 	//
@@ -340,6 +347,7 @@ MStatus animExport::writer(	const MFileObject& file,
 	int precision = kDefaultPrecision;
 	bool nodeNames = true;
 	bool verboseUnits = false;
+	bool binaryKeys = false;
 
 	//	Parse the options. The options syntax is in the form of
 	//	"flag=val;flag1=val;flag2=val"
@@ -350,6 +358,7 @@ MStatus animExport::writer(	const MFileObject& file,
 		const MString flagNodeNames("nodeNames");
 		const MString flagVerboseUnits("verboseUnits");
 		const MString flagCopyKeyCmd("copyKeyCmd");
+		const MString flagBinaryKeys("binaryKeys");
 
 		//	Start parsing.
 		//
@@ -380,6 +389,11 @@ MStatus animExport::writer(	const MFileObject& file,
 				if (theOption[1].isInt()) {
 					verboseUnits = (theOption[1].asInt()) ? true : false;
 				}
+			} else if (	theOption[0] == 
+						flagBinaryKeys && theOption.length() > 1) {
+				if (theOption[1].isInt()) {
+					binaryKeys = (theOption[1].asInt()) ? true : false;
+				}
 			} else if (	theOption[0] == 
 						flagCopyKeyCmd && theOption.length() > 1) {
 
@@ -404,11 +418,21 @@ MStatus animExport::writer(	const MFileObject& file,
 		}
 	}
 	
+	//	Binary keys must not have their newlines translated.
+	//
+	ofstream animFile;
+	if (binaryKeys) {
+		animFile.open(fname, ios::out | ios::binary);
+	} else {
+		animFile.open(fname);
+	}
+
 	//	Set the precision of the ofstream.
 	//
 	animFile.precision(precision);
 
-	status = exportSelected(animFile, copyFlags, nodeNames, verboseUnits);
+	status = exportSelected(animFile, copyFlags, nodeNames, verboseUnits,
+							binaryKeys);
 
 	animFile.flush();
 	animFile.close();
@@ -453,7 +477,8 @@ MPxFileTranslator::MFileKind animExport::identifyFile(
 MStatus animExport::exportSelected(	ofstream &animFile, 
 									MString &copyFlags,
 									bool nodeNames /* false */,
-									bool verboseUnits /* false */)
+									bool verboseUnits /* false */,
+									bool binaryKeys /* false */)
 {
 	MStatus status = MS::kFailure;
 
@@ -490,7 +515,7 @@ MStatus animExport::exportSelected(	ofstream &animFile,
 	if (MS::kSuccess != (	status = 
 							fWriter.writeClipboard(animFile, 
 							MAnimCurveClipboard::theAPIClipboard(),
-							nodeNames, verboseUnits))) {
+							nodeNames, verboseUnits, binaryKeys))) {
 		return (MS::kFailure);
 	}
 
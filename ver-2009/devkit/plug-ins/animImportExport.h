@@ -76,7 +76,7 @@ public:
 										const char* buffer,
 										short size) const;
 private:
-	MStatus				importAnim(ifstream&, const MString&);
+	MStatus				importAnim(const char *, size_t, const MString&);
 	MStatus				exportSelected(ofstream&);
 
 	animReader			fReader;
@@ -122,7 +122,8 @@ public:
 										short size) const;
 private:
 	MStatus				exportSelected(	ofstream&, MString &,
-										bool = false, bool = false);
+										bool = false, bool = false,
+										bool = false);
 
 	animWriter			fWriter;
 };
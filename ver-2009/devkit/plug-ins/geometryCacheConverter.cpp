@@ -18,10 +18,17 @@
 //
 //	Usage :
 //		convertGeometryCache -toAscii -file fileName1 -file fileName2 ..
+//		convertGeometryCache -toAscii -batch [-threads n] -file fileName1 ..
 //		
 //		Where "fileName1" and "fileName2" are the string paths to the geometry 
 //		cache files.
 //
+//		With -batch the files are converted concurrently by a fixed number
+//		of worker threads (-threads, default one per processor), progress
+//		is reported while they run and a summary of the files, bytes and
+//		throughput is printed at the end. Errors are reported once all
+//		workers have finished.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 // Project includes
@@ -36,6 +43,21 @@
 #include <maya/MArgList.h>
 #include <maya/MArgDatabase.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MThreadAsync.h>
+#include <maya/MThreadUtils.h>
+#include <maya/MAtomic.h>
+#include <maya/MProgressWindow.h>
+#include <maya/MTimer.h>
+
+// Other includes
+//
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 #define LFLAG_TOASCII "-toAscii"
 #define SFLAG_TOASCII "-ta"
@@ -43,6 +65,16 @@
 #define LFLAG_FILE "-file"
 #define SFLAG_FILE "-f"
 
+#define LFLAG_BATCH "-batch"
+#define SFLAG_BATCH "-b"
+
+#define LFLAG_THREADS "-threads"
+#define SFLAG_THREADS "-th"
+
+// How often the main thread checks on the batch workers, in milliseconds
+//
+#define BATCH_POLL_INTERVAL 100
+
 class convertGeometryCache : public MPxCommand
 {
 public:
@@ -63,8 +95,95 @@ public:
 	// Do It method
 	//
 	virtual MStatus		doIt( const MArgList& args );
+
+private:
+	// Batch conversion method
+	//
+	MStatus				convertBatch( const MStringArray& names, int numThreads );
+};
+
+// Batch conversion states of a file
+//
+enum {
+	kBatchPending = 0,
+	kBatchConverted,
+	kBatchReadFailed,
+	kBatchConvertFailed
+};
+
+// A file in a batch conversion. Each entry is only written by the
+// worker that claimed it.
+//
+struct batchFile
+{
+	MString				name;
+	int					state;
+	size_t				bytesRead;
+	unsigned long long	bytesWritten;
+};
+
+// Shared state of a batch conversion. The counters are only written
+// through MAtomic.
+//
+struct batchJob
+{
+	batchFile*			files;
+	int					numFiles;
+	volatile int		nextFile;		// next file to claim
+	volatile int		filesDone;		// files finished, for progress
+	volatile int		workersDone;	// workers that have returned
+	volatile int		cancelled;
 };
 
+static MThreadRetVal batchWorker( void* data )
+///////////////////////////////////////////////////////////////////////////////
+//
+// Description :
+//		Convert files until none are left. Each file is mapped, converted
+//		and released before the next one is claimed, so a worker holds at
+//		most one file at a time.
+//
+///////////////////////////////////////////////////////////////////////////////
+{
+	batchJob* job = (batchJob*)data;
+
+	for( ;; ) {
+		if( job->cancelled ) break;
+
+		int i = MAtomic::postIncrement( &job->nextFile );
+		if( i >= job->numFiles ) break;
+
+		batchFile& file = job->files[i];
+		geometryCacheFile cacheFile( file.name );
+		if( !cacheFile.readCacheFiles() ) {
+			file.state = kBatchReadFailed;
+		} else if( !cacheFile.writeAscii( cacheFile.asciiFileName(), &file.bytesWritten ) ) {
+			file.state = kBatchConvertFailed;
+		} else {
+			file.state = kBatchConverted;
+		}
+		file.bytesRead = cacheFile.fileSize();
+
+		MAtomic::preIncrement( &job->filesDone );
+	}
+	return 0;
+}
+
+static void batchWorkerDone( void* data )
+{
+	batchJob* job = (batchJob*)data;
+	MAtomic::preIncrement( &job->workersDone );
+}
+
+static void batchSleep()
+{
+#if defined(_WIN32)
+	Sleep( BATCH_POLL_INTERVAL );
+#else
+	usleep( BATCH_POLL_INTERVAL * 1000 );
+#endif
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Methods
@@ -125,6 +244,8 @@ MSyntax convertGeometryCache::cmdSyntax()
 	syntax.addFlag( SFLAG_TOASCII, LFLAG_TOASCII, MSyntax::kNoArg );
 	syntax.addFlag( SFLAG_FILE, LFLAG_FILE, MSyntax::kString );
 	syntax.makeFlagMultiUse( SFLAG_FILE );	
+	syntax.addFlag( SFLAG_BATCH, LFLAG_BATCH, MSyntax::kNoArg );
+	syntax.addFlag( SFLAG_THREADS, LFLAG_THREADS, MSyntax::kLong );
 	syntax.enableQuery( false );
 	syntax.enableEdit( false );
 
@@ -153,12 +274,9 @@ MStatus convertGeometryCache::doIt( const MArgList& args )
 		return status;
 	}
 
-	// Create an MIffFile to read our cache files
-    //
-	MIffFile iffFilePtr;
-
-	// Iterate through all the files specified
+	// Collect all the files specified
 	//
+	MStringArray names;
 	uint numUses = argDb.numberOfFlagUses( SFLAG_FILE );
 	for( uint i = 0; i < numUses; i++ )
 	{
@@ -169,9 +287,33 @@ MStatus convertGeometryCache::doIt( const MArgList& args )
 		MString name = argList.asString( 0, &status );
 		if( !status ) return status;
 
+		names.append( name );
+	}
+
+	// Batch mode converts the files concurrently
+	//
+	if( argDb.isFlagSet( SFLAG_BATCH ) )
+	{
+		int numThreads = 0;
+		if( argDb.isFlagSet( SFLAG_THREADS ) ) {
+			status = argDb.getFlagArgument( SFLAG_THREADS, 0, numThreads );
+			if( !status ) return status;
+		}
+		if( numThreads < 1 )
+			numThreads = MThreadUtils::getNumThreads();
+
+		return convertBatch( names, numThreads );
+	}
+
+	// Iterate through all the files specified
+	//
+	for( uint i = 0; i < names.length(); i++ )
+	{
+		const MString& name = names[i];
+
 		// Create a geometryCacheFile object from the current file path
 		//
-		geometryCacheFile cacheFile( name, &iffFilePtr);
+		geometryCacheFile cacheFile( name );
 
 		// Read the geometry cache file
 		//
@@ -211,6 +353,140 @@ MStatus convertGeometryCache::doIt( const MArgList& args )
 	return status;
 }
 
+MStatus convertGeometryCache::convertBatch( const MStringArray& names, int numThreads )
+///////////////////////////////////////////////////////////////////////////////
+//
+// Description : ( private method )
+//		Convert the files to Ascii on a bounded number of worker threads.
+//		The main thread only reports progress while the workers run, and
+//		reports errors and a summary once they have all finished.
+//		Fails if any file was not converted.
+//
+///////////////////////////////////////////////////////////////////////////////
+{
+	int numFiles = (int)names.length();
+	if( numFiles == 0 ) return MS::kSuccess;
+
+	std::vector<batchFile> files( numFiles );
+	for( int i = 0; i < numFiles; i++ ) {
+		files[i].name = names[i];
+		files[i].state = kBatchPending;
+		files[i].bytesRead = 0;
+		files[i].bytesWritten = 0;
+	}
+
+	batchJob job;
+	job.files = &files[0];
+	job.numFiles = numFiles;
+	job.nextFile = 0;
+	job.filesDone = 0;
+	job.workersDone = 0;
+	job.cancelled = 0;
+
+	int numWorkers = numThreads < numFiles ? numThreads : numFiles;
+	if( numWorkers < 1 ) numWorkers = 1;
+
+	MTimer timer;
+	timer.beginTimer();
+
+	MStatus status = MThreadAsync::init();
+	int numStarted = 0;
+	if( MS::kSuccess == status ) {
+		for( int w = 0; w < numWorkers; w++ ) {
+			if( MS::kSuccess != MThreadAsync::createTask( batchWorker, &job, batchWorkerDone, NULL ) )
+				break;
+			numStarted++;
+		}
+	}
+
+	if( numStarted == 0 ) {
+		// no threads available, convert everything here
+		batchWorker( &job );
+	} else {
+		// Report progress until every worker has returned
+		//
+		bool progressWindow = MGlobal::mayaState() == MGlobal::kInteractive &&
+							  MProgressWindow::reserve();
+		if( progressWindow ) {
+			MProgressWindow::setTitle( "Converting Geometry Caches" );
+			MProgressWindow::setProgressRange( 0, numFiles );
+			MProgressWindow::setInterruptable( true );
+			MProgressWindow::startProgress();
+		}
+
+		int reported = 0;
+		int nextReport = numFiles / 10;
+		while( job.workersDone < numStarted ) {
+			batchSleep();
+
+			int done = job.filesDone;
+			if( done == reported ) continue;
+			reported = done;
+
+			if( progressWindow ) {
+				MProgressWindow::setProgress( done );
+				if( MProgressWindow::isCancelled() )
+					MAtomic::set( &job.cancelled, 1 );
+			} else if( done >= nextReport ) {
+				MString msg = "convertGeometryCache: ";
+				msg += done;
+				msg += " of ";
+				msg += numFiles;
+				msg += " files converted";
+				MGlobal::displayInfo( msg );
+				nextReport = done + numFiles / 10;
+			}
+		}
+
+		if( progressWindow )
+			MProgressWindow::endProgress();
+	}
+
+	if( MS::kSuccess == status )
+		MThreadAsync::release();
+
+	timer.endTimer();
+	double seconds = timer.elapsedTime();
+
+	// Report errors now that the workers are done
+	//
+	int numConverted = 0, numFailed = 0;
+	double bytesRead = 0.0, bytesWritten = 0.0;
+	for( int i = 0; i < numFiles; i++ ) {
+		const batchFile& file = files[i];
+		bytesRead += (double)file.bytesRead;
+		bytesWritten += (double)file.bytesWritten;
+		if( file.state == kBatchConverted ) {
+			numConverted++;
+		} else if( file.state == kBatchReadFailed ) {
+			MGlobal::displayError( "Failed in reading file \"" + file.name + "\"" );
+			numFailed++;
+		} else if( file.state == kBatchConvertFailed ) {
+			MGlobal::displayError( "Failed in converting file \"" + 
+									file.name +
+									"\" to ASCII");
+			numFailed++;
+		}
+	}
+
+	// Summary
+	//
+	char summary[256];
+	double mb = 1.0 / (1024.0 * 1024.0);
+	sprintf( summary,
+			 "convertGeometryCache: converted %d of %d files (%d failed, %d skipped) "
+			 "on %d threads in %.2f s, %.1f MB read, %.1f MB written, %.1f MB/s",
+			 numConverted, numFiles, numFailed, numFiles - numConverted - numFailed,
+			 numStarted ? numStarted : 1, seconds, bytesRead * mb, bytesWritten * mb,
+			 seconds > 0.0 ? bytesRead * mb / seconds : 0.0 );
+	MGlobal::displayInfo( summary );
+
+	// Let scripts see that not every file was converted; the names of
+	// the ones that failed have been reported above.
+	//
+	return numConverted == numFiles ? MS::kSuccess : MS::kFailure;
+}
+
 MStatus initializePlugin( MObject obj )
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -24,24 +24,54 @@
 #include <geometryCacheBlockBase.h>
 #include <geometryCacheBlockStringData.h>
 #include <geometryCacheBlockIntData.h>
-#include <geometryCacheBlockDVAData.h>
-#include <geometryCacheBlockFVAData.h>
 
 // Maya includes
 //
-#include <maya/flib.h>
 #include <maya/MString.h>
 #include <maya/MGlobal.h>
+#include <maya/MVector.h>
 
 // Other includes
 //
 #include <fstream>
+#include <algorithm>
+#include <string.h>
+
+// IFF tags, as read big endian from the file
+//
+#define IFF_TAG(a,b,c,d)	(((unsigned int)(a) << 24) | ((unsigned int)(b) << 16) | \
+							 ((unsigned int)(c) << 8) | (unsigned int)(d))
+
+static const unsigned int kTagFOR4 = IFF_TAG('F','O','R','4');
+static const unsigned int kTagFOR8 = IFF_TAG('F','O','R','8');
+static const unsigned int kTagCACH = IFF_TAG('C','A','C','H');
+static const unsigned int kTagVRSN = IFF_TAG('V','R','S','N');
+static const unsigned int kTagSTIM = IFF_TAG('S','T','I','M');
+static const unsigned int kTagETIM = IFF_TAG('E','T','I','M');
+static const unsigned int kTagMYCH = IFF_TAG('M','Y','C','H');
+static const unsigned int kTagTIME = IFF_TAG('T','I','M','E');
+static const unsigned int kTagCHNM = IFF_TAG('C','H','N','M');
+static const unsigned int kTagSIZE = IFF_TAG('S','I','Z','E');
+static const unsigned int kTagDVCA = IFF_TAG('D','V','C','A');
+static const unsigned int kTagFVCA = IFF_TAG('F','V','C','A');
+
+static bool hostIsBigEndian()
+{
+	const unsigned int one = 1;
+	return *(const unsigned char*)&one == 0;
+}
 
-#if defined (OSMac_)
-#include <stdlib.h>
-#else
-#include <malloc.h>
-#endif
+static unsigned int getBE32( const char* p )
+{
+	const unsigned char* b = (const unsigned char*)p;
+	return ((unsigned int)b[0] << 24) | ((unsigned int)b[1] << 16) |
+		   ((unsigned int)b[2] << 8) | (unsigned int)b[3];
+}
+
+static unsigned long long getBE64( const char* p )
+{
+	return ((unsigned long long)getBE32( p ) << 32) | (unsigned long long)getBE32( p + 4 );
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -49,7 +79,7 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
-geometryCacheFile::geometryCacheFile( const MString& fileName, MIffFile* iffFile )
+geometryCacheFile::geometryCacheFile( const MString& fileName )
 	:cacheFileName( fileName )
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -59,7 +89,11 @@ geometryCacheFile::geometryCacheFile( const MString& fileName, MIffFile* iffFile
 ///////////////////////////////////////////////////////////////////////////////
 {	
 	readStatus = false;
-	iffFilePtr = iffFile;
+	wideChunks = false;
+	header = false;
+	cacheStartTime = 0;
+	cacheEndTime = 0;
+	timesSorted = true;
 }
 
 geometryCacheFile::~geometryCacheFile()
@@ -70,26 +104,9 @@ geometryCacheFile::~geometryCacheFile()
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	// Free all the pointers in the blockList.
-	// Start from the back of the list, delete the pointer returned then 
-	// pop it off the stack.
+	// Unmap the cache file
 	//
-	while( blockList.size() )
-	{	
-		// Get current pointer
-		//
-		geometryCacheBlockBase * block = blockList.back();
-
-		delete block;
-
-		// Pop the back item of the stack
-        //
-		blockList.pop_back();
-	}
-	
-	// Close the cache file
-	//
-	iffFilePtr->close();
+	cacheData.close();
 }
 
 const MString& geometryCacheFile::fileName()
@@ -118,40 +135,55 @@ bool geometryCacheFile::readCacheFiles()
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Description : ( public method )
-//		Read the cache file
+//		Map the cache file and index its header, time groups and channels.
+//		No channel data is decoded here.
 //
 ///////////////////////////////////////////////////////////////////////////////
 {	
-	MStatus status = MS::kSuccess;
+	readStatus = false;
+	header = false;
+	timeGroups.clear();
+	channels.clear();
+	timesSorted = true;
 
 	// Attempt to open the file
 	//
-	status = iffFilePtr->open( cacheFileName );
-	if( !status ) return false;
+	if( !cacheData.open( cacheFileName.asChar() ) ) return false;
 
-	// Proceed if the file is open
-	//
-	if( iffFilePtr->isActive() ) {
-		// Read the Header
-		//
-		readStatus	= readHeaderGroup( status );
-		if( !readStatus ) return false;
+	size_t fileSize = cacheData.size();
+	if( fileSize < 4 ) return false;
 
-		// Read all the channel groups
-		//
-		do {
-			// Read the next channel group
-			//
-			readStatus = readChannelGroup( status );
-			if( !readStatus ) return false;
+	unsigned int formTag = getBE32( cacheData.data() );
+	if( formTag == kTagFOR4 )
+		wideChunks = false;
+	else if( formTag == kTagFOR8 )
+		wideChunks = true;
+	else
+		return false;
 
-		} while ( status == MS::kSuccess );
+	// Read the Header
+	//
+	iffChunk group;
+	unsigned int groupType;
+	if( !readGroup( 0, fileSize, group, groupType ) ) return false;
+
+	size_t pos = 0;
+	if( groupType == kTagCACH ) {
+		if( !indexHeaderGroup( group ) ) return false;
+		pos = group.next;
+	}
 
-	} else
-		// If file failed to open
-		//
-		return false;
+	// Index all the channel groups. Anything after the last group
+	// that does not parse as a group ends the file.
+	//
+	while( pos < fileSize && readGroup( pos, fileSize, group, groupType ) ) {
+		if( groupType == kTagMYCH ) {
+			if( !indexChannelGroup( group ) ) return false;
+		}
+		pos = group.next;
+	}
 
+	readStatus = true;
 	return true;
 }
 
@@ -163,39 +195,8 @@ bool geometryCacheFile::convertToAscii()
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	// Generate an output file name by changing the file name extention to txt
-	//
-	int loc = cacheFileName.rindex('.');
-	MString outputFileName = cacheFileName.substring(0, loc-1);
-	outputFileName += ".txt";
-
-	// Create an output file steam to flush our data to ascii
-	//
-	std::ofstream oFile( outputFileName.asChar() );
-	if( !oFile.bad() ) 
-	{
-		// Create an iterator to iterate through the blockList
-		//
-		cacheBlockIterator blockIt;
-
-		// Write out all the blocks in the blockList
-		//
-		for( blockIt = blockList.begin();
-			blockIt != blockList.end();
-			blockIt++ )
-		{
-			// Get the current block
-			//
-			geometryCacheBlockBase* block = *blockIt;
-			
-			// OutputToAscii
-			//
-			block->outputToAscii( oFile );
-		}
-	} else
-		// If output file stream could not open the file
-		//
-		return false;
+	MString outputFileName = asciiFileName();
+	if( !writeAscii( outputFileName ) ) return false;
 
 	// Output a message to indicate that the file has been converted
 	//
@@ -207,425 +208,421 @@ bool geometryCacheFile::convertToAscii()
 	return true;
 }
 
-bool geometryCacheFile::readHeaderGroup( MStatus& status )
+MString geometryCacheFile::asciiFileName() const
 ///////////////////////////////////////////////////////////////////////////////
 //
-// Description : ( private method )
-//		Read the Header group CACH. 
-//		The header of every disk cache file consists of these tags
-//
-//		CACH	( header group )
-//		VRSN	( version )
-//		STIM	( startTime in ticks )
-//		ETIM 	( endTime in ticks )
+// Description : ( public method )
+//		Generate an output file name by changing the file name extention
+//		to txt
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	MIffTag tmpTag;
-	MIffTag cachTag;
-
-	status = iffFilePtr->beginReadGroup( tmpTag, cachTag );
-	if( status ) {
-		if( cachTag == MIffTag('C', 'A', 'C', 'H') ) {
-			// Store a "CACH" tag into the blockList
-			//
-			storeCacheBlock( "CACH" );
-
-			// Read the header version
-			//
-			readStatus = readHeaderVersion();
-			if( !readStatus ) return false;
-
-			// Read the Time Range
-			//
-			readStatus = readHeaderTimeRange();
-			if( !readStatus ) return false;
-
-			// Store an ending "/CACH" tag into the blockList
-			//
-			storeCacheBlock( "/CACH" );
-		}		
-	}
-	iffFilePtr->endReadGroup();
+	int loc = cacheFileName.rindex('.');
+	MString outputFileName = cacheFileName.substring(0, loc-1);
+	outputFileName += ".txt";
+	return outputFileName;
+}
 
-	return true;
+size_t geometryCacheFile::fileSize() const
+{
+	return cacheData.size();
 }
 
-bool geometryCacheFile::readHeaderVersion()
+bool geometryCacheFile::writeAscii( const MString& outputFileName,
+									unsigned long long* bytesWritten ) const
 ///////////////////////////////////////////////////////////////////////////////
 //
-// Description : ( private method )
-//		Read and store the cache file version from the VRSN block.
+// Description : ( public method )
+//		Write the file as Ascii. Channels are decoded one at a time while
+//		writing, so only one channel is ever held in memory.
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	MStatus status = MS::kSuccess;
-	MIffTag tmpTag;
-	unsigned int byteCount;
-    
-	status = iffFilePtr->beginGet( tmpTag, (unsigned *)&byteCount );
-	if( !status ) return false;
-
-	char *tmpName = (char*)alloca(sizeof(char)* (byteCount+1));
-	//pointers allocated by alloca are from the stack and automatically freed when
-	//the function exits.  Do not free explicitly.
-
-	if( tmpName && tmpTag == MIffTag('V', 'R', 'S', 'N') ) {
-		// read the data from the block
-		//
-		iffFilePtr->get( tmpName, byteCount, &status);
-		if( !status ) return false;
+	if( !readStatus ) return false;
 
-		// Store the cache file version in the blockList
+	// Create an output file steam to flush our data to ascii, with a
+	// larger buffer than the default
+	//
+	std::vector<char> streamBuffer( 1 << 20 );
+	std::ofstream oFile;
+	oFile.rdbuf()->pubsetbuf( &streamBuffer[0], (std::streamsize)streamBuffer.size() );
+	oFile.open( outputFileName.asChar() );
+	if( !oFile.is_open() || oFile.bad() ) 
+	{
+		// If output file stream could not open the file
 		//
-		storeCacheBlock( "VRSN", tmpName );
-
-		status = iffFilePtr->endGet();
-		if( !status ) return false;
+		return false;
 	}
 
-	return true;
-}
-
-bool geometryCacheFile::readHeaderTimeRange()
-///////////////////////////////////////////////////////////////////////////////
-//
-// Description : ( private method )
-//		Read and store the start and end time from the STIM and ETIM blocks.
-//		The data from these blocks are only used for multiple cache files.
-//		If the cache file is a single cache file, then the values will only be 
-//		from 0 to 1.
-//
-///////////////////////////////////////////////////////////////////////////////
-{
-	MStatus status = MS::kSuccess;
-	MIffTag tmpTag;
-	unsigned int byteCount;
-	
-#if (!defined BYTE_ORDER) || (BYTE_ORDER == BIG_ENDIAN)
-	const int *startTime = (int *)iffFilePtr->getChunk( 
-								tmpTag, 
-								(unsigned int *)&byteCount );  
-	if(	startTime == NULL ||
-		!(tmpTag == MIffTag ('S', 'T', 'I', 'M')) || 
-		byteCount != sizeof(int) )
-		return false;
+	// Write out the header
+	//
+	if( header ) {
+		geometryCacheBlockBase( "CACH" ).outputToAscii( oFile );
+		geometryCacheBlockStringData( "VRSN", cacheVersion ).outputToAscii( oFile );
+		geometryCacheBlockIntData( "STIM", cacheStartTime ).outputToAscii( oFile );
+		geometryCacheBlockIntData( "ETIM", cacheEndTime ).outputToAscii( oFile );
+		geometryCacheBlockBase( "/CACH" ).outputToAscii( oFile );
+	}
 
-	// Store the start time in the blockList
+	// Write out the time groups, decoding each channel's data
+	// into the same buffers
 	//
-	storeCacheBlock( "STIM", *startTime );
+	std::vector<double> doubleBuffer;
+	std::vector<float> floatBuffer;
 
-	const int *endTime = (int *)iffFilePtr->getChunk( 
-								tmpTag, 
-								(unsigned int *)&byteCount );  
-	if(	endTime == NULL ||
-		!(tmpTag == MIffTag('E', 'T', 'I', 'M')) ||
-		byteCount != sizeof(int) )
-		return false;				
+	for( uint t = 0; t < numTimes(); t++ )
+	{
+		geometryCacheBlockBase( "MYCH" ).outputToAscii( oFile );
+		if( timeGroups[t].hasTime )
+			geometryCacheBlockIntData( "TIME", timeGroups[t].time ).outputToAscii( oFile );
 
-	// Store the end time in the blockList
-	//
-	storeCacheBlock( "ETIM", *endTime );
-#else
-	const int *startTime = (int *)iffFilePtr->getChunk( tmpTag, (unsigned int *)&byteCount );  
-	if(	startTime == NULL ||
-		// There is no != operator for MIffTag
-		!(tmpTag == MIffTag ('S', 'T', 'I', 'M')) ||
-		byteCount != sizeof(int) )
-		return false;
+		for( uint c = 0; c < numChannels( t ); c++ )
+		{
+			const cacheChannel* chan = findChannel( t, c );
+			geometryCacheBlockStringData( "CHNM", chan->name ).outputToAscii( oFile );
+			geometryCacheBlockIntData( "SIZE", (int)chan->size ).outputToAscii( oFile );
+			if( !chan->size ) continue;
 
-	// Store the start time in the blockList
-	//
-	storeCacheBlock( "STIM", FLswapword(*startTime) );
+			// A [FVCA] or [DVCA] tag and one vector per line
+			//
+			if( chan->isFloat ) {
+				const float* v = floatVectorData( t, c, floatBuffer );
+				oFile << "\t[FVCA]\n";
+				for( uint i = 0; i < chan->size * 3; i += 3 )
+					oFile << "\t\t" << MVector( v[i], v[i+1], v[i+2] ) << "\n";
+			} else {
+				const double* v = doubleVectorData( t, c, doubleBuffer );
+				oFile << "\t[DVCA]\n";
+				for( uint i = 0; i < chan->size * 3; i += 3 )
+					oFile << "\t\t" << MVector( v[i], v[i+1], v[i+2] ) << "\n";
+			}
+		}
+		geometryCacheBlockBase( "/MYCH" ).outputToAscii( oFile );
+	}
 
-	const int *endTime = (int *)iffFilePtr->getChunk( tmpTag, (unsigned int *)&byteCount );  
-	if(	endTime == NULL ||
-		!(tmpTag == MIffTag('E', 'T', 'I', 'M')) ||
-		byteCount != sizeof(int) )
-		return false;
+	oFile.flush();
+	if( bytesWritten ) *bytesWritten = (unsigned long long)oFile.tellp();
+	bool ok = !oFile.fail();
+	oFile.close();
+	return ok && !oFile.fail();
+}
 
-	// Store the end time in the blockList
-	//
-	storeCacheBlock( "ETIM", FLswapword(*endTime) );
-#endif
-	return true;
+bool geometryCacheFile::hasHeader() const
+{
+	return header;
 }
 
-bool geometryCacheFile::readChannelGroup( MStatus& groupStatus )
-///////////////////////////////////////////////////////////////////////////////
-//
-// Description : ( private method )
-//		Read the channel group MYCH.
-//		The channel group can consist of these following tags
-//
-//		MYCH	( time group )
-//		TIME	( time in ticks )
-//		CHNM	( channel name )
-//		SIZE 	( size )
-//		DVCA	( geometry point data )
-//
-///////////////////////////////////////////////////////////////////////////////
+const MString& geometryCacheFile::version() const
 {
-	MIffTag mychTag;
-	MIffTag tmpTag;
-	unsigned int byteCount;
-
-	groupStatus = iffFilePtr->beginReadGroup(tmpTag, mychTag);
-	if( groupStatus == MS::kSuccess ) {
-		if( mychTag == MIffTag('M', 'Y', 'C', 'H')) {
-			// Store the "MYCH" group in the blockList
-			//
-			storeCacheBlock( "MYCH" );
+	return cacheVersion;
+}
 
-			// Get the next tag
-			//
-			MStatus stat = iffFilePtr->beginGet(tmpTag, (unsigned *)&byteCount);
-			if (!stat) return false;
+int geometryCacheFile::startTime() const
+{
+	return cacheStartTime;
+}
 
-			// If the tag is TIME, then this is a single file cache file
-			// Read the time chunk before the channel name chunk
-			//
-			if( tmpTag == MIffTag('T', 'I', 'M', 'E') )
-			{
-				// Read channel time
-				//
-				readStatus = readChannelTime();
-				if ( !readStatus ) return false;
-
-				// End Get
-				//
-				stat = iffFilePtr->endGet();
-				if (!stat) return false;
-			}
+int geometryCacheFile::endTime() const
+{
+	return cacheEndTime;
+}
 
-			// Read Channel
-			//
-			MStatus channelStatus = MS::kSuccess;
-			do {
-				// Read channel name, size and data
-				//
-				readStatus = readChannel( channelStatus );
-				if( !readStatus ) return false;
+uint geometryCacheFile::numTimes() const
+{
+	return (uint)timeGroups.size();
+}
 
-			} while ( channelStatus == MS::kSuccess );
+bool geometryCacheFile::hasTime( uint timeIndex ) const
+{
+	return timeIndex < numTimes() && timeGroups[timeIndex].hasTime;
+}
 
-			// Store the ending "/MYCH" in the blockList
-			//
-			storeCacheBlock( "/MYCH" );
-		}
-	} 
-	iffFilePtr->endReadGroup();
-	return readStatus;
+int geometryCacheFile::time( uint timeIndex ) const
+{
+	return timeIndex < numTimes() ? timeGroups[timeIndex].time : 0;
 }
 
-bool geometryCacheFile::readChannelTime()
-///////////////////////////////////////////////////////////////////////////////
+// Orders time groups by their TIME chunk
 //
-// Description : ( private method )
-//		Read and store the channel time from the TIME block.
-//
-///////////////////////////////////////////////////////////////////////////////
+struct geometryCacheTimeLess
 {
-	MIffTag tmpTag;
-	unsigned int byteCount;
-
-	const int *tmpNum =	(int*) iffFilePtr->getChunk( tmpTag, (unsigned *)&byteCount );
-	if( tmpNum && 
-		tmpTag == MIffTag('T', 'I', 'M', 'E') && 
-		byteCount == sizeof(int)) {
-#if (!defined BYTE_ORDER) || (BYTE_ORDER == BIG_ENDIAN)
-		// Store the channel time in the blockList
-		//
-		storeCacheBlock( "TIME", *tmpNum );
-#else
-		// Store the channel time in the blockList
-		//
-		storeCacheBlock( "TIME", FLswapword(*tmpNum) );
-#endif		
-	} 
-	return true;
-}
+	template <class Group>
+	bool operator()( const Group& g, int t ) const { return g.time < t; }
+};
 
-bool geometryCacheFile::readChannel( MStatus& channelStatus )
+bool geometryCacheFile::findTime( int t, uint& timeIndex ) const
 ///////////////////////////////////////////////////////////////////////////////
 //
-// Description : ( private method )
-//		Read and store the channel data.
+// Description : ( public method )
+//		Find the time group for the given time in ticks. Caches written
+//		by Maya store their times in order, which allows a binary search.
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	readStatus = readChannelName( channelStatus );
-	if( !readStatus ) return false;
+	if( timesSorted ) {
+		std::vector<cacheTimeGroup>::const_iterator it =
+			std::lower_bound( timeGroups.begin(), timeGroups.end(), t,
+							  geometryCacheTimeLess() );
+		if( it != timeGroups.end() && it->hasTime && it->time == t ) {
+			timeIndex = (uint)(it - timeGroups.begin());
+			return true;
+		}
+		return false;
+	}
 
-	// If channelStatus is not MS::Success then this means that there is no
-	// more channel data to read.  Return from function.
-	//
-	if( !channelStatus ) return true;
+	for( uint i = 0; i < numTimes(); i++ ) {
+		if( timeGroups[i].hasTime && timeGroups[i].time == t ) {
+			timeIndex = i;
+			return true;
+		}
+	}
+	return false;
+}
 
-	readStatus = readChannelData();
-	if( !readStatus ) return false;
+uint geometryCacheFile::numChannels( uint timeIndex ) const
+{
+	return timeIndex < numTimes() ? timeGroups[timeIndex].numChannels : 0;
+}
 
-	return true;
+const geometryCacheFile::cacheChannel* geometryCacheFile::findChannel( uint timeIndex, uint channel ) const
+{
+	if( channel >= numChannels( timeIndex ) ) return NULL;
+	return &channels[timeGroups[timeIndex].firstChannel + channel];
 }
-bool geometryCacheFile::readChannelName( MStatus& channelStatus )
-///////////////////////////////////////////////////////////////////////////////
-//
-// Description : ( private method )
-//		Read and store the channel name from the CHNM block.
-//
-///////////////////////////////////////////////////////////////////////////////
+
+const MString& geometryCacheFile::channelName( uint timeIndex, uint channel ) const
 {
-	MStatus lStatus;
-	unsigned int byteCount;
-	MIffTag chnmTag;
-	
-	channelStatus = iffFilePtr->beginGet( chnmTag, (unsigned *)&byteCount );
-	if( channelStatus == MS::kSuccess ) {
-		char *tmpName = (char*)alloca(sizeof(char)* (byteCount+1));
-		//pointers allocated by alloca are from the stack and automatically freed when
-		//the function exits.  Do not free explicitly.
-
-		if( tmpName && chnmTag == MIffTag('C', 'H', 'N', 'M') ) {
-			iffFilePtr->get( tmpName, byteCount, &lStatus);
-			if( !lStatus ) return false;
-			MString channelName = tmpName;
-
-			// Store the channel name in the blockList
-			//
-			storeCacheBlock( "CHNM", channelName );
-		} else return false;
-	} 
-	iffFilePtr->endGet();
-	return true;
+	static const MString empty;
+	const cacheChannel* chan = findChannel( timeIndex, channel );
+	return chan ? chan->name : empty;
+}
+
+uint geometryCacheFile::channelSize( uint timeIndex, uint channel ) const
+{
+	const cacheChannel* chan = findChannel( timeIndex, channel );
+	return chan ? chan->size : 0;
 }
 
-bool geometryCacheFile::readChannelData()
+bool geometryCacheFile::channelIsFloat( uint timeIndex, uint channel ) const
+{
+	const cacheChannel* chan = findChannel( timeIndex, channel );
+	return chan && chan->isFloat;
+}
+
+const double* geometryCacheFile::doubleVectorData( uint timeIndex, uint channel,
+												   std::vector<double>& buffer ) const
 ///////////////////////////////////////////////////////////////////////////////
 //
-// Description : ( private method )
-//		Read and store the channel size and geometry point data from the SIZE
-//		and DVCA or FVCA blocks.
+// Description : ( public method )
+//		Decode the DVCA data of a channel. IFF data is big endian.
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-    MIffTag tmpTag;
-	unsigned int byteCount;
-	uint size;
-
-	// Read the channel size
-	//
-	const int *tmpNum = (int*) iffFilePtr->getChunk(tmpTag, (unsigned *)&byteCount);
-	if( tmpNum && 
-		tmpTag == MIffTag('S', 'I', 'Z', 'E') && 
-		byteCount == sizeof(int)) 
-	{
-#if (!defined BYTE_ORDER) || (BYTE_ORDER == BIG_ENDIAN)
-			size = *tmpNum;
-#else
-			size = FLswapword(*tmpNum);
-#endif
-		// Store the channel size in the blockList
-		//
-		storeCacheBlock( "SIZE", size );
-	} else return false;
-
-	// Read the channel data
-	//
-	if( size ) {
-		const void *tmpVec = (double*) iffFilePtr->getChunk(tmpTag, (unsigned *)&byteCount);
-
-		if( tmpVec && 
-			tmpTag == MIffTag('D', 'V', 'C', 'A') &&
-			size * sizeof(double)*3 == byteCount )
-		{
-			double *tmpVecDbl = (double*) tmpVec;
-			double *dataArray = new double[size*3];
-#if (!defined BYTE_ORDER) || (BYTE_ORDER == BIG_ENDIAN)
-			memcpy(dataArray, tmpVec, byteCount);
-#else
-			for(unsigned int i = 0; i < size*3; i++) {
-				FLswapdouble(tmpVecDbl[i], &(dataArray[i]));
-			}
-#endif		
-			// Store the channel geometry points in the blockList
-			//
-			storeCacheBlock( "DVCA", dataArray, size );
-			delete [] dataArray;
-		} else if( tmpVec && 
-				   tmpTag == MIffTag('F', 'V', 'C', 'A') &&
-				   size * sizeof(float)*3 == byteCount ) {
-			float *tmpVecFlt = (float*) tmpVec;
-			float *dataArray = new float[size*3];
-#if (!defined BYTE_ORDER) || (BYTE_ORDER == BIG_ENDIAN)
-			memcpy(dataArray, tmpVec, byteCount);
-#else
-			for(unsigned int i = 0; i < size*3; i++) {
-				FLswapfloat(tmpVecFlt[i], &(dataArray[i]));
-			}
-#endif		
-			// Store the channel geometry points in the blockList
-			//
-			storeCacheBlock( "FVCA", dataArray, size );
-			delete [] dataArray;
-		} else {
-			return false;
-		}
+	const cacheChannel* chan = findChannel( timeIndex, channel );
+	if( !chan || chan->isFloat || !chan->size ) return NULL;
+
+	const char* src = cacheData.data() + chan->dataOffset;
+	size_t count = (size_t)chan->size * 3;
+	if( hostIsBigEndian() && ((size_t)src % sizeof(double)) == 0 )
+		return (const double*)src;
+
+	buffer.resize( count );
+	for( size_t i = 0; i < count; i++ ) {
+		unsigned long long bits = getBE64( src + i * sizeof(double) );
+		memcpy( &buffer[i], &bits, sizeof(double) );
 	}
-	return true;
+	return &buffer[0];
 }
 
-void geometryCacheFile::storeCacheBlock( const MString& tag )
+const float* geometryCacheFile::floatVectorData( uint timeIndex, uint channel,
+												 std::vector<float>& buffer ) const
 ///////////////////////////////////////////////////////////////////////////////
 //
-// Description : ( private method )
-//		Stores the specified data into the blockList.
+// Description : ( public method )
+//		Decode the FVCA data of a channel. IFF data is big endian.
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	blockList.push_back( new geometryCacheBlockBase( tag ) );
+	const cacheChannel* chan = findChannel( timeIndex, channel );
+	if( !chan || !chan->isFloat || !chan->size ) return NULL;
+
+	const char* src = cacheData.data() + chan->dataOffset;
+	size_t count = (size_t)chan->size * 3;
+	if( hostIsBigEndian() && ((size_t)src % sizeof(float)) == 0 )
+		return (const float*)src;
+
+	buffer.resize( count );
+	for( size_t i = 0; i < count; i++ ) {
+		unsigned int bits = getBE32( src + i * sizeof(float) );
+		memcpy( &buffer[i], &bits, sizeof(float) );
+	}
+	return &buffer[0];
 }
 
-void geometryCacheFile::storeCacheBlock( const MString& tag, const int& value )
+bool geometryCacheFile::readChunk( size_t pos, size_t end, iffChunk& chunk ) const
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Description : ( private method )
-//		Stores the specified data into the blockList.
+//		Read the chunk header at pos. Fails if the chunk does not fit
+//		before end.
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	blockList.push_back( new geometryCacheBlockIntData( tag, value ) );
+	size_t sizeBytes = wideChunks ? 8 : 4;
+	size_t align = wideChunks ? 8 : 4;
+	if( pos > end || end - pos < 4 + sizeBytes ) return false;
+
+	const char* p = cacheData.data() + pos;
+	unsigned long long size = wideChunks ? getBE64( p + 4 ) : getBE32( p + 4 );
+	size_t dataOffset = pos + 4 + sizeBytes;
+	if( size > end - dataOffset ) return false;
+
+	chunk.tag = getBE32( p );
+	chunk.dataOffset = dataOffset;
+	chunk.size = (size_t)size;
+
+	// The padding of the last chunk in a group may be left out
+	//
+	size_t padded = (chunk.size + align - 1) & ~(align - 1);
+	chunk.next = padded > end - dataOffset ? end : dataOffset + padded;
+	return true;
 }
 
-void geometryCacheFile::storeCacheBlock( const MString& tag, const MString& value  )
+bool geometryCacheFile::readGroup( size_t pos, size_t end, iffChunk& group,
+								   unsigned int& groupType ) const
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Description : ( private method )
-//		Stores the specified data into the blockList.
+//		Read a FOR4 / FOR8 group header. The group's chunks follow its
+//		type, from dataOffset + 4 to dataOffset + size.
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	blockList.push_back( new geometryCacheBlockStringData( tag, value ) );
+	if( !readChunk( pos, end, group ) ) return false;
+	if( group.tag != (wideChunks ? kTagFOR8 : kTagFOR4) || group.size < 4 ) return false;
+
+	groupType = getBE32( cacheData.data() + group.dataOffset );
+	return true;
 }
 
-void geometryCacheFile::storeCacheBlock( const MString& tag, const double* value, const uint& size )
+bool geometryCacheFile::indexHeaderGroup( const iffChunk& group )
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Description : ( private method )
-//		Stores the specified data into the blockList.
+//		Read the Header group CACH. 
+//		The header of every disk cache file consists of these tags
+//
+//		CACH	( header group )
+//		VRSN	( version )
+//		STIM	( startTime in ticks )
+//		ETIM 	( endTime in ticks )
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	blockList.push_back( new geometryCacheBlockDVAData( tag, value, size ) );
-}
+	size_t end = group.dataOffset + group.size;
+	size_t pos = group.dataOffset + 4;
+	bool hasStart = false, hasEnd = false;
+
+	iffChunk chunk;
+	while( pos < end && readChunk( pos, end, chunk ) ) {
+		const char* data = cacheData.data() + chunk.dataOffset;
+		if( chunk.tag == kTagVRSN ) {
+			// the version may or may not be null terminated
+			size_t length = chunk.size;
+			while( length > 0 && data[length-1] == '\0' ) length--;
+			cacheVersion = MString( data, (int)length );
+		} else if( chunk.tag == kTagSTIM && chunk.size == 4 ) {
+			cacheStartTime = (int)getBE32( data );
+			hasStart = true;
+		} else if( chunk.tag == kTagETIM && chunk.size == 4 ) {
+			cacheEndTime = (int)getBE32( data );
+			hasEnd = true;
+		}
+		pos = chunk.next;
+	}
 
+	header = hasStart && hasEnd;
+	return header;
+}
 
-void geometryCacheFile::storeCacheBlock( const MString& tag, const float* value, const uint& size )
+bool geometryCacheFile::indexChannelGroup( const iffChunk& group )
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Description : ( private method )
-//		Stores the specified data into the blockList.
+//		Index the channel group MYCH.
+//		The channel group can consist of these following tags
+//
+//		MYCH	( time group )
+//		TIME	( time in ticks, single file caches only )
+//		CHNM	( channel name )
+//		SIZE 	( size )
+//		DVCA	( geometry point data, or FVCA )
 //
 ///////////////////////////////////////////////////////////////////////////////
 {
-	blockList.push_back( new geometryCacheBlockFVAData( tag, value, size ) );
+	size_t end = group.dataOffset + group.size;
+	size_t pos = group.dataOffset + 4;
+
+	cacheTimeGroup timeGroup;
+	timeGroup.hasTime = false;
+	timeGroup.time = 0;
+	timeGroup.firstChannel = (uint)channels.size();
+	timeGroup.numChannels = 0;
+
+	iffChunk chunk;
+	if( pos < end && readChunk( pos, end, chunk ) && chunk.tag == kTagTIME ) {
+		if( chunk.size != 4 ) return false;
+		timeGroup.hasTime = true;
+		timeGroup.time = (int)getBE32( cacheData.data() + chunk.dataOffset );
+		pos = chunk.next;
+	}
+
+	while( pos < end && readChunk( pos, end, chunk ) ) {
+		// Channel name
+		//
+		if( chunk.tag != kTagCHNM ) return false;
+		const char* name = cacheData.data() + chunk.dataOffset;
+		size_t length = chunk.size;
+		while( length > 0 && name[length-1] == '\0' ) length--;
+
+		cacheChannel chan;
+		chan.name = MString( name, (int)length );
+		chan.isFloat = false;
+		chan.dataOffset = 0;
+		pos = chunk.next;
+
+		// Channel size
+		//
+		if( !readChunk( pos, end, chunk ) || chunk.tag != kTagSIZE || chunk.size != 4 )
+			return false;
+		chan.size = getBE32( cacheData.data() + chunk.dataOffset );
+		pos = chunk.next;
+
+		// Channel data, only present for non-empty channels
+		//
+		if( chan.size ) {
+			if( !readChunk( pos, end, chunk ) ) return false;
+			if( chunk.tag == kTagDVCA && chunk.size == (size_t)chan.size * 3 * sizeof(double) ) {
+				chan.isFloat = false;
+			} else if( chunk.tag == kTagFVCA && chunk.size == (size_t)chan.size * 3 * sizeof(float) ) {
+				chan.isFloat = true;
+			} else {
+				return false;
+			}
+			chan.dataOffset = chunk.dataOffset;
+			pos = chunk.next;
+		}
+
+		channels.push_back( chan );
+		timeGroup.numChannels++;
+	}
+
+	if( timeGroup.hasTime && !timeGroups.empty() &&
+		(!timeGroups.back().hasTime || timeGroups.back().time > timeGroup.time) )
+		timesSorted = false;
+	if( !timeGroup.hasTime && !timeGroups.empty() )
+		timesSorted = false;
+
+	timeGroups.push_back( timeGroup );
+	return true;
 }
@@ -60,32 +60,36 @@
 //		TIME chunk.	Note that the value of the header's STIM and ETIM chunk 
 //		are only relevant with multiple file caches.
 //
+//		Files starting with FOR4 (.mcc) use 32 bit chunk sizes and 4 byte
+//		alignment. Files starting with FOR8 (.mcx) are read as having 64 bit
+//		chunk sizes and 8 byte alignment.
+//
+//		The file is memory mapped and readCacheFiles() only records where
+//		each group and channel is. Channel data is decoded when it is asked
+//		for, so even very large caches can be inspected and converted
+//		without holding them in memory.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 // Project includes
 //
 #include <geometryCacheBlockBase.h>
+#include <mappedFile.h>
 
 // Maya includes
 //
 #include <maya/MString.h>
-#include <maya/MIffFile.h>
 
 // Other includes
 //
-#include <list>
-
-// Typedef of STL containers to store our chunks of data
-//
-typedef std::list<geometryCacheBlockBase*> cacheBlockList;
-typedef std::list<geometryCacheBlockBase*>::iterator cacheBlockIterator;
+#include <vector>
 
 class geometryCacheFile
 {
 public:
 	// Constructor / Destructor methods
 	//
-				geometryCacheFile( const MString& fileName, MIffFile* iffFile );
+				geometryCacheFile( const MString& fileName );
 	virtual		~geometryCacheFile();
 
 	// Accessor methods
@@ -97,46 +101,105 @@ public:
 	//
 	bool	readCacheFiles();
 
-	// Convert cache method
+	// Convert cache methods. convertToAscii() writes asciiFileName() and
+	// reports the conversion. writeAscii() only writes the file, and may
+	// be called from any thread.
 	//
 	bool	convertToAscii();
+	MString	asciiFileName() const;
+	bool	writeAscii( const MString& outputFileName,
+						unsigned long long* bytesWritten = NULL ) const;
+
+	// Size in bytes of the mapped cache file
+	//
+	size_t	fileSize() const;
+
+	// Header access. Only valid if the file has a CACH group.
+	//
+	bool			hasHeader() const;
+	const MString&	version() const;
+	int				startTime() const;
+	int				endTime() const;
+
+	// Time group access. Groups are in file order; groups without a
+	// TIME chunk (multiple file caches) report hasTime() false.
+	//
+	uint			numTimes() const;
+	bool			hasTime( uint timeIndex ) const;
+	int				time( uint timeIndex ) const;
+	bool			findTime( int time, uint& timeIndex ) const;
+
+	// Channel access within a time group
+	//
+	uint			numChannels( uint timeIndex ) const;
+	const MString&	channelName( uint timeIndex, uint channel ) const;
+	uint			channelSize( uint timeIndex, uint channel ) const;
+	bool			channelIsFloat( uint timeIndex, uint channel ) const;
+
+	// Decode a channel's DVCA or FVCA data, 3 values per point. If the
+	// data is stored in host byte order and is aligned, the returned
+	// pointer refers straight into the mapped file; otherwise the data is
+	// decoded into buffer. Returns NULL if the channel is empty or holds
+	// the other type. The result is valid until the file is destroyed or
+	// buffer is changed.
+	//
+	const double*	doubleVectorData( uint timeIndex, uint channel,
+									  std::vector<double>& buffer ) const;
+	const float*	floatVectorData( uint timeIndex, uint channel,
+									 std::vector<float>& buffer ) const;
 
 private:
-	// Read header methods
+	// Location of one IFF chunk in the mapped file
 	//
-	bool	readHeaderGroup( MStatus& status );
-	bool	readHeaderVersion();
-	bool	readHeaderTimeRange();
-
-	// Read channel methods
-	//    
-	bool	readChannelGroup( MStatus& groupStatus );
-	
-	bool	readChannelTime();
-	bool	readChannel( MStatus& channelStatus );
-	bool	readChannelName( MStatus& channelStatus );
-	bool	readChannelData();
-
-	// These methods are for modifying the data in the 
-	// cacheBlockList member called "blockList"
+	struct iffChunk
+	{
+		unsigned int	tag;
+		size_t			dataOffset;
+		size_t			size;
+		size_t			next;
+	};
+
+	struct cacheChannel
+	{
+		MString			name;
+		uint			size;			// number of points
+		bool			isFloat;		// FVCA rather than DVCA
+		size_t			dataOffset;		// of the array in the file
+	};
+
+	struct cacheTimeGroup
+	{
+		bool			hasTime;
+		int				time;
+		uint			firstChannel;
+		uint			numChannels;
+	};
+
+	// Index methods
 	//
-	void	storeCacheBlock( const MString& tag );
-	void	storeCacheBlock( const MString& tag, const int& value );
-	void	storeCacheBlock( const MString& tag, const MString& value  );
-	void	storeCacheBlock( const MString& tag, 
-						const double* value, 
-						const uint& size );
-	void	storeCacheBlock( const MString& tag, 
-						const float* value, 
-						const uint& size );
+	bool	readChunk( size_t pos, size_t end, iffChunk& chunk ) const;
+	bool	readGroup( size_t pos, size_t end, iffChunk& group,
+					   unsigned int& groupType ) const;
+	bool	indexHeaderGroup( const iffChunk& group );
+	bool	indexChannelGroup( const iffChunk& group );
+
+	const cacheChannel*	findChannel( uint timeIndex, uint channel ) const;
 
 	// Data members
 	//
-	MIffFile*			iffFilePtr;		// Object that reads the cache files
-	MString				cacheFileName;	// The cache file name
-	bool				readStatus;		// Indicates if the file was read
-	cacheBlockList		blockList;		// List of read data blocks from file
+	mappedFile					cacheData;		// The mapped cache file
+	MString						cacheFileName;	// The cache file name
+	bool						readStatus;		// Indicates if the file was read
+	bool						wideChunks;		// FOR8 file
+
+	bool						header;			// A CACH group was found
+	MString						cacheVersion;
+	int							cacheStartTime;
+	int							cacheEndTime;
+
+	std::vector<cacheTimeGroup>	timeGroups;		// MYCH groups in file order
+	std::vector<cacheChannel>	channels;		// Channels of all groups
+	bool						timesSorted;	// TIME increases through the file
 };
 
 #endif
-
@@ -20,8 +20,17 @@
 #include <maya/MFnMesh.h>
 #include <maya/MHairSystem.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MPointArray.h>
+#include <maya/MIntArray.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
+#include <maya/MAtomic.h>
 
 #include <math.h> 
+#include <vector>
+
+#include "triangleBVH.h"
 
 #define	kPluginName		"hairCollisionSolver"
 
@@ -85,10 +94,20 @@
 // representation of your object pre-frame (e.g. an octree representation)
 // and then access this representation during the collision testing.
 //
-// For the purposes of our simple demo plug-in, our private data will
-// consist of a COLLISION_INFO which contains an array of COLLISION_OBJ
-// structures, each one holding the bounding box of the object in world
-// space.
+// Our private data is a COLLISION_INFO per hair system, which contains
+// an array of COLLISION_OBJ structures, each one holding a bounding
+// volume hierarchy (see triangleBVH.h) over the triangles of the object
+// in world space. The hierarchy keeps the triangles at both the previous
+// and the current frame, so collide() can intersect the moving hair with
+// the moving object. Building a hierarchy is only needed when an object
+// is added or its topology changes; otherwise it is refit each frame,
+// which is much cheaper. The objects are updated in parallel.
+//
+// collide() then sweeps a sphere the width of the hair along the motion
+// of each hair point (and the middle of each segment) through the frame.
+// The hierarchy quickly narrows this to the few triangles the sphere
+// could reach, and each is tested continuously in time, so fast hair
+// and fast objects cannot pass through each other between frames.
 //
 // One issue with pre-processing the data involves managing the private
 // data. A collision object could be deleted or turned off during a
@@ -103,24 +122,119 @@
 // callback can get triggered 1000's of times per frame, for efficiency
 // you can pass back your private data as a pointer from your pre-frame
 // routine, and this pointer is then passed directly into your collide()
-// callback.
+// callback. This plug-in keeps its private data in a table of its own
+// instead, which is freed when the plug-in is unloaded.
 // 
 //
 typedef struct {
-	int				numVerts;	// Number of vertices in object.
-	double			minx;		// Bounding box minimal extrema.
-	double			miny;		// Bounding box minimal extrema.
-	double			minz;		// Bounding box minimal extrema.
-	double			maxx;		// Bounding box maximal extrema.
-	double			maxy;		// Bounding box maximal extrema.
-	double			maxz;		// Bounding box maximal extrema.
+	MObjectHandle	mesh;		// The collision mesh shape.
+	triangleBVH		bvh;		// World space triangles at the previous
+								// and current frame. Edits to the
+								// triangulation force a rebuild.
 } COLLISION_OBJ ;
 
 typedef struct {
-	int				numObjs;	// Number of collision objects.
-	COLLISION_OBJ	*objs;		// Array of per-object info.
+	MObjectHandle	hairSystem;	// The hair system this data belongs to.
+	double			lastTime;	// curTime of the last preFrame() call.
+	std::vector<COLLISION_OBJ> objs;	// Array of per-object info.
 } COLLISION_INFO ;
 
+// The private data of every hair system we have seen. It is kept here
+// rather than on a dynamic attribute so that uninitializePlugin() can
+// free it all.
+//
+static std::vector<COLLISION_INFO *> collisionInfos;
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Synopsis:
+//		COLLISION_INFO	*findCollisionInfo( hairSystem )
+//
+// Description:
+//		Look up the private data for `hairSystem', creating it the first
+//	time the hair system is seen. Data for hair systems which have since
+//	been deleted is freed along the way.
+//
+// Parameters:
+//		MObject hairSystem	: (in)	The hair system shape node.
+//
+// Returns:
+//		COLLISION_INFO *	: The private data for `hairSystem'.
+//
+//////////////////////////////////////////////////////////////////////////
+
+
+static COLLISION_INFO	*findCollisionInfo( const MObject hairSystem )
+{
+	COLLISION_INFO *found = NULL;
+	size_t	i = 0;
+	while ( i < collisionInfos.size() ) {
+		COLLISION_INFO *ci = collisionInfos[i];
+		if ( !ci->hairSystem.isAlive() ) {
+			delete ci;
+			collisionInfos.erase( collisionInfos.begin() + i );
+			continue;
+		}
+		if ( ci->hairSystem == hairSystem ) {
+			found = ci;
+		}
+		++i;
+	}
+
+	if ( !found ) {
+		found = new COLLISION_INFO;
+		found->hairSystem = hairSystem;
+		found->lastTime = 0.0;
+		collisionInfos.push_back( found );
+	}
+	return( found );
+}
+
+// The BVH work for one preFrame() call. The mesh data is fetched on the
+// main thread; building or refitting the hierarchies only touches our
+// own data, so the objects are shared out between the threads through
+// `nextObj'.
+//
+typedef struct {
+	COLLISION_INFO				*ci;
+	std::vector<MPointArray>	points;
+	std::vector<MIntArray>		triangles;
+	std::vector<bool>			rebuild;
+	volatile int				nextObj;
+	int							numObjs;
+	int							numTasks;
+} PREFRAME_REGION ;
+
+static MThreadRetVal	updateObjects( void *data )
+{
+	PREFRAME_REGION *region = (PREFRAME_REGION *) data;
+	for ( ;; ) {
+		int obj = MAtomic::postIncrement( &region->nextObj );
+		if ( obj >= region->numObjs ) {
+			break;
+		}
+
+		COLLISION_OBJ *co = &region->ci->objs[obj];
+		if ( region->rebuild[obj]
+				|| !co->bvh.advance( region->points[obj] ) ) {
+			// A new hierarchy has no previous frame, so the first
+			// frame after a rebuild collides against a static mesh.
+			//
+			co->bvh.build( region->points[obj], region->triangles[obj] );
+		}
+	}
+	return( (MThreadRetVal) 0 );
+}
+
+static void		decomposeObjects( void *data, MThreadRootTask *root )
+{
+	PREFRAME_REGION *region = (PREFRAME_REGION *) data;
+	for ( int i = 0; i < region->numTasks; ++i ) {
+		MThreadPool::createTask( updateObjects, data, root );
+	}
+	MThreadPool::executeAndJoin( root );
+}
+
 //////////////////////////////////////////////////////////////////////////
 //
 // Synopsis:
@@ -166,54 +280,38 @@ bool		preFrame(
 {
 	MStatus status;
 
-	// If you need want to perform any preprocessing on your collision
-	// objects pre-frame, do it here. One option for storing the pre-
-	// processed data is on a typed attribute on the hairSystem node.
-	// That data could be fetched and updated here.
-	//
-	// In our example, we'll just compute a bounding box here and NOT use
-	// attribute storage. That is an exercise for the reader.
-	//
-	MFnDependencyNode fnHairSystem( hairSystem, &status );
-	CHECK_MSTATUS_AND_RETURN( status, false );
-	fprintf( stderr,
-			"preFrame: calling hairSystem node=`%s', time=%g\n",
-			fnHairSystem.name().asChar(), curTime );
 	MObjectArray	cols;
 	MIntArray		logIdxs;
 	CHECK_MSTATUS_AND_RETURN( MHairSystem::getCollisionObject( hairSystem,
 			cols, logIdxs ), false );
 	int nobj = cols.length();
 
-	// Allocate private data.
-	// This allows us to pre-process data on a pre-frame basis to avoid
-	// calculating it per hair inside the collide() call. As noted earlier
-	// we could allocate this in preFrame() and hang it off the hairSystem
-	// node via a dynamic attribute.
-	// Instead we'll allocate it here.
-	//
-	COLLISION_INFO *collisionInfo = (COLLISION_INFO *) malloc(
-			sizeof( COLLISION_INFO ) );
-	collisionInfo->objs = (COLLISION_OBJ *) malloc(
-			nobj * sizeof( COLLISION_OBJ ) );
-	collisionInfo->numObjs = nobj;
-
-	// Create the private data that we'll make available to the collide
-	// method. The data should actually be stored in a way that it can
-	// be cleaned up (such as storing the pointer on the hairSystem node
-	// using a dynamic attribute). As it stands right now, there is a
-	// memory leak with this plug-in because the memory we're allocating
-	// for the private data is never cleaned up.
-	//
-	// Note that when using the dynamic attribute approach, it is still
-	// wise to set *privateData because this avoids the need to look up
-	// the plug inside the collide() routine which is a high-traffic
-	// method.
+	// Find the private data we kept for this hair system last frame.
+	// If the time has not moved forward, assume the playback has
+	// restarted from the beginning and rebuild everything.
 	//
+	COLLISION_INFO *collisionInfo = findCollisionInfo( hairSystem );
+	bool restart = collisionInfo->objs.empty()
+			|| curTime <= collisionInfo->lastTime;
+	collisionInfo->lastTime = curTime;
 	*privateData = (void *) collisionInfo;
 
-	// Loop through the collision objects and pre-process, storing the
-	// results in the collisionInfo structure.
+	if ( (int) collisionInfo->objs.size() != nobj ) {
+		collisionInfo->objs.clear();
+		collisionInfo->objs.resize( nobj );
+		restart = true;
+	}
+
+	PREFRAME_REGION region;
+	region.ci = collisionInfo;
+	region.points.resize( nobj );
+	region.triangles.resize( nobj );
+	region.rebuild.resize( nobj );
+	region.nextObj = 0;
+	region.numObjs = nobj;
+
+	// Fetch the world space points and triangles of each collision
+	// object. This talks to Maya, so it stays on this thread.
 	//
 	int	   obj;
 	for ( obj = 0; obj < nobj; ++obj ) {
@@ -237,91 +335,335 @@ bool		preFrame(
 			return( false );
 		}
 
-		// Get the vertices of the object transformed to world space.
-		//
-		MFloatPointArray	verts;
-		status = fnMesh.getPoints( verts, MSpace::kWorld );
+		status = fnMesh.getPoints( region.points[obj], MSpace::kWorld );
+		CHECK_MSTATUS_AND_RETURN( status, false );
+		MIntArray triangleCounts;
+		status = fnMesh.getTriangles( triangleCounts, region.triangles[obj] );
 		CHECK_MSTATUS_AND_RETURN( status, false );
 
-		// Compute the bounding box for the collision object.
-		// As this is a quick and dirty demo, we'll just support collisions
-		// between hair and the bbox.
+		// Moving points only need the hierarchy refit over the motion
+		// since last frame; a new object or anything that changes the
+		// triangulation needs a new hierarchy.
 		//
-		double minx, miny, minz, maxx, maxy, maxz, x, y, z;
-		minx = maxx = verts[0].x;
-		miny = maxy = verts[0].y;
-		minz = maxz = verts[0].z;
-		int nv = verts.length();
-		int i;
-		for ( i = 1; i < nv; ++i ) {
-			x = verts[i].x;
-			y = verts[i].y;
-			z = verts[i].z;
-
-			if ( x < minx ) {
-				minx = x;
-			}
-			if ( y < miny ) {
-				miny = y;
-			}
-			if ( z < minz ) {
-				minz = z;
-			}
+		COLLISION_OBJ *co = &collisionInfo->objs[obj];
+		region.rebuild[obj] = restart || co->mesh != colObj
+				|| !co->bvh.sameTopology( region.points[obj].length(),
+										  region.triangles[obj] );
+		co->mesh = colObj;
+	}
+
+	int numThreads = MThreadUtils::getNumThreads();
+	if ( numThreads < 1 ) {
+		numThreads = 1;
+	}
+	region.numTasks = nobj < numThreads ? nobj : numThreads;
+
+	if ( region.numTasks <= 1 || MS::kSuccess != MThreadPool::init() ) {
+		updateObjects( &region );
+	} else {
+		MThreadPool::newParallelRegion( decomposeObjects, &region );
+
+		// release the reference taken by init()
+		MThreadPool::release();
+	}
+
+	return( true );
+}
+
+#define	EPSILON	0.0001
+
+// Time steps at which a sample's motion is checked for crossing the
+// plane of a moving triangle, and bisection steps to then pin down when.
+//
+#define	CROSS_STEPS		4
+#define	BISECT_STEPS	16
+
+// A swept sphere: a point on the hair moving from p0 to p1 this frame.
+//
+typedef struct {
+	MVector			p0;			// Position at the previous time.
+	MVector			p1;			// Desired position at current time.
+	double			radius;		// Half the hair width here.
+} HAIR_SAMPLE ;
+
+// Where a sample first touches a collision object.
+//
+typedef struct {
+	double			fracTime;	// Time of contact, 0..1 over the frame.
+	MVector			normal;		// Surface normal at current time, on the
+								// side the sample came from.
+	MVector			contact;	// Contact point on the surface at current
+								// time.
+	MVector			objectVel;	// Motion of the contact point this frame.
+} HAIR_CONTACT ;
+
+static inline void	lerp3( const double *x0, const double *x1, double t,
+				double *r )
+{
+	r[0] = x0[0] + ( x1[0] - x0[0] ) * t;
+	r[1] = x0[1] + ( x1[1] - x0[1] ) * t;
+	r[2] = x0[2] + ( x1[2] - x0[2] ) * t;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Synopsis:
+//		double	planeDistance( s, a0, b0, c0, a1, b1, c1, t, normal )
+//
+// Description:
+//		Signed distance, scaled by twice the triangle's area, from the
+//	sample to the plane of the moving triangle at time `t'. The vertices
+//	move linearly from a0,b0,c0 to a1,b1,c1. The (unnormalised) triangle
+//	normal at `t' is returned in `normal'.
+//
+//////////////////////////////////////////////////////////////////////////
+
+
+static double	planeDistance(
+				const HAIR_SAMPLE	&s,
+				const double		*a0,
+				const double		*b0,
+				const double		*c0,
+				const double		*a1,
+				const double		*b1,
+				const double		*c1,
+				double				t,
+				MVector				&normal )
+{
+	double a[3], b[3], c[3];
+	lerp3( a0, a1, t, a );
+	lerp3( b0, b1, t, b );
+	lerp3( c0, c1, t, c );
+
+	MVector ab( b[0] - a[0], b[1] - a[1], b[2] - a[2] );
+	MVector ac( c[0] - a[0], c[1] - a[1], c[2] - a[2] );
+	normal = ab ^ ac;
+
+	MVector p = s.p0 + ( s.p1 - s.p0 ) * t;
+	return( normal * ( p - MVector( a[0], a[1], a[2] ) ) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Synopsis:
+//		bool	touchTriangle( s, bvh, triangle, t, side, hit )
+//
+// Description:
+//		Test if the sample is within its radius of the triangle at time
+//	`t', and if so fill in `hit'. The normal is flipped to the `side' of
+//	the triangle the sample started on; a `side' of zero means use the
+//	side the sample is on at `t'.
+//
+//////////////////////////////////////////////////////////////////////////
+
+
+static bool		touchTriangle(
+				const HAIR_SAMPLE	&s,
+				const triangleBVH	&bvh,
+				int					triangle,
+				double				t,
+				double				side,
+				HAIR_CONTACT		&hit )
+{
+	const double *a0, *b0, *c0, *a1, *b1, *c1;
+	bvh.previousTriangle( triangle, a0, b0, c0 );
+	bvh.triangle( triangle, a1, b1, c1 );
+
+	double a[3], b[3], c[3];
+	lerp3( a0, a1, t, a );
+	lerp3( b0, b1, t, b );
+	lerp3( c0, c1, t, c );
+
+	MVector pt = s.p0 + ( s.p1 - s.p0 ) * t;
+	double p[3] = { pt.x, pt.y, pt.z };
+	double closest[3], u, v;
+	double dist2 = triangleBVH::closestPointOnTriangle( p, a, b, c,
+			closest, u, v );
+	if ( dist2 > s.radius * s.radius + EPSILON * EPSILON ) {
+		return( false );
+	}
+
+	// The same barycentric point on the triangle at either end of the
+	// frame gives the motion of the surface under the hair.
+	//
+	double w = 1.0 - u - v;
+	MVector start( w * a0[0] + u * b0[0] + v * c0[0],
+				   w * a0[1] + u * b0[1] + v * c0[1],
+				   w * a0[2] + u * b0[2] + v * c0[2] );
+	MVector end(   w * a1[0] + u * b1[0] + v * c1[0],
+				   w * a1[1] + u * b1[1] + v * c1[1],
+				   w * a1[2] + u * b1[2] + v * c1[2] );
+
+	MVector normal = MVector( b1[0] - a1[0], b1[1] - a1[1], b1[2] - a1[2] )
+			^ MVector( c1[0] - a1[0], c1[1] - a1[1], c1[2] - a1[2] );
+	if ( side == 0.0 ) {
+		MVector unused;
+		side = planeDistance( s, a0, b0, c0, a1, b1, c1, t, unused );
+		if ( side == 0.0 ) {
+			// Exactly in the plane: push out along the hair's motion
+			// reversed, so it goes back where it came from.
+			//
+			side = -( normal * ( s.p1 - s.p0 ) );
+		}
+	}
+	if ( side < 0.0 ) {
+		normal = -normal;
+	}
+	if ( normal.length() < EPSILON * EPSILON ) {
+		// Degenerate triangle: use the direction away from it.
+		//
+		normal = pt - MVector( closest[0], closest[1], closest[2] );
+		if ( normal.length() < EPSILON * EPSILON ) {
+			return( false );
+		}
+	}
+
+	hit.fracTime = t;
+	hit.normal = normal.normal();
+	hit.contact = end;
+	hit.objectVel = end - start;
+	return( true );
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Synopsis:
+//		bool	sweepTriangle( s, bvh, triangle, maxTime, hit )
+//
+// Description:
+//		Continuous collision test between a swept sample and a moving
+//	triangle. The sample hits the triangle where its path crosses the
+//	triangle's moving plane within the triangle (give or take the
+//	sample's radius), or if it ends the frame within its radius of the
+//	triangle. Only hits before `maxTime' are considered.
+//
+// Returns:
+//		bool	true		: A hit was found, and `hit' is filled in.
+//		bool	false		: The sample misses the triangle.
+//
+//////////////////////////////////////////////////////////////////////////
+
 
-			if ( x > maxx ) {
-				maxx = x;
+static bool		sweepTriangle(
+				const HAIR_SAMPLE	&s,
+				const triangleBVH	&bvh,
+				int					triangle,
+				double				maxTime,
+				HAIR_CONTACT		&hit )
+{
+	const double *a0, *b0, *c0, *a1, *b1, *c1;
+	bvh.previousTriangle( triangle, a0, b0, c0 );
+	bvh.triangle( triangle, a1, b1, c1 );
+
+	// The signed distance is a cubic in time, so it can cross zero more
+	// than once. Step through the frame looking for sign changes and
+	// take the first crossing that lands on the triangle.
+	//
+	MVector	normal;
+	double	t0 = 0.0;
+	double	d0 = planeDistance( s, a0, b0, c0, a1, b1, c1, t0, normal );
+	double	side = d0;
+	int		step;
+	for ( step = 1; step <= CROSS_STEPS; ++step ) {
+		double t1 = step / (double) CROSS_STEPS;
+		double d1 = planeDistance( s, a0, b0, c0, a1, b1, c1, t1, normal );
+
+		if ( d0 != 0.0 && d1 != 0.0 && ( d0 < 0.0 ) != ( d1 < 0.0 ) ) {
+			double lo = t0, hi = t1, dlo = d0;
+			int i;
+			for ( i = 0; i < BISECT_STEPS; ++i ) {
+				double mid = 0.5 * ( lo + hi );
+				double dmid = planeDistance( s, a0, b0, c0, a1, b1, c1,
+						mid, normal );
+				if ( ( dmid < 0.0 ) == ( dlo < 0.0 ) ) {
+					lo = mid;
+					dlo = dmid;
+				} else {
+					hi = mid;
+				}
 			}
-			if ( y > maxy ) {
-				maxy = y;
+			if ( lo >= maxTime ) {
+				return( false );
 			}
-			if ( z > maxz ) {
-				maxz = z;
+			if ( touchTriangle( s, bvh, triangle, lo, dlo, hit ) ) {
+				return( true );
 			}
 		}
 
-		// Store this precomputed informantion into our private data
-		// structure.
-		//
-		collisionInfo->objs[obj].numVerts = nv;
-		collisionInfo->objs[obj].minx = minx;
-		collisionInfo->objs[obj].miny = miny;
-		collisionInfo->objs[obj].minz = minz;
-		collisionInfo->objs[obj].maxx = maxx;
-		collisionInfo->objs[obj].maxy = maxy;
-		collisionInfo->objs[obj].maxz = maxz;
-		fprintf( stderr, "Inside preFrameInit, bbox=%g %g %g %g %g %g\n",
-				minx,miny,minz,maxx,maxy,maxz);
+		if ( d1 != 0.0 ) {
+			side = d1;
+		}
+		t0 = t1;
+		d0 = d1;
 	}
 
-	return( true );
+	// No crossing, but the sample may still end up resting within its
+	// radius of the surface.
+	//
+	if ( maxTime <= 1.0 ) {
+		return( false );
+	}
+	return( touchTriangle( s, bvh, triangle, 1.0, side, hit ) );
 }
 
 //////////////////////////////////////////////////////////////////////////
 //
 // Synopsis:
-//		bool	belowCollisionPlane( co, pnt )
+//		bool	sweepSample( ci, s, candidates, hit )
 //
 // Description:
-//		Test if `pnt' is directly below the collision plane of `co'.
+//		Find the first contact of a swept sample with any of the collision
+//	objects. Each object's BVH narrows the search to the triangles whose
+//	motion this frame overlaps the sample's.
 //
 // Parameters:
-//		COLLISION_OBJ	*co	: (in)	The collision object to test against.
-//		MVector			&pnt: (in)	Point to test.
+//		COLLISION_INFO	*ci	: (in)	The collision objects.
+//		HAIR_SAMPLE	&s		: (in)	The sample to test.
+//		vector<int>	&candidates:(mod) Scratch space for triangle lists.
+//		HAIR_CONTACT &hit	: (out)	The earliest contact found.
 //
 // Returns:
-//		bool	true		: The `pnt' is directly below the collision
-//							  plane specified by `co'.
-//		bool	false		: The `pnt' is not directly below the collis-
-//							  ion plane specified by `co'.
+//		bool	true		: The sample hits something.
+//		bool	false		: The sample is clear of every object.
 //
 //////////////////////////////////////////////////////////////////////////
 
 
-bool	belowCollisionPlane( const COLLISION_OBJ *co, const MVector &pnt )
+static bool		sweepSample(
+				const COLLISION_INFO	*ci,
+				const HAIR_SAMPLE		&s,
+				std::vector<int>		&candidates,
+				HAIR_CONTACT			&hit )
 {
-	return(    pnt.x > co->minx && pnt.x < co->maxx
-			                    && pnt.y < co->maxy
-			&& pnt.z > co->minz && pnt.z < co->maxz );
+	double bmin[3], bmax[3];
+	bmin[0] = s.p0.x < s.p1.x ? s.p0.x : s.p1.x;
+	bmin[1] = s.p0.y < s.p1.y ? s.p0.y : s.p1.y;
+	bmin[2] = s.p0.z < s.p1.z ? s.p0.z : s.p1.z;
+	bmax[0] = s.p0.x > s.p1.x ? s.p0.x : s.p1.x;
+	bmax[1] = s.p0.y > s.p1.y ? s.p0.y : s.p1.y;
+	bmax[2] = s.p0.z > s.p1.z ? s.p0.z : s.p1.z;
+
+	// Anything after the end of the frame (including resting contact
+	// at the very end) is later than any crossing.
+	//
+	double	maxTime = 2.0;
+	bool	found = false;
+	size_t	obj;
+	for ( obj = 0; obj < ci->objs.size(); ++obj ) {
+		const triangleBVH &bvh = ci->objs[obj].bvh;
+		bvh.overlapping( bmin, bmax, s.radius + EPSILON, candidates );
+
+		size_t i;
+		for ( i = 0; i < candidates.size(); ++i ) {
+			HAIR_CONTACT contact;
+			if ( sweepTriangle( s, bvh, candidates[i], maxTime, contact ) ) {
+				hit = contact;
+				found = true;
+				maxTime = contact.fracTime;
+			}
+		}
+	}
+	return( found );
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -346,6 +688,10 @@ bool	belowCollisionPlane( const COLLISION_OBJ *co, const MVector &pnt )
 //	iterations factor is multipled by 2, so at its default value of 4, you
 //	get 8x calls. However, if you set iterations=0, it clamps to 1x calls).
 //
+//		Our implementation only reads the private data built in preFrame()
+//	and keeps everything else on the stack, so several follicles can be
+//	collided at once from different threads.
+//
 // Parameters:
 //		MObject hairSystem	: (in)	The hair system shape node.
 //		int		follicleIndex:(in)	Which follicle we are processing.
@@ -399,8 +745,6 @@ bool	belowCollisionPlane( const COLLISION_OBJ *co, const MVector &pnt )
 //////////////////////////////////////////////////////////////////////////
 
 
-#define	EPSILON	0.0001
-
 bool	collide(
 				const MObject		hairSystem,
 				const int			follicleIndex,
@@ -416,237 +760,108 @@ bool	collide(
 	// Get the private data for the collision objects which was returned
 	// from preFrame().
 	//
-	COLLISION_INFO *ci = (COLLISION_INFO *) privateData;
+	const COLLISION_INFO *ci = (const COLLISION_INFO *) privateData;
 	if ( !ci ) {
 		fprintf( stderr,"%s:%d: collide() privateData pointer is NULL\n",
 				__FILE__, __LINE__ );
 		return( false );
 	}
 
-	// If object has no vertices, or hair has no segments, then there is
+	// If there are no objects, or hair has no segments, then there is
 	// nothing to collide. In our example, we'll return here, but if you
 	// want to implement your own hair processing such as smoothing or
 	// freeze on the hair, you could proceed and let the processing happen
-	// after the object loop so that the data gets processed even if no
+	// after the sample loop so that the data gets processed even if no
 	// collisions occur.
 	//
-	if ( ci->numObjs <= 0 || hairPositions.length() <= 0 ) {
+	int numPositions = hairPositions.length();
+	if ( ci->objs.empty() || numPositions <= 0 ) {
 		return( true );
 	}
 
-	int		obj;
-	for ( obj = 0; obj < ci->numObjs; ++obj ) {
-		COLLISION_OBJ *co = &ci->objs[obj];
+	// Step through the follicle from the root toward the tip, testing
+	// each hair point and then the middle of the segment that ends at
+	// it, once both its ends are settled, so that long segments cannot
+	// straddle thin parts of the object. Each test is a sphere the width
+	// of the hair swept over the frame against the moving triangles of
+	// the objects:
+	//
+	//		p1 = hairPositions		// Desired pos'n at cur frame.
+	//		p0 = hairPositionsLast	// Position at prev frame.
+	//
+	// Points before startIndex or after endIndex are locked. A segment
+	// is tested if either end can move, and a hit on it moves whichever
+	// ends can.
+	//
+	std::vector<int> candidates;
+	int		seg;
+	for ( seg = 0; seg < numPositions; ++seg ) {
+		int		sample;
+		for ( sample = 0; sample < 2; ++sample ) {
+			int		first = sample == 0 ? seg : seg - 1;
+			int		last = seg;
+			if ( first < 0 ) {
+				break;
+			}
 
-		// For our plug-in example, we just collide the segments of the
-		// hair against the top of the bounding box for the geometry.
-		// In an implementation where you only care about hair falling
-		// downwards onto flat objects, this might be OK. However, in the
-		// most deluxe of implementation, you should do the following:
-		//
-		//		o  Determine the motion of each face of your collision
-		//		   object during the time range.
-		//		o  Step through the follicle, and consider each segment
-		//		   to be a moving cylinder where the start and end radii
-		//		   can differ. The radii come from `hairWidths' and the
-		//		   motion comes from the difference between `hairPositions'
-		//		   and `hairPositionsLast'.
-		//		o  Intersect each moving element (e.g. moving triangle
-		//		   if you have a mesh obect) with each hair segment
-		//		   e.g. moving cylinder). This intersection may occur
-		//		   at a point within the frame. (Remember that the
-		//		   hairPositions[] array holds the DESIRED location where
-		//		   the hair system wants the hair to go.
-		//		o  There can be multiple collisions along a hair segment.
-		//		   Use the first location found and the maximal velocity.
-		//
-		// If a collision is detected, the `hairPositions' array should be
-		// updated. `hairPositionsLast' may also be updated to provide a
-		// dampening effect only.
-		//
+			bool	moveFirst = first >= startIndex && first <= endIndex;
+			bool	moveLast = last >= startIndex && last <= endIndex;
+			if ( !moveFirst && !moveLast ) {
+				continue;
+			}
 
-		// Loop through the follicle, starting at the root and advancing
-		// toward the tip.
-		//
-		int		numSegments = hairPositions.length() - 1;
-		int		seg;
-		for ( seg = 0; seg < numSegments; ++seg ) {
-			// Get the desired position of the segment (i.e. where the
-			// solver is trying to put the hair for the current frame)
-			// and the velocity required to get to that desired position.
+			HAIR_SAMPLE s;
+			s.p1 = ( hairPositions[first] + hairPositions[last] ) * 0.5;
+			s.p0 = ( hairPositionsLast[first] + hairPositionsLast[last] )
+					* 0.5;
+			s.radius = 0.25 * ( hairWidths[first] + hairWidths[last] );
+
+			HAIR_CONTACT hit;
+			if ( !sweepSample( ci, s, candidates, hit ) ) {
+				continue;
+			}
+
+			// We have a collision. Compute the new velocity for the
+			// hair at the point of collision: the object's velocity
+			// along the normal, plus the hair's tangential velocity
+			// dragged toward the object's by friction.
 			//
-			// Thus,
-			//		P = hairPositions		// Desired pos'n at cur frame.
-			//		L = hairPositionsLast	// Position at prev frame.
-			//		V = P - L				// Desired velocity of hair.
+			MVector v = s.p1 - s.p0;
+			MVector normal = hit.normal;
+			MVector objectVel = hit.objectVel;
+			MVector objVelAlongNormal = (objectVel * normal) * normal;
+			MVector objVelAlongTangent = objectVel - objVelAlongNormal;
+			MVector pntVelAlongTangent = v - ( v * normal ) * normal;
+			MVector reflectedPntVelAlongTangent
+					= pntVelAlongTangent * ( 1.0 - friction )
+					+ objVelAlongTangent * friction;
+			MVector newVel = objVelAlongNormal
+					+ reflectedPntVelAlongTangent;
+
+			// Put the sample just clear of the surface where it is now,
+			// and move the hair points it came from by the same amount.
+			// Their velocity changes as the sample's did.
 			//
-			MVector pStart = hairPositions[seg];
-			MVector pEnd = hairPositions[seg + 1];
-
-			MVector vStart = pStart - hairPositionsLast[seg];
-			MVector vEnd = pEnd - hairPositionsLast[seg + 1];
-
-			// The proper way to time sample is to intersect the moving
-			// segment of width `hairWidths[seg] to hairWidths[seg + 1]'
-			// with the moving collision object. For the purposes of our
-			// demo plug-in, we will simply assume the collision object is
-			// static, the hair segment has zero width, and instead of
-			// intersecting continuously in time, we will sample discrete
-			// steps along the segment.
+			// If only one end of a segment can move, it has to move
+			// twice as far to carry the middle there.
 			//
-			#define STEPS 4
-			int		step;
-			for ( step = 0; step < STEPS; ++step ) {
-				// Compute the point for this step and its corresponding
-				// velocity. This is a "time swept" point:
-				//	p1 = desired position at current time
-				//	p0 = position at previous time to achieve desired pos
-				//
-				MVector pCur, pPrev, v;
-				double fracAlongSeg = step / ( (double) STEPS );
-				v = vStart * ( 1.0 - fracAlongSeg ) + vEnd * fracAlongSeg;
-				MVector p1 = pStart * ( 1.0 - fracAlongSeg )
-						+ pEnd * fracAlongSeg;
-				MVector p0 = p1 - v;
-
-				// See if BOTH endpoints are outside of the bounding box
-				// on the same side. If so, then the segment cannot
-				// intersect the bounding box. Note that we assume the
-				// bounding box is static.
-				//
-				if (       p0.x < co->minx && p1.x < co->minx
-						|| p0.y < co->miny && p1.y < co->miny
-						|| p0.z < co->minz && p1.z < co->minz
-						|| p0.x > co->maxx && p1.x > co->maxx
-						|| p0.y > co->maxy && p1.y > co->maxy
-						|| p0.z > co->maxz && p1.z > co->maxz ) {
-					continue;
-				}
-
-				// For the purposes of this example plug-in, we'll assume
-				// the hair always moves downwards (due to gravity and
-				// thus in the negative Y direction). As such, we only
-				// need to test for collisions with the TOP of the
-				// bounding box. Expanding the example to all 6 sides is
-				// left as an exercise for the reader.
-				//
-				// Remember that p1 is the point at current time, and
-				// p0 is the point at the previous time. Since we assume
-				// the bounding box to be static, this simplifies things.
-				//
-				MVector	where(-100000,-100000,-100000);	// Loc'n of collision
-				double  fracTime;	// Time at which collision happens 0..1
-
-				if ( fabs( v.y ) < EPSILON		// velocity is zero
-						&& fabs( p1.y - co->maxy ) < EPSILON ) {	// right on the bbox
-					// Velocity is zero and the desired location (p1) is
-					// right on top of the bounding box.
-					//
-					where = p1;
-					fracTime = 1.0;		// Collides right at end;
-				} else {
-					fracTime = ( co->maxy -  p0.y ) / v.y;
-					if ( fracTime >= 0.0 && fracTime <= 1.0 ) {
-						// Compute the collision of the swept point with the
-						// plane defined by the top of the bounding box.
-						//
-						where = p0 + v * fracTime;
-					}
-				}
-
-				// If `seg' lies between startIndex and endIndex
-				// we can move it. If its <= startIndex, the root is
-				// locked and if >= endIndex the tip is locked.
-				//
-				if ( seg >= startIndex && seg <= endIndex ) {
-					// Since we are just colliding with the top of the
-					// bounding box, the normal where we hit is (0,1,0).
-					// For the object velocity, we SHOULD measure the
-					// relative motion of the object during the time
-					// interval, but for our example, we'll assume its
-					// not moving (0,0,0).
-					//
-					bool segCollides = false;
-					MVector normal(0.0,1.0,0.0);	// normal is always up
-					MVector objectVel(0.0,0.0,0.0);	// assume bbox is static
-
-					// If we get the this point, then the intersection
-					// point `where' is on the plane of the bounding box
-					// top. See if it lies within the actual bounds of the
-					// boxtop, and if so compute the position and velocity
-					// information and apply to the hair segment.
-					//
-					if ( where.x >= co->minx && where.x <= co->maxx
-							&& where.z >= co->minz && where.z <= co->maxz
-							&& fracTime >= 0.0 && fracTime <= 0.0 ) {
-						// We have a collision at `where' with the plane.
-						// Compute the new velocity for the hair at the
-						// point of collision.
-						//
-						MVector objVelAlongNormal = (objectVel * normal)
-								* normal;
-						MVector objVelAlongTangent = objectVel
-								- objVelAlongNormal;
-						MVector pntVelAlongTangent = v - ( v * normal )
-								* normal;
-						MVector reflectedPntVelAlongTangent
-								= pntVelAlongTangent * ( 1.0 - friction )
-								+ objVelAlongTangent * friction;
-						MVector newVel = objVelAlongNormal
-								+ reflectedPntVelAlongTangent;
-
-						// Update the hair position. It actually looks
-						// more stable from a simulation standpoint to
-						// just move the closest segment endpoint, but
-						// you are free to experiment. What we'll do in
-						// our example is move the closest segment end-
-						// point by the amount the collided point (where)
-						// has to move to have velocity `newVel' yet still
-						// pass through `where' at time `fracTime'.
-						//
-						if ( fracAlongSeg > 0.5 ) {
-							MVector	deltaPos = -newVel * fracTime;
-							hairPositionsLast[seg + 1] += deltaPos;
-							hairPositions[seg + 1] = hairPositionsLast[seg]
-									+ newVel;
-						} else {
-							MVector	deltaPos = newVel * fracTime;
-							hairPositionsLast[seg] += deltaPos;
-							hairPositions[seg] = hairPositionsLast[seg]
-									+ newVel;
-						}
-						segCollides = true;
-					}
-
-                    // Check for segment endpoints that may still be
-					// inside. Note that segments which started out being
-					// totally inside will never collide using the
-					// algorithm we use above, so we'll simply clamp them
-					// here. One might expect an inside-the-bounding-box
-					// test instead. However, this does not work if the
-					// collision object is a very thin object.
-					//
-					bool inside = false;
-                    if ( belowCollisionPlane( co, hairPositions[seg] ) ) {
-						hairPositions[seg].y = co->maxy + EPSILON;
-						hairPositionsLast[seg] = hairPositions[seg] - objectVel;
-						inside = true;
-                    }
-                    if ( belowCollisionPlane( co, hairPositions[seg+1] ) ) {
-						hairPositions[seg+1].y = co->maxy + EPSILON;
-						hairPositionsLast[seg+1] = hairPositions[seg+1] - objectVel;
-						inside = true;
-                    }
-
-					// If we collided, go onto the next segment.
-					//
-					if ( segCollides || inside ) {
-						goto nextSeg;
-					}
-				}
+			MVector target = hit.contact
+					+ normal * ( s.radius + EPSILON );
+			MVector deltaPos = target - s.p1;
+			MVector deltaLast = deltaPos + v - newVel;
+			if ( last != first && !( moveFirst && moveLast ) ) {
+				deltaPos *= 2.0;
+				deltaLast *= 2.0;
 			}
-nextSeg:;
-    	}
+			if ( moveFirst ) {
+				hairPositions[first] += deltaPos;
+				hairPositionsLast[first] += deltaLast;
+			}
+			if ( moveLast && last != first ) {
+				hairPositions[last] += deltaPos;
+				hairPositionsLast[last] += deltaLast;
+			}
+		}
 	}
 
 	// You could perform any global filtering that you want on the hair
@@ -713,5 +928,11 @@ MStatus uninitializePlugin( MObject obj )
 	CHECK_MSTATUS( MHairSystem::unregisterCollisionSolverCollide() );
 	CHECK_MSTATUS( MHairSystem::unregisterCollisionSolverPreFrame() );
 
+	size_t i;
+	for ( i = 0; i < collisionInfos.size(); ++i ) {
+		delete collisionInfos[i];
+	}
+	collisionInfos.clear();
+
 	return( MS::kSuccess );
 }
@@ -0,0 +1,159 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+//
+//  File: mappedFile.cpp
+//
+//  Description:
+//		Read-only memory mapped file, with a read() fallback.
+//		See mappedFile.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mappedFile.h"
+
+mappedFile::mappedFile()
+:	fData( NULL ), fSize( 0 ), fMapped( false ), fOpenEmpty( false )
+#if defined(_WIN32)
+	, fFileHandle( NULL ), fMappingHandle( NULL )
+#endif
+{
+}
+
+mappedFile::~mappedFile()
+{
+	close();
+}
+
+// Read the whole file into memory, for when it cannot be mapped.
+//
+static const char* readWholeFile( const char* fileName, size_t& size )
+{
+	FILE* fp = fopen( fileName, "rb" );
+	if( NULL == fp ) return NULL;
+
+	char* buffer = NULL;
+	if( 0 == fseek( fp, 0, SEEK_END ) ) {
+		long length = ftell( fp );
+		if( length > 0 && 0 == fseek( fp, 0, SEEK_SET ) ) {
+			buffer = (char*) malloc( (size_t) length );
+			if( buffer && fread( buffer, 1, (size_t) length, fp ) != (size_t) length ) {
+				free( buffer );
+				buffer = NULL;
+			}
+			if( buffer ) size = (size_t) length;
+		}
+	}
+	fclose( fp );
+	return buffer;
+}
+
+bool mappedFile::open( const char* fileName )
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+							   OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL );
+	if( INVALID_HANDLE_VALUE == file ) return false;
+
+	LARGE_INTEGER length;
+	if( !GetFileSizeEx( file, &length ) ) {
+		CloseHandle( file );
+		return false;
+	}
+	if( length.QuadPart == 0 ) {
+		CloseHandle( file );
+		fOpenEmpty = true;
+		return true;
+	}
+	if( (unsigned __int64) length.QuadPart <= (size_t) -1 ) {
+		HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+		if( mapping ) {
+			void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+			if( view ) {
+				fFileHandle = file;
+				fMappingHandle = mapping;
+				fData = (const char*) view;
+				fSize = (size_t) length.QuadPart;
+				fMapped = true;
+				return true;
+			}
+			CloseHandle( mapping );
+		}
+	}
+	CloseHandle( file );
+#else
+	int fd = ::open( fileName, O_RDONLY );
+	if( fd < 0 ) return false;
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 ) {
+		::close( fd );
+		return false;
+	}
+	if( st.st_size == 0 ) {
+		::close( fd );
+		fOpenEmpty = true;
+		return true;
+	}
+	if( (unsigned long long) st.st_size <= (size_t) -1 ) {
+		void* view = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+		if( view != MAP_FAILED ) {
+			// the mapping keeps its own reference to the file
+			::close( fd );
+			fData = (const char*) view;
+			fSize = (size_t) st.st_size;
+			fMapped = true;
+			return true;
+		}
+	}
+	::close( fd );
+#endif
+
+	fData = readWholeFile( fileName, fSize );
+	return fData != NULL;
+}
+
+void mappedFile::close()
+{
+	if( fData ) {
+		if( fMapped ) {
+#if defined(_WIN32)
+			UnmapViewOfFile( (void*) fData );
+			CloseHandle( (HANDLE) fMappingHandle );
+			CloseHandle( (HANDLE) fFileHandle );
+			fMappingHandle = NULL;
+			fFileHandle = NULL;
+#else
+			munmap( (void*) fData, fSize );
+#endif
+		} else {
+			free( (void*) fData );
+		}
+	}
+	fData = NULL;
+	fSize = 0;
+	fMapped = false;
+	fOpenEmpty = false;
+}
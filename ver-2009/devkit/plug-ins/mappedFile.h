@@ -0,0 +1,59 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _mappedFile_h
+#define _mappedFile_h
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// mappedFile
+//
+// Read-only view of a whole file. The file is memory mapped where the
+// platform allows it, so only the pages that are actually touched are
+// read from disk; if mapping fails the contents are read into memory
+// instead. Either way data() stays valid until close().
+//
+// The view is shared, read-only state, so any number of threads may
+// read from it at once.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+
+class mappedFile
+{
+public:
+						mappedFile();
+						~mappedFile();
+
+	bool				open( const char* fileName );
+	void				close();
+
+	bool				isOpen() const		{ return fData != NULL || fOpenEmpty; }
+	bool				isMapped() const	{ return fMapped; }
+	const char*			data() const		{ return fData; }
+	size_t				size() const		{ return fSize; }
+
+private:
+						mappedFile( const mappedFile& );
+	mappedFile&			operator=( const mappedFile& );
+
+	const char*			fData;
+	size_t				fSize;
+	bool				fMapped;
+	bool				fOpenEmpty;
+#if defined(_WIN32)
+	void*				fFileHandle;
+	void*				fMappingHandle;
+#endif
+};
+
+#endif
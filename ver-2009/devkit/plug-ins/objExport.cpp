@@ -68,6 +68,13 @@
 #include <maya/MDistance.h>
 #include <maya/MIntArray.h>
 #include <maya/MIOStream.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
+
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <vector>
 
 #if defined (_WIN32)
 #define strcasecmp stricmp
@@ -81,20 +88,268 @@ extern "C" Boolean createMacFile (const char *fileName, FSRef *fsRef, long creat
 #define INVALID_ID              -1
 
 //
-// Edge info structure
+// Edge info structure. All of a mesh's edges are allocated in a single
+// pool and looked up by vertex pair through an open addressing hash.
 //
 typedef struct EdgeInfo {
     int                 polyIds[2]; // Id's of polygons that reference edge
-    int                 vertId;     // The second vertex of this edge
-    struct EdgeInfo *   next;       // Pointer to next edge
     bool                smooth;     // Is this edge smooth
 } * EdgeInfoPtr;
 
+//
+// Output buffer. All text goes through one of these rather than
+// through fprintf. With a sink file the buffer is written out whenever
+// it fills up; without one it grows to hold everything, which is what
+// the parallel formatting path uses to keep each mesh's text until it
+// can be written in order.
+//
+#define OBJ_BUFFER_SIZE     (1 << 20)
+
+class ObjWriteBuffer {
+public:
+                    ObjWriteBuffer( FILE *sink = NULL );
+                    ~ObjWriteBuffer();
+
+    void            put( char c );
+    void            put( const char *str );
+    void            put( const char *str, size_t len );
+    void            putInt( int value );
+    void            putFloat( double value );
+
+    size_t          length() const      { return fLength; }
+    const char *    data() const        { return fData; }
+    void            clear()             { fLength = 0; }
+
+    // True once the buffer ran out of memory or could not be written.
+    // Nothing more is buffered after that.
+    //
+    bool            failed() const      { return fFailed; }
+
+    // Write the buffered text to the sink, or to the given file.
+    //
+    bool            flush();
+    bool            writeTo( FILE *file ) const;
+
+    // Flush, then write another buffer's text straight to the sink.
+    // A failure, here or in text, is remembered just as it is by flush().
+    //
+    bool            flush( const ObjWriteBuffer& text );
+
+private:
+                    ObjWriteBuffer( const ObjWriteBuffer& );
+    ObjWriteBuffer& operator=( const ObjWriteBuffer& );
+
+    bool            reserve( size_t len );
+
+    char *          fData;
+    size_t          fLength;
+    size_t          fCapacity;
+    FILE *          fSink;
+    bool            fFailed;
+};
+
+ObjWriteBuffer::ObjWriteBuffer( FILE *sink )
+:   fData( NULL ), fLength( 0 ), fCapacity( 0 ), fSink( sink ), fFailed( false )
+{
+}
+
+ObjWriteBuffer::~ObjWriteBuffer()
+{
+    flush();
+    free( fData );
+}
+
+bool ObjWriteBuffer::reserve( size_t len )
+{
+    if ( fFailed )
+        return false;
+    if ( fLength + len <= fCapacity )
+        return true;
+
+    if ( NULL != fSink ) {
+        if ( !flush() )
+            return false;
+        if ( len <= fCapacity )
+            return true;
+    }
+
+    size_t capacity = fCapacity ? fCapacity : OBJ_BUFFER_SIZE;
+    while ( capacity < fLength + len )
+        capacity *= 2;
+
+    char *data = (char *)realloc( fData, capacity );
+    if ( NULL == data ) {
+        fFailed = true;
+        return false;
+    }
+    fData = data;
+    fCapacity = capacity;
+    return true;
+}
+
+inline void ObjWriteBuffer::put( char c )
+{
+    if ( !reserve( 1 ) )
+        return;
+    fData[fLength++] = c;
+}
+
+inline void ObjWriteBuffer::put( const char *str, size_t len )
+{
+    if ( !reserve( len ) )
+        return;
+    memcpy( fData + fLength, str, len );
+    fLength += len;
+}
+
+inline void ObjWriteBuffer::put( const char *str )
+{
+    put( str, strlen( str ) );
+}
+
+void ObjWriteBuffer::putInt( int value )
+{
+    char tmp[16];
+    if ( fFailed )
+        return;
+    char *p = tmp + sizeof(tmp);
+    unsigned int u = ( value < 0 ) ? 0u - (unsigned int)value : (unsigned int)value;
+    do {
+        *--p = (char)( '0' + u % 10 );
+        u /= 10;
+    } while ( u );
+    if ( value < 0 )
+        *--p = '-';
+    put( p, tmp + sizeof(tmp) - p );
+}
+
+void ObjWriteBuffer::putFloat( double value )
+//
+// Writes value the way printf's "%f" does (six decimals, ties to even).
+// value * 1e6 is exact for float inputs, as it needs at most 44
+// significant bits. For doubles the product may be off by half an ulp,
+// so values that land that close to a rounding boundary, along with
+// non-finite values and those whose scaled value is past 2^53 (about
+// 9.007e9 before scaling), where a double no longer holds every
+// integer, go through snprintf instead.
+//
+{
+    // room for "%f" of -DBL_MAX: sign, 309 digits, point and 6 decimals
+    char tmp[DBL_MAX_10_EXP + 16];
+
+    if ( fFailed )
+        return;
+
+    // printf keeps the sign of negative values that round to zero
+    bool negative = ( value < 0.0 ) || ( value == 0.0 && 1.0 / value < 0.0 );
+    double scaled = fabs( value ) * 1.0e6;
+    double r = floor( scaled );
+    double diff = scaled - r;
+
+    if ( !( fabs( value ) < 9.0e9 ) ||
+         ( fabs( diff - 0.5 ) <= scaled * 2.3e-16 && (double)(float)value != value ) ) {
+#if defined (_WIN32)
+        int n = _snprintf( tmp, sizeof(tmp), "%f", value );
+#else
+        int n = snprintf( tmp, sizeof(tmp), "%f", value );
+#endif
+        if ( n < 0 || n >= (int)sizeof(tmp) ) {
+            tmp[sizeof(tmp) - 1] = '\0';
+            n = (int)strlen( tmp );
+        }
+        put( tmp, n );
+        return;
+    }
+
+    if ( diff > 0.5 || ( diff == 0.5 && fmod( r, 2.0 ) != 0.0 ) )
+        r += 1.0;
+
+    // the largest scaled value (9e15) fits in 64 bits
+    unsigned long long u = (unsigned long long)r;
+    unsigned int frac = (unsigned int)( u % 1000000 );
+    unsigned long long whole = u / 1000000;
+
+    char *p = tmp + sizeof(tmp);
+    for ( int i = 0; i < 6; i++ ) {
+        *--p = (char)( '0' + frac % 10 );
+        frac /= 10;
+    }
+    *--p = '.';
+    do {
+        *--p = (char)( '0' + (int)( whole % 10 ) );
+        whole /= 10;
+    } while ( whole );
+    if ( negative )
+        *--p = '-';
+    put( p, tmp + sizeof(tmp) - p );
+}
+
+bool ObjWriteBuffer::writeTo( FILE *file ) const
+{
+    if ( 0 == fLength )
+        return true;
+    return fwrite( fData, 1, fLength, file ) == fLength;
+}
+
+bool ObjWriteBuffer::flush()
+{
+    if ( NULL == fSink || 0 == fLength )
+        return !fFailed;
+    if ( !writeTo( fSink ) )
+        fFailed = true;
+    fLength = 0;
+    return !fFailed;
+}
+
+bool ObjWriteBuffer::flush( const ObjWriteBuffer& text )
+{
+    if ( text.failed() )
+        fFailed = true;
+    if ( NULL == fSink ) {
+        put( text.data(), text.length() );
+        return !fFailed;
+    }
+    if ( flush() && !text.writeTo( fSink ) )
+        fFailed = true;
+    return !fFailed;
+}
+
+//
+// Everything needed to format one mesh, fetched in bulk from MFnMesh.
+// Group, material and smoothing lines depend on state that carries
+// over from mesh to mesh, so they are worked out when the mesh is
+// gathered and stored as notes: text to emit in front of a given
+// vertex or face.
+//
+struct ObjNote {
+    int                 index;      // vertex or face the text precedes
+    size_t              begin;      // range in ObjMeshData::notes
+    size_t              end;
+};
+
+struct ObjMeshData {
+                        ObjMeshData() : uiScale( 1.0 ), voff( 0 ), vtoff( 0 ), vnoff( 0 ) {}
+
+    MPointArray         points;
+    MFloatArray         uArray, vArray;
+    MFloatVectorArray   normals;
+    MIntArray           polyCounts, polyVerts;
+    MIntArray           uvCounts, uvIds;
+    MIntArray           normalIds;
+    double              uiScale;    // internal to UI units
+    int                 voff, vtoff, vnoff;
+
+    ObjWriteBuffer      notes;
+    std::vector<ObjNote> vertexNotes;
+    std::vector<ObjNote> faceNotes;
+};
+
+
 
 //////////////////////////////////////////////////////////////
 class ObjTranslator : public MPxFileTranslator {
 public:
-                    ObjTranslator () {};
+                    ObjTranslator () : out( NULL ) {};
     virtual         ~ObjTranslator () {};
     static void*    creator();
 
@@ -112,8 +367,12 @@ public:
                                    const char* buffer,
                                    short size) const;
 private:
-    void            outputSetsAndGroups    ( MDagPath&, int, bool, int );
+    void            outputSetsAndGroups    ( MDagPath&, int, bool, int, ObjWriteBuffer& );
     MStatus         OutputPolygons( MDagPath&, MObject& );
+    MStatus         flushMeshes();
+    static void     formatMesh( ObjMeshData&, ObjWriteBuffer& );
+    static void     formatMeshesInParallel( void*, MThreadRootTask* );
+    static MThreadRetVal formatMeshTask( void* );
     MStatus         exportSelected();
     MStatus         exportAll();
 	void		    initializeSetsAndLookupTables( bool exportAll );
@@ -129,7 +388,7 @@ private:
     void            addEdgeInfo( int, int, bool );
     EdgeInfoPtr     findEdgeInfo( int, int );
     void            destroyEdgeTable();
-    bool            smoothingAlgorithm( int, MFnMesh& );
+    void            assignSmoothingGroups( int );
 
 private:
     // counters
@@ -137,9 +396,15 @@ private:
     // offsets
     int voff,vtoff,vnoff;
     // options
-    bool groups, ptgroups, materials, smoothing, normals;
+    bool groups, ptgroups, materials, smoothing, normals, parallel;
 
     FILE *fp;
+
+    // Meshes gathered but not yet written, and the buffer used when
+    // they are formatted one at a time.
+    //
+    std::vector<ObjMeshData*>   pendingMeshes;
+    ObjWriteBuffer *            out;
 	
 	// Keeps track of all sets.
 	//
@@ -173,14 +438,15 @@ private:
 	int objectId;
 	int objectCount;
     
-    // Edge lookup table (by vertex id) and smoothing group info
+    // Edge lookup table (by vertex pair) and smoothing group info
     //
-    EdgeInfoPtr *   edgeTable;
+    EdgeInfoPtr     edgePool;       // one entry per edge
+    int             edgePoolSize;   // entries in use
+    int             edgePoolCapacity;
+    unsigned long long * edgeKeys;  // vertex pair per slot, 0 if empty
+    int *           edgeSlots;      // edgePool index per slot
+    unsigned int    edgeHashMask;   // number of slots - 1
     int *           polySmoothingGroups;
-    int             edgeTableSize;
-    int             nextSmoothingGroup;
-    int             currSmoothingGroup;
-    bool            newSmoothingGroup;
 
 	// List of names of the mesh shapes that we export from maya
 	MStringArray	objectNodeNamesArray;
@@ -199,6 +465,7 @@ const char *const objDefaultOptions =
     "materials=1;"
     "smoothing=1;"
     "normals=1;"
+    "parallel=0;"
     ;
 
 //////////////////////////////////////////////////////////////
@@ -301,6 +568,7 @@ MStatus ObjTranslator::writer ( const MFileObject& file,
     materials   = true; // write out shading groups
     smoothing   = true; // write out facet smoothing information
     normals     = true; // write out normal table and facet normals
+    parallel    = false; // format several meshes at once
     
   if (options.length() > 0) {
         int i, length;
@@ -353,13 +621,24 @@ MStatus ObjTranslator::writer ( const MFileObject& file,
                     smoothing = false;
                 }
             }
+            if( theOption[0] == MString("parallel") &&
+                                                    theOption.length() > 1 ) {
+                if( theOption[1].asInt() > 0 ){
+                    parallel = true;
+                }else{
+                    parallel = false;
+                }
+            }
         }
     }
 
     /* print current linear units used as a comment in the obj file */
     setToLongUnitName(MDistance::uiUnit(), unitName);
+    out = new ObjWriteBuffer( fp );
     //fprintf( fp, "# This file uses %s as units for non-parametric coordinates.\n\n", unitName.asChar() ); 
-    fprintf( fp, "# The units used in this file are %s.\n", unitName.asChar() );
+    out->put( "# The units used in this file are " );
+    out->put( unitName.asChar() );
+    out->put( ".\n" );
 
     if( ( mode == MPxFileTranslator::kExportAccessMode ) ||
         ( mode == MPxFileTranslator::kSaveAccessMode ) )
@@ -370,7 +649,17 @@ MStatus ObjTranslator::writer ( const MFileObject& file,
     {
         exportSelected();
     }
-    fclose(fp);
+
+    bool written = out->flush();
+    delete out;
+    out = NULL;
+    if ( fclose(fp) != 0 )
+        written = false;
+
+    if ( !written ) {
+        cerr << "Error: could not write to " << fname << endl;
+        return MS::kFailure;
+    }
 
     return MS::kSuccess;
 }
@@ -473,6 +762,13 @@ MStatus ObjTranslator::OutputPolygons(
         MDagPath& mdagPath,
         MObject&  mComponent
 )
+//
+// Description :
+//    Fetches the mesh data in bulk and queues it for formatting. The
+//    group, material and smoothing lines are decided here, in export
+//    order, since they depend on what was written before; the numeric
+//    text is produced later by formatMesh().
+//
 {
 	MStatus stat = MS::kSuccess;
 	MSpace::Space space = MSpace::kWorld;
@@ -484,18 +780,7 @@ MStatus ObjTranslator::OutputPolygons(
 		return MS::kFailure;
 	}
 
-	MItMeshPolygon polyIter( mdagPath, mComponent, &stat );
-	if ( MS::kSuccess != stat) {
-		fprintf(stderr,"Failure in MItMeshPolygon initialization.\n");
-		return MS::kFailure;
-	}
-	MItMeshVertex vtxIter( mdagPath, mComponent, &stat );
-	if ( MS::kSuccess != stat) {
-		fprintf(stderr,"Failure in MItMeshVertex initialization.\n");
-		return MS::kFailure;
-	}
-
-	int objectIdx, length;
+	int objectIdx = 0, length;
 	MString mdagPathNodeName = fnMesh.name();
 	// Find i such that objectGroupsTablePtr[i] corresponds to the
 	// object node pointed to by mdagPath
@@ -507,69 +792,77 @@ MStatus ObjTranslator::OutputPolygons(
 		}
 	}
 
-    // Write out the vertex table
-    //
+	ObjMeshData *mesh = new ObjMeshData;
 
-	for ( ; !vtxIter.isDone(); vtxIter.next() ) {
-		MPoint p = vtxIter.position( space );
-		if (ptgroups && groups) {
-			int compIdx = vtxIter.index();
-		    outputSetsAndGroups( mdagPath, compIdx, true, objectIdx );
-		}
-		// convert from internal units to the current ui units
-		p.x = MDistance::internalToUI(p.x);
-		p.y = MDistance::internalToUI(p.y);
-		p.z = MDistance::internalToUI(p.z);
-		fprintf(fp,"v %f %f %f\n",p.x,p.y,p.z);
-		v++;
+	// Vertex, uv and normal tables
+	//
+	if ( MS::kSuccess != fnMesh.getPoints( mesh->points, space ) ||
+		 MS::kSuccess != fnMesh.getVertices( mesh->polyCounts, mesh->polyVerts ) ) {
+		fprintf(stderr,"Failure reading mesh vertices.\n");
+		delete mesh;
+		return MS::kFailure;
 	}
-
-    // Write out the uv table
-    //
-	MFloatArray uArray, vArray;
-	fnMesh.getUVs( uArray, vArray );
-    int uvLength = uArray.length();
-	for ( int x=0; x<uvLength; x++ ) {
-		fprintf(fp,"vt %f %f\n",uArray[x],vArray[x]);
-		vt++;
+	fnMesh.getUVs( mesh->uArray, mesh->vArray );
+	if ( mesh->uArray.length() > 0 ) {
+		// faces without mapping get a count of 0
+		fnMesh.getAssignedUVs( mesh->uvCounts, mesh->uvIds );
+	}
+	if ( normals ) {
+		MIntArray normalCounts;
+		fnMesh.getNormals( mesh->normals, MSpace::kWorld );
+		fnMesh.getNormalIds( normalCounts, mesh->normalIds );
 	}
 
-    // Write out the normal table
-    //
-    if ( normals ) {
-	    MFloatVectorArray norms;
-	    fnMesh.getNormals( norms, MSpace::kWorld );
-        int normsLength = norms.length();
-	    for ( int t=0; t<normsLength; t++ ) {
-	    	MFloatVector tmpf = norms[t];
-	    	fprintf(fp,"vn %f %f %f\n",tmpf[0],tmpf[1],tmpf[2]);
-	    	vn++;
-	    }
-    }
+	// convert from internal units to the current ui units
+	mesh->uiScale = MDistance::internalToUI( 1.0 );
+
+	mesh->voff = voff;
+	mesh->vtoff = vtoff;
+	mesh->vnoff = vnoff;
+
+	// Point groups
+	//
+	int numVertices = mesh->points.length();
+	if (ptgroups && groups) {
+		for ( int vtx=0; vtx<numVertices; vtx++ ) {
+			ObjNote note;
+			note.index = vtx;
+			note.begin = mesh->notes.length();
+			outputSetsAndGroups( mdagPath, vtx, true, objectIdx, mesh->notes );
+			note.end = mesh->notes.length();
+			if ( note.end > note.begin )
+				mesh->vertexNotes.push_back( note );
+		}
+	}
 
-    // For each polygon, write out: 
+    // For each polygon, note: 
     //    s  smoothing_group
     //    sets/groups the polygon belongs to 
-    //    f  vertex_index/uvIndex/normalIndex
     //
     int lastSmoothingGroup = INITIALIZE_SMOOTHING;
+	int numPolygons = mesh->polyCounts.length();
 
-	for ( ; !polyIter.isDone(); polyIter.next() )
+	for ( int poly=0; poly<numPolygons; poly++ )
 	{
+		ObjNote note;
+		note.index = poly;
+		note.begin = mesh->notes.length();
+
         // Write out the smoothing group that this polygon belongs to
         // We only write out the smoothing group if it is different
         // from the last polygon.
         //
         if ( smoothing ) {
-           	int compIdx = polyIter.index();
-            int smoothingGroup = polySmoothingGroups[ compIdx ];
+            int smoothingGroup = polySmoothingGroups[ poly ];
             
             if ( lastSmoothingGroup != smoothingGroup ) {
                 if ( NO_SMOOTHING_GROUP == smoothingGroup ) {
-                    fprintf(fp,"s off\n");
+                    mesh->notes.put( "s off\n" );
                 }
                 else {
-                    fprintf(fp,"s %d\n", smoothingGroup );
+                    mesh->notes.put( "s " );
+                    mesh->notes.putInt( smoothingGroup );
+                    mesh->notes.put( '\n' );
                 }
                 lastSmoothingGroup = smoothingGroup;
             }
@@ -578,44 +871,204 @@ MStatus ObjTranslator::OutputPolygons(
         // Write out all the sets that this polygon belongs to
         //
 		if (groups || materials) {
-			int compIdx = polyIter.index();
-			outputSetsAndGroups( mdagPath, compIdx, false, objectIdx );
+			outputSetsAndGroups( mdagPath, poly, false, objectIdx, mesh->notes );
+		}
+
+		note.end = mesh->notes.length();
+		if ( note.end > note.begin )
+			mesh->faceNotes.push_back( note );
+	}
+
+	v += numVertices;
+	vt += mesh->uArray.length();
+	vn += mesh->normals.length();
+
+	pendingMeshes.push_back( mesh );
+
+	// Meshes are formatted as they come unless we are batching them
+	// up to format in parallel.
+	//
+	if ( !parallel || (int)pendingMeshes.size() >= MThreadUtils::getNumThreads() ) {
+		stat = flushMeshes();
+	}
+	return stat;
+}
+
+//////////////////////////////////////////////////////////////
+
+void ObjTranslator::formatMesh( ObjMeshData& mesh, ObjWriteBuffer& text )
+//
+// Description :
+//    Formats the v/vt/vn tables and faces of a gathered mesh. Only
+//    reads the mesh data, so it is safe to run on worker threads.
+//
+{
+	int i;
+	size_t nextNote = 0;
+
+    // Write out the vertex table
+    //
+	int numVertices = mesh.points.length();
+	for ( i=0; i<numVertices; i++ ) {
+		if ( nextNote < mesh.vertexNotes.size() &&
+			 mesh.vertexNotes[nextNote].index == i ) {
+			const ObjNote& note = mesh.vertexNotes[nextNote++];
+			text.put( mesh.notes.data() + note.begin, note.end - note.begin );
 		}
-                
-        // Write out vertex/uv/normal index information
+		const MPoint& p = mesh.points[i];
+		text.put( "v " );
+		text.putFloat( p.x * mesh.uiScale );
+		text.put( ' ' );
+		text.putFloat( p.y * mesh.uiScale );
+		text.put( ' ' );
+		text.putFloat( p.z * mesh.uiScale );
+		text.put( '\n' );
+	}
+
+    // Write out the uv table
+    //
+    int uvLength = mesh.uArray.length();
+	for ( i=0; i<uvLength; i++ ) {
+		text.put( "vt " );
+		text.putFloat( mesh.uArray[i] );
+		text.put( ' ' );
+		text.putFloat( mesh.vArray[i] );
+		text.put( '\n' );
+	}
+
+    // Write out the normal table
+    //
+    int normsLength = mesh.normals.length();
+    for ( i=0; i<normsLength; i++ ) {
+    	const MFloatVector& n = mesh.normals[i];
+		text.put( "vn " );
+		text.putFloat( n[0] );
+		text.put( ' ' );
+		text.putFloat( n[1] );
+		text.put( ' ' );
+		text.putFloat( n[2] );
+		text.put( '\n' );
+    }
+
+    // Write out vertex/uv/normal index information
+    //
+	bool haveUVs = ( mesh.uvCounts.length() > 0 );
+	bool haveNormals = ( normsLength > 0 ) &&
+					   ( mesh.normalIds.length() == mesh.polyVerts.length() );
+	int numPolygons = mesh.polyCounts.length();
+	int faceVertex = 0;
+	int uvIndex = 0;
+	nextNote = 0;
+
+	for ( int poly=0; poly<numPolygons; poly++ ) {
+		if ( nextNote < mesh.faceNotes.size() &&
+			 mesh.faceNotes[nextNote].index == poly ) {
+			const ObjNote& note = mesh.faceNotes[nextNote++];
+			text.put( mesh.notes.data() + note.begin, note.end - note.begin );
+		}
+
+        // If there is no mapping information for this polygon
+        // then we don't write any uvs
         //
-		fprintf(fp,"f");
-        int polyVertexCount = polyIter.polygonVertexCount();
-		for ( int vtx=0; vtx<polyVertexCount; vtx++ ) {
-			fprintf(fp," %d", polyIter.vertexIndex( vtx ) +1 +voff);
-
-            bool noUV = true;
-			if ( fnMesh.numUVs() > 0 ) {
-    			int uvIndex;
-                // If the call to getUVIndex fails then there is no
-                // mapping information for this polyon so we don't write
-                // anything
-                //
-    			if ( polyIter.getUVIndex(vtx,uvIndex) ) {
-    			    fprintf(fp,"/%d",uvIndex+1 +vtoff);
-                    noUV = false;
-                }
+		bool noUV = !haveUVs || ( mesh.uvCounts[poly] == 0 );
+
+		text.put( 'f' );
+        int polyVertexCount = mesh.polyCounts[poly];
+		for ( int vtx=0; vtx<polyVertexCount; vtx++, faceVertex++ ) {
+			text.put( ' ' );
+			text.putInt( mesh.polyVerts[faceVertex] +1 +mesh.voff );
+
+			if ( !noUV ) {
+				text.put( '/' );
+				text.putInt( mesh.uvIds[uvIndex++] +1 +mesh.vtoff );
 			}
             
-			if ( (normals) && (fnMesh.numNormals() > 0) ) {
+			if ( haveNormals ) {
                 if ( noUV ) {
                     // If there are no UVs then our polygon is written
                     // in the form vertex//normal
                     //
-                    fprintf(fp,"/");
+                    text.put( '/' );
                 }
-                fprintf(fp,"/%d",polyIter.normalIndex( vtx ) +1 +vnoff);
+				text.put( '/' );
+				text.putInt( mesh.normalIds[faceVertex] +1 +mesh.vnoff );
             }
 		}
-		fprintf(fp,"\n");
-		fflush(fp);
+		text.put( '\n' );
 	}
-	return stat;
+}
+
+//////////////////////////////////////////////////////////////
+
+struct ObjFormatTask {
+    ObjMeshData *       mesh;
+    ObjWriteBuffer *    text;
+};
+
+MThreadRetVal ObjTranslator::formatMeshTask( void *data )
+{
+	ObjFormatTask *task = (ObjFormatTask *)data;
+	formatMesh( *task->mesh, *task->text );
+	return (MThreadRetVal)0;
+}
+
+void ObjTranslator::formatMeshesInParallel( void *data, MThreadRootTask *root )
+{
+	std::vector<ObjFormatTask> *tasks = (std::vector<ObjFormatTask> *)data;
+	for ( size_t i=0; i<tasks->size(); i++ ) {
+		MThreadPool::createTask( formatMeshTask, (void *)&(*tasks)[i], root );
+	}
+	MThreadPool::executeAndJoin( root );
+}
+
+MStatus ObjTranslator::flushMeshes()
+//
+// Description :
+//    Formats and writes all queued meshes, in the order they were
+//    gathered.
+//
+{
+	MStatus status = MS::kSuccess;
+	size_t numMeshes = pendingMeshes.size();
+	if ( 0 == numMeshes )
+		return status;
+
+	bool threaded = false;
+	if ( parallel && numMeshes > 1 && MS::kSuccess == MThreadPool::init() ) {
+		threaded = true;
+	}
+
+	if ( threaded ) {
+		std::vector<ObjFormatTask> tasks( numMeshes );
+		for ( size_t i=0; i<numMeshes; i++ ) {
+			tasks[i].mesh = pendingMeshes[i];
+			tasks[i].text = new ObjWriteBuffer;
+		}
+
+		MThreadPool::newParallelRegion( formatMeshesInParallel, (void *)&tasks );
+		MThreadPool::release();
+
+		// splice the results in order
+		for ( size_t i=0; i<numMeshes; i++ ) {
+			if ( MS::kSuccess == status && !out->flush( *tasks[i].text ) )
+				status = MS::kFailure;
+			delete tasks[i].text;
+		}
+	}
+	else {
+		for ( size_t i=0; i<numMeshes; i++ ) {
+			formatMesh( *pendingMeshes[i], *out );
+		}
+		if ( out->failed() )
+			status = MS::kFailure;
+	}
+
+	for ( size_t i=0; i<numMeshes; i++ ) {
+		delete pendingMeshes[i];
+	}
+	pendingMeshes.clear();
+
+	return status;
 }
 //////////////////////////////////////////////////////////////
 
@@ -623,8 +1076,8 @@ void ObjTranslator::outputSetsAndGroups(
     MDagPath & mdagPath, 
 	int cid,
 	bool isVertexIterator,
-	int objectIdx
-	
+	int objectIdx,
+	ObjWriteBuffer & text
 )
 {
     MStatus stat;
@@ -702,11 +1155,12 @@ void ObjTranslator::outputSetsAndGroups(
 			if (groups) {
 				int gLength = gArray.length();
 			    if ( gLength > 0  ) {
-			        fprintf(fp,"g");
+			        text.put( 'g' );
 			        for ( i=0; i<gLength; i++ ) {
-			            fprintf(fp," %s",gArray[i].asChar());
+			            text.put( ' ' );
+			            text.put( gArray[i].asChar() );
 			        }
-			        fprintf(fp,"\n");
+			        text.put( '\n' );
 			    }
 			}
 		}
@@ -747,11 +1201,12 @@ void ObjTranslator::outputSetsAndGroups(
 				int mLength = mArray.length();
 
 				if ( mLength > 0  ) {
-			    	fprintf(fp,"usemtl");
+			    	text.put( "usemtl" );
 			    	for ( i=0; i<mLength; i++ ) {
-			        	fprintf(fp," %s",mArray[i].asChar());
+			        	text.put( ' ' );
+			        	text.put( mArray[i].asChar() );
 			    	}
-			    	fprintf(fp,"\n");
+			    	text.put( '\n' );
 				}
 			}
 		}
@@ -1268,6 +1723,12 @@ void ObjTranslator::freeLookupTables()
 		delete objectNames;
 		objectNames = NULL;
 	}		
+
+	// anything still queued is discarded
+	for ( size_t m=0; m<pendingMeshes.size(); m++ ) {
+		delete pendingMeshes[m];
+	}
+	pendingMeshes.clear();
 }
 
 //////////////////////////////////////////////////////////////
@@ -1297,11 +1758,21 @@ void ObjTranslator::buildEdgeTable( MDagPath& mesh )
     if ( !smoothing )
         return;
     
-    // Create our edge lookup table and initialize all entries to NULL
+    // Create the edge pool and an empty hash with at least twice as
+    // many slots as there are edges
     //
     MFnMesh fnMesh( mesh );
-    edgeTableSize = fnMesh.numVertices();
-    edgeTable = (EdgeInfoPtr*) calloc( edgeTableSize, sizeof(int) );
+    int numEdges = fnMesh.numEdges();
+    edgePoolCapacity = numEdges > 0 ? numEdges : 1;
+    edgePoolSize = 0;
+    edgePool = (EdgeInfoPtr) malloc( sizeof(struct EdgeInfo) * edgePoolCapacity );
+
+    unsigned int numSlots = 16;
+    while ( numSlots < 2 * (unsigned int)edgePoolCapacity )
+        numSlots *= 2;
+    edgeHashMask = numSlots - 1;
+    edgeKeys = (unsigned long long *) calloc( numSlots, sizeof(unsigned long long) );
+    edgeSlots = (int *) malloc( sizeof(int) * numSlots );
 
     // Add entries, for each edge, to the lookup table
     //
@@ -1314,157 +1785,170 @@ void ObjTranslator::buildEdgeTable( MDagPath& mesh )
 
     // Fill in referenced polygons
     //
-    MItMeshPolygon pIt( mesh );
-    for ( ; !pIt.isDone(); pIt.next() )
+    MIntArray polyCounts, polyVerts;
+    fnMesh.getVertices( polyCounts, polyVerts );
+    int numPolygons = polyCounts.length();
+    int faceVertex = 0;
+    for ( int pid=0; pid<numPolygons; pid++ )
     {
-        int pvc = pIt.polygonVertexCount();
+        int pvc = polyCounts[pid];
         for ( int v=0; v<pvc; v++ )
         {
-            int a = pIt.vertexIndex( v );
-            int b = pIt.vertexIndex( v==(pvc-1) ? 0 : v+1 );
+            int a = polyVerts[ faceVertex + v ];
+            int b = polyVerts[ faceVertex + ( v==(pvc-1) ? 0 : v+1 ) ];
 
             EdgeInfoPtr elem = findEdgeInfo( a, b );
             if ( NULL != elem ) {
-                int edgeId = pIt.index();
-                
                 if ( INVALID_ID == elem->polyIds[0] ) {
-                    elem->polyIds[0] = edgeId;
+                    elem->polyIds[0] = pid;
                 }
                 else {
-                    elem->polyIds[1] = edgeId;
+                    elem->polyIds[1] = pid;
                 }                
-                    
             }
         }
+        faceVertex += pvc;
     }
 
     // Now create a polyId->smoothingGroup table
     //   
-    int numPolygons = fnMesh.numPolygons();
+    assignSmoothingGroups( numPolygons );
+}
+
+//////////////////////////////////////////////////////////////
+
+static int findSmoothingRoot( int * parent, int id )
+//
+// Union-find lookup with path halving.
+//
+{
+    while ( parent[id] != id ) {
+        parent[id] = parent[ parent[id] ];
+        id = parent[id];
+    }
+    return id;
+}
+
+#define POLY_HAS_INTERIOR_EDGE  1
+#define POLY_HAS_SMOOTH_EDGE    2
+
+void ObjTranslator::assignSmoothingGroups( int numPolygons )
+//
+// Fills in polySmoothingGroups. Polygons that share a smooth edge
+// end up in the same smoothing group; polygons with no smooth shared
+// edges get NO_SMOOTHING_GROUP ("s off").
+//
+// Groups are numbered in order of the lowest polygon id in each group.
+// A polygon that is the first of its group but whose shared edges are
+// all hard still uses up a number, so the numbering is the same as the
+// old recursive polygon walk produced.
+//
+{
     polySmoothingGroups = (int*)malloc( sizeof(int) *  numPolygons );
+    int * parent = (int*)malloc( sizeof(int) * numPolygons );
+    unsigned char * flags = (unsigned char*)calloc( numPolygons, 1 );
+
     for ( int i=0; i< numPolygons; i++ ) {
         polySmoothingGroups[i] = NO_SMOOTHING_GROUP;
+        parent[i] = i;
     }    
-    
-    // Now call the smoothingAlgorithm to fill in the polySmoothingGroups
-    // table.
-    // Note: we have to traverse ALL polygons to handle the case
-    // of disjoint polygons.
+
+    // Join polygons across smooth edges.
+    // NOTE: We assume there are at most 2 polygons per edge
+    //       halfEdge polygons get a smoothing group of
+    //       NO_SMOOTHING_GROUP which is equivalent to "s off"
+    //
+    for ( int e=0; e<edgePoolSize; e++ ) {
+        EdgeInfo & edge = edgePool[e];
+        if ( INVALID_ID == edge.polyIds[1] ) // Edge is a border
+            continue;
+
+        int p0 = edge.polyIds[0];
+        int p1 = edge.polyIds[1];
+        unsigned char mark = POLY_HAS_INTERIOR_EDGE;
+        if ( edge.smooth ) {
+            mark |= POLY_HAS_SMOOTH_EDGE;
+            int r0 = findSmoothingRoot( parent, p0 );
+            int r1 = findSmoothingRoot( parent, p1 );
+            if ( r0 != r1 ) {
+                // keep the lower id as the root
+                if ( r0 < r1 ) parent[r1] = r0;
+                else           parent[r0] = r1;
+            }
+        }
+        flags[p0] |= mark;
+        flags[p1] |= mark;
+    }
+
+    // Number the groups. The root of each set is its lowest polygon
+    // id, so the first member seen creates the group.
     //
-    nextSmoothingGroup = 1;
-    currSmoothingGroup = 1;
+    int nextSmoothingGroup = 1;
     for ( int pid=0; pid<numPolygons; pid++ ) {
-        newSmoothingGroup = true;
-        // Check polygon has not already been visited
-        if ( NO_SMOOTHING_GROUP == polySmoothingGroups[pid] ) {
-           if ( !smoothingAlgorithm(pid,fnMesh) ) {
-               // No smooth edges for this polygon so we set
-               // the smoothing group to NO_SMOOTHING_GROUP (off)
-               polySmoothingGroups[pid] = NO_SMOOTHING_GROUP;
-           }
+        if ( !(flags[pid] & POLY_HAS_INTERIOR_EDGE) )
+            continue;
+
+        int root = findSmoothingRoot( parent, pid );
+        if ( root != pid ) {
+            polySmoothingGroups[pid] = polySmoothingGroups[root];
+        }
+        else {
+            int group = nextSmoothingGroup++;
+            if ( flags[pid] & POLY_HAS_SMOOTH_EDGE ) {
+                polySmoothingGroups[pid] = group;
+            }
         }
     }
+
+    free( flags );
+    free( parent );
 }
 
 //////////////////////////////////////////////////////////////
 
-bool ObjTranslator::smoothingAlgorithm( int polyId, MFnMesh& fnMesh )
+static inline unsigned long long edgeKey( int v1, int v2 )
 {
-    MIntArray vertexList;
-    fnMesh.getPolygonVertices( polyId, vertexList );
-    int vcount = vertexList.length();
-    bool smoothEdgeFound = false;
-    
-    for ( int vid=0; vid<vcount;vid++ ) {
-        int a = vertexList[vid];
-        int b = vertexList[ vid==(vcount-1) ? 0 : vid+1 ];
-        
-        EdgeInfoPtr elem = findEdgeInfo( a, b );
-        if ( NULL != elem ) {
-            // NOTE: We assume there are at most 2 polygons per edge
-            //       halfEdge polygons get a smoothing group of
-            //       NO_SMOOTHING_GROUP which is equivalent to "s off"
-            //
-            if ( NO_SMOOTHING_GROUP != elem->polyIds[1] ) { // Edge not a border
-                
-                // We are starting a new smoothing group
-                //                
-                if ( newSmoothingGroup ) {
-                    currSmoothingGroup = nextSmoothingGroup++;
-                    newSmoothingGroup = false;
-                    
-                    // This is a SEED (starting) polygon and so we always
-                    // give it the new smoothing group id.
-                    // Even if all edges are hard this must be done so
-                    // that we know we have visited the polygon.
-                    //
-                    polySmoothingGroups[polyId] = currSmoothingGroup;
-                }
-                
-                // If we have a smooth edge then this poly must be a member
-                // of the current smoothing group.
-                //
-                if ( elem->smooth ) {
-                    polySmoothingGroups[polyId] = currSmoothingGroup;
-                    smoothEdgeFound = true;
-                }
-                else { // Hard edge so ignore this polygon
-                    continue;
-                }
-                
-                // Find the adjacent poly id
-                //
-                int adjPoly = elem->polyIds[0];
-                if ( adjPoly == polyId ) {
-                    adjPoly = elem->polyIds[1];
-                }                             
-                
-                // If we are this far then adjacent poly belongs in this
-                // smoothing group.
-                // If the adjacent polygon's smoothing group is not
-                // NO_SMOOTHING_GROUP then it has already been visited
-                // so we ignore it.
-                //
-                if ( NO_SMOOTHING_GROUP == polySmoothingGroups[adjPoly] ) {
-                    smoothingAlgorithm( adjPoly, fnMesh );
-                }
-                else if ( polySmoothingGroups[adjPoly] != currSmoothingGroup ) {
-                    cerr << "Warning: smoothing group problem at polyon ";
-                    cerr << adjPoly << endl;
-                }
-            }
-        }
+    // Order the pair so both directions hash the same. The +1 keeps
+    // every key non-zero, since 0 marks an empty slot.
+    //
+    if ( v1 > v2 ) {
+        int tmp = v1; v1 = v2; v2 = tmp;
     }
-    return smoothEdgeFound;
+    return ( (unsigned long long)(unsigned int)( v1 + 1 ) << 32 ) |
+             (unsigned long long)(unsigned int)v2;
 }
 
-//////////////////////////////////////////////////////////////
+static inline unsigned int edgeHash( unsigned long long key )
+{
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (unsigned int)( key >> 32 );
+}
 
 void ObjTranslator::addEdgeInfo( int v1, int v2, bool smooth )
 //
-// Adds a new edge info element to the vertex table.
+// Adds a new edge info element to the edge table.
 //
 {
-    EdgeInfoPtr element = NULL;
-
-    if ( NULL == edgeTable[v1] ) {
-        edgeTable[v1] = (EdgeInfoPtr)malloc( sizeof(struct EdgeInfo) );
-        element = edgeTable[v1];
+    unsigned long long key = edgeKey( v1, v2 );
+    unsigned int slot = edgeHash( key ) & edgeHashMask;
+    while ( 0 != edgeKeys[slot] ) {
+        if ( key == edgeKeys[slot] )
+            return;             // already known
+        slot = ( slot + 1 ) & edgeHashMask;
     }
-    else {
-        element = edgeTable[v1];
-        while ( NULL != element->next ) {
-            element = element->next;
-        }
-        element->next = (EdgeInfoPtr)malloc( sizeof(struct EdgeInfo) );
-        element = element->next;
+
+    if ( edgePoolSize == edgePoolCapacity ) {
+        cerr << "Warning: more edges than MFnMesh::numEdges() reported\n";
+        return;
     }
 
+    EdgeInfoPtr element = &edgePool[ edgePoolSize ];
+    edgeKeys[slot] = key;
+    edgeSlots[slot] = edgePoolSize++;
+
     // Setup data for new edge
     //
-    element->vertId     = v2;
     element->smooth     = smooth;
-    element->next       = NULL;
    
     // Initialize array of id's of polygons that reference this edge.
     // There are at most 2 polygons per edge.
@@ -1480,27 +1964,13 @@ EdgeInfoPtr ObjTranslator::findEdgeInfo( int v1, int v2 )
 // Finds the info for the specified edge.
 //
 {
-    EdgeInfoPtr element = NULL;
-    element = edgeTable[v1];
-
-    while ( NULL != element ) {
-        if ( v2 == element->vertId ) {
-            return element;
-        }
-        element = element->next;
-    }
-    
-    if ( element == NULL ) {
-        element = edgeTable[v2];
-
-        while ( NULL != element ) {
-            if ( v1 == element->vertId ) {
-                return element;
-            }
-            element = element->next;
-        }
+    unsigned long long key = edgeKey( v1, v2 );
+    unsigned int slot = edgeHash( key ) & edgeHashMask;
+    while ( 0 != edgeKeys[slot] ) {
+        if ( key == edgeKeys[slot] )
+            return &edgePool[ edgeSlots[slot] ];
+        slot = ( slot + 1 ) & edgeHashMask;
     }
-
     return NULL;
 }
 
@@ -1508,30 +1978,25 @@ EdgeInfoPtr ObjTranslator::findEdgeInfo( int v1, int v2 )
 
 void ObjTranslator::destroyEdgeTable()
 //
-// Free up all of the memory used by the edgeTable.
+// Free up all of the memory used by the edge table.
 //
 {
     if ( !smoothing )
         return;
     
-    EdgeInfoPtr element = NULL;
-    EdgeInfoPtr tmp = NULL;
-
-    for ( int v=0; v<edgeTableSize; v++ )
-    {
-        element = edgeTable[v];
-        while ( NULL != element )
-        {
-            tmp = element;
-            element = element->next;
-            free( tmp );
-        }
+    if ( NULL != edgePool ) {
+        free( edgePool );
+        edgePool = NULL;
     }
-
-    if ( NULL != edgeTable ) {
-        free( edgeTable );
-        edgeTable = NULL;
+    if ( NULL != edgeKeys ) {
+        free( edgeKeys );
+        edgeKeys = NULL;
+    }
+    if ( NULL != edgeSlots ) {
+        free( edgeSlots );
+        edgeSlots = NULL;
     }
+    edgePoolSize = edgePoolCapacity = 0;
     
     if ( NULL != polySmoothingGroups ) {
         free( polySmoothingGroups );
@@ -1638,6 +2103,7 @@ MStatus ObjTranslator::exportSelected( )
 		}
 	}
 	
+	flushMeshes();
 	freeLookupTables();
 	
 	return status;
@@ -1719,6 +2185,7 @@ MStatus ObjTranslator::exportAll( )
 		vnoff = vn;
 	}
 
+	flushMeshes();
 	freeLookupTables();
 
 	return status;
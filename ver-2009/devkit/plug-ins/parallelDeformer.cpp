@@ -0,0 +1,239 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+//
+//  File: parallelDeformer.cpp
+//
+//  Description:
+//		Chunked MThreadPool scheduling shared by the threaded deformer
+//		examples. See parallelDeformer.h.
+//
+
+#include <stdlib.h>
+
+#include <maya/MIOStream.h>
+#include <maya/MDataBlock.h>
+#include <maya/MDataHandle.h>
+#include <maya/MItGeometry.h>
+#include <maya/MMatrix.h>
+#include <maya/MAtomic.h>
+#include <maya/MThreadUtils.h>
+
+#include "parallelDeformer.h"
+
+const unsigned int parallelDeformer::kMinChunkSize = 1024;
+const unsigned int parallelDeformer::kChunksPerThread = 8;
+
+// Chunk states
+//
+enum {
+	kChunkPending = 0,
+	kChunkDone,
+	kChunkFailed
+};
+
+struct parallelDeformerChunk
+{
+	unsigned int	begin;
+	unsigned int	end;
+	int				state;
+};
+
+// Shared state for one deform call. nextChunk and failed are only
+// written through MAtomic.
+//
+struct parallelDeformerRegion
+{
+	parallelDeformer*		node;
+	MPointArray*			points;
+	const float*			weights;
+	parallelDeformerChunk*	chunks;
+	int						numChunks;
+	int						numTasks;
+	volatile int			nextChunk;
+	volatile int			failed;
+};
+
+parallelDeformer::parallelDeformer()
+:	fWeights( NULL ), fWeightsCapacity( 0 )
+{
+}
+
+parallelDeformer::~parallelDeformer()
+{
+	free( fWeights );
+}
+
+MStatus parallelDeformer::beginDeform( MDataBlock&, const MMatrix&, unsigned int )
+{
+	return MS::kSuccess;
+}
+
+void parallelDeformer::endDeform()
+{
+}
+
+MThreadRetVal parallelDeformer::runChunks( void* data )
+{
+	parallelDeformerRegion* region = (parallelDeformerRegion*) data;
+
+	for( ;; ) {
+		// Stop claiming work once any chunk has failed. Chunks that
+		// were never started stay pending and are reported as skipped.
+		if( region->failed ) break;
+
+		int c = MAtomic::postIncrement( &region->nextChunk );
+		if( c >= region->numChunks ) break;
+
+		parallelDeformerChunk& chunk = region->chunks[c];
+		if( region->node->deformPoints( *region->points, region->weights,
+										chunk.begin, chunk.end ) ) {
+			chunk.state = kChunkDone;
+		} else {
+			chunk.state = kChunkFailed;
+			MAtomic::set( &region->failed, 1 );
+		}
+	}
+	return (MThreadRetVal)0;
+}
+
+void parallelDeformer::decomposeChunks( void* data, MThreadRootTask* root )
+{
+	parallelDeformerRegion* region = (parallelDeformerRegion*) data;
+
+	for( int i = 0; i < region->numTasks; ++i ) {
+		MThreadPool::createTask( runChunks, data, root );
+	}
+	MThreadPool::executeAndJoin( root );
+}
+
+MStatus parallelDeformer::deform( MDataBlock& block,
+								  MItGeometry& iter,
+								  const MMatrix& mat,
+								  unsigned int multiIndex )
+{
+	MStatus status;
+
+	MDataHandle envData = block.inputValue( envelope, &status );
+	if( MS::kSuccess != status ) return status;
+	float env = envData.asFloat();
+	if( env == 0.0f ) return MS::kSuccess;
+
+	status = beginDeform( block, mat, multiIndex );
+	if( MS::kSuccess != status ) return status;
+
+	// get all points at once. Faster to query, and also better for
+	// threading than using the iterator
+	MPointArray points;
+	iter.allPositions( points );
+	unsigned int nPoints = points.length();
+	if( nPoints == 0 ) {
+		endDeform();
+		return MS::kSuccess;
+	}
+
+	// weightValue() reads the data block, so evaluate it up front on
+	// this thread rather than from the tasks.
+	if( nPoints > fWeightsCapacity ) {
+		float* weights = (float*) realloc( fWeights, nPoints * sizeof(float) );
+		if( NULL == weights ) {
+			endDeform();
+			return MS::kInsufficientMemory;
+		}
+		fWeights = weights;
+		fWeightsCapacity = nPoints;
+	}
+	unsigned int n = 0;
+	for( iter.reset(); !iter.isDone() && n < nPoints; iter.next(), n++ ) {
+		fWeights[n] = env * weightValue( block, multiIndex, iter.index() );
+	}
+	for( ; n < nPoints; n++ ) {
+		fWeights[n] = env;
+	}
+
+	// Size the chunks. The granularity is one cache line of weights,
+	// which is also a whole number of cache lines of points.
+	int numThreads = MThreadUtils::getNumThreads();
+	if( numThreads < 1 ) numThreads = 1;
+
+	unsigned int granularity = MThreadUtils::getCacheLineSize() / sizeof(float);
+	if( granularity < 1 ) granularity = 1;
+
+	unsigned int chunkSize = nPoints / (numThreads * kChunksPerThread);
+	if( chunkSize < kMinChunkSize ) chunkSize = kMinChunkSize;
+	chunkSize = ((chunkSize + granularity - 1) / granularity) * granularity;
+
+	int numChunks = (int)((nPoints + chunkSize - 1) / chunkSize);
+	parallelDeformerChunk* chunks = new parallelDeformerChunk[numChunks];
+	for( int c = 0; c < numChunks; c++ ) {
+		chunks[c].begin = c * chunkSize;
+		chunks[c].end = chunks[c].begin + chunkSize;
+		if( chunks[c].end > nPoints ) chunks[c].end = nPoints;
+		chunks[c].state = kChunkPending;
+	}
+
+	parallelDeformerRegion region;
+	region.node = this;
+	region.points = &points;
+	region.weights = fWeights;
+	region.chunks = chunks;
+	region.numChunks = numChunks;
+	region.numTasks = (numChunks < numThreads) ? numChunks : numThreads;
+	region.nextChunk = 0;
+	region.failed = 0;
+
+	if( region.numTasks == 1 ) {
+		// not worth waking the pool for a single chunk
+		runChunks( &region );
+	} else {
+		status = MThreadPool::init();
+		if( MS::kSuccess != status ) {
+			// fall back to running every chunk on this thread
+			runChunks( &region );
+		} else {
+			MThreadPool::newParallelRegion( decomposeChunks, &region );
+
+			// release the reference taken by init()
+			MThreadPool::release();
+		}
+	}
+
+	// collect per-chunk errors
+	int nFailed = 0, nSkipped = 0;
+	int firstFailed = -1;
+	for( int c = 0; c < numChunks; c++ ) {
+		if( chunks[c].state == kChunkFailed ) {
+			if( firstFailed < 0 ) firstFailed = c;
+			nFailed++;
+		} else if( chunks[c].state == kChunkPending ) {
+			nSkipped++;
+		}
+	}
+
+	endDeform();
+
+	if( nFailed > 0 ) {
+		// leave the geometry as it was rather than write back a mix
+		// of deformed and undeformed points
+		cerr << name().asChar() << ": " << nFailed << " of " << numChunks
+			 << " chunks failed (first at points " << chunks[firstFailed].begin
+			 << "-" << chunks[firstFailed].end - 1 << "), "
+			 << nSkipped << " skipped\n";
+		delete [] chunks;
+		return MS::kFailure;
+	}
+
+	// write values back onto output using fast set method on iterator
+	iter.setAllPositions( points );
+
+	delete [] chunks;
+	return MS::kSuccess;
+}
@@ -0,0 +1,103 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _parallelDeformer_h
+#define _parallelDeformer_h
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// parallelDeformer
+//
+// Base class for deformers whose per-point work is independent. It
+// implements MPxDeformerNode::deform() so the base class compute still
+// handles the input/output geometry copy and the groupId membership.
+// For each deform call it:
+//
+//   - fetches all member positions with MItGeometry::allPositions,
+//   - evaluates envelope * weightValue() for each member point,
+//   - splits the points into chunks whose size is a multiple of the
+//     cache line size, so no two chunks write to the same cache line
+//     of the weight array and at most one line of the point array,
+//   - runs the chunks on MThreadPool. One task is created per thread
+//     and each task pulls the next unclaimed chunk from a shared
+//     atomic counter, so threads that finish early take over work
+//     that slower threads have not yet started,
+//   - records failures per chunk and reports them once all tasks
+//     have joined. Only if every chunk succeeded are the positions
+//     written back with MItGeometry::setAllPositions; otherwise the
+//     geometry is left untouched and kFailure is returned.
+//
+// Derived classes implement deformPoints(), which is called from
+// worker threads, and may override beginDeform() / endDeform() to read
+// their attributes and build shared data on the main thread.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <maya/MPxDeformerNode.h>
+#include <maya/MPointArray.h>
+#include <maya/MThreadPool.h>
+
+class MDataBlock;
+class MItGeometry;
+class MMatrix;
+
+class parallelDeformer : public MPxDeformerNode
+{
+public:
+						parallelDeformer();
+	virtual				~parallelDeformer();
+
+	virtual MStatus		deform( MDataBlock& block,
+								MItGeometry& iter,
+								const MMatrix& mat,
+								unsigned int multiIndex );
+
+protected:
+	// Called on the main thread before any chunk is scheduled. Returning
+	// anything other than kSuccess skips the deformation.
+	//
+	virtual MStatus		beginDeform( MDataBlock& block,
+									 const MMatrix& mat,
+									 unsigned int multiIndex );
+
+	// Called from worker threads for the points [begin, end). weights
+	// holds envelope * weightValue() for every point in the array.
+	// Implementations may only write to points in their own range and
+	// must only read shared node state. Return false on failure.
+	//
+	virtual bool		deformPoints( MPointArray& points,
+									  const float* weights,
+									  unsigned int begin,
+									  unsigned int end ) = 0;
+
+	// Called on the main thread once all chunks have finished, whether
+	// they succeeded or not.
+	//
+	virtual void		endDeform();
+
+	// Smallest number of points worth handing to a thread.
+	//
+	static const unsigned int kMinChunkSize;
+
+	// Chunks per thread; more chunks balance better, fewer cost less.
+	//
+	static const unsigned int kChunksPerThread;
+
+private:
+	static void			decomposeChunks( void* data, MThreadRootTask* root );
+	static MThreadRetVal	runChunks( void* data );
+
+	// envelope * weightValue() per point, kept between deforms
+	float*				fWeights;
+	unsigned int		fWeightsCapacity;
+};
+
+#endif
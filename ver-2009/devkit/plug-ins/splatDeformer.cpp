@@ -14,7 +14,13 @@
 //
 //  Description:
 // 		Example implementation of a threaded deformer. This node
-//		deforms one mesh using another.
+//		deforms one mesh using another. The threading, weights and
+//		groupId handling come from the parallelDeformer base class.
+//
+//		The closest point structure over the deforming mesh is kept
+//		between evaluations. It is refit when only the deforming
+//		mesh's points or transform change and rebuilt when its
+//		triangulation changes.
 //
 
 #include <maya/MIOStream.h>
@@ -25,14 +31,14 @@
 #include <maya/MDataBlock.h>
 #include <maya/MDataHandle.h>
 #include <maya/MPoint.h>
-#include <maya/MTimer.h>
 #include <maya/MFnMesh.h>
 #include <maya/MPointArray.h>
 #include <maya/MFnTypedAttribute.h>
 #include <maya/MFnMeshData.h>
-#include <maya/MMeshIntersector.h>
+#include <maya/MIntArray.h>
 
-#include <maya/MThreadUtils.h>
+#include "parallelDeformer.h"
+#include "triangleBVH.h"
 
 // Macros
 //
@@ -42,7 +48,7 @@
 		return status;					\
 	}
 
-class splatDeformer : public MPxDeformerNode
+class splatDeformer : public parallelDeformer
 {
 public:
 						splatDeformer();
@@ -51,9 +57,15 @@ public:
 	static  void*		creator();
 	static  MStatus		initialize();
 
-	// deformation function
+protected:
+	// update the closest point structure on the main thread
+	//
+	virtual MStatus		beginDeform(MDataBlock& block, const MMatrix& mat, unsigned int multiIndex);
+
+	// deformation function, called from worker threads
 	//
-	virtual MStatus compute(const MPlug& plug, MDataBlock& dataBlock);
+	virtual bool		deformPoints(MPointArray& points, const float* weights,
+									 unsigned int begin, unsigned int end);
 
 public:
 	// local node attributes
@@ -63,6 +75,8 @@ public:
 	static MObject deformingMesh;
 
 private:
+	// fast closest point structure, shared by all worker threads
+	triangleBVH			fBVH;
 };
 
 MTypeId     splatDeformer::id( 0x8104D );
@@ -94,36 +108,9 @@ MStatus splatDeformer::initialize()
 	return MStatus::kSuccess;
 }
 
-MStatus splatDeformer::compute(const MPlug& plug, MDataBlock& data)
+MStatus splatDeformer::beginDeform(MDataBlock& data, const MMatrix& /*mat*/, unsigned int /*multiIndex*/)
 {
-	// do this if we are using an OpenMP implementation that is not the same as Maya's.
-	// Even if it is the same, it does no harm to make this call.
-	MThreadUtils::syncNumOpenMPThreads();
-
-	MStatus status = MStatus::kUnknownParameter;
- 	if (plug.attribute() != outputGeom) {
-		return status;
-	}
-
-	unsigned int index = plug.logicalIndex();
-	MObject thisNode = this->thisMObject();
-
-	// get input value
-	MPlug inPlug(thisNode,input);
-	inPlug.selectAncestorLogicalIndex(index,input);
-	MDataHandle hInput = data.inputValue(inPlug, &status);
-	MCheckStatus(status, "ERROR getting input mesh\n");
-	
-	// get the input geometry
-	MDataHandle inputData = hInput.child(inputGeom);
-	if (inputData.type() != MFnData::kMesh) {
- 		printf("Incorrect input geometry type\n");
-		return MStatus::kFailure;
- 	}
-
-	// get the input groupId - ignored for now...
-	MDataHandle hGroup = inputData.child(groupId);
-	unsigned int groupId = hGroup.asLong();
+	MStatus status;
 
 	// get deforming mesh
 	MDataHandle deformData = data.inputValue(deformingMesh, &status);
@@ -134,75 +121,51 @@ MStatus splatDeformer::compute(const MPlug& plug, MDataBlock& data)
 	}
 
   	MObject dSurf = deformData.asMeshTransformed();
- 	MFnMesh fnDeformingMesh;
- 	fnDeformingMesh.setObject( dSurf ) ;
-
-	MDataHandle outputData = data.outputValue(plug);
-	outputData.copy(inputData);
- 	if (outputData.type() != MFnData::kMesh) {
-		printf("Incorrect output mesh type\n");
+ 	MFnMesh fnDeformingMesh( dSurf, &status );
+	MCheckStatus(status, "ERROR reading deforming mesh\n");
+
+	MPointArray dPoints;
+	MIntArray triangleCounts, triangleVertices;
+	fnDeformingMesh.getPoints(dPoints);
+	fnDeformingMesh.getTriangles(triangleCounts, triangleVertices);
+	if (triangleVertices.length() == 0) {
+		printf("Deforming mesh has no faces\n");
 		return MStatus::kFailure;
 	}
-	
-	MItGeometry iter(outputData, groupId, false);
-
-	// create fast intersector structure
-	MMeshIntersector intersector;
-	intersector.create(dSurf);
-
-	// get all points at once. Faster to query, and also better for
-	// threading than using iterator
-	MPointArray verts;
-	iter.allPositions(verts);
-	int nPoints = verts.length();
-
-	// use bool variable as lightweight object for failure check in loop below
-	bool failed = false;
-
- 	MTimer timer; timer.beginTimer();
-
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
- 	for(int i=0; i<nPoints; i++) {
-
-		// Cannot break out of an OpenMP loop, so if one of the
-		// intersections failed, skip the rest
-		if(failed) continue;
-
-		// mesh point object must be in loop-local scope to avoid race conditions
-		MPointOnMesh meshPoint;
-
-		// Do intersection. Need to use per-thread status value as
-		// MStatus has internal state and may trigger race conditions
-		// if set from multiple threads. Probably benign in this case,
-		// but worth being careful.
-		MStatus localStatus = intersector.getClosestPoint(verts[i], meshPoint);
-		if(localStatus != MStatus::kSuccess) {
-			// NOTE - we cannot break out of an OpenMP region, so set
-			// bad status and skip remaining iterations
-			failed = true;
-			continue;
-		}
 
-		// default OpenMP scheduling breaks traversal into large
-		// chunks, so low risk of false sharing here in array write.
-		verts[i] = meshPoint.getPoint();
- 	}
-
- 	timer.endTimer(); printf("Runtime for threaded loop %f\n", timer.elapsedTime());
-
-	// write values back onto output using fast set method on iterator
-	iter.setAllPositions(verts);
-
-	if(failed) {
-		printf("Closest point failed\n");
-		return MStatus::kFailure;
+	// Moving points only need the bounds updated; anything that
+	// changes the triangulation needs a new hierarchy.
+	if (!fBVH.sameTopology(dPoints.length(), triangleVertices) ||
+		!fBVH.refit(dPoints)) {
+		fBVH.build(dPoints, triangleVertices);
 	}
 
 	return status;
 }
 
+bool splatDeformer::deformPoints(MPointArray& verts, const float* weights,
+								 unsigned int begin, unsigned int end)
+{
+	// Neighbouring vertices usually land on the same or a nearby
+	// triangle, so each query starts from the previous answer.
+	int hint = -1;
+
+ 	for(unsigned int i=begin; i<end; i++) {
+		float w = weights[i];
+		if(w == 0.0f) continue;
+
+		MPoint closest;
+		int triangle;
+		if(!fBVH.closestPoint(verts[i], closest, triangle, hint)) {
+			return false;
+		}
+		hint = triangle;
+
+		verts[i] += (closest - verts[i]) * w;
+ 	}
+	return true;
+}
+
 // standard initialization procedures
 //
 MStatus initializePlugin( MObject obj )
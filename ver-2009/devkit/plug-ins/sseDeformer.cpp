@@ -18,6 +18,14 @@
 //		The weights are set using the set editor or the
 //		percent command.
 //
+//		When enableSSE is on, the points are copied once per
+//		compute into an aligned structure-of-arrays buffer and
+//		deformed by an explicit SSE2, SSE4.1 or AVX2 kernel which
+//		is chosen at runtime from what the CPU supports (the
+//		kernelISA attribute can force a lower level for timing).
+//		When enableSSE is off, the original scalar loop is used
+//		so the two paths can be compared.
+//
 
 #include <string.h>
 #include <float.h> // for FLT_MAX
@@ -53,6 +61,27 @@
 #include <maya/MFnTypedAttribute.h>
 #include <maya/MFnMeshData.h>
 #include <maya/MFloatVectorArray.h>
+#include <maya/MFnEnumAttribute.h>
+
+#include <stdlib.h>
+
+// SIMD support. The kernels are compiled for their own instruction
+// set regardless of the global compiler flags, and are only called
+// once the CPU has reported support for them.
+//
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define SSE_DEFORMER_X86
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SSE_TARGET(isa)
+#else
+#include <cpuid.h>
+#define SSE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
 
 // Macros
 //
@@ -62,6 +91,331 @@
 		return status;					\
 	}
 
+// Kernel instruction sets, in increasing order of preference.
+//
+enum sseKernelISA {
+	kScalar = 0,
+	kSSE2,
+	kSSE41,
+	kAVX2
+};
+
+static const char* kernelISAName( sseKernelISA isa )
+{
+	switch( isa ) {
+		case kSSE2:		return "SSE2";
+		case kSSE41:	return "SSE4.1";
+		case kAVX2:		return "AVX2";
+		default:		return "scalar";
+	}
+}
+
+// Widest vector (in floats) used by any kernel. The staging buffer is
+// padded to a multiple of this and aligned to its size in bytes.
+//
+#define SSE_KERNEL_WIDTH	8
+#define SSE_KERNEL_ALIGN	(SSE_KERNEL_WIDTH * sizeof(float))
+
+// Aligned structure-of-arrays copy of the deformed points. The x, y
+// and z planes live back to back in one block, each one padded with
+// zeros to a multiple of SSE_KERNEL_WIDTH, so a kernel can run over
+// all three planes in a single pass using aligned loads and stores.
+//
+class sseDeformerPoints
+{
+public:
+					sseDeformerPoints();
+					~sseDeformerPoints();
+
+	bool			gather( const MFloatPointArray& pts );
+	void			scatter( MFloatPointArray& pts ) const;
+
+	float*			data() const		{ return fData; }
+	unsigned int	paddedLength() const	{ return fPadded; }
+
+private:
+					sseDeformerPoints( const sseDeformerPoints& );
+	sseDeformerPoints& operator=( const sseDeformerPoints& );
+
+	void*			fBlock;		// unaligned allocation
+	float*			fData;		// aligned start of the x plane
+	unsigned int	fLength;	// number of points
+	unsigned int	fPadded;	// floats per plane
+	unsigned int	fCapacity;	// floats per plane allocated
+};
+
+sseDeformerPoints::sseDeformerPoints()
+:	fBlock( NULL ), fData( NULL ), fLength( 0 ), fPadded( 0 ), fCapacity( 0 )
+{
+}
+
+sseDeformerPoints::~sseDeformerPoints()
+{
+	free( fBlock );
+}
+
+bool sseDeformerPoints::gather( const MFloatPointArray& pts )
+{
+	unsigned int n = pts.length();
+	unsigned int padded = (n + SSE_KERNEL_WIDTH - 1) & ~(SSE_KERNEL_WIDTH - 1);
+
+	// The buffer is kept between computes and only grows.
+	//
+	if( padded > fCapacity ) {
+		free( fBlock );
+		fBlock = malloc( 3 * padded * sizeof(float) + SSE_KERNEL_ALIGN );
+		if( NULL == fBlock ) {
+			fData = NULL;
+			fLength = fPadded = fCapacity = 0;
+			return false;
+		}
+		size_t addr = (size_t) fBlock;
+		addr = (addr + SSE_KERNEL_ALIGN - 1) & ~((size_t) SSE_KERNEL_ALIGN - 1);
+		fData = (float*) addr;
+		fCapacity = padded;
+	}
+	fLength = n;
+	fPadded = padded;
+
+	float* x = fData;
+	float* y = fData + padded;
+	float* z = fData + 2 * padded;
+	unsigned int i;
+	for( i = 0; i < n; i++ ) {
+		const MFloatPoint& pt = pts[i];
+		x[i] = pt.x;
+		y[i] = pt.y;
+		z[i] = pt.z;
+	}
+	for( ; i < padded; i++ ) {
+		x[i] = y[i] = z[i] = 0.0f;
+	}
+	return true;
+}
+
+void sseDeformerPoints::scatter( MFloatPointArray& pts ) const
+{
+	const float* x = fData;
+	const float* y = fData + fPadded;
+	const float* z = fData + 2 * fPadded;
+	for( unsigned int i = 0; i < fLength; i++ ) {
+		MFloatPoint& pt = pts[i];
+		pt.x = x[i];
+		pt.y = y[i];
+		pt.z = z[i];
+	}
+}
+
+// Kernels
+//
+// Every kernel computes
+//
+//		p = env * cos(p) * sin(p) * tan(p)
+//
+// in place over n floats. Since cos(p) * tan(p) == sin(p), the SIMD
+// kernels evaluate env * sin(p)^2 with a Cephes style polynomial after
+// reducing p to [-pi/4, pi/4] by multiples of pi/2. All SIMD kernels
+// use the same operations in the same order (no FMA), so they produce
+// identical results; they agree with the scalar libm kernel to a few
+// ulps for |p| up to around 8192.
+//
+typedef void (*sseKernel)( float* p, unsigned int n, float env );
+
+// Cody-Waite split of pi/2.
+//
+#define SSE_PIO2_1		1.5703125f
+#define SSE_PIO2_2		4.837512969970703125e-4f
+#define SSE_PIO2_3		7.54978995489188216e-8f
+#define SSE_2OPI		0.636619772367581343f
+
+#define SSE_SIN_C0		-1.9515295891e-4f
+#define SSE_SIN_C1		8.3321608736e-3f
+#define SSE_SIN_C2		-1.6666654611e-1f
+#define SSE_COS_C0		2.443315711809948e-5f
+#define SSE_COS_C1		-1.388731625493765e-3f
+#define SSE_COS_C2		4.166664568298827e-2f
+
+static void scalarKernel( float* p, unsigned int n, float env )
+{
+	for( unsigned int i = 0; i < n; i++ ) {
+		p[i] = env * (cosf(p[i]) * sinf(p[i]) * tanf(p[i]));
+	}
+}
+
+#ifdef SSE_DEFORMER_X86
+
+SSE_TARGET("sse2")
+static void sse2Kernel( float* p, unsigned int n, float env )
+{
+	const __m128 vEnv = _mm_set1_ps( env );
+	const __m128 vHalf = _mm_set1_ps( 0.5f );
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	const __m128i vOdd = _mm_set1_epi32( 1 );
+
+	for( unsigned int i = 0; i < n; i += 4 ) {
+		__m128 x = _mm_load_ps( p + i );
+
+		// Quadrant and reduced argument.
+		__m128i j = _mm_cvtps_epi32( _mm_mul_ps( x, _mm_set1_ps( SSE_2OPI ) ) );
+		__m128 fj = _mm_cvtepi32_ps( j );
+		__m128 r = _mm_sub_ps( x, _mm_mul_ps( fj, _mm_set1_ps( SSE_PIO2_1 ) ) );
+		r = _mm_sub_ps( r, _mm_mul_ps( fj, _mm_set1_ps( SSE_PIO2_2 ) ) );
+		r = _mm_sub_ps( r, _mm_mul_ps( fj, _mm_set1_ps( SSE_PIO2_3 ) ) );
+		__m128 z = _mm_mul_ps( r, r );
+
+		__m128 s = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( SSE_SIN_C0 ), z ), _mm_set1_ps( SSE_SIN_C1 ) );
+		s = _mm_add_ps( _mm_mul_ps( s, z ), _mm_set1_ps( SSE_SIN_C2 ) );
+		s = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( s, z ), r ), r );
+
+		__m128 c = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( SSE_COS_C0 ), z ), _mm_set1_ps( SSE_COS_C1 ) );
+		c = _mm_add_ps( _mm_mul_ps( c, z ), _mm_set1_ps( SSE_COS_C2 ) );
+		c = _mm_mul_ps( _mm_mul_ps( c, z ), z );
+		c = _mm_add_ps( _mm_sub_ps( c, _mm_mul_ps( vHalf, z ) ), vOne );
+
+		// Odd quadrants take the cosine branch.
+		__m128 odd = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( j, vOdd ), vOdd ) );
+		__m128 v = _mm_or_ps( _mm_and_ps( odd, c ), _mm_andnot_ps( odd, s ) );
+
+		_mm_store_ps( p + i, _mm_mul_ps( vEnv, _mm_mul_ps( v, v ) ) );
+	}
+}
+
+SSE_TARGET("sse4.1")
+static void sse41Kernel( float* p, unsigned int n, float env )
+{
+	const __m128 vEnv = _mm_set1_ps( env );
+	const __m128 vHalf = _mm_set1_ps( 0.5f );
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	const __m128i vOdd = _mm_set1_epi32( 1 );
+
+	for( unsigned int i = 0; i < n; i += 4 ) {
+		__m128 x = _mm_load_ps( p + i );
+
+		__m128 fj = _mm_round_ps( _mm_mul_ps( x, _mm_set1_ps( SSE_2OPI ) ),
+								  _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+		__m128i j = _mm_cvtps_epi32( fj );
+		__m128 r = _mm_sub_ps( x, _mm_mul_ps( fj, _mm_set1_ps( SSE_PIO2_1 ) ) );
+		r = _mm_sub_ps( r, _mm_mul_ps( fj, _mm_set1_ps( SSE_PIO2_2 ) ) );
+		r = _mm_sub_ps( r, _mm_mul_ps( fj, _mm_set1_ps( SSE_PIO2_3 ) ) );
+		__m128 z = _mm_mul_ps( r, r );
+
+		__m128 s = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( SSE_SIN_C0 ), z ), _mm_set1_ps( SSE_SIN_C1 ) );
+		s = _mm_add_ps( _mm_mul_ps( s, z ), _mm_set1_ps( SSE_SIN_C2 ) );
+		s = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( s, z ), r ), r );
+
+		__m128 c = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( SSE_COS_C0 ), z ), _mm_set1_ps( SSE_COS_C1 ) );
+		c = _mm_add_ps( _mm_mul_ps( c, z ), _mm_set1_ps( SSE_COS_C2 ) );
+		c = _mm_mul_ps( _mm_mul_ps( c, z ), z );
+		c = _mm_add_ps( _mm_sub_ps( c, _mm_mul_ps( vHalf, z ) ), vOne );
+
+		__m128 odd = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( j, vOdd ), vOdd ) );
+		__m128 v = _mm_blendv_ps( s, c, odd );
+
+		_mm_store_ps( p + i, _mm_mul_ps( vEnv, _mm_mul_ps( v, v ) ) );
+	}
+}
+
+SSE_TARGET("avx2")
+static void avx2Kernel( float* p, unsigned int n, float env )
+{
+	const __m256 vEnv = _mm256_set1_ps( env );
+	const __m256 vHalf = _mm256_set1_ps( 0.5f );
+	const __m256 vOne = _mm256_set1_ps( 1.0f );
+	const __m256i vOdd = _mm256_set1_epi32( 1 );
+
+	for( unsigned int i = 0; i < n; i += 8 ) {
+		__m256 x = _mm256_load_ps( p + i );
+
+		__m256 fj = _mm256_round_ps( _mm256_mul_ps( x, _mm256_set1_ps( SSE_2OPI ) ),
+									 _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+		__m256i j = _mm256_cvtps_epi32( fj );
+		__m256 r = _mm256_sub_ps( x, _mm256_mul_ps( fj, _mm256_set1_ps( SSE_PIO2_1 ) ) );
+		r = _mm256_sub_ps( r, _mm256_mul_ps( fj, _mm256_set1_ps( SSE_PIO2_2 ) ) );
+		r = _mm256_sub_ps( r, _mm256_mul_ps( fj, _mm256_set1_ps( SSE_PIO2_3 ) ) );
+		__m256 z = _mm256_mul_ps( r, r );
+
+		__m256 s = _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( SSE_SIN_C0 ), z ), _mm256_set1_ps( SSE_SIN_C1 ) );
+		s = _mm256_add_ps( _mm256_mul_ps( s, z ), _mm256_set1_ps( SSE_SIN_C2 ) );
+		s = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( s, z ), r ), r );
+
+		__m256 c = _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( SSE_COS_C0 ), z ), _mm256_set1_ps( SSE_COS_C1 ) );
+		c = _mm256_add_ps( _mm256_mul_ps( c, z ), _mm256_set1_ps( SSE_COS_C2 ) );
+		c = _mm256_mul_ps( _mm256_mul_ps( c, z ), z );
+		c = _mm256_add_ps( _mm256_sub_ps( c, _mm256_mul_ps( vHalf, z ) ), vOne );
+
+		__m256 odd = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( j, vOdd ), vOdd ) );
+		__m256 v = _mm256_blendv_ps( s, c, odd );
+
+		_mm256_store_ps( p + i, _mm256_mul_ps( vEnv, _mm256_mul_ps( v, v ) ) );
+	}
+}
+
+static void cpuid( int leaf, int regs[4] )
+{
+#if defined(_MSC_VER)
+	__cpuidex( regs, leaf, 0 );
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count( leaf, 0, a, b, c, d );
+	regs[0] = a; regs[1] = b; regs[2] = c; regs[3] = d;
+#endif
+}
+
+// Returns true if the OS saves the AVX register state.
+//
+static bool osSupportsAVX()
+{
+#if defined(_MSC_VER)
+	return (_xgetbv( 0 ) & 6) == 6;
+#else
+	unsigned int eax, edx;
+	__asm__ __volatile__( "xgetbv" : "=a"(eax), "=d"(edx) : "c"(0) );
+	return (eax & 6) == 6;
+#endif
+}
+
+#endif // SSE_DEFORMER_X86
+
+// Best kernel instruction set supported by this CPU.
+//
+static sseKernelISA detectKernelISA()
+{
+	sseKernelISA isa = kScalar;
+#ifdef SSE_DEFORMER_X86
+	int regs[4];
+	cpuid( 0, regs );
+	int maxLeaf = regs[0];
+
+	cpuid( 1, regs );
+	bool sse2 = (regs[3] & (1 << 26)) != 0;
+	bool sse41 = (regs[2] & (1 << 19)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0 && (regs[2] & (1 << 27)) != 0;
+
+	bool avx2 = false;
+	if( avx && maxLeaf >= 7 && osSupportsAVX() ) {
+		cpuid( 7, regs );
+		avx2 = (regs[1] & (1 << 5)) != 0;
+	}
+
+	if( sse2 ) isa = kSSE2;
+	if( sse2 && sse41 ) isa = kSSE41;
+	if( sse2 && sse41 && avx2 ) isa = kAVX2;
+#endif
+	return isa;
+}
+
+static sseKernel kernelForISA( sseKernelISA isa )
+{
+	switch( isa ) {
+#ifdef SSE_DEFORMER_X86
+		case kSSE2:		return sse2Kernel;
+		case kSSE41:	return sse41Kernel;
+		case kAVX2:		return avx2Kernel;
+#endif
+		default:		return scalarKernel;
+	}
+}
+
 class sseDeformer : public MPxDeformerNode
 {
 public:
@@ -78,16 +432,25 @@ public:
 public:
 	// local node attributes
 	static  MObject sseEnabled;
+	static  MObject kernelISA;
 
 	static  MTypeId		id;
 
 private:
+	// staging buffer, kept between computes
+	sseDeformerPoints	fPoints;
+
+	// best instruction set supported by the CPU
+	static sseKernelISA	fHostISA;
 };
 
 MTypeId     sseDeformer::id( 0x8104E );
 
 // local attributes
 MObject sseDeformer::sseEnabled;
+MObject sseDeformer::kernelISA;
+
+sseKernelISA sseDeformer::fHostISA = kScalar;
 
 sseDeformer::sseDeformer() {}
 sseDeformer::~sseDeformer() {}
@@ -105,12 +468,30 @@ MStatus sseDeformer::initialize()
  	sseEnabled=mSSEAttr.create( "enableSSE", "sse", MFnNumericData::kBoolean, 0, &status);
 	mSSEAttr.setStorable(true);
 
+	// Highest instruction set the SIMD path may use. The CPU's own
+	// limit is always respected, so "auto" picks the best available.
+	//
+	MFnEnumAttribute mISAAttr;
+	kernelISA = mISAAttr.create( "kernelISA", "isa", 0, &status );
+	MCheckStatus(status, "ERROR creating kernelISA attribute\n");
+	mISAAttr.addField( "auto", 0 );
+	mISAAttr.addField( "sse2", (short) kSSE2 );
+	mISAAttr.addField( "sse41", (short) kSSE41 );
+	mISAAttr.addField( "avx2", (short) kAVX2 );
+	mISAAttr.setStorable(true);
+
  	//  deformation attributes
  	status = addAttribute( sseEnabled );
 	MCheckStatus(status, "ERROR in addAttribute\n");
+ 	status = addAttribute( kernelISA );
+	MCheckStatus(status, "ERROR in addAttribute\n");
 
  	status = attributeAffects( sseEnabled, outputGeom );
 	MCheckStatus(status, "ERROR in attributeAffects\n");
+ 	status = attributeAffects( kernelISA, outputGeom );
+	MCheckStatus(status, "ERROR in attributeAffects\n");
+
+	fHostISA = detectKernelISA();
 
 	return MStatus::kSuccess;
 }
@@ -171,42 +552,50 @@ MStatus sseDeformer::compute(const MPlug& plug, MDataBlock& data)
 	MDataHandle sseData = data.inputValue(sseEnabled, &status);
 	bool sseEnabled = (bool) sseData.asBool();	
 
-	// NOTE: Using MTimer and possibly other classes disables
-	// autovectorization with Intel <=10.1 compiler on OSX and Linux!!
-	// Must compile this function with -fno-exceptions on OSX and
-	// Linux to guarantee autovectorization is done. Use -fvec_report2
-	// to check for vectorization status messages with Intel compiler.
- 	MTimer timer; timer.beginTimer();
+	MDataHandle isaData = data.inputValue(kernelISA, &status);
+	sseKernelISA isa = (sseKernelISA) isaData.asShort();
 
 	if(sseEnabled) {
 
-		// Innter loop will autovectorize. Around 3x faster than the
-		// loop below it. It would be faster if first element was
-		// guaranteed to be aligned on 16 byte boundary.
-		for(int i=0; i<nPoints; i++) {
-			float* ptPtr = &pts[i].x;
-			for(int j=0; j<4; j++) {
-				ptPtr[j] = env * (cosf(ptPtr[j]) * sinf(ptPtr[j]) * tanf(ptPtr[j]));
-			}
+		// Never go past what the CPU supports.
+		if(isa == kScalar || isa > fHostISA) {
+			isa = fHostISA;
 		}
 
+		MTimer gatherTimer; gatherTimer.beginTimer();
+		if(!fPoints.gather(pts)) {
+			printf("Could not allocate staging buffer\n");
+			return MStatus::kFailure;
+		}
+		gatherTimer.endTimer();
+
+		// One pass covers the x, y and z planes.
+		MTimer timer; timer.beginTimer();
+		sseKernel kernel = kernelForISA(isa);
+		kernel(fPoints.data(), 3 * fPoints.paddedLength(), env);
+		timer.endTimer();
+
+		MTimer scatterTimer; scatterTimer.beginTimer();
+		fPoints.scatter(pts);
+		scatterTimer.endTimer();
+
+		printf("%s kernel, %d points, runtime %f (staging %f)\n",
+			kernelISAName(isa), nPoints, timer.elapsedTime(),
+			gatherTimer.elapsedTime() + scatterTimer.elapsedTime());
+
 	} else {
 
-		// This inner loop will not autovectorize.
+		// Scalar reference loop, kept for comparison.
+ 		MTimer timer; timer.beginTimer();
 		for(int i=0; i<nPoints; i++) {
 			MFloatPoint& pt = pts[i];
 			for(int j=0; j<3; j++) {
 				pt[j] = env * (cosf(pt[j]) * sinf(pt[j]) * tanf(pt[j]));
 			}
-
 		}
-	}
+ 		timer.endTimer(); 
 
- 	timer.endTimer(); 
-	if(sseEnabled) {
-		printf("SSE enabled, runtime %f\n", timer.elapsedTime());
-	} else {
-		printf("SSE disabled, runtime %f\n", timer.elapsedTime());
+		printf("SSE disabled, %d points, runtime %f\n", nPoints, timer.elapsedTime());
 	}
 
 	outMesh.setPoints(pts);
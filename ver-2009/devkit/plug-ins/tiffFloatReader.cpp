@@ -23,6 +23,13 @@
 #include <maya/MStringArray.h>
 #include <maya/MIOStream.h>
 #include <maya/MGlobal.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
+#include <maya/MAtomic.h>
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
 
 // #pragma warning( disable : 4290 )		// Disable STL warnings.
 
@@ -51,6 +58,11 @@ protected:
 	unsigned int	fWidth;				// Width
 	unsigned int	fHeight;			// Height
 	unsigned int	fChannels;			// Number of channels
+	bool			fTiled;				// Tiled rather than stripped
+	unsigned int	fTileWidth;			// Tile size, if tiled
+	unsigned int	fTileLength;
+	unsigned int	fRowsPerStrip;		// Strip height, if stripped
+	MString			fPathname;
 
 #if defined(_TIFF_LIBRARY_AVAILABLE_)
 	TIFF			*fInputFile;		// Tif interface
@@ -59,6 +71,135 @@ protected:
 #endif
 };
 
+#if defined(_TIFF_LIBRARY_AVAILABLE_)
+// Shared state for one load. Strips and tiles decode independently, so
+// each task opens its own handle on the file and pulls the next strip
+// or tile from nextUnit until none are left. nextUnit and failed are
+// only written through MAtomic.
+//
+struct tiffLoadRegion
+{
+	const char*		pathname;
+	bool			tiled;
+	unsigned int	width;
+	unsigned int	height;
+	unsigned int	channels;
+	unsigned int	tileWidth;
+	unsigned int	tileLength;
+	unsigned int	rowsPerStrip;
+	unsigned int	tilesAcross;
+	int				numUnits;
+	int				numTasks;
+	float*			dest;
+	volatile int	nextUnit;
+	volatile int	failed;
+};
+
+//
+// DESCRIPTION:
+//		Decode a strip straight into the image rows it covers, then
+//		reverse their order in place; Maya expects images upside down.
+///////////////////////////////////////////////////////
+static bool readStrip( TIFF* tif, const tiffLoadRegion* region, int strip)
+{
+	size_t rowFloats = (size_t)region->width * region->channels;
+	unsigned int r0 = strip * region->rowsPerStrip;
+	unsigned int r1 = r0 + region->rowsPerStrip;
+	if (r1 > region->height)
+		r1 = region->height;
+	unsigned int rows = r1 - r0;
+
+	float* block = region->dest + (region->height - r1) * rowFloats;
+	tsize_t size = (tsize_t)(rows * rowFloats * sizeof(float));
+	if (TIFFReadEncodedStrip( tif, (tstrip_t)strip, block, size ) < size)
+		return false;
+
+	for (unsigned int i = 0; i < rows / 2; i++)
+	{
+		float* top = block + i * rowFloats;
+		std::swap_ranges( top, top + rowFloats, block + (rows - 1 - i) * rowFloats );
+	}
+	return true;
+}
+
+//
+// DESCRIPTION:
+//		Decode a tile and copy the part inside the image into the
+//		flipped rows.
+///////////////////////////////////////////////////////
+static bool readTile( TIFF* tif, const tiffLoadRegion* region, int tile, float* buffer)
+{
+	unsigned int x0 = (tile % region->tilesAcross) * region->tileWidth;
+	unsigned int y0 = (tile / region->tilesAcross) * region->tileLength;
+	tsize_t size = (tsize_t)((size_t)region->tileWidth * region->tileLength *
+							 region->channels * sizeof(float));
+	if (TIFFReadEncodedTile( tif, TIFFComputeTile( tif, x0, y0, 0, 0 ), buffer, size ) < 0)
+		return false;
+
+	unsigned int cols = std::min( region->tileWidth, region->width - x0 );
+	unsigned int rows = std::min( region->tileLength, region->height - y0 );
+	for (unsigned int r = 0; r < rows; r++)
+	{
+		const float* src = buffer + (size_t)r * region->tileWidth * region->channels;
+		float* dst = region->dest +
+			((size_t)(region->height - 1 - (y0 + r)) * region->width + x0) * region->channels;
+		memcpy( dst, src, cols * region->channels * sizeof(float) );
+	}
+	return true;
+}
+
+//
+// DESCRIPTION:
+///////////////////////////////////////////////////////
+static MThreadRetVal readUnits( void* data)
+{
+	tiffLoadRegion* region = (tiffLoadRegion*)data;
+
+	// (TIFF *) cast from integer required on Mac.
+	TIFF* tif = (TIFF *) TIFFOpen( region->pathname, "r" );
+	if (!tif)
+	{
+		MAtomic::set( &region->failed, 1 );
+		return (MThreadRetVal)0;
+	}
+
+	std::vector<float> tileBuffer;
+	if (region->tiled)
+		tileBuffer.resize( (size_t)region->tileWidth * region->tileLength * region->channels );
+
+	for (;;)
+	{
+		if (region->failed)
+			break;
+		int u = MAtomic::postIncrement( &region->nextUnit );
+		if (u >= region->numUnits)
+			break;
+
+		bool ok = region->tiled ? readTile( tif, region, u, &tileBuffer[0] )
+								: readStrip( tif, region, u );
+		if (!ok)
+		{
+			MAtomic::set( &region->failed, 1 );
+			break;
+		}
+	}
+
+	TIFFClose( tif );
+	return (MThreadRetVal)0;
+}
+
+//
+// DESCRIPTION:
+///////////////////////////////////////////////////////
+static void decomposeUnits( void* data, MThreadRootTask* root)
+{
+	tiffLoadRegion* region = (tiffLoadRegion*)data;
+	for (int i = 0; i < region->numTasks; i++)
+		MThreadPool::createTask( readUnits, data, root );
+	MThreadPool::executeAndJoin( root );
+}
+#endif
+
 //
 // DESCRIPTION:
 ///////////////////////////////////////////////////////
@@ -66,7 +207,11 @@ tiffFloatReader::tiffFloatReader()
 : fInputFile( NULL), 
   fChannels( 0), 
   fWidth(0),
-  fHeight(0)
+  fHeight(0),
+  fTiled(false),
+  fTileWidth(0),
+  fTileLength(0),
+  fRowsPerStrip(0)
 {
 
 }
@@ -96,6 +241,7 @@ void * tiffFloatReader::creator()
 MStatus tiffFloatReader::open( MString pathname, MImageFileInfo* info)
 {
 #if defined(_TIFF_LIBRARY_AVAILABLE_)
+	close();
 	try
 	{
 		// Open the tif file for read
@@ -157,6 +303,30 @@ MStatus tiffFloatReader::open( MString pathname, MImageFileInfo* info)
 		goto no_support;
 	}
 
+	// Strip or tile layout, so load() can decode each one on its own.
+	// Compressed files are handled by libtiff's strip and tile decoders.
+	fTiled = TIFFIsTiled( fInputFile ) != 0;
+	if (fTiled)
+	{
+		if (_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_TILEWIDTH, &fTileWidth) ||
+			_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_TILELENGTH, &fTileLength) ||
+			fTileWidth < 1 || fTileLength < 1)
+		{
+			goto no_support;
+		}
+	}
+	else
+	{
+		if (_TIFF_SUCCESS != TIFFGetFieldDefaulted(fInputFile, TIFFTAG_ROWSPERSTRIP, &fRowsPerStrip) ||
+			fRowsPerStrip < 1)
+		{
+			goto no_support;
+		}
+		if (fRowsPerStrip > fHeight)
+			fRowsPerStrip = fHeight;
+	}
+	fPathname = pathname;
+
 	// Compression not supported yet.. 
 #if 0
 	unsigned short compression;
@@ -179,6 +349,8 @@ MStatus tiffFloatReader::open( MString pathname, MImageFileInfo* info)
 		info->channels( fChannels );
 		info->numberOfImages( 1 );
 		info->pixelType( MImage::kFloat);
+		info->hasAlpha( fChannels == 4 );
+		info->hasMipMaps( false );
 	}
 	return MS::kSuccess;
 
@@ -223,27 +395,53 @@ MStatus tiffFloatReader::load( MImage& image, unsigned int imageNumber)
 	float* outputBuffer = image.floatPixels();
 	if (outputBuffer == NULL)
 		return rval;
-	
-	// Maya expects images upside down
-	unsigned int row = 0;
-	bool flipVertically = true;
-	if (flipVertically)
+
+	tiffLoadRegion region;
+	region.pathname = fPathname.asChar();
+	region.tiled = fTiled;
+	region.width = fWidth;
+	region.height = fHeight;
+	region.channels = fChannels;
+	region.tileWidth = fTileWidth;
+	region.tileLength = fTileLength;
+	region.rowsPerStrip = fRowsPerStrip;
+	if (fTiled)
 	{
-		outputBuffer += (fHeight-1) * (fWidth * fChannels);
-		for (row = 0; row < fHeight; row++)
-		{
-			TIFFReadScanline (fInputFile, outputBuffer, row);
-			outputBuffer -= (fWidth * fChannels);
-		}
+		region.tilesAcross = (fWidth + fTileWidth - 1) / fTileWidth;
+		region.numUnits = region.tilesAcross * ((fHeight + fTileLength - 1) / fTileLength);
 	}
 	else
 	{
-		for (row = 0; row < fHeight; row++)
-		{
-			TIFFReadScanline (fInputFile, outputBuffer, row);
-			outputBuffer += (fWidth * fChannels);
-		}
+		region.tilesAcross = 0;
+		region.numUnits = (fHeight + fRowsPerStrip - 1) / fRowsPerStrip;
+	}
+	region.dest = outputBuffer;
+	region.nextUnit = 0;
+	region.failed = 0;
+
+	int numThreads = MThreadUtils::getNumThreads();
+	if (numThreads < 1)
+		numThreads = 1;
+	region.numTasks = region.numUnits < numThreads ? region.numUnits : numThreads;
+
+	if (region.numTasks == 1 || MS::kSuccess != MThreadPool::init())
+	{
+		readUnits( &region );
 	}
+	else
+	{
+		MThreadPool::newParallelRegion( decomposeUnits, &region );
+
+		// release the reference taken by init()
+		MThreadPool::release();
+	}
+
+	if (region.failed)
+	{
+		cerr << "tiffFloatReader::load() failed to read " << fPathname.asChar() << endl;
+		return rval;
+	}
+
 	rval = MS::kSuccess;
 #endif
 	return rval;
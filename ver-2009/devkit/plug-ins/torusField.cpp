@@ -11,6 +11,7 @@
 
 #include <maya/MIOStream.h>
 #include <math.h>
+#include <vector>
 
 #include <torusField.h>
 
@@ -27,6 +28,9 @@
 #include <maya/MFnVectorArrayData.h>
 #include <maya/MFnDoubleArrayData.h>
 #include <maya/MFnMatrixData.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
+#include <maya/MAtomic.h>
 
 
 MObject torusField::aMinDistance;
@@ -172,15 +176,7 @@ MStatus torusField::compute(const MPlug& plug, MDataBlock& block)
 	//
 
 	MVectorArray forceArray;
-	bool useMaxDistSet = useMaxDistanceValue( block );
-	if( useMaxDistSet )
-	{
-		applyMaxDist( block, points, velocities, masses, forceArray );
-	}
-	else
-	{
-		applyNoMaxDist( block, points, velocities, masses, forceArray );
-	}
+	applyForce( block, points, velocities, masses, forceArray );
 
 	// get output data handle
 	//
@@ -207,260 +203,440 @@ MStatus torusField::compute(const MPlug& plug, MDataBlock& block)
 }
 
 
-void torusField::applyNoMaxDist
-	(
-		MDataBlock &block,				// get field param from this block
-		const MVectorArray &points,		// current position of Object
-		const MVectorArray &velocities,	// current velocity of Object
-		const MDoubleArray &/*masses*/,		// mass of Object
-		MVectorArray &outputForce		// output force
-	)
+// Field parameters, read from the data block once per evaluation rather
+// than once per field position and receptor.
 //
-//	Descriptions:
-//		Compute output force in the case that the useMaxDistance is not set.
+struct torusFieldParams
+{
+	double	magnitude;
+	double	attenuation;
+	bool	useMaxDistance;
+	double	maxDistance;
+	double	minDistance;
+	double	attractDistance;
+	double	repelDistance;
+	double	drag;
+	double	swarmAmplitude;
+	double	swarmFrequency;
+	double	swarmPhase;
+
+	// falloffCurve() sampled over [0,1], or empty if it is constant one.
+	// The curve is evaluated through the node, so it is sampled before
+	// the receptors are shared out between threads.
+	//
+	std::vector<double>	falloff;
+};
+
+#define FALLOFF_SAMPLES 1024
+
+static double falloffValue( const torusFieldParams &params, double param )
+{
+	if( params.falloff.empty() )
+		return( 1.0 );
+
+	double x = param * FALLOFF_SAMPLES;
+	if( x <= 0.0 )
+		return( params.falloff[0] );
+	if( x >= FALLOFF_SAMPLES )
+		return( params.falloff[FALLOFF_SAMPLES] );
+
+	int i = (int)x;
+	double t = x - i;
+	return( params.falloff[i] * (1.0 - t) + params.falloff[i+1] * t );
+}
+
+// Uniform grid over the field positions. Cells are at least as wide as
+// the largest distance the grid is queried with, so a query only visits
+// the few cells around the receptor. The positions are stored sorted by
+// cell, so each cell's positions are contiguous.
 //
+class torusFieldGrid
 {
-	// points and velocities should have the same length. If not return.
+public:
+	void	build( const MVectorArray &positions, double cellSize );
+
+	// Append to "result" the (sorted) index of every position within
+	// "radius" of p, and add those positions to "sum".
 	//
-	if( points.length() != velocities.length() )
-		return;
+	void	near( const double p[3], double radius,
+				  std::vector<int> &result, double sum[3] ) const;
+
+	const double *position( int i ) const	{ return &fPositions[3*i]; }
+	int		count() const		{ return (int)fPositions.size() / 3; }
+	const double *total() const	{ return fTotal; }
+
+private:
+	double				fMin[3];
+	double				fCellSize;
+	int					fDims[3];
+	std::vector<int>	fCellStart;		// first position of each cell, +1
+	std::vector<double>	fPositions;		// xyz, sorted by cell
+	double				fTotal[3];		// sum of all positions
+};
+
+void torusFieldGrid::build( const MVectorArray &positions, double cellSize )
+{
+	int n = positions.length();
+	fPositions.resize( 3 * n );
+	fTotal[0] = fTotal[1] = fTotal[2] = 0.0;
 
-	// clear the output force array.
+	// The bounds only cover finite positions. NaN or infinite ones, from
+	// particles that have blown up, are kept in the first cell of each
+	// axis, where no distance test will ever pick them.
 	//
-	outputForce.clear();
+	double bmin[3] = { 0.0, 0.0, 0.0 };
+	double bmax[3] = { 0.0, 0.0, 0.0 };
+	bool bounded[3] = { false, false, false };
+	int i, k;
+	for( i = 0; i < n; i++ )
+	{
+		const MVector &p = positions[i];
+		for( k = 0; k < 3; k++ )
+		{
+			fTotal[k] += p[k];
+			if( p[k] - p[k] != 0.0 )
+				continue;
+			if( !bounded[k] || p[k] < bmin[k] ) bmin[k] = p[k];
+			if( !bounded[k] || p[k] > bmax[k] ) bmax[k] = p[k];
+			bounded[k] = true;
+		}
+	}
 
-	// get field parameters.
+	// An extent too wide for a double gets a single cell.
 	//
-	double magValue = magnitudeValue( block );
-	// double attenValue = attenuationValue( block );
-	double minDist = minDistanceValue( block );
-	double attractDist = attractDistanceValue( block );
-	double repelDist = repelDistanceValue( block );
-	double dragMag = dragValue( block );
-	double swarmAmp = swarmAmplitudeValue( block );
+	double extent[3];
+	double maxExtent = 0.0;
+	for( k = 0; k < 3; k++ )
+	{
+		extent[k] = bmax[k] - bmin[k];
+		if( extent[k] - extent[k] != 0.0 )
+			extent[k] = 0.0;
+		if( extent[k] > maxExtent )
+			maxExtent = extent[k];
+	}
 
-	// get owner's data. posArray may have only one point which is the centroid
-	// (if this has owner) or field position(if without owner). Or it may have
-	// a list of points if with owner and applyPerVertex.
+	// Keep the number of cells in proportion to the number of positions;
+	// a small cutoff over a wide spread would otherwise make a huge grid.
+	// Once a cell spans the whole extent there is only one, so the loop
+	// always ends.
 	//
-	MVectorArray posArray;
-	posArray.clear();
-	ownerPosition( block, posArray );
+	double maxCells = 4.0 * n + 64.0;
+	fCellSize = cellSize > 1.0e-9 ? cellSize : 1.0e-9;
+	while( fCellSize <= maxExtent )
+	{
+		double cells = 1.0;
+		for( k = 0; k < 3; k++ )
+			cells *= floor( extent[k] / fCellSize ) + 1.0;
+		if( cells <= maxCells )
+			break;
+		fCellSize *= 2.0;
+	}
 
-	int fieldPosCount = posArray.length();
-	int receptorSize = points.length();
+	for( k = 0; k < 3; k++ )
+	{
+		fMin[k] = bmin[k];
+		fDims[k] = (int)floor( extent[k] / fCellSize ) + 1;
+	}
 
-	// With this model,if max distance isn't set then we
-	// also don't attenuate, because 1 - dist/maxDist isn't
-	// meaningful. No max distance and no attenuation.
+	// Counting sort of the positions by cell.
 	//
-	if (dragMag <= 0)
+	std::vector<int> cellOf( n );
+	fCellStart.assign( fDims[0] * fDims[1] * fDims[2] + 1, 0 );
+	for( i = 0; i < n; i++ )
 	{
-		if (swarmAmp <= 0)
+		const MVector &p = positions[i];
+		int c[3];
+		for( k = 0; k < 3; k++ )
 		{
-			// No max dist, no attenuation, no drag, no swarm
-			//
-			for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
-			{
-				MVector forceV(0.0,0.0,0.0);
-				const MVector &receptorPoint = points[ptIndex];
+			double cell = ( p[k] - fMin[k] ) / fCellSize;
+			if( !( cell >= 0.0 ) )
+				c[k] = 0;
+			else if( cell >= fDims[k] )
+				c[k] = fDims[k] - 1;
+			else
+				c[k] = (int)cell;
+		}
+		cellOf[i] = (c[2] * fDims[1] + c[1]) * fDims[0] + c[0];
+		fCellStart[cellOf[i] + 1]++;
+	}
+	for( i = 1; i < (int)fCellStart.size(); i++ )
+		fCellStart[i] += fCellStart[i-1];
 
-				// Apply from every field position to every receptor position.
-				//
-				for(int i = fieldPosCount; --i>=0; )
-				{
-					MVector difference = (receptorPoint-posArray[i]);
+	std::vector<int> next( fCellStart.begin(), fCellStart.end() - 1 );
+	for( i = 0; i < n; i++ )
+	{
+		int j = next[cellOf[i]]++;
+		const MVector &p = positions[i];
+		fPositions[3*j+0] = p.x;
+		fPositions[3*j+1] = p.y;
+		fPositions[3*j+2] = p.z;
+	}
+}
+
+void torusFieldGrid::near( const double p[3], double radius,
+						   std::vector<int> &result, double sum[3] ) const
+{
+	if( fPositions.empty() || radius < 0.0 )
+		return;
 
-					double distance = difference.length();
-					if (distance < minDist) continue;
+	int lo[3], hi[3], k;
+	for( k = 0; k < 3; k++ )
+	{
+		double a = floor( (p[k] - radius - fMin[k]) / fCellSize );
+		double b = floor( (p[k] + radius - fMin[k]) / fCellSize );
+		if( !( b >= 0.0 ) || !( a < fDims[k] ) )
+			return;
+		lo[k] = a < 0.0 ? 0 : (int)a;
+		hi[k] = b >= fDims[k] ? fDims[k] - 1 : (int)b;
+	}
 
-					if (distance <= repelDist)
-						forceV += difference * magValue;
-					else if (distance >= attractDist)
-						forceV += -difference * magValue;
-				}
-				outputForce.append( forceV );
-			}
-		}
-		else
+	double r2 = radius * radius;
+	for( int z = lo[2]; z <= hi[2]; z++ )
+	{
+		for( int y = lo[1]; y <= hi[1]; y++ )
 		{
-			// No max dist, no attenuation, no drag, yes swarm
-			//
-			for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
+			int row = (z * fDims[1] + y) * fDims[0];
+			int first = fCellStart[row + lo[0]];
+			int last = fCellStart[row + hi[0] + 1];
+			for( int j = first; j < last; j++ )
 			{
-				MVector forceV(0.0,0.0,0.0);
-				const MVector &receptorPoint = points[ptIndex];
-
-				// Apply from every field position to every receptor position.
-				//
-				double distance = 0.0;
-				int i;
-				for(i = fieldPosCount; --i>=0; )
+				const double *q = &fPositions[3*j];
+				double dx = p[0] - q[0];
+				double dy = p[1] - q[1];
+				double dz = p[2] - q[2];
+				if( dx*dx + dy*dy + dz*dz <= r2 )
 				{
-					MVector difference = (receptorPoint-posArray[i]);
-					distance = difference.length();
-					if (distance < minDist) continue;
-
-					if (distance <= repelDist)
-						forceV += difference * magValue;
-					else if (distance >= attractDist)
-						forceV += -difference * magValue;
+					result.push_back( j );
+					sum[0] += q[0];
+					sum[1] += q[1];
+					sum[2] += q[2];
 				}
-
-				// Apply swarm only if the object is inside the zone
-				// the repulsion-attraction is pushing the object to.
-				//
-				if ( distance >= repelDist && distance <= attractDist)
-				{
-					double frequency = swarmFrequencyValue( block );
-					MVector phase( 0.0, 0.0, swarmPhaseValue(block) );
-
-					// Add swarm in here
-					//
-					for(i = fieldPosCount; --i >= 0;)
-					{
-						MVector difference = receptorPoint - posArray[i];
-						difference = (difference + phase) * frequency;
-
-						double *noiseEffect = &difference.x;
-						if( (noiseEffect[0] < -2147483647.0) ||
-							(noiseEffect[0] >  2147483647.0) ||
-							(noiseEffect[1] < -2147483647.0) ||
-							(noiseEffect[1] >  2147483647.0) ||
-							(noiseEffect[2] < -2147483647.0) ||
-							(noiseEffect[2] >  2147483647.0) )
-							continue;
-
-						double noiseOut[4];
-						noiseFunction( noiseEffect, noiseOut );
-			 			MVector swarmForce( noiseOut[0] * swarmAmp,
-											noiseOut[1] * swarmAmp,
-											noiseOut[2] * swarmAmp );
-						forceV += swarmForce;
-					}
-				}
-				outputForce.append( forceV );
 			}
 		}
 	}
-	else
+}
+
+// Add the swarm force between a receptor and a field position "d" away
+// from it, unless the noise lookup would overflow.
+//
+static void addSwarm( const torusFieldParams &params, const double d[3],
+					  double force[3] )
+{
+	double noiseEffect[3];
+	noiseEffect[0] = d[0] * params.swarmFrequency;
+	noiseEffect[1] = d[1] * params.swarmFrequency;
+	noiseEffect[2] = (d[2] + params.swarmPhase) * params.swarmFrequency;
+	for( int k = 0; k < 3; k++ )
+	{
+		if( noiseEffect[k] < -2147483647.0 || noiseEffect[k] > 2147483647.0 )
+			return;
+	}
+
+	double noiseOut[4];
+	torusField::noiseFunction( noiseEffect, noiseOut );
+	force[0] += noiseOut[0] * params.swarmAmplitude;
+	force[1] += noiseOut[1] * params.swarmAmplitude;
+	force[2] += noiseOut[2] * params.swarmAmplitude;
+}
+
+// Everything one evaluation of the field needs, shared by the threads
+// computing it. Receptors are handed out in batches through nextBatch.
+//
+struct torusFieldRegion
+{
+	const torusFieldParams	*params;
+	const torusFieldGrid	*grid;
+	const MVectorArray		*fieldPositions;
+	const MVectorArray		*points;
+	const MVectorArray		*velocities;
+	MVectorArray			*outputForce;
+	int						numBatches;
+	int						numTasks;
+	volatile int			nextBatch;
+};
+
+#define RECEPTOR_BATCH 256
+
+static void applyToReceptor( const torusFieldRegion &region, int ptIndex,
+							 std::vector<int> &nearby )
+{
+	const torusFieldParams &params = *region.params;
+	const torusFieldGrid &grid = *region.grid;
+	const MVector &receptor = (*region.points)[ptIndex];
+	const MVector &velocity = (*region.velocities)[ptIndex];
+	double r[3] = { receptor.x, receptor.y, receptor.z };
+	int fieldPosCount = grid.count();
+
+	double force[3] = { 0.0, 0.0, 0.0 };
+	double nearSum[3] = { 0.0, 0.0, 0.0 };
+	nearby.clear();
+
+	if( params.useMaxDistance )
 	{
-		if (swarmAmp <= 0)
+		// Only positions within maxDistance apply.
+		//
+		double maxDist = params.maxDistance;
+		grid.near( r, maxDist, nearby, nearSum );
+
+		for( size_t n = 0; n < nearby.size(); n++ )
 		{
-			// Yes drag, no swarm
-			//
-			for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
+			const double *q = grid.position( nearby[n] );
+			double d[3] = { r[0] - q[0], r[1] - q[1], r[2] - q[2] };
+			double distance = sqrt( d[0]*d[0] + d[1]*d[1] + d[2]*d[2] );
+			if( distance < params.minDistance )
+				continue;
+
+			double scale = 0.0;
+			if( params.attenuation > 0.0 )
 			{
-				const MVector& receptorPoint = points[ptIndex];
+				scale = params.magnitude;
+				if( maxDist > 0.0 )
+					scale *= pow( 1.0 - distance / maxDist, params.attenuation );
+			}
+			else if( distance <= params.repelDistance )
+				scale = params.magnitude;
+			else if( distance >= params.attractDistance )
+				scale = -params.magnitude;
 
-				// Apply from every field position to every receptor position.
-				//
-				MVector forceV(0,0,0);
-				double distance = 0.0;
-				for(int i = fieldPosCount; --i>=0; )
-				{
-					MVector difference = (receptorPoint-posArray[i]);
-					distance = difference.length();
-					if (distance < minDist) continue;
-
-					if (distance <= repelDist)
-						forceV += difference * magValue;
-					else if (distance >= attractDist)
-						forceV += -difference * magValue;
-				}
+			double f[3] = { d[0] * scale, d[1] * scale, d[2] * scale };
 
-				// Apply drag only if the object is inside the zone
-				// the repulsion-attraction is pushing the object to.
-				//
-				if ( distance >= repelDist && distance <= attractDist)
+			// Apply drag and swarm if the object is inside the zone
+			// the repulsion-attraction is pushing the object to.
+			//
+			if( distance >= params.repelDistance &&
+				distance <= params.attractDistance )
+			{
+				if( params.drag > 0.0 )
 				{
-					if (fieldPosCount > 0)
-					{
-						MVector dragForceV;
-						dragForceV = velocities[ptIndex] *
-												(-dragMag) * fieldPosCount;
-						forceV += dragForceV;
-					}
+					double drag = -params.drag * fieldPosCount;
+					f[0] += velocity.x * drag;
+					f[1] += velocity.y * drag;
+					f[2] += velocity.z * drag;
 				}
+				if( params.swarmAmplitude > 0.0 )
+					addSwarm( params, d, f );
+			}
 
-				outputForce.append( forceV );
+			if( maxDist > 0.0 )
+			{
+				double falloff = falloffValue( params, distance / maxDist );
+				f[0] *= falloff;
+				f[1] *= falloff;
+				f[2] *= falloff;
 			}
+			force[0] += f[0];
+			force[1] += f[1];
+			force[2] += f[2];
 		}
-		else
+	}
+	else
+	{
+		// Without max distance every position either repels, attracts
+		// or does nothing, and beyond the largest of the distances they
+		// all attract. The attraction is linear in the offset, so the
+		// far positions are summed in one go from the total of all
+		// positions less the nearby ones, which are done one by one.
+		//
+		double nearDist = params.attractDistance;
+		if( params.repelDistance > nearDist ) nearDist = params.repelDistance;
+		if( params.minDistance > nearDist ) nearDist = params.minDistance;
+		if( nearDist < 0.0 ) nearDist = 0.0;
+		grid.near( r, nearDist, nearby, nearSum );
+
+		const double *total = grid.total();
+		double farCount = (double)( fieldPosCount - (int)nearby.size() );
+		for( int k = 0; k < 3; k++ )
+			force[k] = -params.magnitude *
+				( farCount * r[k] - (total[k] - nearSum[k]) );
+
+		for( size_t n = 0; n < nearby.size(); n++ )
 		{
-			// Yes drag, yes swarm
-			//
-			for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
-			{
-				const MVector &receptorPoint = points[ptIndex];
+			const double *q = grid.position( nearby[n] );
+			double d[3] = { r[0] - q[0], r[1] - q[1], r[2] - q[2] };
+			double distance = sqrt( d[0]*d[0] + d[1]*d[1] + d[2]*d[2] );
+			if( distance < params.minDistance )
+				continue;
+
+			double scale;
+			if( distance <= params.repelDistance )
+				scale = params.magnitude;
+			else if( distance >= params.attractDistance )
+				scale = -params.magnitude;
+			else
+				continue;
+			force[0] += d[0] * scale;
+			force[1] += d[1] * scale;
+			force[2] += d[2] * scale;
+		}
 
-				// Apply from every field position to every receptor position.
-				//
-				MVector forceV(0,0,0);
-				double distance = 0.0;
-				int i;
-				for(i = fieldPosCount; --i>=0; )
+		// Apply drag and swarm only if the object is inside the zone
+		// the repulsion-attraction is pushing it to, as measured from
+		// the first field position. Swarm comes from every position.
+		//
+		if( fieldPosCount > 0 &&
+			( params.drag > 0.0 || params.swarmAmplitude > 0.0 ) )
+		{
+			const MVectorArray &posArray = *region.fieldPositions;
+			MVector difference = receptor - posArray[0];
+			double distance = difference.length();
+			if( distance >= params.repelDistance &&
+				distance <= params.attractDistance )
+			{
+				if( params.drag > 0.0 )
 				{
-					MVector difference = (receptorPoint-posArray[i]);
-					distance = difference.length();
-					if (distance < minDist) continue;
-
-					if (distance <= repelDist)
-						forceV += difference * magValue;
-					else if (distance >= attractDist)
-						forceV += -difference * magValue;
+					double drag = -params.drag * fieldPosCount;
+					force[0] += velocity.x * drag;
+					force[1] += velocity.y * drag;
+					force[2] += velocity.z * drag;
 				}
-
-				// Apply drag and swarm only if the object is inside
-				// the zone the repulsion-attraction is pushing the object to.
-				//
-				if ( distance >= repelDist && distance <= attractDist)
+				if( params.swarmAmplitude > 0.0 )
 				{
-					if (fieldPosCount > 0)
-					{
-						MVector dragForceV;
-						dragForceV = velocities[ptIndex] *
-												(-dragMag) * fieldPosCount;
-						forceV += dragForceV;
-					}
-
-					// Add swarm in here
-					//
-					double frequency = swarmFrequencyValue( block );
-					MVector phase( 0.0, 0.0, swarmPhaseValue(block) );
-
-					for(i = fieldPosCount; --i>=0; )
+					for( int i = fieldPosCount; --i >= 0; )
 					{
-						MVector difference = receptorPoint - posArray[i];
-						difference = (difference + phase) * frequency;
-
-						double *noiseEffect = &difference.x;
-						if( (noiseEffect[0] < -2147483647.0) ||
-							(noiseEffect[0] >  2147483647.0) ||
-							(noiseEffect[1] < -2147483647.0) ||
-							(noiseEffect[1] >  2147483647.0) ||
-							(noiseEffect[2] < -2147483647.0) ||
-							(noiseEffect[2] >  2147483647.0) )
-							continue;
-
-						double noiseOut[4];
-						noiseFunction( noiseEffect, noiseOut );
-						MVector swarmForce( noiseOut[0] * swarmAmp,
-											noiseOut[1] * swarmAmp,
-											noiseOut[2] * swarmAmp );
-						forceV += swarmForce;
+						const MVector &q = posArray[i];
+						double d[3] = { r[0] - q.x, r[1] - q.y, r[2] - q.z };
+						addSwarm( params, d, force );
 					}
 				}
-				outputForce.append( forceV );
 			}
 		}
 	}
+
+	(*region.outputForce)[ptIndex] = MVector( force[0], force[1], force[2] );
+}
+
+static MThreadRetVal applyToBatches( void *data )
+{
+	torusFieldRegion *region = (torusFieldRegion *)data;
+	int receptorSize = region->points->length();
+	std::vector<int> nearby;
+
+	for( ;; )
+	{
+		int batch = MAtomic::postIncrement( &region->nextBatch );
+		if( batch >= region->numBatches )
+			break;
+
+		int end = (batch + 1) * RECEPTOR_BATCH;
+		if( end > receptorSize ) end = receptorSize;
+		for( int ptIndex = batch * RECEPTOR_BATCH; ptIndex < end; ptIndex++ )
+			applyToReceptor( *region, ptIndex, nearby );
+	}
+	return( (MThreadRetVal)0 );
+}
+
+static void decomposeBatches( void *data, MThreadRootTask *root )
+{
+	torusFieldRegion *region = (torusFieldRegion *)data;
+	for( int i = 0; i < region->numTasks; i++ )
+		MThreadPool::createTask( applyToBatches, data, root );
+	MThreadPool::executeAndJoin( root );
 }
 
 
-void torusField::applyMaxDist
+void torusField::applyForce
 	(
-		MDataBlock& block,				// get field param from this block
+		MDataBlock &block,				// get field param from this block
 		const MVectorArray &points,		// current position of Object
 		const MVectorArray &velocities,	// current velocity of Object
 		const MDoubleArray &/*masses*/,		// mass of Object
@@ -468,7 +644,9 @@ void torusField::applyMaxDist
 	)
 //
 //	Descriptions:
-//		Compute output force in the case that the useMaxDistance is set.
+//		Compute output force. The field positions are put in a grid
+//		keyed on the largest distance at which a position acts on its
+//		own, and the receptors are shared out between threads.
 //
 {
 	// points and velocities should have the same length. If not return.
@@ -476,20 +654,28 @@ void torusField::applyMaxDist
 	if( points.length() != velocities.length() )
 		return;
 
-	// clear the output force array.
-	//
-	outputForce.clear();
-
 	// get field parameters.
 	//
-	double magValue = magnitudeValue( block );
-	double attenValue = attenuationValue( block );
-	double maxDist = maxDistanceValue( block );
-	double minDist = minDistanceValue( block );
-	double attractDist = attractDistanceValue( block );
-	double repelDist = repelDistanceValue( block );
-	double dragMag = dragValue( block );
-	double swarmAmp = swarmAmplitudeValue( block );
+	torusFieldParams params;
+	params.magnitude = magnitudeValue( block );
+	params.attenuation = attenuationValue( block );
+	params.useMaxDistance = useMaxDistanceValue( block );
+	params.maxDistance = maxDistanceValue( block );
+	params.minDistance = minDistanceValue( block );
+	params.attractDistance = attractDistanceValue( block );
+	params.repelDistance = repelDistanceValue( block );
+	params.drag = dragValue( block );
+	params.swarmAmplitude = swarmAmplitudeValue( block );
+	params.swarmFrequency = swarmFrequencyValue( block );
+	params.swarmPhase = swarmPhaseValue( block );
+
+	if( params.useMaxDistance && params.maxDistance > 0.0 &&
+		!isFalloffCurveConstantOne() )
+	{
+		params.falloff.resize( FALLOFF_SAMPLES + 1 );
+		for( int i = 0; i <= FALLOFF_SAMPLES; i++ )
+			params.falloff[i] = falloffCurve( (double)i / FALLOFF_SAMPLES );
+	}
 
 	// get owner's data. posArray may have only one point which is the centroid
 	// (if this has owner) or field position(if without owner). Or it may have
@@ -499,151 +685,48 @@ void torusField::applyMaxDist
 	posArray.clear();
 	ownerPosition( block, posArray );
 
-	int fieldPosCount = posArray.length();
-	int receptorSize = points.length();
-
-	if (attenValue > 0.0)
+	// With max distance only positions that close apply; without it, only
+	// positions within the largest of the other distances need testing.
+	//
+	double cellSize = params.maxDistance;
+	if( !params.useMaxDistance )
 	{
-		// Max distance applies and so does attenuation.
-		//
-		for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
-		{
-			const MVector &receptorPoint = points[ptIndex];
+		cellSize = params.attractDistance;
+		if( params.repelDistance > cellSize ) cellSize = params.repelDistance;
+		if( params.minDistance > cellSize ) cellSize = params.minDistance;
+	}
+	torusFieldGrid grid;
+	grid.build( posArray, cellSize );
 
-			// Apply from every field position to every receptor position.
-			//
-			MVector forceV(0,0,0);
-			MVector sumForceV(0,0,0);
-			for(int i = fieldPosCount; --i>=0; )
-			{
-				MVector difference = receptorPoint-posArray[i];
-				double distance  = difference.length();
-				if (distance <= maxDist && distance >= minDist )
-				{
-					double force = magValue *
-									(pow((1.0-(distance/maxDist)),attenValue));
-					forceV = difference * force;
-
-					// Apply drag and swarm if the object is inside
-					// the zone the repulsion-attraction is pushing the
-					// object to, and if they are set.
-					//
-					if ( distance >= repelDist && distance <= attractDist)
-					{
-						if (fieldPosCount > 0 && dragMag > 0)
-						{
-							MVector dragForceV;
-							dragForceV = velocities[ptIndex] *
-											(-dragMag) * fieldPosCount;
-							forceV += dragForceV;
-						}
-
-						// Add swarm if swarm aplitude is set.
-						//
-						if (swarmAmp > 0)
-						{
-							double frequency = swarmFrequencyValue( block );
-							MVector phase( 0.0, 0.0, swarmPhaseValue(block) );
-
-							difference = receptorPoint - posArray[i];
-							difference = (difference + phase) * frequency;
-							double *noiseEffect = &difference.x;
-							if( (noiseEffect[0] < -2147483647.0) ||
-								(noiseEffect[0] >  2147483647.0) ||
-								(noiseEffect[1] < -2147483647.0) ||
-								(noiseEffect[1] >  2147483647.0) ||
-								(noiseEffect[2] < -2147483647.0) ||
-								(noiseEffect[2] >  2147483647.0) )
-								continue;
-
-							double noiseOut[4];
-							noiseFunction( noiseEffect, noiseOut );
-							MVector swarmForce( noiseOut[0] * swarmAmp,
-												noiseOut[1] * swarmAmp,
-												noiseOut[2] * swarmAmp );
-							forceV += swarmForce;
-						}
-					}
-				}
-				if (maxDist > 0.0) forceV *= falloffCurve(distance/maxDist);
-				sumForceV += forceV;					
-			}
-			outputForce.append( sumForceV );
-		}
+	int receptorSize = points.length();
+	outputForce.setLength( receptorSize );
+
+	torusFieldRegion region;
+	region.params = &params;
+	region.grid = &grid;
+	region.fieldPositions = &posArray;
+	region.points = &points;
+	region.velocities = &velocities;
+	region.outputForce = &outputForce;
+	region.numBatches = (receptorSize + RECEPTOR_BATCH - 1) / RECEPTOR_BATCH;
+	region.nextBatch = 0;
+
+	int numThreads = MThreadUtils::getNumThreads();
+	if( numThreads < 1 )
+		numThreads = 1;
+	region.numTasks = region.numBatches < numThreads ?
+						region.numBatches : numThreads;
+
+	if( region.numTasks <= 1 || MS::kSuccess != MThreadPool::init() )
+	{
+		applyToBatches( &region );
 	}
 	else
 	{
-		// Max dist applies, but not attenuation.
-		//
-		for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
-		{
-			const MVector & receptorPoint = points[ptIndex];
+		MThreadPool::newParallelRegion( decomposeBatches, &region );
 
-			// Apply from every field position to every receptor position.
-			//
-			MVector forceV(0,0,0);
-			MVector sumForceV(0,0,0);
-			int i;
-			for(i = fieldPosCount; --i>=0; )
-			{
-				MVector difference = (receptorPoint-posArray[i]);
-				double distance = difference.length();
-				if (distance < minDist || distance > maxDist) continue;
-
-				if (distance <= repelDist)
-					forceV = difference * magValue;
-				else if (distance >= attractDist)
-					forceV = -difference * magValue;
-
-				// Apply drag and swarm if the object is inside
-				// the zone the repulsion-attraction is pushing the
-				// object to, and if they are set.
-				//
-				if ( distance >= repelDist && distance <= attractDist)
-				{
-					if (fieldPosCount > 0 && dragMag > 0)
-					{
-						MVector dragForceV;
-						dragForceV = velocities[ptIndex] *
-											(-dragMag) * fieldPosCount;
-						forceV += dragForceV;
-					}
-
-					// Add swarm if swarm aplitude is set.
-					//
-					if (swarmAmp > 0)
-					{
-						double frequency = swarmFrequencyValue( block );
-						MVector phase( 0.0, 0.0, swarmPhaseValue(block) );
-
-						for(i = fieldPosCount; --i >= 0;)
-						{
-							difference = receptorPoint - posArray[i];
-							difference = (difference + phase) * frequency;
-							double *noiseEffect = &difference.x;
-							if( (noiseEffect[0] < -2147483647.0) ||
-								(noiseEffect[0] >  2147483647.0) ||
-								(noiseEffect[1] < -2147483647.0) ||
-								(noiseEffect[1] >  2147483647.0) ||
-								(noiseEffect[2] < -2147483647.0) ||
-								(noiseEffect[2] >  2147483647.0) )
-								continue;
-
-							double noiseOut[4];
-							noiseFunction( noiseEffect, noiseOut );
-							MVector swarmForce( noiseOut[0] * swarmAmp,
-												noiseOut[1] * swarmAmp,
-												noiseOut[2] * swarmAmp );
-
-							forceV += swarmForce;
-						}
-					}
-				}
-				if (maxDist > 0.0) forceV *= falloffCurve(distance/maxDist);
-				sumForceV += forceV;
-			}
-			outputForce.append( sumForceV );
-		}
+		// release the reference taken by init()
+		MThreadPool::release();
 	}
 }
 
@@ -824,15 +907,7 @@ MStatus torusField::getForceAtPoint(const MVectorArray&	points,
 {
 	MDataBlock block = forceCache();
 
-	bool useMaxDistSet = useMaxDistanceValue( block );
-	if( useMaxDistSet )
-	{
-		applyMaxDist( block, points, velocities, masses, forceArray );
-	}
-	else
-	{
-		applyNoMaxDist( block, points, velocities, masses, forceArray );
-	}
+	applyForce( block, points, velocities, masses, forceArray );
 
     return MS::kSuccess;
 }
@@ -884,8 +959,14 @@ MStatus torusField::iconBitmap(GLubyte* bitmap)
 #define rand3c(x,y,z)	frand(89*(x)+97*(y)+101*(z))
 #define rand3d(x,y,z)	frand(103*(x)+107*(y)+109*(z))
 
-int		xlim[3][2];		// integer bound for point
-double	xarg[3];		// fractional part
+// The lattice cell a noise lookup falls in. It is local to each lookup
+// so that receptors can be evaluated from several threads at once.
+//
+struct noiseLattice
+{
+	int		xlim[3][2];		// integer bound for point
+	double	xarg[3];		// fractional part
+};
 
 double frand( register int s )   // get random number from seed
 {
@@ -904,7 +985,7 @@ double hermite( double p0, double p1, double r0, double r1, double t )
 	return(p0*(_2t3-_3t2+1) + p1*(-_2t3+_3t2) + r0*(t3-2.*t2+t) + r1*(t3-t2));
 }
 
-void interpolate( double f[4], register int i, register int n )
+void interpolate( const noiseLattice &l, double f[4], register int i, register int n )
 //
 //	f[] returned tangent and value *
 //	i   location ?
@@ -915,46 +996,47 @@ void interpolate( double f[4], register int i, register int n )
 
 	if( n == 0 )	// at 0, return lattice value
 	{
-		f[0] = rand3a( xlim[0][i&1], xlim[1][i>>1&1], xlim[2][i>>2] );
-		f[1] = rand3b( xlim[0][i&1], xlim[1][i>>1&1], xlim[2][i>>2] );
-		f[2] = rand3c( xlim[0][i&1], xlim[1][i>>1&1], xlim[2][i>>2] );
-		f[3] = rand3d( xlim[0][i&1], xlim[1][i>>1&1], xlim[2][i>>2] );
+		f[0] = rand3a( l.xlim[0][i&1], l.xlim[1][i>>1&1], l.xlim[2][i>>2] );
+		f[1] = rand3b( l.xlim[0][i&1], l.xlim[1][i>>1&1], l.xlim[2][i>>2] );
+		f[2] = rand3c( l.xlim[0][i&1], l.xlim[1][i>>1&1], l.xlim[2][i>>2] );
+		f[3] = rand3d( l.xlim[0][i&1], l.xlim[1][i>>1&1], l.xlim[2][i>>2] );
 		return;
 	}
 
 	n--;
-	interpolate( f0, i, n );		// compute first half
-	interpolate( f1, i| 1<<n, n );	// compute second half
+	interpolate( l, f0, i, n );			// compute first half
+	interpolate( l, f1, i| 1<<n, n );	// compute second half
 
 	// use linear interpolation for slopes
 	//
-	f[0] = (1. - xarg[n]) * f0[0] + xarg[n] * f1[0];
-	f[1] = (1. - xarg[n]) * f0[1] + xarg[n] * f1[1];
-	f[2] = (1. - xarg[n]) * f0[2] + xarg[n] * f1[2];
+	f[0] = (1. - l.xarg[n]) * f0[0] + l.xarg[n] * f1[0];
+	f[1] = (1. - l.xarg[n]) * f0[1] + l.xarg[n] * f1[1];
+	f[2] = (1. - l.xarg[n]) * f0[2] + l.xarg[n] * f1[2];
 
 	// use hermite interpolation for values
 	//
-	f[3] = hermite( f0[3], f1[3], f0[n], f1[n], xarg[n] );
+	f[3] = hermite( f0[3], f1[3], f0[n], f1[n], l.xarg[n] );
 }
 
 void torusField::noiseFunction( double *inNoise, double *out )
 //
 //	Descriptions:
-//		A noise function.
+//		A noise function. Safe to call from several threads at once.
 //
 {
-	xlim[0][0] = (int)floor( inNoise[0] );
-	xlim[0][1] = xlim[0][0] + 1;
-	xlim[1][0] = (int)floor( inNoise[1] );
-	xlim[1][1] = xlim[1][0] + 1;
-	xlim[2][0] = (int)floor( inNoise[2] );
-	xlim[2][1] = xlim[2][0] + 1;
-
-	xarg[0] = inNoise[0] - xlim[0][0];
-	xarg[1] = inNoise[1] - xlim[1][0];
-	xarg[2] = inNoise[2] - xlim[2][0];
-
-	interpolate( out, 0, 3 ) ;
+	noiseLattice l;
+	l.xlim[0][0] = (int)floor( inNoise[0] );
+	l.xlim[0][1] = l.xlim[0][0] + 1;
+	l.xlim[1][0] = (int)floor( inNoise[1] );
+	l.xlim[1][1] = l.xlim[1][0] + 1;
+	l.xlim[2][0] = (int)floor( inNoise[2] );
+	l.xlim[2][1] = l.xlim[2][0] + 1;
+
+	l.xarg[0] = inNoise[0] - l.xlim[0][0];
+	l.xarg[1] = inNoise[1] - l.xlim[1][0];
+	l.xarg[2] = inNoise[2] - l.xlim[2][0];
+
+	interpolate( l, out, 0, 3 ) ;
 }
 
 #define TORUS_PI 3.14159265
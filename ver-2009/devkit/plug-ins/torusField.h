@@ -105,26 +105,23 @@ public:
 	//
 	static MTypeId	id;
 
+	// noise used for the swarm force.
+	//
+	static void		noiseFunction( double *inputNoise, double *out );
+
 private:
 
-	// methods to compute output force.
+	// method to compute output force.
 	//
-	void	applyNoMaxDist( MDataBlock& block,
-							const MVectorArray &points,
-							const MVectorArray &velocities,
-							const MDoubleArray &masses,
-							MVectorArray &outputForce );
-
-	void	applyMaxDist( MDataBlock& block,
-							const MVectorArray &points,
-							const MVectorArray &velocities,
-							const MDoubleArray &masses,
-							MVectorArray &outputForce );
+	void	applyForce( MDataBlock& block,
+						const MVectorArray &points,
+						const MVectorArray &velocities,
+						const MDoubleArray &masses,
+						MVectorArray &outputForce );
 
 	void	ownerPosition( MDataBlock& block, MVectorArray &vArray );
 	MStatus	getWorldPosition( MVector &vector );
 	MStatus	getWorldPosition( MDataBlock& block, MVector &vector );
-	void	noiseFunction( double *inputNoise, double *out );
 
 	// methods to get attribute value.
 	//
@@ -0,0 +1,511 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+//
+//  File: triangleBVH.cpp
+//
+//  Description:
+//		Refittable bounding volume hierarchy over triangles.
+//		See triangleBVH.h.
+//
+
+#include <float.h>
+#include <algorithm>
+
+#include "triangleBVH.h"
+
+// Maximum number of triangles in a leaf
+//
+#define BVH_LEAF_SIZE		4
+
+// Traversal stack size kept on the program stack. The tree is split at
+// the median, so its depth is about log2(triangles / BVH_LEAF_SIZE);
+// deeper trees get a stack from the heap.
+//
+#define BVH_STACK_SIZE		64
+
+// Orders triangles by their centroid along one axis.
+//
+struct triangleBVHCentroidLess
+{
+	triangleBVHCentroidLess( const std::vector<double>& c, int a )
+	:	centroids( c ), axis( a ) {}
+
+	bool operator()( int t0, int t1 ) const
+	{
+		return centroids[3*t0 + axis] < centroids[3*t1 + axis];
+	}
+
+	const std::vector<double>&	centroids;
+	int							axis;
+};
+
+static inline double boxDistanceSquared( const double p[3],
+										 const double bmin[3],
+										 const double bmax[3] )
+{
+	double d = 0.0;
+	for( int k = 0; k < 3; k++ ) {
+		double v = 0.0;
+		if( p[k] < bmin[k] )		v = bmin[k] - p[k];
+		else if( p[k] > bmax[k] )	v = p[k] - bmax[k];
+		d += v * v;
+	}
+	return d;
+}
+
+static inline bool boxesOverlap( const double amin[3], const double amax[3],
+								 const double bmin[3], const double bmax[3] )
+{
+	return amin[0] <= bmax[0] && amax[0] >= bmin[0] &&
+		   amin[1] <= bmax[1] && amax[1] >= bmin[1] &&
+		   amin[2] <= bmax[2] && amax[2] >= bmin[2];
+}
+
+triangleBVH::triangleBVH()
+:	fDepth( 0 ),
+	fTopologyKey( 0 )
+{
+}
+
+triangleBVH::~triangleBVH()
+{
+}
+
+void triangleBVH::clear()
+{
+	fNodes.clear();
+	fTriangles.clear();
+	fOrder.clear();
+	fPoints.clear();
+	fPreviousPoints.clear();
+	fDepth = 0;
+	fTopologyKey = 0;
+}
+
+void triangleBVH::build( const MPointArray& points,
+						 const MIntArray& triangleVertices )
+{
+	clear();
+
+	unsigned int nPoints = points.length();
+	fTopologyKey = topologyKey( nPoints, triangleVertices );
+	fPoints.resize( 3 * nPoints );
+	for( unsigned int i = 0; i < nPoints; i++ ) {
+		const MPoint& pt = points[i];
+		fPoints[3*i+0] = pt.x;
+		fPoints[3*i+1] = pt.y;
+		fPoints[3*i+2] = pt.z;
+	}
+
+	int nTriangles = (int) triangleVertices.length() / 3;
+	if( nTriangles == 0 ) return;
+
+	fTriangles.resize( 3 * nTriangles );
+	for( int i = 0; i < 3 * nTriangles; i++ ) {
+		fTriangles[i] = triangleVertices[i];
+	}
+
+	std::vector<double> centroids( 3 * nTriangles );
+	fOrder.resize( nTriangles );
+	for( int t = 0; t < nTriangles; t++ ) {
+		const double* a = &fPoints[3 * fTriangles[3*t+0]];
+		const double* b = &fPoints[3 * fTriangles[3*t+1]];
+		const double* c = &fPoints[3 * fTriangles[3*t+2]];
+		for( int k = 0; k < 3; k++ ) {
+			centroids[3*t+k] = (a[k] + b[k] + c[k]) * (1.0 / 3.0);
+		}
+		fOrder[t] = t;
+	}
+
+	fNodes.reserve( 2 * (nTriangles / BVH_LEAF_SIZE + 1) );
+	buildNode( 0, nTriangles, 1, centroids );
+}
+
+bool triangleBVH::sameTopology( unsigned int numPoints,
+								const MIntArray& triangleVertices ) const
+{
+	if( fNodes.empty() || numPoints != this->numPoints() ) return false;
+
+	unsigned int n = triangleVertices.length();
+	if( n != (unsigned int) fTriangles.size() ) return false;
+	if( topologyKey( numPoints, triangleVertices ) != fTopologyKey ) return false;
+
+	// equal hashes do not prove equal triangles
+	for( unsigned int i = 0; i < n; i++ ) {
+		if( triangleVertices[i] != fTriangles[i] ) return false;
+	}
+	return true;
+}
+
+unsigned int triangleBVH::topologyKey( unsigned int numPoints,
+									   const MIntArray& triangleVertices )
+{
+	unsigned int hash = 2166136261u;
+	hash = (hash ^ numPoints) * 16777619u;
+	unsigned int n = triangleVertices.length();
+	for( unsigned int i = 0; i < n; i++ ) {
+		hash = (hash ^ (unsigned int) triangleVertices[i]) * 16777619u;
+	}
+	return hash;
+}
+
+int triangleBVH::buildNode( int first, int count, int depth,
+							std::vector<double>& centroids )
+{
+	int index = (int) fNodes.size();
+	fNodes.push_back( Node() );
+	fDepth = std::max( fDepth, depth );
+
+	Node node;
+	node.first = first;
+	node.count = count;
+
+	double cmin[3] = {  DBL_MAX,  DBL_MAX,  DBL_MAX };
+	double cmax[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+	for( int k = 0; k < 3; k++ ) {
+		node.bmin[k] = DBL_MAX;
+		node.bmax[k] = -DBL_MAX;
+	}
+	for( int i = first; i < first + count; i++ ) {
+		int t = fOrder[i];
+		double tmin[3], tmax[3];
+		triangleBounds( t, tmin, tmax );
+		for( int k = 0; k < 3; k++ ) {
+			node.bmin[k] = std::min( node.bmin[k], tmin[k] );
+			node.bmax[k] = std::max( node.bmax[k], tmax[k] );
+			cmin[k] = std::min( cmin[k], centroids[3*t+k] );
+			cmax[k] = std::max( cmax[k], centroids[3*t+k] );
+		}
+	}
+
+	// split along the longest axis of the centroid bounds
+	int axis = 0;
+	for( int k = 1; k < 3; k++ ) {
+		if( cmax[k] - cmin[k] > cmax[axis] - cmin[axis] ) axis = k;
+	}
+
+	if( count <= BVH_LEAF_SIZE || cmax[axis] <= cmin[axis] ) {
+		fNodes[index] = node;
+		return index;
+	}
+
+	int mid = first + count / 2;
+	std::nth_element( fOrder.begin() + first,
+					  fOrder.begin() + mid,
+					  fOrder.begin() + first + count,
+					  triangleBVHCentroidLess( centroids, axis ) );
+
+	// the left child always follows its parent
+	buildNode( first, mid - first, depth + 1, centroids );
+	node.first = buildNode( mid, first + count - mid, depth + 1, centroids );
+	node.count = 0;
+
+	fNodes[index] = node;
+	return index;
+}
+
+// A depth first traversal holds at most one pending sibling for each
+// level above the node it visits, plus that node's two children, so
+// fDepth entries are enough.
+//
+int* triangleBVH::traversalStack( int localStack[],
+								  std::vector<int>& heapStack ) const
+{
+	if( fDepth <= BVH_STACK_SIZE ) return localStack;
+	heapStack.resize( fDepth );
+	return &heapStack[0];
+}
+
+void triangleBVH::triangleBounds( int triangle, double bmin[3], double bmax[3] ) const
+{
+	const double* a = &fPoints[3 * fTriangles[3*triangle+0]];
+	const double* b = &fPoints[3 * fTriangles[3*triangle+1]];
+	const double* c = &fPoints[3 * fTriangles[3*triangle+2]];
+	for( int k = 0; k < 3; k++ ) {
+		bmin[k] = std::min( a[k], std::min( b[k], c[k] ) );
+		bmax[k] = std::max( a[k], std::max( b[k], c[k] ) );
+	}
+
+	if( !fPreviousPoints.empty() ) {
+		a = &fPreviousPoints[3 * fTriangles[3*triangle+0]];
+		b = &fPreviousPoints[3 * fTriangles[3*triangle+1]];
+		c = &fPreviousPoints[3 * fTriangles[3*triangle+2]];
+		for( int k = 0; k < 3; k++ ) {
+			bmin[k] = std::min( bmin[k], std::min( a[k], std::min( b[k], c[k] ) ) );
+			bmax[k] = std::max( bmax[k], std::max( a[k], std::max( b[k], c[k] ) ) );
+		}
+	}
+}
+
+bool triangleBVH::refit( const MPointArray& points )
+{
+	if( points.length() != numPoints() ) return false;
+
+	fPreviousPoints.clear();
+
+	unsigned int nPoints = points.length();
+	for( unsigned int i = 0; i < nPoints; i++ ) {
+		const MPoint& pt = points[i];
+		fPoints[3*i+0] = pt.x;
+		fPoints[3*i+1] = pt.y;
+		fPoints[3*i+2] = pt.z;
+	}
+
+	refitBounds();
+	return true;
+}
+
+bool triangleBVH::advance( const MPointArray& points )
+{
+	if( points.length() != numPoints() ) return false;
+
+	fPreviousPoints.swap( fPoints );
+	fPoints.resize( fPreviousPoints.size() );
+
+	unsigned int nPoints = points.length();
+	for( unsigned int i = 0; i < nPoints; i++ ) {
+		const MPoint& pt = points[i];
+		fPoints[3*i+0] = pt.x;
+		fPoints[3*i+1] = pt.y;
+		fPoints[3*i+2] = pt.z;
+	}
+
+	refitBounds();
+	return true;
+}
+
+void triangleBVH::refitBounds()
+{
+	// Children are always stored after their parent, so walking the
+	// nodes backwards visits both children before the parent.
+	for( int n = (int) fNodes.size() - 1; n >= 0; n-- ) {
+		Node& node = fNodes[n];
+		if( node.count > 0 ) {
+			for( int k = 0; k < 3; k++ ) {
+				node.bmin[k] = DBL_MAX;
+				node.bmax[k] = -DBL_MAX;
+			}
+			for( int i = node.first; i < node.first + node.count; i++ ) {
+				double tmin[3], tmax[3];
+				triangleBounds( fOrder[i], tmin, tmax );
+				for( int k = 0; k < 3; k++ ) {
+					node.bmin[k] = std::min( node.bmin[k], tmin[k] );
+					node.bmax[k] = std::max( node.bmax[k], tmax[k] );
+				}
+			}
+		} else {
+			const Node& left = fNodes[n+1];
+			const Node& right = fNodes[node.first];
+			for( int k = 0; k < 3; k++ ) {
+				node.bmin[k] = std::min( left.bmin[k], right.bmin[k] );
+				node.bmax[k] = std::max( left.bmax[k], right.bmax[k] );
+			}
+		}
+	}
+}
+
+double triangleBVH::closestOnTriangle( const double p[3], int triangle,
+									   double r[3] ) const
+{
+	const double* a;
+	const double* b;
+	const double* c;
+	double u, v;
+	this->triangle( triangle, a, b, c );
+	return closestPointOnTriangle( p, a, b, c, r, u, v );
+}
+
+double triangleBVH::closestPointOnTriangle( const double p[3],
+											const double a[3],
+											const double b[3],
+											const double c[3],
+											double r[3],
+											double& u, double& v )
+{
+	double ab[3], ac[3], ap[3];
+	for( int k = 0; k < 3; k++ ) {
+		ab[k] = b[k] - a[k];
+		ac[k] = c[k] - a[k];
+		ap[k] = p[k] - a[k];
+	}
+
+	double d1 = ab[0]*ap[0] + ab[1]*ap[1] + ab[2]*ap[2];
+	double d2 = ac[0]*ap[0] + ac[1]*ap[1] + ac[2]*ap[2];
+
+	if( d1 <= 0.0 && d2 <= 0.0 ) {
+		u = 0.0; v = 0.0;
+	} else {
+		double bp[3];
+		for( int k = 0; k < 3; k++ ) bp[k] = p[k] - b[k];
+		double d3 = ab[0]*bp[0] + ab[1]*bp[1] + ab[2]*bp[2];
+		double d4 = ac[0]*bp[0] + ac[1]*bp[1] + ac[2]*bp[2];
+
+		if( d3 >= 0.0 && d4 <= d3 ) {
+			u = 1.0; v = 0.0;
+		} else {
+			double vc = d1*d4 - d3*d2;
+			if( vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0 ) {
+				u = d1 / (d1 - d3); v = 0.0;
+			} else {
+				double cp[3];
+				for( int k = 0; k < 3; k++ ) cp[k] = p[k] - c[k];
+				double d5 = ab[0]*cp[0] + ab[1]*cp[1] + ab[2]*cp[2];
+				double d6 = ac[0]*cp[0] + ac[1]*cp[1] + ac[2]*cp[2];
+
+				if( d6 >= 0.0 && d5 <= d6 ) {
+					u = 0.0; v = 1.0;
+				} else {
+					double vb = d5*d2 - d1*d6;
+					if( vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0 ) {
+						u = 0.0; v = d2 / (d2 - d6);
+					} else {
+						double va = d3*d6 - d5*d4;
+						if( va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0 ) {
+							double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+							u = 1.0 - w; v = w;
+						} else {
+							double denom = 1.0 / (va + vb + vc);
+							u = vb * denom; v = vc * denom;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	double d = 0.0;
+	for( int k = 0; k < 3; k++ ) {
+		r[k] = a[k] + ab[k] * u + ac[k] * v;
+		double e = p[k] - r[k];
+		d += e * e;
+	}
+	return d;
+}
+
+bool triangleBVH::closestPoint( const MPoint& p,
+								MPoint& result,
+								int& triangle,
+								int hintTriangle ) const
+{
+	if( fNodes.empty() ) return false;
+
+	double q[3] = { p.x, p.y, p.z };
+	double best = DBL_MAX;
+	double bestPoint[3] = { 0.0, 0.0, 0.0 };
+	int bestTriangle = -1;
+
+	if( hintTriangle >= 0 && hintTriangle < (int) numTriangles() ) {
+		best = closestOnTriangle( q, hintTriangle, bestPoint );
+		bestTriangle = hintTriangle;
+	}
+
+	int localStack[BVH_STACK_SIZE];
+	std::vector<int> heapStack;
+	int* stack = traversalStack( localStack, heapStack );
+	int sp = 0;
+	stack[sp++] = 0;
+
+	while( sp > 0 ) {
+		int n = stack[--sp];
+		const Node& node = fNodes[n];
+		if( boxDistanceSquared( q, node.bmin, node.bmax ) >= best ) continue;
+
+		if( node.count > 0 ) {
+			for( int i = node.first; i < node.first + node.count; i++ ) {
+				int t = fOrder[i];
+				if( t == bestTriangle ) continue;
+				double r[3];
+				double d = closestOnTriangle( q, t, r );
+				if( d < best ) {
+					best = d;
+					bestTriangle = t;
+					bestPoint[0] = r[0]; bestPoint[1] = r[1]; bestPoint[2] = r[2];
+				}
+			}
+		} else {
+			// push the farther child first so the nearer one is
+			// searched first and tightens the radius
+			int left = n + 1;
+			int right = node.first;
+			double dl = boxDistanceSquared( q, fNodes[left].bmin, fNodes[left].bmax );
+			double dr = boxDistanceSquared( q, fNodes[right].bmin, fNodes[right].bmax );
+			if( dl > dr ) {
+				std::swap( left, right );
+				std::swap( dl, dr );
+			}
+			if( dr < best ) stack[sp++] = right;
+			if( dl < best ) stack[sp++] = left;
+		}
+	}
+
+	triangle = bestTriangle;
+	result = MPoint( bestPoint[0], bestPoint[1], bestPoint[2] );
+	return bestTriangle >= 0;
+}
+
+void triangleBVH::overlapping( const double bmin[3], const double bmax[3],
+							   double padding,
+							   std::vector<int>& triangles ) const
+{
+	triangles.clear();
+	if( fNodes.empty() ) return;
+
+	double qmin[3], qmax[3];
+	for( int k = 0; k < 3; k++ ) {
+		qmin[k] = bmin[k] - padding;
+		qmax[k] = bmax[k] + padding;
+	}
+
+	int localStack[BVH_STACK_SIZE];
+	std::vector<int> heapStack;
+	int* stack = traversalStack( localStack, heapStack );
+	int sp = 0;
+	stack[sp++] = 0;
+
+	while( sp > 0 ) {
+		int n = stack[--sp];
+		const Node& node = fNodes[n];
+		if( !boxesOverlap( node.bmin, node.bmax, qmin, qmax ) ) continue;
+
+		if( node.count > 0 ) {
+			for( int i = node.first; i < node.first + node.count; i++ ) {
+				int t = fOrder[i];
+				double tmin[3], tmax[3];
+				triangleBounds( t, tmin, tmax );
+				if( boxesOverlap( tmin, tmax, qmin, qmax ) ) {
+					triangles.push_back( t );
+				}
+			}
+		} else {
+			stack[sp++] = node.first;
+			stack[sp++] = n + 1;
+		}
+	}
+}
+
+void triangleBVH::triangle( int triangle, const double*& a,
+							const double*& b, const double*& c ) const
+{
+	a = &fPoints[3 * fTriangles[3*triangle+0]];
+	b = &fPoints[3 * fTriangles[3*triangle+1]];
+	c = &fPoints[3 * fTriangles[3*triangle+2]];
+}
+
+void triangleBVH::previousTriangle( int triangle, const double*& a,
+									const double*& b, const double*& c ) const
+{
+	const std::vector<double>& points =
+		fPreviousPoints.empty() ? fPoints : fPreviousPoints;
+	a = &points[3 * fTriangles[3*triangle+0]];
+	b = &points[3 * fTriangles[3*triangle+1]];
+	c = &points[3 * fTriangles[3*triangle+2]];
+}
@@ -0,0 +1,148 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _triangleBVH_h
+#define _triangleBVH_h
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// triangleBVH
+//
+// Axis aligned bounding volume hierarchy over a triangle list. Unlike
+// MMeshIntersector, the hierarchy can be refit in place when only the
+// vertex positions change, which is much cheaper than building it again.
+// Call build() when the triangle connectivity changes and refit() when
+// only the points move.
+//
+// For moving geometry, advance() keeps the points of the previous time
+// step as well, and the node bounds enclose each triangle over the whole
+// step, so a query finds every triangle that passed through a region.
+//
+// Queries are const and keep their traversal stack locally, so any
+// number of threads can query the same hierarchy at once.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+
+#include <maya/MPoint.h>
+#include <maya/MPointArray.h>
+#include <maya/MIntArray.h>
+
+class triangleBVH
+{
+public:
+						triangleBVH();
+						~triangleBVH();
+
+	// Build the hierarchy for the given points and triangle vertex
+	// indices (three per triangle, as returned by MFnMesh::getTriangles).
+	//
+	void				build( const MPointArray& points,
+							   const MIntArray& triangleVertices );
+
+	// Update the vertex positions and node bounds without changing the
+	// tree structure. Fails if the point count differs from build().
+	//
+	bool				refit( const MPointArray& points );
+
+	// Move on to the next time step: the current points become the
+	// previous ones and the bounds are refit to cover the motion from
+	// them to the new points. Fails if the point count differs.
+	//
+	bool				advance( const MPointArray& points );
+
+	// True if the hierarchy was built from this many points and exactly
+	// these triangle vertex indices, so refit() or advance() will do.
+	// The topologyKey() recorded by build() rules out most changes
+	// before the indices are compared one by one.
+	//
+	bool				sameTopology( unsigned int numPoints,
+									  const MIntArray& triangleVertices ) const;
+
+	// FNV-1a hash of the point count and triangle vertex indices.
+	//
+	static unsigned int	topologyKey( unsigned int numPoints,
+									 const MIntArray& triangleVertices );
+
+	void				clear();
+
+	bool				isBuilt() const		{ return !fNodes.empty(); }
+	bool				isSwept() const		{ return !fPreviousPoints.empty(); }
+	unsigned int		numTriangles() const	{ return (unsigned int) fTriangles.size() / 3; }
+	unsigned int		numPoints() const		{ return (unsigned int) fPoints.size() / 3; }
+
+	// Find the closest point on any triangle to p. If hintTriangle is a
+	// valid triangle index, the distance to it is used as the initial
+	// search radius; passing the result of a nearby query makes the
+	// search for coherent batches of points considerably cheaper.
+	// Returns false if the hierarchy is empty.
+	//
+	bool				closestPoint( const MPoint& p,
+									  MPoint& result,
+									  int& triangle,
+									  int hintTriangle = -1 ) const;
+
+	// Collect the triangles whose bounds (over the time step, if swept)
+	// overlap the box grown by padding on every side. The list is
+	// cleared first.
+	//
+	void				overlapping( const double bmin[3], const double bmax[3],
+									 double padding,
+									 std::vector<int>& triangles ) const;
+
+	// Vertex positions of a triangle at the end of the time step, and at
+	// its start (the same unless swept).
+	//
+	void				triangle( int triangle, const double*& a,
+								  const double*& b, const double*& c ) const;
+	void				previousTriangle( int triangle, const double*& a,
+										  const double*& b, const double*& c ) const;
+
+	// Closest point to p on the triangle abc, from Ericson, "Real-Time
+	// Collision Detection", 5.1.5. Returns the squared distance; the
+	// result is a + u (b - a) + v (c - a).
+	//
+	static double		closestPointOnTriangle( const double p[3],
+												const double a[3],
+												const double b[3],
+												const double c[3],
+												double result[3],
+												double& u, double& v );
+
+private:
+	struct Node
+	{
+		double			bmin[3];
+		double			bmax[3];
+		int				first;		// leaf: first entry in fOrder, else right child
+		int				count;		// leaf: number of triangles, else 0
+	};
+
+	int					buildNode( int first, int count, int depth,
+								   std::vector<double>& centroids );
+	int*				traversalStack( int localStack[],
+										std::vector<int>& heapStack ) const;
+	void				triangleBounds( int triangle, double bmin[3], double bmax[3] ) const;
+	void				refitBounds();
+	double				closestOnTriangle( const double p[3], int triangle,
+										   double result[3] ) const;
+
+	std::vector<Node>	fNodes;
+	std::vector<int>	fTriangles;		// 3 vertex indices per triangle
+	std::vector<int>	fOrder;			// triangle indices in leaf order
+	std::vector<double>	fPoints;		// xyz per vertex
+	std::vector<double>	fPreviousPoints;	// xyz per vertex, if swept
+	int					fDepth;			// nodes on the longest root to leaf path
+	unsigned int		fTopologyKey;	// topologyKey() of the build() input
+};
+
+#endif